@@ -0,0 +1,502 @@
+// C++ port of Nupic HTM with the aim of being lite and fast
+//
+// Copyright (c) 2017 Henk-Jan Lebbink
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero Public License version 3 as
+// published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero Public License for more details.
+//
+// You should have received a copy of the GNU Affero Public License
+// along with this program.  If not, see http://www.gnu.org/licenses.
+
+// Benchmark of the kernels (reference, AVX2 and AVX512 as far as supported by the cpu) for a number of static
+// parameters, and of layer::run on the datasets in Misc/data. The results are written to a JSON file; when a
+// baseline JSON file is provided the results are compared with it and the exit code is 1 when a result is slower
+// than the threshold allows or computed a different check value than the baseline, and 0 otherwise.
+//
+// usage: HTM-Lite-Bench [options]
+//   --out <file>          write the results to file (default bench.json)
+//   --baseline <file>     compare the results with the provided baseline
+//   --compare <a> <b>     only compare result file b with baseline a
+//   --threshold <f>       relative slowdown that is flagged (default 0.1 = 10%)
+//   --runs <n>            number of timed runs per kernel (default 10)
+//   --warmup <n>          number of time steps to learn before the kernels are timed (default 200)
+//   --steps <n>           number of time steps of layer::run (default 1000)
+//   --data <dir>          directory with the datasets (default ../../Misc/data)
+//   --filter <str>        only run benchmarks whose name contains str
+//   --kernels / --layers  only run the kernel or the layer benchmarks
+//   --pages               also run layer::run of a large layer for every page policy of the layer storage
+//   --tp                  also time the dendrite activation of a 65536 column layer that learned --steps time steps
+//                         (and log its learning steps/sec, slab slots and the peak RSS of the process)
+//   --numa <placement>    NUMA placement of the page policies: first_touch (default), local, or a node number
+//   --threads <n>         number of threads of layer::run in the page benchmarks (default 1)
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+#include <filesystem>
+
+#include "..\Spike-Tools-Lib\log.ipp"
+#include "..\Spike-Tools-Lib\timing.ipp"
+#include "..\Spike-Tools-Lib\benchmark.ipp"
+
+#include "..\HTM-Lite-LIB\parameters.ipp"
+#include "..\HTM-Lite-LIB\types.ipp"
+#include "..\HTM-Lite-LIB\layer.ipp"
+#include "..\HTM-Lite-LIB\datastream.ipp"
+
+using namespace htm;
+using namespace htm::types;
+using namespace htm::datastream;
+using ::tools::benchmark::Result;
+
+struct Bench_Options
+{
+	std::string out_filename = "bench.json";
+	std::string baseline_filename;
+	double threshold = 0.1;
+	int n_runs = 10;
+	int n_warmup_steps = 200;
+	int n_time_steps = 1000;
+	std::string data_dir = "../../Misc/data";
+	std::string filter;
+	bool kernels = true;
+	bool layers = true;
+	bool pages = false;
+	bool tp = false;
+	::tools::allocator::numa_t numa = ::tools::allocator::numa_t::FIRST_TOUCH;
+	int numa_node = 0;
+	int n_threads = 1;
+};
+
+//Static parameters with the synapse backward spatial pooler.
+template <typename P_IN>
+struct Static_Param_SP_Synapse_Backward : P_IN
+{
+	static constexpr bool SP_SYNAPSE_FORWARD = false;
+};
+
+//Dynamic parameters of test_1layer; the same for every benchmark such that results of different runs can be compared.
+inline Dynamic_Param bench_param(const int dim1, const int dim2, const int n_time_steps)
+{
+	Dynamic_Param param;
+	param.learn = true;
+	param.quiet = true;
+	param.n_time_steps = n_time_steps;
+	param.n_times = 1;
+	param.n_visible_sensors_dim1 = dim1;
+	param.n_visible_sensors_dim2 = dim2;
+
+	param.SP_LOCAL_AREA_DENSITY = 0.1f;
+	param.SP_PD_PERMANENCE_INIT = 6;
+	param.SP_PD_PERMANENCE_INC = 7;
+	param.SP_PD_PERMANENCE_DEC = 23;
+	param.SP_PD_PERMANENCE_INC_WEAK = 18;
+
+	param.TP_DD_PERMANENCE_INIT = 12;
+	param.TP_DD_PERMANENCE_INC = 26;
+	param.TP_DD_PERMANENCE_DEC = 15;
+	param.TP_DD_PREDICTED_SEGMENT_DEC = 15;
+
+	param.TP_DD_SEGMENT_ACTIVE_THRESHOLD = 22;
+	param.TP_MIN_DD_ACTIVATION_THRESHOLD = 16;
+	param.TP_DD_MAX_NEW_SYNAPSE_COUNT = 27;
+	return param;
+}
+
+//Seed the columns with fixed random numbers instead of rdrand, such that every run starts with the same layer.
+template <typename P>
+void seed_columns(Layer_Fluent<P>& layer_fluent)
+{
+	unsigned int random_number = 0x1234567;
+	for (auto& r : layer_fluent.random_number)
+	{
+		random_number = ::tools::random::next_rand(random_number);
+		r = random_number;
+	}
+}
+
+inline bool selected(const Bench_Options& options, const std::string& name)
+{
+	return options.filter.empty() || (name.find(options.filter) != std::string::npos);
+}
+
+//Time the kernels of the spatial and temporal pooler for the static parameters P on the state of a layer that has
+//learned the ABBCBBA sequence for a number of time steps. Kernels that learn are timed with zero increments and
+//decrements such that every run sees the same permanences.
+template <typename P>
+void bench_kernels(const Bench_Options& options, std::vector<Result>& results)
+{
+	static_assert(P::N_VISIBLE_SENSORS == 20 * 20, "ERROR: bench_kernels: the kernels are timed on the 20x20 ABBCBBA dataset.");
+	using P_SB = Static_Param_SP_Synapse_Backward<P>;
+	const std::string config = std::to_string(P::N_COLUMNS) + "x" + std::to_string(P::N_BITS_CELL) + "x" + std::to_string(P::HISTORY_SIZE);
+	const arch_t arch = architecture_switch(arch_t::RUNTIME);
+	const bool avx2 = (arch == arch_t::AVX2) || (arch == arch_t::AVX512);
+	const bool avx512 = (arch == arch_t::AVX512);
+
+	const std::string filename = options.data_dir + "/ABBCBBA_20x20/input.txt";
+	if (!std::filesystem::exists(filename))
+	{
+		log_WARNING("bench_kernels: could not find file ", filename, ".\n");
+		return;
+	}
+	Dynamic_Param param = bench_param(20, 20, options.n_warmup_steps);
+	DataStream<P> datastream;
+	datastream.load_from_file(filename, param);
+
+	auto layer = std::make_unique<Layer_Persisted<P>>();
+	auto layer_fluent = std::make_unique<Layer_Fluent<P>>();
+	seed_columns(*layer_fluent);
+	layer::init(*layer_fluent, *layer, param);
+	std::vector<int> prediction_mismatch(1);
+	layer::run(datastream, param, *layer_fluent, *layer, prediction_mismatch);
+
+	auto layer_sb = std::make_unique<Layer_Persisted<P_SB>>();
+	auto layer_fluent_sb = std::make_unique<Layer_Fluent<P_SB>>();
+	seed_columns(*layer_fluent_sb);
+	layer::init(*layer_fluent_sb, *layer_sb, param);
+
+	const int time = options.n_warmup_steps;
+	const auto active_sensors = layer_fluent->active_sensors;
+	const auto active_columns = layer_fluent->active_columns;
+	const auto active_cells = layer_fluent->active_cells;
+	const auto boosted_overlap = layer_fluent->sp_boosted_overlap;
+	const int inhibition_top = static_cast<int>(P::N_COLUMNS * param.SP_LOCAL_AREA_DENSITY);
+
+	Dynamic_Param param_no_learn = param;
+	param_no_learn.SP_PD_PERMANENCE_INC = 0;
+	param_no_learn.SP_PD_PERMANENCE_DEC = 0;
+
+	std::vector<int> overlaps(P::N_COLUMNS);
+	typename Layer_Fluent<P>::Active_Columns active_columns_out;
+
+	auto bench = [&](const std::string& kernel, const bool supported, const auto& f)
+	{
+		const std::string name = kernel + "/" + config;
+		if (!supported || !selected(options, name)) return;
+		results.push_back(::tools::benchmark::measure(name, options.n_runs, f));
+		log_INFO("bench_kernels: ", name, ": ", results.back().median_ns / 1000, " us\n");
+	};
+
+	{
+		using namespace sp::priv::calc_overlap;
+		bench("sp.calc_overlap_sb_ref", true, [&]() { std::fill(overlaps.begin(), overlaps.end(), 0); synapse_backward::calc_overlap_sb_ref(*layer_sb, param, active_sensors, overlaps); });
+		bench("sp.calc_overlap_sf_ref", true, [&]() { synapse_forward::calc_overlap_sf_ref(*layer, param, active_sensors, overlaps); });
+		bench("sp.calc_overlap_sf_avx2", avx2, [&]() { synapse_forward::calc_overlap_sf_avx2(*layer, param, active_sensors, overlaps); });
+		bench("sp.calc_overlap_sf_avx512", avx512, [&]() { synapse_forward::calc_overlap_sf_avx512(*layer, param, active_sensors, overlaps); });
+		bench("sp.calc_overlap_avx512_sf_small_epi32", avx512, [&]() { synapse_forward::calc_overlap_avx512_sf_small_epi32(*layer, param, active_sensors, overlaps); });
+		bench("sp.calc_overlap_avx512_sf_small_epi16", avx512, [&]() { synapse_forward::calc_overlap_avx512_sf_small_epi16(*layer, param, active_sensors, overlaps); });
+	}
+	{
+		using namespace sp::priv::inhibit_columns;
+		bench("sp.active_columns_ref1", true, [&]() { active_columns_ref1<P>(boosted_overlap, inhibition_top, active_columns_out); });
+		bench("sp.active_columns_ref2", true, [&]() { active_columns_ref2<P>(boosted_overlap, inhibition_top, active_columns_out); });
+		bench("sp.active_columns_ref3", true, [&]() { active_columns_ref3<P>(boosted_overlap, inhibition_top, active_columns_out, layer_fluent->sp_inhibition_values); });
+		bench("sp.active_columns_ref4", true, [&]() { active_columns_ref4<P>(boosted_overlap, inhibition_top, active_columns_out, layer_fluent->sp_inhibition_values); });
+		bench("sp.active_columns_top_k_ref", true, [&]() { active_columns_top_k_ref<P>(boosted_overlap, inhibition_top, *layer_fluent, active_columns_out); });
+		bench("sp.active_columns_top_k_avx2", avx2, [&]() { active_columns_top_k_avx2<P>(boosted_overlap, inhibition_top, *layer_fluent, active_columns_out); });
+		bench("sp.active_columns_top_k_avx512", avx512, [&]() { active_columns_top_k_avx512<P>(boosted_overlap, inhibition_top, *layer_fluent, active_columns_out); });
+	}
+	{
+		// update_synapses_is_avx512 is not timed: it is not used by the dispatcher and does not compile for the
+		// current synapse backward layout.
+		using namespace sp::priv::update_synapses;
+		bench("sp.update_synapses_sb_ref", true, [&]() { synapse_backward::update_synapses_sb_ref(*layer_sb, param_no_learn, active_columns, active_sensors); });
+		bench("sp.update_synapses_sf_ref", true, [&]() { synapse_forward::update_synapses_sf_ref(*layer, param_no_learn, active_columns, active_sensors); });
+		bench("sp.update_synapses_sf_avx2", avx2, [&]() { synapse_forward::update_synapses_sf_avx2(*layer, param_no_learn, active_columns, active_sensors); });
+	}
+	{
+		using namespace tp::priv::activate_dendrites::synapse_forward;
+		bench("tp.activate_dendrites_sf_ref", true, [&]() { activate_dendrites_sf_ref<true>(*layer_fluent, *layer, time, active_cells, param); });
+		bench("tp.activate_dendrites_sf_avx2", avx2, [&]() { activate_dendrites_sf_avx2<true>(*layer_fluent, *layer, time, active_cells, param); });
+		bench("tp.activate_dendrites_sf_avx512", avx512, [&]() { activate_dendrites_sf_avx512<true>(*layer_fluent, *layer, time, active_cells, param); });
+	}
+	{
+		// every segment of every column is adapted
+		using namespace tp::priv::activate_cells::adapt_segment;
+		const auto for_each_segment = [&](const auto& adapt)
+		{
+			for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+			{
+				for (int segment_i = 0; segment_i < layer->dd_segment_count[column_i]; ++segment_i) adapt(column_i, segment_i);
+			}
+		};
+		bench("tp.adapt_segment_ref", true, [&]() { for_each_segment([&](const int column_i, const int segment_i) { adapt_segment_ref(*layer, column_i, segment_i, active_cells, 0, 0); }); });
+		bench("tp.adapt_segment_avx2", avx2, [&]() { for_each_segment([&](const int column_i, const int segment_i) { adapt_segment_avx2(*layer, column_i, segment_i, active_cells, 0, 0); }); });
+		bench("tp.adapt_segment_avx512", avx512, [&]() { for_each_segment([&](const int column_i, const int segment_i) { adapt_segment_avx512(*layer, column_i, segment_i, active_cells, 0, 0); }); });
+	}
+}
+
+//Time layer::run on the dataset in directory name; the check value of the result is the prediction mismatch.
+template <int DIM1, int DIM2>
+void bench_layer(const Bench_Options& options, const std::string& name, std::vector<Result>& results)
+{
+	using P = Static_Param<64 * 32, 4, DIM1 * DIM2, 0, 1, arch_t::RUNTIME>;
+	const std::string result_name = "layer.run/" + name;
+	if (!selected(options, result_name)) return;
+
+	const std::string filename = options.data_dir + "/" + name + "/input.txt";
+	if (!std::filesystem::exists(filename))
+	{
+		log_WARNING("bench_layer: could not find file ", filename, ".\n");
+		return;
+	}
+	const Dynamic_Param param = bench_param(DIM1, DIM2, options.n_time_steps);
+	DataStream<P> datastream;
+	datastream.load_from_file(filename, param);
+
+	auto layer = std::make_unique<Layer_Persisted<P>>();
+	auto layer_fluent = std::make_unique<Layer_Fluent<P>>();
+	std::vector<int> prediction_mismatch(1);
+	auto result = ::tools::benchmark::measure(result_name, std::max(1, options.n_runs / 4), [&]()
+	{
+		seed_columns(*layer_fluent);
+		layer::init(*layer_fluent, *layer, param);
+		datastream.reset_time();
+		layer::run(datastream, param, *layer_fluent, *layer, prediction_mismatch);
+	});
+	result.check = prediction_mismatch[0];
+	results.push_back(result);
+	log_INFO("bench_layer: ", result_name, ": ", result.median_ns / 1e6, " ms; ", options.n_time_steps * 1e9 / result.median_ns, " steps/sec; mismatch ", result.check, "\n");
+}
+
+//Time layer::run on every dataset in the data directory; the name of a dataset ends with its dimensions, eg. ABBCBB_20x20.
+inline void bench_layers(const Bench_Options& options, std::vector<Result>& results)
+{
+	std::vector<std::string> names;
+	for (const auto& entry : std::filesystem::directory_iterator(options.data_dir))
+	{
+		if (entry.is_directory()) names.push_back(entry.path().filename().string());
+	}
+	std::sort(names.begin(), names.end());
+
+	for (const auto& name : names)
+	{
+		const std::string dim = name.substr(name.rfind('_') + 1);
+		if (dim == "3x1") bench_layer<3, 1>(options, name, results);
+		else if (dim == "3x2") bench_layer<3, 2>(options, name, results);
+		else if (dim == "3x3") bench_layer<3, 3>(options, name, results);
+		else if (dim == "16x16") bench_layer<16, 16>(options, name, results);
+		else if (dim == "20x20") bench_layer<20, 20>(options, name, results);
+		else if (dim == "40x40") bench_layer<40, 40>(options, name, results);
+		else log_WARNING("bench_layers: dataset ", name, " is skipped: no static parameters for dimensions ", dim, ".\n");
+	}
+}
+
+//Time layer::run of a layer with N_COLUMNS columns on the dataset in directory name for every page policy of the
+//layer storage. Besides the time, the data TLB misses and page faults per time step of the last run (when the OS
+//exposes them) and the pages of the pool are reported; the check value of a result is the prediction mismatch.
+template <int N_COLUMNS, int DIM1, int DIM2>
+void bench_pages(const Bench_Options& options, const std::string& name, std::vector<Result>& results)
+{
+	using P = Static_Param<N_COLUMNS, 4, DIM1 * DIM2, 0, 1, arch_t::RUNTIME>;
+	using ::tools::allocator::page_t;
+	using ::tools::benchmark::event_t;
+
+	const std::string filename = options.data_dir + "/" + name + "/input.txt";
+	if (!std::filesystem::exists(filename))
+	{
+		log_WARNING("bench_pages: could not find file ", filename, ".\n");
+		return;
+	}
+	Dynamic_Param param = bench_param(DIM1, DIM2, options.n_time_steps);
+	param.n_threads = options.n_threads;
+	DataStream<P> datastream;
+	datastream.load_from_file(filename, param);
+
+	const std::pair<std::string, page_t> pages[] = { { "none", page_t::NONE }, { "small", page_t::SMALL }, { "thp", page_t::TRANSPARENT_HUGE }, { "hugetlb", page_t::HUGETLB } };
+	for (const auto& page : pages)
+	{
+		const std::string result_name = "pages." + page.first + "/" + name + "/" + std::to_string(N_COLUMNS);
+		if (!selected(options, result_name)) continue;
+
+		::tools::allocator::Page_Policy policy;
+		policy.page = page.second;
+		policy.numa = options.numa;
+		policy.numa_node = options.numa_node;
+		::tools::allocator::set_page_policy(policy);
+		{
+			auto layer = std::make_unique<Layer_Persisted<P>>();
+			auto layer_fluent = std::make_unique<Layer_Fluent<P>>();
+			std::vector<int> prediction_mismatch(1);
+			::tools::benchmark::Event_Counter dtlb_misses(event_t::DTLB_LOAD_MISSES);
+			::tools::benchmark::Event_Counter page_faults(event_t::PAGE_FAULTS);
+			int64_t n_dtlb_misses = -1;
+			int64_t n_page_faults = -1;
+
+			auto result = ::tools::benchmark::measure(result_name, std::max(1, options.n_runs / 4), [&]()
+			{
+				seed_columns(*layer_fluent);
+				layer::init(*layer_fluent, *layer, param);
+				datastream.reset_time();
+				dtlb_misses.start();
+				page_faults.start();
+				layer::run(datastream, param, *layer_fluent, *layer, prediction_mismatch);
+				n_dtlb_misses = dtlb_misses.stop();
+				n_page_faults = page_faults.stop();
+			});
+			result.check = prediction_mismatch[0];
+			results.push_back(result);
+
+			const double n_steps = options.n_time_steps;
+			log_INFO("bench_pages: ", result_name, ": ", result.median_ns / 1e6, " ms; ", n_steps * 1e9 / result.median_ns, " steps/sec; mismatch ", result.check,
+				"; dTLB misses/step ", ((n_dtlb_misses < 0) ? std::string("n/a") : std::to_string(n_dtlb_misses / n_steps)),
+				"; page faults/step ", ((n_page_faults < 0) ? std::string("n/a") : std::to_string(n_page_faults / n_steps)), "\n");
+			if (page.second != page_t::NONE) log_INFO("bench_pages: ", result_name, ": ", ::tools::allocator::page_stats().to_string(), "\n");
+		}
+		::tools::allocator::set_page_policy(::tools::allocator::Page_Policy());
+	}
+}
+
+//Time the dendrite activation kernels of a layer with N_COLUMNS columns that has learned the dataset in directory
+//name for options.n_time_steps time steps. With many columns and segments the time step is dominated by the temporal
+//pooler, and the kernels walk the distal segment slabs of all columns; the check value of a result is the number
+//of distal synapses of the layer.
+template <int N_COLUMNS, int DIM1, int DIM2>
+void bench_tp(const Bench_Options& options, const std::string& name, std::vector<Result>& results)
+{
+	using P = Static_Param<N_COLUMNS, 4, DIM1 * DIM2, 0, 1, arch_t::RUNTIME>;
+	const arch_t arch = architecture_switch(arch_t::RUNTIME);
+	const bool avx2 = (arch == arch_t::AVX2) || (arch == arch_t::AVX512);
+	const bool avx512 = (arch == arch_t::AVX512);
+
+	const std::string filename = options.data_dir + "/" + name + "/input.txt";
+	if (!std::filesystem::exists(filename))
+	{
+		log_WARNING("bench_tp: could not find file ", filename, ".\n");
+		return;
+	}
+	Dynamic_Param param = bench_param(DIM1, DIM2, options.n_time_steps);
+	param.SP_LOCAL_AREA_DENSITY = 0.02f;
+	DataStream<P> datastream;
+	datastream.load_from_file(filename, param);
+
+	auto layer = std::make_unique<Layer_Persisted<P>>();
+	auto layer_fluent = std::make_unique<Layer_Fluent<P>>();
+	seed_columns(*layer_fluent);
+	layer::init(*layer_fluent, *layer, param);
+	std::vector<int> prediction_mismatch(1);
+	const auto start_time = std::chrono::steady_clock::now();
+	layer::run(datastream, param, *layer_fluent, *layer, prediction_mismatch);
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+	int n_segments = 0;
+	int n_synapses = 0;
+	int64_t n_slab_slots = 0;
+	int64_t n_free_slots = 0;
+	for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+	{
+		n_segments += layer->dd_segment_count[column_i];
+		for (int segment_i = 0; segment_i < layer->dd_segment_count[column_i]; ++segment_i) n_synapses += layer->dd_synapse_count_sf[column_i][segment_i];
+		n_slab_slots += static_cast<int64_t>(layer->dd_synapse_permanence_sf[column_i].size());
+		for (const uint64_t chunk : layer->dd_slab_free_sf[column_i]) n_free_slots += tp::priv::dd_slab::get_chunk_capacity(chunk);
+	}
+	const int64_t peak_rss = ::tools::benchmark::peak_rss_bytes();
+	log_INFO("bench_tp: ", name, "/", N_COLUMNS, ": learn ", options.n_time_steps / seconds, " steps/sec; mismatch ", prediction_mismatch[0], "; segments ", n_segments, "; synapses ", n_synapses,
+		"; slab slots ", n_slab_slots, " (", n_free_slots, " free); peak RSS ", ((peak_rss < 0) ? std::string("n/a") : std::to_string(peak_rss >> 20) + " MB"), "\n");
+
+	const int time = options.n_time_steps;
+	const auto active_cells = layer_fluent->active_cells;
+
+	auto bench = [&](const std::string& kernel, const bool supported, const auto& f)
+	{
+		const std::string result_name = kernel + "/" + name + "/" + std::to_string(N_COLUMNS);
+		if (!supported || !selected(options, result_name)) return;
+		results.push_back(::tools::benchmark::measure(result_name, options.n_runs, f));
+		results.back().check = n_synapses;
+		log_INFO("bench_tp: ", result_name, ": ", results.back().median_ns / 1000, " us; ", n_synapses / results.back().median_ns, " G synapses/sec\n");
+	};
+	using namespace tp::priv::activate_dendrites::synapse_forward;
+	bench("tp.activate_dendrites_sf_ref", true, [&]() { activate_dendrites_sf_ref<true>(*layer_fluent, *layer, time, active_cells, param); });
+	bench("tp.activate_dendrites_sf_avx2", avx2, [&]() { activate_dendrites_sf_avx2<true>(*layer_fluent, *layer, time, active_cells, param); });
+	bench("tp.activate_dendrites_sf_avx512", avx512, [&]() { activate_dendrites_sf_avx512<true>(*layer_fluent, *layer, time, active_cells, param); });
+}
+
+inline void bench_all_pages(const Bench_Options& options, std::vector<Result>& results)
+{
+	bench_pages<64 * 64, 40, 40>(options, "JumpingBall_40x40", results);
+	bench_pages<64 * 256, 40, 40>(options, "JumpingBall_40x40", results);
+}
+
+inline void bench_all_kernels(const Bench_Options& options, std::vector<Result>& results)
+{
+	// number of columns
+	bench_kernels<Static_Param<64 * 16, 4, 20 * 20, 0, 1, arch_t::RUNTIME>>(options, results);
+	bench_kernels<Static_Param<64 * 64, 4, 20 * 20, 0, 1, arch_t::RUNTIME>>(options, results);
+	bench_kernels<Static_Param<64 * 256, 4, 20 * 20, 0, 1, arch_t::RUNTIME>>(options, results);
+	// number of cells per column
+	bench_kernels<Static_Param<64 * 64, 2, 20 * 20, 0, 1, arch_t::RUNTIME>>(options, results);
+	// history size
+	bench_kernels<Static_Param<64 * 64, 4, 20 * 20, 0, 3, arch_t::RUNTIME>>(options, results);
+}
+
+int main(int argc, char * argv[])
+{
+	Bench_Options options;
+	std::string compare_current_filename;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		const bool has_value = (i + 1 < argc);
+		if ((arg == "--out") && has_value) options.out_filename = argv[++i];
+		else if ((arg == "--baseline") && has_value) options.baseline_filename = argv[++i];
+		else if ((arg == "--compare") && (i + 2 < argc)) { options.baseline_filename = argv[++i]; compare_current_filename = argv[++i]; }
+		else if ((arg == "--threshold") && has_value) options.threshold = std::stod(argv[++i]);
+		else if ((arg == "--runs") && has_value) options.n_runs = std::stoi(argv[++i]);
+		else if ((arg == "--warmup") && has_value) options.n_warmup_steps = std::stoi(argv[++i]);
+		else if ((arg == "--steps") && has_value) options.n_time_steps = std::stoi(argv[++i]);
+		else if ((arg == "--data") && has_value) options.data_dir = argv[++i];
+		else if ((arg == "--filter") && has_value) options.filter = argv[++i];
+		else if (arg == "--kernels") options.layers = false;
+		else if (arg == "--layers") options.kernels = false;
+		else if (arg == "--pages") options.pages = true;
+		else if (arg == "--tp") options.tp = true;
+		else if ((arg == "--numa") && has_value)
+		{
+			const std::string numa = argv[++i];
+			if (numa == "first_touch") options.numa = ::tools::allocator::numa_t::FIRST_TOUCH;
+			else if (numa == "local") options.numa = ::tools::allocator::numa_t::LOCAL;
+			else { options.numa = ::tools::allocator::numa_t::BIND; options.numa_node = std::stoi(numa); }
+		}
+		else if ((arg == "--threads") && has_value) options.n_threads = std::stoi(argv[++i]);
+		else
+		{
+			log_WARNING("HTM-Lite-Bench: unknown argument ", arg, "; see the top of HTM-Lite-Bench.cpp for the options.\n");
+			return -1;
+		}
+	}
+
+	std::vector<Result> results;
+	if (compare_current_filename.empty())
+	{
+		const auto start_time = std::chrono::system_clock::now();
+		if (options.kernels) bench_all_kernels(options, results);
+		if (options.layers) bench_layers(options, results);
+		if (options.pages) bench_all_pages(options, results);
+		if (options.tp) bench_tp<64 * 1024, 40, 40>(options, "JumpingBall_40x40", results);
+		const auto end_time = std::chrono::system_clock::now();
+
+		const char * arch_names[] = { "X64", "AVX2", "AVX512" };
+		const std::string description = std::string("arch ") + arch_names[architecture_switch(arch_t::RUNTIME)] + "; runs " + std::to_string(options.n_runs)
+			+ "; warmup " + std::to_string(options.n_warmup_steps) + "; steps " + std::to_string(options.n_time_steps);
+		if (::tools::benchmark::write_json(options.out_filename, description, results)) log_INFO("HTM-Lite-Bench: wrote ", results.size(), " results to ", options.out_filename, "\n");
+		log_INFO("HTM-Lite-Bench: elapsed time ", ::tools::timing::elapsed_time_str(start_time, end_time));
+	}
+	else if (!::tools::benchmark::read_json(compare_current_filename, results))
+	{
+		return -1;
+	}
+
+	if (options.baseline_filename.empty()) return 0;
+	std::vector<Result> baseline;
+	if (!::tools::benchmark::read_json(options.baseline_filename, baseline)) return -1;
+	const int n_failed = ::tools::benchmark::compare(baseline, results, options.threshold);
+	if (n_failed > 0) log_WARNING("HTM-Lite-Bench: ", n_failed, " results failed the comparison with ", options.baseline_filename, "\n");
+	return (n_failed > 0) ? 1 : 0;
+}
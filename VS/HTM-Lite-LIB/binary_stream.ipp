@@ -0,0 +1,358 @@
+// C++ port of Nupic HTM with the aim of being lite and fast
+//
+// Copyright (c) 2017 Henk-Jan Lebbink
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero Public License version 3 as
+// published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero Public License for more details.
+//
+// You should have received a copy of the GNU Affero Public License
+// along with this program.  If not, see http://www.gnu.org/licenses.
+
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstring>		// std::memset
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "..\Spike-Tools-Lib\log.ipp"
+
+#include "tools.ipp"
+#include "parameters.ipp"
+#include "types.ipp"
+#include "encoder.ipp"
+
+//Hierarchical Temporal Memory (HTM)
+namespace htm
+{
+	//Binary input stream of visible sensor frames. A binary stream file is a header followed by frames; every frame
+	//is the packed blocks of an Active_Visible_Sensors bitset, padded to a multiple of 64 bytes. Frames are read by
+	//a background thread into a bounded ring of frames, such that memory is constant in the length of the stream.
+	namespace binary_stream
+	{
+		using namespace ::tools::log;
+		using namespace htm::types;
+
+		//Version of the binary stream format; streams with a different version are not opened.
+		static constexpr uint32_t VERSION = 1;
+
+		namespace priv
+		{
+			static constexpr uint64_t MAGIC = 0x3142524453544D48; // "HTMSDRB1"
+			static constexpr int ALIGN = 64;
+
+			struct Header
+			{
+				uint64_t magic;
+				uint32_t version;
+				int32_t n_visible_sensors;
+				int32_t n_visible_sensors_dim1;
+				int32_t n_visible_sensors_dim2;
+				int32_t n_blocks; // number of int blocks in a frame
+				int32_t frame_size; // bytes of a frame including padding; a multiple of ALIGN
+				uint64_t n_frames;
+				uint8_t padding[24];
+			};
+			static_assert(sizeof(Header) == ALIGN, "ERROR: binary_stream: header is not 64 bytes.");
+
+			template <typename P>
+			constexpr int n_blocks()
+			{
+				return tools::n_blocks_32(P::N_VISIBLE_SENSORS);
+			}
+
+			//Number of ints of a frame in a file and in the ring: the blocks padded to a multiple of ALIGN bytes.
+			template <typename P>
+			constexpr int frame_stride()
+			{
+				constexpr int n = ALIGN / sizeof(int);
+				return ((n_blocks<P>() + n - 1) / n) * n;
+			}
+
+			template <typename P>
+			Header create_header(const Dynamic_Param& param, const uint64_t n_frames)
+			{
+				Header header;
+				std::memset(&header, 0, sizeof(Header));
+				header.magic = MAGIC;
+				header.version = VERSION;
+				header.n_visible_sensors = P::N_VISIBLE_SENSORS;
+				header.n_visible_sensors_dim1 = param.n_visible_sensors_dim1;
+				header.n_visible_sensors_dim2 = param.n_visible_sensors_dim2;
+				header.n_blocks = n_blocks<P>();
+				header.frame_size = frame_stride<P>() * sizeof(int);
+				header.n_frames = n_frames;
+				return header;
+			}
+		}
+
+		//Convert a text input file (as read by encoder::encode_pass_through) into a binary stream file. The text
+		//file is read one item at a time, such that the conversion does not hold the stream in memory.
+		template <typename P>
+		bool convert_text_to_binary(
+			const std::string& text_filename,
+			const std::string& binary_filename,
+			const Dynamic_Param& param)
+		{
+			std::ifstream input(text_filename);
+			if (!input.good())
+			{
+				log_WARNING("binary_stream:convert_text_to_binary: could not open file ", text_filename, ".\n");
+				return false;
+			}
+			std::ofstream output(binary_filename, std::ios::binary | std::ios::trunc);
+			if (!output.good())
+			{
+				log_WARNING("binary_stream:convert_text_to_binary: could not open file ", binary_filename, ".\n");
+				return false;
+			}
+
+			// write a header without frames; it is rewritten when the number of frames is known.
+			priv::Header header = priv::create_header<P>(param, 0);
+			output.write(reinterpret_cast<const char *>(&header), sizeof(priv::Header));
+
+			std::vector<int> frame(priv::frame_stride<P>(), 0);
+			typename Layer_Fluent<P>::Active_Visible_Sensors item;
+			uint64_t n_frames = 0;
+			int line = 0;
+			bool end_file = false;
+			while (!end_file)
+			{
+				if (encoder::read_pass_through_item<P>(input, param, item, line, end_file))
+				{
+					std::copy(item._data.begin(), item._data.end(), frame.begin());
+					output.write(reinterpret_cast<const char *>(frame.data()), frame.size() * sizeof(int));
+					n_frames++;
+				}
+			}
+
+			header = priv::create_header<P>(param, n_frames);
+			output.seekp(0);
+			output.write(reinterpret_cast<const char *>(&header), sizeof(priv::Header));
+			if (!output.good())
+			{
+				log_WARNING("binary_stream:convert_text_to_binary: could not write file ", binary_filename, ".\n");
+				return false;
+			}
+			if (true) log_INFO_DEBUG("binary_stream:convert_text_to_binary: converted ", n_frames, " items from file ", text_filename, " to ", binary_filename, ".\n");
+			return true;
+		}
+
+		//Reader of a binary stream file. Frame t (t = 0, 1, 2, ...) is frame (t mod n_frames) of the file. A background
+		//thread reads ahead into a ring of capacity frames; frame(t) returns the packed blocks of frame t without
+		//copying, and remains valid until release(t') with t' > t. At most capacity frames can be unreleased. A copy
+		//of a reader opens the file again and has its own thread (eg. a DataStream that is copied to a worker thread).
+		template <typename P>
+		class Reader
+		{
+		public:
+			Reader() = default;
+			~Reader()
+			{
+				this->stop();
+			}
+			Reader(const Reader& other)
+			{
+				this->open_copy(other);
+			}
+			Reader& operator=(const Reader& other)
+			{
+				if (this != &other) this->open_copy(other);
+				return *this;
+			}
+
+			bool is_open() const
+			{
+				return this->thread_.joinable();
+			}
+
+			bool open(const std::string& filename, const int capacity)
+			{
+				return this->open(filename, capacity, 0);
+			}
+
+			int64_t n_frames() const
+			{
+				return this->n_frames_;
+			}
+			int capacity() const
+			{
+				return this->capacity_;
+			}
+
+			//Packed blocks of frame time; blocks until the frame has been read. Returns nullptr when time is not in the
+			//ring (released, or capacity frames or more ahead) or when the file could not be read up to frame time.
+			const int * frame(const int64_t time)
+			{
+				std::unique_lock<std::mutex> lock(this->mutex_);
+				if ((time < this->begin_) || (time >= this->begin_ + this->capacity_))
+				{
+					log_ERROR("binary_stream:Reader:frame: time ", time, " is not in the ring [", this->begin_, ", ", this->begin_ + this->capacity_, ").\n");
+					return nullptr;
+				}
+				this->cv_.wait(lock, [&]() { return (this->end_ > time) || this->failed_; });
+				if (this->end_ <= time) return nullptr; // the read failed before frame time
+				return &this->ring_[static_cast<size_t>(time % this->capacity_) * priv::frame_stride<P>()];
+			}
+
+			//Frames before time are no longer used; their slots may be refilled.
+			void release(const int64_t time)
+			{
+				{
+					std::lock_guard<std::mutex> lock(this->mutex_);
+					if (time <= this->begin_) return;
+					this->begin_ = time;
+				}
+				this->cv_.notify_all();
+			}
+
+			//Restart the stream at frame 0.
+			void rewind()
+			{
+				if (!this->is_open()) return;
+				this->stop();
+				this->start(0);
+			}
+
+		private:
+			std::string filename_;
+			int64_t n_frames_ = 0;
+			int capacity_ = 0;
+			std::vector<int, htm::types::priv::Allocator<int>> ring_;
+
+			std::thread thread_;
+			mutable std::mutex mutex_;
+			std::condition_variable cv_;
+			int64_t begin_ = 0; // first frame that is in use
+			int64_t end_ = 0; // one past the last frame that has been read
+			bool stop_ = false;
+			bool failed_ = false;
+
+			bool open(const std::string& filename, const int capacity, const int64_t time)
+			{
+				this->stop();
+
+				std::ifstream input(filename, std::ios::binary);
+				if (!input.good())
+				{
+					log_WARNING("binary_stream:Reader:open: could not open file ", filename, ".\n");
+					return false;
+				}
+				priv::Header header;
+				input.read(reinterpret_cast<char *>(&header), sizeof(priv::Header));
+				if (!input.good() || (header.magic != priv::MAGIC) || (header.version != VERSION))
+				{
+					log_WARNING("binary_stream:Reader:open: file ", filename, " is not a binary stream (version ", VERSION, ").\n");
+					return false;
+				}
+				if ((header.n_visible_sensors != P::N_VISIBLE_SENSORS) || (header.frame_size != static_cast<int32_t>(priv::frame_stride<P>() * sizeof(int))))
+				{
+					log_WARNING("binary_stream:Reader:open: file ", filename, " has ", header.n_visible_sensors, " visible sensors; expected ", P::N_VISIBLE_SENSORS, ".\n");
+					return false;
+				}
+				if (header.n_frames == 0)
+				{
+					log_WARNING("binary_stream:Reader:open: file ", filename, " has no frames.\n");
+					return false;
+				}
+
+				this->filename_ = filename;
+				this->n_frames_ = static_cast<int64_t>(header.n_frames);
+				this->capacity_ = std::max(1, capacity);
+				this->ring_.assign(static_cast<size_t>(this->capacity_) * priv::frame_stride<P>(), 0);
+				this->start(time);
+				return true;
+			}
+
+			void open_copy(const Reader& other)
+			{
+				this->stop();
+				if (!other.is_open()) return;
+				int64_t time;
+				{
+					std::lock_guard<std::mutex> lock(other.mutex_);
+					time = other.begin_;
+				}
+				this->open(other.filename_, other.capacity_, time);
+			}
+
+			void start(const int64_t time)
+			{
+				this->begin_ = time;
+				this->end_ = time;
+				this->stop_ = false;
+				this->failed_ = false;
+				this->thread_ = std::thread([this]() { this->read_loop(); });
+			}
+			void stop()
+			{
+				if (!this->thread_.joinable()) return;
+				{
+					std::lock_guard<std::mutex> lock(this->mutex_);
+					this->stop_ = true;
+				}
+				this->cv_.notify_all();
+				this->thread_.join();
+			}
+
+			//Fill the free slots of the ring; consecutive free slots are read with one read.
+			void read_loop()
+			{
+				constexpr int STRIDE = priv::frame_stride<P>();
+				std::ifstream input(this->filename_, std::ios::binary);
+				int64_t file_frame = -1; // frame at the current position of input
+
+				while (true)
+				{
+					int64_t end;
+					int64_t n;
+					{
+						std::unique_lock<std::mutex> lock(this->mutex_);
+						this->cv_.wait(lock, [this]() { return this->stop_ || (this->end_ - this->begin_ < this->capacity_); });
+						if (this->stop_) return;
+						end = this->end_;
+						n = this->capacity_ - (this->end_ - this->begin_);
+					}
+					const int64_t slot = end % this->capacity_;
+					const int64_t frame_i = end % this->n_frames_;
+					n = std::min(n, std::min(this->capacity_ - slot, this->n_frames_ - frame_i));
+
+					if (frame_i != file_frame)
+					{
+						input.clear();
+						input.seekg(sizeof(priv::Header) + frame_i * STRIDE * sizeof(int));
+					}
+					input.read(reinterpret_cast<char *>(&this->ring_[slot * STRIDE]), n * STRIDE * sizeof(int));
+					file_frame = frame_i + n;
+
+					{
+						std::lock_guard<std::mutex> lock(this->mutex_);
+						if (!input.good())
+						{// the frames that were read completely remain available
+							const int64_t n_read = static_cast<int64_t>(input.gcount()) / static_cast<int64_t>(STRIDE * sizeof(int));
+							log_WARNING("binary_stream:Reader:read_loop: could not read frame ", frame_i + n_read, " from file ", this->filename_, ".\n");
+							this->end_ = end + n_read;
+							this->failed_ = true;
+						}
+						else
+						{
+							this->end_ = end + n;
+						}
+					}
+					this->cv_.notify_all();
+					if (this->failed_) return;
+				}
+			}
+		};
+	}
+}
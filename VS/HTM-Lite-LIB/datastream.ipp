@@ -17,11 +17,13 @@
 #pragma once
 #include <string>
 #include <random>
+#include <algorithm>	// std::fill_n
 
 #include "tools.ipp"
 #include "parameters.ipp"
 #include "types.ipp"
 #include "encoder.ipp"
+#include "binary_stream.ipp"
 
 
 namespace htm
@@ -42,6 +44,7 @@ namespace htm
 
 			mutable int time_ = 0;
 			std::vector<data_type> file_data_;
+			mutable binary_stream::Reader<P> binary_data_; // if open, the file data is streamed from a binary stream file
 
 			mutable int sequence_i_ = 0;
 			mutable int pos_in_sequence_ = 0;
@@ -53,6 +56,20 @@ namespace htm
 			mutable std::uniform_int_distribution<unsigned int> random_number_dist_;
 			mutable std::uniform_int_distribution<int> random_sequence_dist_;
 
+			//Copy frame time of the binary stream to the visible sensors; without a frame (see binary_stream::Reader::frame)
+			//no visible sensor is active and false is returned.
+			bool copy_frame(typename Layer_Fluent<P>::Active_Sensors& sensor_activity, const int time) const
+			{
+				const int * const frame = this->binary_data_.frame(time);
+				if (frame == nullptr)
+				{
+					std::fill_n(sensor_activity._data.data(), data_type::N_BLOCKS, 0);
+					return false;
+				}
+				copy_partial<P::N_VISIBLE_SENSORS>(sensor_activity, frame);
+				return true;
+			}
+
 			data_type create_random(float sparcity, unsigned int random_number) const
 			{
 				data_type result;
@@ -101,6 +118,7 @@ namespace htm
 				if (this->use_file_data)
 				{
 					this->time_++;
+					if (this->binary_data_.is_open()) this->binary_data_.release(this->time_);
 				}
 				else
 				{
@@ -134,6 +152,7 @@ namespace htm
 				if (this->use_file_data)
 				{
 					this->time_ = 0;
+					if (this->binary_data_.is_open()) this->binary_data_.rewind();
 				}
 				else
 				{
@@ -146,7 +165,27 @@ namespace htm
 			{
 				this->use_file_data = true;
 				this->file_data_ = encoder::encode_pass_through<P>(filename, param);
+				this->binary_data_ = binary_stream::Reader<P>();
+				this->reset_time();
+			}
+			// encode n_steps records of numeric and categorical fields (see encoder::Record_Encoder::encode) as the data
+			void load_from_records(const encoder::Record_Encoder<P>& encoder, const float * const values, const int n_steps)
+			{
+				this->use_file_data = true;
+				this->file_data_ = std::vector<data_type>(n_steps);
+				this->binary_data_ = binary_stream::Reader<P>();
+				encoder.encode(values, n_steps, this->file_data_.data());
+				this->reset_time();
+			}
+			// stream the data from a binary stream file (see binary_stream::convert_text_to_binary); at most 
+			// capacity frames are in memory, which bounds the number of futures that can be requested.
+			bool load_from_binary_file(const std::string& filename, int capacity = 64)
+			{
+				this->use_file_data = true;
+				this->file_data_.clear();
+				if (!this->binary_data_.open(filename, capacity)) return false;
 				this->reset_time();
+				return true;
 			}
 			void generate_random_NxR(float sparsity, int n_sequences, int sequence_length)
 			{
@@ -184,28 +223,45 @@ namespace htm
 			{
 				return sensors_predictable(1);
 			}
-			void current_sensors(typename Layer_Fluent<P>::Active_Sensors& sensor_activity) const
+			//Load the current active sensors; returns false when the frame of a binary stream could not be read (then no
+			//visible sensor is active).
+			bool current_sensors(typename Layer_Fluent<P>::Active_Sensors& sensor_activity) const
 			{
 				if (this->use_file_data)
 				{
-					const int time_step_max = static_cast<int>(this->file_data_.size());
-					const int i = this->time_ % time_step_max;
-					copy_partial(sensor_activity, this->file_data_[i]);
+					if (this->binary_data_.is_open())
+					{
+						return this->copy_frame(sensor_activity, this->time_);
+					}
+					else
+					{
+						const int time_step_max = static_cast<int>(this->file_data_.size());
+						const int i = this->time_ % time_step_max;
+						copy_partial(sensor_activity, this->file_data_[i]);
+					}
 				}
 				else
 				{
 					copy_partial(sensor_activity, this->sequences[this->sequence_i_][this->pos_in_sequence_]);
 				}
+				return true;
 			}
 
-			// load the future (next) active sensors
+			// load the future (next) active sensors; without a frame of the binary stream no visible sensor is active
 			void future_sensors(typename Layer_Fluent<P>::Active_Sensors& sensor_activity, int future) const
 			{
 				if (this->use_file_data)
 				{
-					const int time_step_max = static_cast<int>(this->file_data_.size());
-					const int i = (this->time_ + future) % time_step_max;
-					copy_partial(sensor_activity, this->file_data_[i]);
+					if (this->binary_data_.is_open())
+					{
+						this->copy_frame(sensor_activity, this->time_ + future);
+					}
+					else
+					{
+						const int time_step_max = static_cast<int>(this->file_data_.size());
+						const int i = (this->time_ + future) % time_step_max;
+						copy_partial(sensor_activity, this->file_data_[i]);
+					}
 				}
 				else
 				{
@@ -18,6 +18,8 @@
 #include <string>
 #include <vector>
 #include <array>
+#include <algorithm>	// std::min
+#include <cmath>		// std::lround, std::fmod
 #include <iostream>		// std::cout
 #include <fstream>
 
@@ -34,6 +36,65 @@ namespace htm
 		using namespace ::tools::log;
 		using namespace htm::types;
 
+		// Read the next item (param.n_visible_sensors_dim1 lines of '0' and '1') from the provided input. 
+		// Returns true if something is present in the item; end_file is set when the input is exhausted.
+		template <typename P>
+		bool read_pass_through_item(
+			std::ifstream& input,
+			const Dynamic_Param& param,
+			//out
+			typename Layer_Fluent<P>::Active_Visible_Sensors& item,
+			int& line,
+			bool& end_file)
+		{
+			std::string str;
+			item.clear_all();
+			auto pos = 0;
+
+			// an item is dim2 lines of dim1 characters
+			for (auto i1 = 0; i1 < param.n_visible_sensors_dim2; ++i1)
+			{
+				std::getline(input, str);
+				if (input.bad())
+				{
+					log_ERROR("encoder::read_pass_through_item: i1 = ", i1, "; D2 = ", param.n_visible_sensors_dim2, "; line ", line, ".\n");
+				}
+				else if (input.eof())
+				{
+					end_file = true;
+				}
+				else
+				{
+					auto strLength = str.length();
+
+					if (strLength == 0) // read optional empty space
+					{
+						i1--;
+					}
+					else
+					{
+						if (false) log_INFO("encoder::read_pass_through_item: i1 = ", i1, "; D2 = ", param.n_visible_sensors_dim2, "; line ", line, "; content = ", str, ".\n");
+						line++;
+
+						if (str.length() < param.n_visible_sensors_dim1) log_WARNING("encoder:read_pass_through_item: str ", str, " is smaller than D1 = ", param.n_visible_sensors_dim1, ".\n");
+
+						for (auto i2 = 0; i2 < std::min(static_cast<int>(str.length()), param.n_visible_sensors_dim1); ++i2)
+						{
+							switch (str[i2])
+							{
+								case '0': item.set(pos, false); pos++; break;
+								case '1': item.set(pos, true); pos++; break;
+								default:
+									log_WARNING("encoder:read_pass_through_item: found ", str[i2], ".\n");
+									break;
+							}
+						}
+					}
+				}
+			}
+			return (pos > 0); // something is present in item: the item is not empty.
+		}
+
 		template <typename P>
 		std::vector<typename Layer_Fluent<P>::Active_Visible_Sensors> encode_pass_through(
 			const std::string& filename,
@@ -48,56 +109,12 @@ namespace htm
 				return data;
 			}
 
-			std::string str;
 			int line = 0;
-
 			bool endFile = false;
 			while (!endFile)
 			{
 				Layer_Fluent<P>::Active_Visible_Sensors item;
-				auto pos = 0;
-
-				for (auto i1 = 0; i1 < param.n_visible_sensors_dim1; ++i1)
-				{
-					std::getline(input, str);
-					if (input.bad())
-					{
-						log_ERROR("encoder::encode_pass_through: i1 = ", i1, "; D2 = ", param.n_visible_sensors_dim2, "; line ", line, ".\n");
-					}
-					else if (input.eof())
-					{
-						endFile = true;
-					}
-					else
-					{
-						auto strLength = str.length();
-
-						if (strLength == 0) // read optional empty space
-						{
-							i1--;
-						}
-						else
-						{
-							if (false) log_INFO("encoder::encode_pass_through: i1 = ", i1, "; D2 = ", param.n_visible_sensors_dim2, "; line ", line, "; content = ", str, ".\n");
-							line++;
-
-							if (str.length() < param.n_visible_sensors_dim1) log_WARNING("encoder:encode_pass_through: str ", str, " is smaller than D1 = ", param.n_visible_sensors_dim1, ".\n");
-
-							for (auto i2 = 0; i2 < std::min(static_cast<int>(str.length()), param.n_visible_sensors_dim1); ++i2)
-							{
-								switch (str[i2])
-								{
-									case '0': item.set(pos, false); pos++; break;
-									case '1': item.set(pos, true); pos++; break;
-									default:
-										log_WARNING("encoder:encode_pass_through: found ", str[i2], ".\n");
-										break;
-								}
-							}
-						}
-					}
-				}
-				if (pos > 0) // something is present in item: the item is not empty.
+				if (read_pass_through_item<P>(input, param, item, line, endFile))
 				{
 					data.push_back(item);
 				}
@@ -107,9 +124,112 @@ namespace htm
 			return data;
 		}
 	
+		namespace priv
+		{
+			//Fill out[0..n) with random ints between min and max (inclusive) drawn from the provided random lanes.
+			template <typename P>
+			void fill_rand_int32(const int min, const int max, const int n, int * const out, ::tools::random::Random_Lanes& lanes)
+			{
+				if (architecture_switch(P::ARCH) == arch_t::X64) ::tools::random::fill_rand_int32_ref(min, max, n, out, lanes);
+				if (architecture_switch(P::ARCH) == arch_t::AVX2) ::tools::random::fill_rand_int32_avx2(min, max, n, out, lanes);
+				if (architecture_switch(P::ARCH) == arch_t::AVX512) ::tools::random::fill_rand_int32_avx512(min, max, n, out, lanes);
+			}
+
+			//Mask of the bits in [begin, end) of word word_i, which holds bits 32*word_i up to 32*word_i+31.
+			inline int run_mask(const int word_i, const int begin, const int end)
+			{
+				const int b = begin - (word_i << 5);
+				const int e = end - (word_i << 5);
+				const unsigned int from_begin = (b <= 0) ? 0xFFFFFFFFu : ((b >= 32) ? 0u : (0xFFFFFFFFu << b));
+				const unsigned int from_end = (e <= 0) ? 0xFFFFFFFFu : ((e >= 32) ? 0u : (0xFFFFFFFFu << e));
+				return static_cast<int>(from_begin & ~from_end);
+			}
+
+			//Replace the bits in [field_begin, field_end) of data by the bits of the runs [run1_begin, run1_end) and 
+			//[run2_begin, run2_end); the bits outside the field are kept.
+			inline void write_runs_ref(int * const data, const int field_begin, const int field_end, const int run1_begin, const int run1_end, const int run2_begin, const int run2_end)
+			{
+				for (int word_i = (field_begin >> 5); word_i < ((field_end + 31) >> 5); ++word_i)
+				{
+					const int field = run_mask(word_i, field_begin, field_end);
+					const int run = run_mask(word_i, run1_begin, run1_end) | run_mask(word_i, run2_begin, run2_end);
+					data[word_i] = (data[word_i] & ~field) | run;
+				}
+			}
+
+			//Masks of the bits in [begin, end) of eight words with first bits bit_i: a shift by 32 or more gives zero.
+			inline __m256i run_mask_avx2(const __m256i bit_i, const int begin, const int end)
+			{
+				const __m256i ones = _mm256_set1_epi32(-1);
+				const __m256i zero = _mm256_setzero_si256();
+				const __m256i from_begin = _mm256_sllv_epi32(ones, _mm256_max_epi32(_mm256_sub_epi32(_mm256_set1_epi32(begin), bit_i), zero));
+				const __m256i from_end = _mm256_sllv_epi32(ones, _mm256_max_epi32(_mm256_sub_epi32(_mm256_set1_epi32(end), bit_i), zero));
+				return _mm256_andnot_si256(from_end, from_begin);
+			}
+
+			inline void write_runs_avx2(int * const data, const int field_begin, const int field_end, const int run1_begin, const int run1_end, const int run2_begin, const int run2_end)
+			{
+				const __m256i iota = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+				const int word_end = (field_end + 31) >> 5;
+				for (int word_i = field_begin >> 5; word_i < word_end; word_i += 8)
+				{
+					const __m256i k = _mm256_cmpgt_epi32(_mm256_set1_epi32(word_end - word_i), iota);
+					const __m256i bit_i = _mm256_slli_epi32(_mm256_add_epi32(_mm256_set1_epi32(word_i), iota), 5);
+					const __m256i field = run_mask_avx2(bit_i, field_begin, field_end);
+					const __m256i run = _mm256_or_si256(run_mask_avx2(bit_i, run1_begin, run1_end), run_mask_avx2(bit_i, run2_begin, run2_end));
+					_mm256_maskstore_epi32(&data[word_i], k, _mm256_or_si256(_mm256_andnot_si256(field, _mm256_maskload_epi32(&data[word_i], k)), run));
+				}
+			}
+
+			inline __m512i run_mask_avx512(const __m512i bit_i, const int begin, const int end)
+			{
+				const __m512i ones = _mm512_set1_epi32(-1);
+				const __m512i zero = _mm512_setzero_si512();
+				const __m512i from_begin = _mm512_sllv_epi32(ones, _mm512_max_epi32(_mm512_sub_epi32(_mm512_set1_epi32(begin), bit_i), zero));
+				const __m512i from_end = _mm512_sllv_epi32(ones, _mm512_max_epi32(_mm512_sub_epi32(_mm512_set1_epi32(end), bit_i), zero));
+				return _mm512_andnot_si512(from_end, from_begin);
+			}
+
+			inline void write_runs_avx512(int * const data, const int field_begin, const int field_end, const int run1_begin, const int run1_end, const int run2_begin, const int run2_end)
+			{
+				const int word_end = (field_end + 31) >> 5;
+				for (int word_i = field_begin >> 5; word_i < word_end; word_i += 16)
+				{
+					const __mmask16 k = ((word_end - word_i) >= 16) ? static_cast<__mmask16>(0xFFFF) : static_cast<__mmask16>((1u << (word_end - word_i)) - 1);
+					const __m512i bit_i = _mm512_slli_epi32(_mm512_add_epi32(_mm512_set1_epi32(word_i), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)), 5);
+					const __m512i field = run_mask_avx512(bit_i, field_begin, field_end);
+					const __m512i run = _mm512_or_si512(run_mask_avx512(bit_i, run1_begin, run1_end), run_mask_avx512(bit_i, run2_begin, run2_end));
+					_mm512_mask_storeu_epi32(&data[word_i], k, _mm512_or_si512(_mm512_andnot_si512(field, _mm512_maskz_loadu_epi32(k, &data[word_i])), run));
+				}
+			}
+
+			template <typename P>
+			void write_runs(int * const data, const int field_begin, const int field_end, const int run1_begin, const int run1_end, const int run2_begin, const int run2_end)
+			{
+				if (architecture_switch(P::ARCH) == arch_t::X64) write_runs_ref(data, field_begin, field_end, run1_begin, run1_end, run2_begin, run2_end);
+				if (architecture_switch(P::ARCH) == arch_t::AVX2) write_runs_avx2(data, field_begin, field_end, run1_begin, run1_end, run2_begin, run2_end);
+				if (architecture_switch(P::ARCH) == arch_t::AVX512) write_runs_avx512(data, field_begin, field_end, run1_begin, run1_end, run2_begin, run2_end);
+			}
+
+			//Hash of position position_i of a random distributed scalar encoder (the murmur3 finalizer of the position 
+			//and the seed); the high bits of hash * n_bits give the sensor in the field.
+			inline unsigned int rdse_hash(const unsigned int seed, const int position_i)
+			{
+				unsigned int h = static_cast<unsigned int>(position_i) ^ (seed * 0x9E3779B9u);
+				h ^= h >> 16;
+				h *= 0x85EBCA6Bu;
+				h ^= h >> 13;
+				h *= 0xC2B2AE35u;
+				h ^= h >> 16;
+				return h;
+			}
+		}
+
+		//Negate random sensors; the distances between negated sensors are drawn (in blocks) from the provided random lanes.
 		template <typename P>
 		void add_sensor_noise(
-			typename Layer_Fluent<P>::Active_Sensors& active_sensors)
+			typename Layer_Fluent<P>::Active_Sensors& active_sensors,
+			::tools::random::Random_Lanes& random_lanes)
 		{
 			if constexpr (P::SP_SENSOR_NOISE_PERCENT > 0)
 			{
@@ -117,13 +237,247 @@ namespace htm
 				#pragma warning( disable : 39)
 				const int range = static_cast<int>(std::floorf(200.0f / P::SP_SENSOR_NOISE_PERCENT) - 1);
 				#pragma warning( pop ) 
-				int i = random::rand_int32(0, range);
-				while (i < P::N_VISIBLE_SENSORS)
+				std::array<int, ::tools::random::Random_Lanes::N_LANES> distance;
+				int distance_i = static_cast<int>(distance.size());
+				int i = 0;
+				while (true)
 				{
+					if (distance_i == static_cast<int>(distance.size()))
+					{
+						priv::fill_rand_int32<P>(0, range, static_cast<int>(distance.size()), distance.data(), random_lanes);
+						distance_i = 0;
+					}
+					i += distance[distance_i++];
+					if (i >= P::N_VISIBLE_SENSORS) break;
 					active_sensors.negate(i);
-					i += random::rand_int32(0, range);
 				}
 			}
 		}
+
+		#pragma region Record encoders
+		//Encoding of one field of an input record.
+		enum encoding_t
+		{
+			//Value in [min, max] (clipped): n_active consecutive sensors that start at a position linear in the value.
+			SCALAR,
+			//Value in [min, max) that wraps around, e.g. the hour of the day: the consecutive sensors wrap around as well.
+			//Any finite value is wrapped into [min, max); an infinite value has no active sensors, like a missing value.
+			CYCLIC,
+			//Category 0, 1, 2, ... (as a float): every category has its own n_active consecutive sensors.
+			CATEGORY,
+			//Random distributed scalar: the n_active hashed sensors of the bucket (of width resolution) of the value; 
+			//neighbouring buckets share all but one sensor, and the values are not bounded.
+			RDSE
+		};
+
+		struct Field
+		{
+			encoding_t encoding = SCALAR;
+			//First sensor and number of sensors of the field.
+			int offset = 0;
+			int n_bits = 0;
+			//Number of active sensors of a value.
+			int n_active = 0;
+			//SCALAR and CYCLIC
+			float min = 0;
+			float max = 1;
+			//RDSE
+			float resolution = 1;
+			unsigned int seed = 0;
+		};
+
+		//Encoder of records of numeric and categorical fields into the (visible) sensors of a block of time steps. Every
+		//field has its own range of sensors, after the sensors of the previous field; the sensors after the last field 
+		//are not written. A missing value (NaN) has no active sensors. Encoding does not allocate.
+		template <typename P>
+		class Record_Encoder
+		{
+		public:
+			//Add a field; returns the index of the field, or -1 when the field does not fit in the visible sensors.
+			int add_scalar(const int n_bits, const int n_active, const float min, const float max)
+			{
+				Field field;
+				field.encoding = SCALAR;
+				field.n_bits = n_bits;
+				field.n_active = n_active;
+				field.min = min;
+				field.max = max;
+				return this->add(field);
+			}
+			int add_cyclic(const int n_bits, const int n_active, const float min, const float max)
+			{
+				Field field;
+				field.encoding = CYCLIC;
+				field.n_bits = n_bits;
+				field.n_active = n_active;
+				field.min = min;
+				field.max = max;
+				return this->add(field);
+			}
+			int add_category(const int n_categories, const int n_active)
+			{
+				Field field;
+				field.encoding = CATEGORY;
+				field.n_bits = n_categories * n_active;
+				field.n_active = n_active;
+				return this->add(field);
+			}
+			int add_rdse(const int n_bits, const int n_active, const float resolution, const unsigned int seed)
+			{
+				Field field;
+				field.encoding = RDSE;
+				field.n_bits = n_bits;
+				field.n_active = n_active;
+				field.resolution = resolution;
+				field.seed = seed;
+				return this->add(field);
+			}
+
+			int n_fields() const
+			{
+				return static_cast<int>(this->fields_.size());
+			}
+			//Number of sensors of all fields.
+			int n_bits() const
+			{
+				return (this->fields_.empty()) ? 0 : (this->fields_.back().offset + this->fields_.back().n_bits);
+			}
+			const Field& field(const int field_i) const
+			{
+				return this->fields_[field_i];
+			}
+
+			//Encode n_steps records in the sensors of n_steps time steps: values[(step_i * n_fields()) + field_i] is 
+			//the value of field field_i in time step step_i. Sensors is either Active_Visible_Sensors or Active_Sensors.
+			template <typename Sensors>
+			void encode(
+				const float * const values,
+				const int n_steps,
+				//out
+				Sensors * const sensors) const
+			{
+				static_assert(Sensors::SIZE >= P::N_VISIBLE_SENSORS, "ERROR: encode: sensors are smaller than the visible sensors.");
+				const int n_fields = this->n_fields();
+
+				for (int field_i = 0; field_i < n_fields; ++field_i)
+				{
+					// copies of the field, such that the writes in the sensors do not reload them
+					const Field field = this->fields_[field_i];
+					const int n_bits = field.n_bits;
+					const int n_active = field.n_active;
+					const int field_begin = field.offset;
+					const int field_end = field.offset + n_bits;
+					const float * value = &values[field_i];
+
+					switch (field.encoding)
+					{
+						case SCALAR:
+						{
+							const float scale = static_cast<float>(n_bits - n_active) / (field.max - field.min);
+							for (int step_i = 0; step_i < n_steps; ++step_i, value += n_fields)
+							{
+								const float v = *value;
+								const int begin = (v != v) ? field_end : field_begin + static_cast<int>(((std::min(field.max, std::max(field.min, v)) - field.min) * scale) + 0.5f);
+								priv::write_runs<P>(sensors[step_i].data(), field_begin, field_end, begin, std::min(field_end, begin + n_active), 0, 0);
+							}
+							break;
+						}
+						case CYCLIC:
+						{
+							const float period = field.max - field.min;
+							const float scale = static_cast<float>(n_bits) / period;
+							const float min_phase = std::fmod(field.min, period);
+							for (int step_i = 0; step_i < n_steps; ++step_i, value += n_fields)
+							{
+								const float v = *value;
+								int begin = n_bits;
+								if (std::isfinite(v))
+								{
+									// the phase is reduced to (-2 * period, 2 * period) with fmod (which is exact) and then to 
+									// [0, period) before it is scaled, such that a large value cannot overflow the conversion to int
+									float phase = std::fmod(v, period) - min_phase;
+									if (phase < 0) phase += period;
+									if (phase < 0) phase += period;
+									if (phase >= period) phase -= period;
+									begin = std::min(n_bits - 1, static_cast<int>(phase * scale));
+								}
+								// a missing value has no run that wraps around
+								const int end = (begin == n_bits) ? n_bits : begin + n_active;
+								priv::write_runs<P>(sensors[step_i].data(), field_begin, field_end, field_begin + begin, field_begin + std::min(n_bits, end), field_begin, field_begin + std::max(0, end - n_bits));
+							}
+							break;
+						}
+						case CATEGORY:
+						{
+							const int n_categories = n_bits / n_active;
+							for (int step_i = 0; step_i < n_steps; ++step_i, value += n_fields)
+							{
+								const float v = *value;
+								const int category = ((v >= 0) && (v < n_categories)) ? static_cast<int>(v) : n_categories;
+								const int begin = field_begin + (category * n_active);
+								priv::write_runs<P>(sensors[step_i].data(), field_begin, field_end, begin, std::min(field_end, begin + n_active), 0, 0);
+							}
+							break;
+						}
+						case RDSE:
+						{
+							// the sensors of a bucket are hashed once in words like those of the sensors, and reused as long 
+							// as the value stays in the bucket
+							const float max_bucket = 1e9f;
+							const int word_begin = field_begin >> 5;
+							const int word_end = (field_end + 31) >> 5;
+							std::array<int, Sensors::N_BLOCKS> bucket_words;
+							int previous_bucket = 0;
+							bool has_previous_bucket = false;
+
+							for (int step_i = 0; step_i < n_steps; ++step_i, value += n_fields)
+							{
+								int * const data = sensors[step_i].data();
+								priv::write_runs<P>(data, field_begin, field_end, 0, 0, 0, 0);
+
+								const float v = *value;
+								if (v != v) continue;
+								const int bucket = static_cast<int>(std::min(max_bucket, std::max(-max_bucket, std::floor(v / field.resolution))));
+								if (!has_previous_bucket || (bucket != previous_bucket))
+								{
+									for (int word_i = word_begin; word_i < word_end; ++word_i) bucket_words[word_i] = 0;
+									for (int i = 0; i < n_active; ++i)
+									{
+										const int sensor_i = field_begin + static_cast<int>((static_cast<uint64_t>(priv::rdse_hash(field.seed, bucket + i)) * static_cast<uint64_t>(n_bits)) >> 32);
+										bucket_words[sensor_i >> 5] |= (1 << (sensor_i & 0b11111));
+									}
+									previous_bucket = bucket;
+									has_previous_bucket = true;
+								}
+								for (int word_i = word_begin; word_i < word_end; ++word_i) data[word_i] |= bucket_words[word_i];
+							}
+							break;
+						}
+					}
+				}
+			}
+
+		private:
+			std::vector<Field> fields_;
+
+			int add(Field& field)
+			{
+				field.offset = this->n_bits();
+				const bool valid_range = (field.encoding == RDSE) ? (field.resolution > 0) : ((field.encoding == CATEGORY) || (field.max > field.min));
+				if (!valid_range)
+				{
+					log_WARNING("encoder::Record_Encoder:add: field with an empty range of values.\n");
+					return -1;
+				}
+				if ((field.n_active <= 0) || (field.n_bits < field.n_active) || ((field.offset + field.n_bits) > P::N_VISIBLE_SENSORS))
+				{
+					log_WARNING("encoder::Record_Encoder:add: field with ", field.n_bits, " sensors and ", field.n_active, " active sensors does not fit after ", field.offset, " of ", P::N_VISIBLE_SENSORS, " visible sensors.\n");
+					return -1;
+				}
+				this->fields_.push_back(field);
+				return this->n_fields() - 1;
+			}
+		};
+		#pragma endregion
 	}
 }
\ No newline at end of file
@@ -0,0 +1,407 @@
+// C++ port of Nupic HTM with the aim of being lite and fast
+//
+// Copyright (c) 2017 Henk-Jan Lebbink
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero Public License version 3 as
+// published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero Public License for more details.
+//
+// You should have received a copy of the GNU Affero Public License
+// along with this program.  If not, see http://www.gnu.org/licenses.
+
+#pragma once
+#include <algorithm>	// std::min
+#include <vector>
+#include <memory>		// std::unique_ptr
+#include <cstdint>
+#include <immintrin.h>	// _tzcnt_u64
+
+#include "..\Spike-Tools-Lib\log.ipp"
+#include "..\Spike-Tools-Lib\profiler.ipp"
+#include "..\Spike-Tools-Lib\thread_pool.ipp"
+
+#include "parameters.ipp"
+#include "tools.ipp"
+#include "types.ipp"
+#include "datastream.ipp"
+#include "encoder.ipp"
+#include "sp.ipp"
+#include "tp.ipp"
+#include "layer.ipp"
+
+//Hierarchical Temporal Memory (HTM)
+namespace htm
+{
+	//Inference of many streams with one trained (read only) layer. The streams are stepped in batches of at most 64:
+	//the SP overlap and the TP dendrite activation of a batch are computed in one pass over the synapses, where every
+	//sensor and every cell holds a 64-bit mask of the streams in which it is active. The batches run concurrently on
+	//the thread pool. The results are identical to layer::run without learning for every stream separately.
+	namespace inference
+	{
+		using namespace ::tools::log;
+		using namespace htm::types;
+		using namespace htm::datastream;
+
+		namespace priv
+		{
+			static constexpr int BATCH_SIZE = 64;
+
+			//Scratch of one batch such that a time step does not allocate. The stream masks are all zero outside a time step.
+			template <typename P>
+			struct Batch
+			{
+				using Active_Cells = typename Layer_Fluent<P>::Active_Cells;
+				static constexpr int N_DELAYS = Active_Cells::HISTORY_SIZE;
+
+				int stream_begin = 0;
+				int n_streams = 0;
+
+				//Streams in which a sensor is active.
+				std::vector<uint64_t> sensor_streams = std::vector<uint64_t>(P::N_SENSORS, 0);
+
+				//Streams in which a cell is active, delay time steps ago; index cell * N_DELAYS + delay.
+				std::vector<uint64_t> cell_streams = std::vector<uint64_t>(static_cast<size_t>(P::N_CELLS) * N_DELAYS, 0);
+
+				//Cells that are active in at least one stream (with any delay), and the indices of cell_streams that are set.
+				std::vector<int> active_cell_ids;
+				std::vector<int> cell_streams_touched;
+
+				//Number of connected and active synapses of the current segment per stream; zero outside a segment.
+				int n_potential_synapses[BATCH_SIZE] = {};
+				int n_active_synapses[BATCH_SIZE] = {};
+			};
+
+			//Compute the overlap of all streams of the batch in one pass over the proximal synapses (synapse forward).
+			template <typename P>
+			void calc_overlap_batch_ref(
+				const Layer_Persisted<P>& layer,
+				Layer_Fluent<P> * const * layer_fluent,
+				Batch<P>& batch)
+			{
+				auto& sensor_streams = batch.sensor_streams;
+				for (int stream_i = 0; stream_i < batch.n_streams; ++stream_i)
+				{
+					const auto& active_sensors = layer_fluent[stream_i]->active_sensors;
+					const uint64_t stream_bit = uint64_t(1) << stream_i;
+					for (int block_i = 0; block_i < active_sensors.N_BLOCKS; ++block_i)
+					{
+						unsigned int word = static_cast<unsigned int>(active_sensors._data[block_i]);
+						while (word)
+						{
+							const int sensor_i = (block_i << 5) + static_cast<int>(_tzcnt_u32(word));
+							sensor_streams[sensor_i] |= stream_bit;
+							word &= word - 1;
+						}
+					}
+				}
+
+				int overlap[BATCH_SIZE];
+				for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+				{
+					const auto& permanence = layer.sp_pd_synapse_permanence_sf[column_i];
+					const auto& synapse_origin = layer.sp_pd_synapse_origin_sensor_sf[column_i];
+
+					std::fill_n(overlap, batch.n_streams, 0);
+					for (auto synapse_i = 0; synapse_i < P::SP_N_PD_SYNAPSES; ++synapse_i)
+					{
+						if (permanence[synapse_i] > P::SP_PD_PERMANENCE_THRESHOLD)
+						{
+							uint64_t streams = sensor_streams[synapse_origin[synapse_i]];
+							while (streams)
+							{
+								overlap[_tzcnt_u64(streams)]++;
+								streams &= streams - 1;
+							}
+						}
+					}
+					for (int stream_i = 0; stream_i < batch.n_streams; ++stream_i)
+					{
+						layer_fluent[stream_i]->sp_overlap[column_i] = (overlap[stream_i] < P::SP_STIMULUS_THRESHOLD) ? 0 : overlap[stream_i];
+					}
+				}
+				std::fill(sensor_streams.begin(), sensor_streams.end(), 0);
+			}
+
+			//Activate the dendrites of all streams of the batch in one pass over the distal synapses (synapse forward);
+			//per stream equal to activate_dendrites_sf_ref without learning.
+			template <typename P>
+			void activate_dendrites_batch_ref(
+				const Layer_Persisted<P>& layer,
+				Layer_Fluent<P> * const * layer_fluent,
+				const Dynamic_Param& param,
+				Batch<P>& batch)
+			{
+				constexpr int N_DELAYS = Batch<P>::N_DELAYS;
+				auto& cell_streams = batch.cell_streams;
+				auto& touched = batch.cell_streams_touched;
+				touched.clear();
+
+				for (int stream_i = 0; stream_i < batch.n_streams; ++stream_i)
+				{
+					const auto& active_cells = layer_fluent[stream_i]->active_cells;
+					const uint64_t stream_bit = uint64_t(1) << stream_i;
+					active_cells.collect_active((1u << N_DELAYS) - 1, batch.active_cell_ids);
+					for (const int cell_i : batch.active_cell_ids)
+					{
+						for (int delay = 0; delay < N_DELAYS; ++delay)
+						{
+							if (active_cells.get(cell_i, delay))
+							{
+								const int index = (cell_i * N_DELAYS) + delay;
+								if (cell_streams[index] == 0) touched.push_back(index);
+								cell_streams[index] |= stream_bit;
+							}
+						}
+					}
+				}
+
+				int * const n_potential_synapses = batch.n_potential_synapses;
+				int * const n_active_synapses = batch.n_active_synapses;
+
+				for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+				{
+					const int n_segments = layer.dd_segment_count[column_i];
+					const Permanence * permanence_slab = layer.dd_synapse_permanence_sf[column_i].data();
+					const typename P::TP_Origin * delay_origin_slab = layer.dd_synapse_delay_origin_sf[column_i].data();
+					const auto& offset_segment = layer.dd_segment_offset_sf[column_i];
+					const auto& synapse_count_segment = layer.dd_synapse_count_sf[column_i];
+
+					for (int stream_i = 0; stream_i < batch.n_streams; ++stream_i)
+					{
+						layer_fluent[stream_i]->active_dd_segments[column_i].current().reset();
+						layer_fluent[stream_i]->matching_dd_segments[column_i].current().reset();
+					}
+
+					for (auto segment_i = 0; segment_i < n_segments; ++segment_i)
+					{
+						const Permanence * dd_synapse_permanence_segment = &permanence_slab[offset_segment[segment_i]];
+						const typename P::TP_Origin * dd_synapse_delay_origin_segment = &delay_origin_slab[offset_segment[segment_i]];
+						const int n_synpases = synapse_count_segment[segment_i];
+
+						uint64_t segment_streams = 0;
+						for (auto synapse_i = 0; synapse_i < n_synpases; ++synapse_i)
+						{
+							const Permanence permanence = dd_synapse_permanence_segment[synapse_i];
+							if (permanence > P::TP_DD_CONNECTED_THRESHOLD)
+							{
+								const int delay_and_cell_id = tools::widen_origin<P>(dd_synapse_delay_origin_segment[synapse_i]);
+								const int global_cell_id = tools::get_global_cell_id(delay_and_cell_id);
+								const int delay = tools::get_delay(delay_and_cell_id) - 1;
+								const uint64_t streams = cell_streams[(global_cell_id * N_DELAYS) + delay];
+								if (streams == 0) continue;
+
+								segment_streams |= streams;
+								const bool active = (permanence > P::TP_DD_PERMANENCE_THRESHOLD);
+								uint64_t s = streams;
+								while (s)
+								{
+									const int stream_i = static_cast<int>(_tzcnt_u64(s));
+									n_potential_synapses[stream_i]++;
+									n_active_synapses[stream_i] += active;
+									s &= s - 1;
+								}
+							}
+						}
+						while (segment_streams)
+						{
+							const int stream_i = static_cast<int>(_tzcnt_u64(segment_streams));
+							if (n_potential_synapses[stream_i] > param.TP_MIN_DD_ACTIVATION_THRESHOLD)
+							{
+								layer_fluent[stream_i]->matching_dd_segments[column_i].current().add(segment_i, n_potential_synapses[stream_i]);
+							}
+							if (n_active_synapses[stream_i] > param.TP_DD_SEGMENT_ACTIVE_THRESHOLD)
+							{
+								layer_fluent[stream_i]->active_dd_segments[column_i].current().add(segment_i, n_active_synapses[stream_i]);
+							}
+							n_potential_synapses[stream_i] = 0;
+							n_active_synapses[stream_i] = 0;
+							segment_streams &= segment_streams - 1;
+						}
+					}
+				}
+				for (const int index : touched) cell_streams[index] = 0;
+			}
+
+			//One time step without learning for all streams of the batch; the active sensors are in the layer_fluent of
+			//every stream. Param is the param of one stream (n_threads is one).
+			template <typename P>
+			void one_step_batch(
+				const Layer_Persisted<P>& layer,
+				Layer_Fluent<P> * const * layer_fluent,
+				const int time,
+				const Dynamic_Param& param,
+				Batch<P>& batch)
+			{
+				for (int stream_i = 0; stream_i < batch.n_streams; ++stream_i)
+				{
+					layer_fluent[stream_i]->active_cells.advance_time();
+					layer_fluent[stream_i]->winner_cells.advance_time();
+					layer_fluent[stream_i]->iteration_num++;
+				}
+
+				{
+					::tools::profiler::Scope scope("inference.sp.overlap");
+					if constexpr (P::SP_SYNAPSE_FORWARD && !P::SP_OVERLAP_INCREMENTAL)
+					{
+						calc_overlap_batch_ref(layer, layer_fluent, batch);
+					}
+					else
+					{
+						// the synapse backward and incremental overlap have no batched variant
+						for (int stream_i = 0; stream_i < batch.n_streams; ++stream_i)
+						{
+							auto& lf = *layer_fluent[stream_i];
+							std::fill(lf.sp_overlap.begin(), lf.sp_overlap.end(), 0);
+							if constexpr (P::SP_OVERLAP_INCREMENTAL)
+								sp::priv::calc_overlap::incremental::calc_overlap_incremental(lf, layer, param, lf.active_sensors, lf.sp_overlap);
+							else
+								sp::priv::calc_overlap::d(layer, param, lf.active_sensors, lf.sp_overlap);
+						}
+					}
+				}
+				{
+					// one stream at a time, such that its state is in cache for the sp and tp steps
+					::tools::profiler::Scope scope("inference.columns_and_cells");
+					for (int stream_i = 0; stream_i < batch.n_streams; ++stream_i)
+					{
+						auto& lf = *layer_fluent[stream_i];
+						sp::compute_sp_columns<false>(lf.active_sensors, lf, layer, param, lf.active_columns);
+						tp::priv::activate_cells::d<false>(lf, layer, time, param, lf.active_columns, lf.active_cells, lf.winner_cells);
+					}
+				}
+				{
+					::tools::profiler::Scope scope("inference.tp.activate_dendrites");
+					activate_dendrites_batch_ref(layer, layer_fluent, param, batch);
+				}
+			}
+		}
+
+		//Streams that infer with one shared trained layer. Every stream has its own fluent state; the layer is not
+		//changed and may be used for inference by other Streams (or other threads) at the same time, but it must not
+		//learn meanwhile. Streams in different threads that step with the same number of threads share one pool of
+		//::tools::thread_pool::get_pool; their steps are correct, but they take turns on that pool.
+		template <typename P>
+		class Streams
+		{
+		public:
+			Streams(const Layer_Persisted<P>& layer, const int n_streams)
+				: layer_(layer)
+			{
+				for (int i = 0; i < n_streams; ++i)
+				{
+					this->layer_fluent_.push_back(std::make_unique<Layer_Fluent<P>>());
+					this->layer_fluent_ptr_.push_back(this->layer_fluent_.back().get());
+				}
+				for (int stream_begin = 0; stream_begin < n_streams; stream_begin += priv::BATCH_SIZE)
+				{
+					this->batch_.push_back(std::make_unique<priv::Batch<P>>());
+					this->batch_.back()->stream_begin = stream_begin;
+					this->batch_.back()->n_streams = std::min(priv::BATCH_SIZE, n_streams - stream_begin);
+				}
+			}
+			Streams(const Streams&) = delete;
+			Streams& operator=(const Streams&) = delete;
+
+			int size() const
+			{
+				return static_cast<int>(this->layer_fluent_.size());
+			}
+			const Layer_Persisted<P>& layer() const
+			{
+				return this->layer_;
+			}
+			Layer_Fluent<P>& layer_fluent(const int stream_i)
+			{
+				return *this->layer_fluent_[stream_i];
+			}
+
+			//Reset the fluent state of all streams.
+			void init(const Dynamic_Param& param)
+			{
+				for (auto& lf : this->layer_fluent_) layer::init_fluent(*lf, this->layer_, param);
+			}
+
+			//Do one time step without learning for all streams: the active sensors of stream i are expected in
+			//layer_fluent(i).active_sensors. The batches are distributed over param.n_threads threads; after every
+			//batch, f(stream_i) is called (by the thread of the batch) for every stream of the batch.
+			template <typename F>
+			void one_step(const int time, const Dynamic_Param& param, const F& f)
+			{
+				// a batch is done by one thread: the column chunks of sp and tp are not distributed again
+				Dynamic_Param param_stream = param;
+				param_stream.n_threads = 1;
+
+				const int n_batches = static_cast<int>(this->batch_.size());
+				::tools::thread_pool::get_pool(param.n_threads).parallel_for(n_batches, 1, [&](const int begin, const int end)
+				{
+					for (int batch_i = begin; batch_i < end; ++batch_i)
+					{
+						auto& batch = *this->batch_[batch_i];
+						priv::one_step_batch(this->layer_, &this->layer_fluent_ptr_[batch.stream_begin], time, param_stream, batch);
+						for (int stream_i = batch.stream_begin; stream_i < (batch.stream_begin + batch.n_streams); ++stream_i) f(stream_i);
+					}
+				});
+			}
+			void one_step(const int time, const Dynamic_Param& param)
+			{
+				this->one_step(time, param, [](const int) {});
+			}
+
+		private:
+			const Layer_Persisted<P>& layer_;
+			std::vector<std::unique_ptr<Layer_Fluent<P>>> layer_fluent_;
+			std::vector<Layer_Fluent<P> *> layer_fluent_ptr_;
+			std::vector<std::unique_ptr<priv::Batch<P>>> batch_;
+		};
+
+		//Run every stream with its own datastream for param.n_time_steps without learning; the datastreams have to be
+		//different objects since they advance concurrently. The prediction mismatch of stream i is summed in
+		//prediction_mismatch[i], which holds (as in layer::run) one value per future.
+		template <typename P>
+		void run(
+			Streams<P>& streams,
+			const std::vector<const DataStream<P> *>& datastreams,
+			const Dynamic_Param& param,
+			//out
+			std::vector<std::vector<int>>& prediction_mismatch)
+		{
+			const int n_streams = streams.size();
+			if (static_cast<int>(datastreams.size()) != n_streams) log_ERROR("inference:run: ", datastreams.size(), " datastreams for ", n_streams, " streams.\n");
+			if (static_cast<int>(prediction_mismatch.size()) != n_streams) log_ERROR("inference:run: ", prediction_mismatch.size(), " mismatch vectors for ", n_streams, " streams.\n");
+
+			Dynamic_Param param_stream = param;
+			param_stream.n_threads = 1;
+
+			auto current_mismatch = std::vector<std::vector<int>>(n_streams);
+			for (int stream_i = 0; stream_i < n_streams; ++stream_i)
+			{
+				tools::clear(prediction_mismatch[stream_i]);
+				current_mismatch[stream_i] = std::vector<int>(prediction_mismatch[stream_i].size(), 0);
+			}
+
+			for (int time = 0; time < param.n_time_steps; ++time)
+			{
+				for (int stream_i = 0; stream_i < n_streams; ++stream_i)
+				{
+					auto& layer_fluent = streams.layer_fluent(stream_i);
+					datastreams[stream_i]->current_sensors(layer_fluent.active_sensors);
+					encoder::add_sensor_noise<P>(layer_fluent.active_sensors, layer_fluent.noise_random_lanes);
+				}
+				streams.one_step(time, param, [&](const int stream_i)
+				{
+					if (!prediction_mismatch[stream_i].empty())
+					{
+						layer::priv::calc_mismatch(time, streams.layer_fluent(stream_i), streams.layer(), param_stream, *datastreams[stream_i], current_mismatch[stream_i]);
+						tools::add(prediction_mismatch[stream_i], current_mismatch[stream_i]);
+					}
+					datastreams[stream_i]->advance_time();
+				});
+			}
+		}
+	}
+}
\ No newline at end of file
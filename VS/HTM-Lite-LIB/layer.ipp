@@ -23,9 +23,12 @@
 #include <array>
 #include <vector>
 
+#include "..\Spike-Tools-Lib\profiler.ipp"
+
 #include "parameters.ipp"
 #include "tools.ipp"
 #include "types.ipp"
+#include "sdr.ipp"
 #include "print.ipp"
 #include "datastream.ipp"
 #include "sp.ipp"
@@ -45,6 +48,59 @@ namespace htm
 		//HTM layer private methods
 		namespace priv
 		{
+			//Fork of the fluent state of a layer: the constructor saves the state that time steps without learning change,
+			//the destructor discards these time steps by swapping the saved state back. Saving copies the cells, the random
+			//numbers of the columns and the segment sets (which are mostly empty); the sp and tp scratch is not saved.
+			template <typename P>
+			class Fork
+			{
+			public:
+				explicit Fork(Layer_Fluent<P>& layer_fluent)
+					: layer_fluent_(layer_fluent)
+				{
+					if (layer_fluent.fork_state.empty()) layer_fluent.fork_state.resize(1);
+					auto& saved = layer_fluent.fork_state[0];
+
+					saved.active_cells = layer_fluent.active_cells;
+					saved.winner_cells = layer_fluent.winner_cells;
+					saved.active_columns = layer_fluent.active_columns;
+					saved.active_dd_segments = layer_fluent.active_dd_segments;
+					saved.matching_dd_segments = layer_fluent.matching_dd_segments;
+					saved.random_number = layer_fluent.random_number;
+					saved.iteration_num = layer_fluent.iteration_num;
+					if constexpr (P::SP_OVERLAP_INCREMENTAL)
+					{
+						saved.sp_overlap_incremental = layer_fluent.sp_overlap_incremental;
+						saved.sp_active_sensors_incremental = layer_fluent.sp_active_sensors_incremental;
+						saved.sp_overlap_valid_incremental = layer_fluent.sp_overlap_valid_incremental;
+					}
+				}
+				~Fork()
+				{
+					auto& layer_fluent = this->layer_fluent_;
+					auto& saved = layer_fluent.fork_state[0];
+
+					std::swap(layer_fluent.active_cells, saved.active_cells);
+					std::swap(layer_fluent.winner_cells, saved.winner_cells);
+					std::swap(layer_fluent.active_columns, saved.active_columns);
+					std::swap(layer_fluent.active_dd_segments, saved.active_dd_segments);
+					std::swap(layer_fluent.matching_dd_segments, saved.matching_dd_segments);
+					std::swap(layer_fluent.random_number, saved.random_number);
+					layer_fluent.iteration_num = saved.iteration_num;
+					if constexpr (P::SP_OVERLAP_INCREMENTAL)
+					{
+						std::swap(layer_fluent.sp_overlap_incremental, saved.sp_overlap_incremental);
+						std::swap(layer_fluent.sp_active_sensors_incremental, saved.sp_active_sensors_incremental);
+						layer_fluent.sp_overlap_valid_incremental = saved.sp_overlap_valid_incremental;
+					}
+				}
+				Fork(const Fork&) = delete;
+				Fork& operator=(const Fork&) = delete;
+
+			private:
+				Layer_Fluent<P>& layer_fluent_;
+			};
+
 			namespace get_predicted_sensors
 			{
 				namespace synapse_backward
@@ -54,13 +110,13 @@ namespace htm
 					//Synapse backwards
 					template <typename P>
 					void get_predicted_sensors_sb_ref(
-						const Layer_Fluent<P>& layer_fluent,
+						Layer_Fluent<P>& layer_fluent,
 						const Layer_Persisted<P>& layer,
 						const Dynamic_Param& param,
 						//out
 						typename Layer_Fluent<P>::Active_Visible_Sensors& predicted_sensor)
 					{
-						std::vector<int> predicted_sensor_activity = std::vector<int>(P::N_VISIBLE_SENSORS, 0);
+						auto& predicted_sensor_activity = layer_fluent.predicted_sensor_activity;
 
 						Layer_Fluent<P>::Active_Columns predicted_columns;
 
@@ -91,11 +147,7 @@ namespace htm
 							predicted_sensor_activity[sensor_i] = sensor_activity;
 						}
 
-						predicted_sensor.clear_all();
-						for (int sensor_i = 0; sensor_i < P::N_VISIBLE_SENSORS; ++sensor_i)
-						{
-							if (predicted_sensor_activity[sensor_i] > param.sensor_threshold) predicted_sensor.set(sensor_i, true);
-						}
+						sdr::threshold<P>(predicted_sensor_activity.data(), param.sensor_threshold, predicted_sensor);
 					}
 				}
 
@@ -104,15 +156,16 @@ namespace htm
 					// predicts sensors one steps into the future
 					template <typename P>
 					void get_predicted_sensors_sf_ref(
-						const Layer_Fluent<P>& layer_fluent,
-						Layer_Persisted<P>& layer,//TODO: should have been const but ICC does not allow it
+						Layer_Fluent<P>& layer_fluent,
+						const Layer_Persisted<P>& layer,
 						const Dynamic_Param& param,
 						//out
 						typename Layer_Fluent<P>::Active_Visible_Sensors& predicted_visible_sensor)
 					{
 						//log_INFO("get_predicted_sensors_sf_ref: active_sensors:\n", print::print_active_sensors<P>(active_sensors, param.n_visible_sensors_dim1));
 
-						auto predicted_visible_sensor_activity = std::vector<int>(P::N_VISIBLE_SENSORS, 0);
+						auto& predicted_visible_sensor_activity = layer_fluent.predicted_sensor_activity;
+						std::fill(predicted_visible_sensor_activity.begin(), predicted_visible_sensor_activity.begin() + P::N_VISIBLE_SENSORS, 0);
 
 						for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
 						{
@@ -135,40 +188,42 @@ namespace htm
 								}
 							}
 						}
-						for (int sensor_i = 0; sensor_i < P::N_VISIBLE_SENSORS; ++sensor_i)
-						{
-							predicted_visible_sensor.set(sensor_i, (predicted_visible_sensor_activity[sensor_i] > param.sensor_threshold));
-						}
+						sdr::threshold<P>(predicted_visible_sensor_activity.data(), param.sensor_threshold, predicted_visible_sensor);
 					}
 					
-					// predicts sensor multi time steps into the future, 
+					// predicts sensor multi time steps into the future: future 0 is predicted by the current active segments, and
+					// future i by a fork of the layer that has done i time steps (without learning) with the predicted sensors
+					// of future i-1 as input. The fluent state of the layer is restored afterwards.
 					template <typename P>
 					void get_predicted_sensors_sf_multifuture_ref(
 						const int time,
-						const typename Layer_Fluent<P>::Active_Sensors& active_sensors,
 						Layer_Fluent<P>& layer_fluent,
-						Layer_Persisted<P>& layer, // should have been const but ICC does not allow it
+						const Layer_Persisted<P>& layer,
 						const Dynamic_Param& param,
 						//out
 						std::vector<typename Layer_Fluent<P>::Active_Visible_Sensors>& predicted_visible_sensor)
 					{
+						::tools::profiler::Scope scope("lookahead");
 						const int n_futures = static_cast<int>(predicted_visible_sensor.size());
-						auto predicted_sensor_activity = std::vector<int>(P::N_SENSORS, 0);
-						typename Layer_Fluent<P>::Active_Sensors predicted_sensors = typename Layer_Fluent<P>::Active_Sensors(active_sensors);
-						typename Layer_Fluent<P>::Active_Columns predicted_columns;
+						auto& predicted_sensor_activity = layer_fluent.predicted_sensor_activity;
+						typename Layer_Fluent<P>::Active_Sensors predicted_sensors;
 
-						//log_INFO("get_predicted_sensors_sf_multifuture_ref: active_sensors:\n", print::print_active_sensors<P>(layer.active_sensors, param.n_visible_sensors_dim1));
+						const Fork<P> fork(layer_fluent);
 
 						for (int future_i = 0; future_i < n_futures; ++future_i)
 						{
-							assert_msg(false, "NOT implemented yet");
-							//TODO: calling one_step destroys the fluent state of the layer: only the (const) persisted state is needed
-							//priv::one_step<false>(predicted_sensors, layer_fluent, layer, time, param);
+							if (future_i > 0)
+							{
+								layer_fluent.active_cells.advance_time();
+								layer_fluent.winner_cells.advance_time();
+								sp::compute_sp<false>(predicted_sensors, layer_fluent, layer, param, layer_fluent.active_columns);
+								tp::compute_tp<false>(layer_fluent, layer, time + future_i, param, layer_fluent.active_columns, layer_fluent.active_cells, layer_fluent.winner_cells);
+							}
 
+							std::fill(predicted_sensor_activity.begin(), predicted_sensor_activity.end(), 0);
 							for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
 							{
 								const bool column_is_predicted = layer_fluent.active_dd_segments[column_i].any_current();
-								//const bool column_is_predicted = predicted_columns.get(column_i);
 								if (column_is_predicted)
 								{
 									const auto& synapse_origin = layer.sp_pd_synapse_origin_sensor_sf[column_i];
@@ -186,15 +241,9 @@ namespace htm
 							}
 							if (future_i < (n_futures - 1))
 							{
-								for (int sensor_i = 0; sensor_i < P::N_SENSORS; ++sensor_i)
-								{
-									predicted_sensors.set(sensor_i, (predicted_sensor_activity[sensor_i] > param.sensor_threshold));
-								}
-							}
-							for (int sensor_i = 0; sensor_i < P::N_VISIBLE_SENSORS; ++sensor_i)
-							{
-								predicted_visible_sensor[future_i].set(sensor_i, (predicted_sensor_activity[sensor_i] > param.sensor_threshold));
+								sdr::threshold<P>(predicted_sensor_activity.data(), param.sensor_threshold, predicted_sensors);
 							}
+							sdr::threshold<P>(predicted_sensor_activity.data(), param.sensor_threshold, predicted_visible_sensor[future_i]);
 						}
 					}
 
@@ -203,16 +252,15 @@ namespace htm
 					void get_predicted_sensors_sf_ref(
 						const int time,
 						Layer_Fluent<P>& layer_fluent,
-						Layer_Persisted<P>& layer, //TODO: should have been const but ICC does not allow it
+						const Layer_Persisted<P>& layer,
 						const Dynamic_Param& param,
 						//out
 						std::vector<typename Layer_Fluent<P>::Active_Visible_Sensors>& predicted_visible_sensor)
 					{
 						if (predicted_visible_sensor.size() == 1)
 							get_predicted_sensors_sf_ref(layer_fluent, layer, param, predicted_visible_sensor[0]);
-							//get_predicted_sensors_sf_multifuture_ref(time, layer_fluent.active_sensors, layer_fluent, layer, param, predicted_visible_sensor);
 						else
-							get_predicted_sensors_sf_multifuture_ref(time, layer_fluent.active_sensors, layer_fluent, layer, param, predicted_visible_sensor);
+							get_predicted_sensors_sf_multifuture_ref(time, layer_fluent, layer, param, predicted_visible_sensor);
 					}
 
 					template <typename P>
@@ -232,14 +280,12 @@ namespace htm
 							bool column_is_predicted = false;
 							{
 								const int n_segments = layer.dd_segment_count[column_i];
-								const auto& permanence_segment = layer.dd_synapse_permanence_sf[column_i];
-								const auto& delay_origin_segment = layer.dd_synapse_delay_origin_sf[column_i];
 								const auto& synapse_count_segment = layer.dd_synapse_count_sf[column_i];
 
 								for (int segment_i = 0; segment_i < n_segments; ++segment_i)
 								{
-									const auto& dd_synapse_permanence_segment = permanence_segment[segment_i];
-									const auto& dd_synapse_delay_origin_segment = delay_origin_segment[segment_i];
+									const Permanence * dd_synapse_permanence_segment = layer.dd_synapse_permanence_segment(column_i, segment_i);
+									const typename P::TP_Origin * dd_synapse_delay_origin_segment = layer.dd_synapse_delay_origin_segment(column_i, segment_i);
 									const int n_synpases = synapse_count_segment[segment_i];
 
 									int n_active_synapses = 0;
@@ -249,7 +295,7 @@ namespace htm
 										const Permanence permanence = dd_synapse_permanence_segment[synapse_i];
 										if (permanence > P::TP_DD_PERMANENCE_THRESHOLD)
 										{
-											const auto delay_and_cell_id = dd_synapse_delay_origin_segment[synapse_i];
+											const int delay_and_cell_id = tools::widen_origin<P>(dd_synapse_delay_origin_segment[synapse_i]);
 											const int delay = tools::get_delay(delay_and_cell_id) - future;
 											if (delay >= 0)
 											{
@@ -298,7 +344,7 @@ namespace htm
 				void d(
 					const int time,
 					Layer_Fluent<P>& layer_fluent,
-					Layer_Persisted<P>& layer,//TODO: should have been const but ICC does not allow it
+					const Layer_Persisted<P>& layer,
 					const Dynamic_Param& param,
 					//out
 					std::vector<typename Layer_Fluent<P>::Active_Visible_Sensors>& predicted_sensors)
@@ -306,11 +352,13 @@ namespace htm
 					if (P::SP_SYNAPSE_FORWARD)
 					{
 						if (architecture_switch(P::ARCH) == arch_t::X64) synapse_forward::get_predicted_sensors_sf_ref(time, layer_fluent, layer, param, predicted_sensors);
+						if (architecture_switch(P::ARCH) == arch_t::AVX2) synapse_forward::get_predicted_sensors_sf_ref(time, layer_fluent, layer, param, predicted_sensors);
 						if (architecture_switch(P::ARCH) == arch_t::AVX512) synapse_forward::get_predicted_sensors_sf_ref(time, layer_fluent, layer, param, predicted_sensors);
 					}
 					else
 					{
 						if (architecture_switch(P::ARCH) == arch_t::X64) synapse_backward::get_predicted_sensors_sb_ref(layer_fluent, layer, param, predicted_sensors[0]);
+						if (architecture_switch(P::ARCH) == arch_t::AVX2) synapse_backward::get_predicted_sensors_sb_ref(layer_fluent, layer, param, predicted_sensors[0]);
 						if (architecture_switch(P::ARCH) == arch_t::AVX512) synapse_backward::get_predicted_sensors_sb_ref(layer_fluent, layer, param, predicted_sensors[0]);
 					}
 				}
@@ -320,7 +368,7 @@ namespace htm
 			void calc_mismatch(
 				const int time,
 				Layer_Fluent<P>& layer_fluent,
-				Layer_Persisted<P>& layer,//TODO: should have been const but ICC does not allow it
+				const Layer_Persisted<P>& layer,
 				const Dynamic_Param& param,
 				const DataStream<P>& datastream,
 				//out
@@ -328,27 +376,21 @@ namespace htm
 			{
 				const int n_futures = static_cast<int>(mismatch.size());
 
-				typename std::vector<Layer_Fluent<P>::Active_Sensors> actual_sensors(n_futures);
-				typename std::vector<Layer_Fluent<P>::Active_Visible_Sensors> predicted_sensors(n_futures);
+				auto& actual_sensors = layer_fluent.future_actual_sensors;
+				auto& predicted_sensors = layer_fluent.future_predicted_sensors;
+				if (static_cast<int>(actual_sensors.size()) != n_futures)
+				{
+					actual_sensors.resize(n_futures);
+					predicted_sensors.resize(n_futures);
+				}
 
 				datastream.future_sensors(actual_sensors);
 				get_predicted_sensors::d(time, layer_fluent, layer, param, predicted_sensors);
 
 				for (int future = 0; future < n_futures; ++future)
 				{
-					int mismatch_counter = 0;
-					if (datastream.sensors_predictable(future))
-					{
-						const auto& predicted = predicted_sensors[future];
-						const auto& actual = actual_sensors[future];
-
-						//TODO: the folling loop can be done by xoring the Active_Visible_Sensors
-						for (int i = 0; i < P::N_VISIBLE_SENSORS; ++i)
-						{
-							if (predicted.get(i) != actual.get(i)) mismatch_counter++;
-						}
-					}
-					mismatch[future] = mismatch_counter;
+					//only the visible sensors of the actual sensors are compared
+					mismatch[future] = (datastream.sensors_predictable(future)) ? sdr::hamming<P>(predicted_sensors[future], actual_sensors[future]) : 0;
 				}
 			}
 
@@ -384,7 +426,7 @@ namespace htm
 			void show_input_and_prediction(
 				const int time,
 				Layer_Fluent<P>& layer_fluent,
-				Layer_Persisted<P>& layer,//TODO: should have been const but ICC does not allow it
+				const Layer_Persisted<P>& layer,
 				const int n_futures,
 				const Dynamic_Param& param,
 				const DataStream<P>& datastream,
@@ -465,6 +507,7 @@ namespace htm
 				const int time,
 				const Dynamic_Param& param)
 			{
+				::tools::profiler::Scope scope("one_step");
 				layer_fluent.active_cells.advance_time();
 				layer_fluent.winner_cells.advance_time();
 
@@ -487,6 +530,16 @@ namespace htm
 					layer_fluent.active_cells,
 					layer_fluent.winner_cells);
 
+				if constexpr (LEARN)
+				{
+					if ((param.TP_DD_COMPACT_INTERVAL > 0) && ((layer_fluent.iteration_learn_num % param.TP_DD_COMPACT_INTERVAL) == 0))
+					{
+						tp::compact(layer_fluent, layer, param);
+					}
+				}
+
+				::tools::profiler::step(time);
+
 				#if _DEBUG
 				if (false) log_INFO("layer:run: active columns at t = ", time, ":\n", print::print_active_columns<P>(layer_fluent.active_columns, static_cast<int>(std::sqrt(P::N_COLUMNS))), "\n");
 				if (false) log_INFO("layer:run: dd_synapes at t = ", time, ": ", print::print_dd_synapses(layer), "\n");
@@ -498,6 +551,36 @@ namespace htm
 		template <typename P>
 		void init(Layer_Fluent<P>& layer_fluent, Layer_Persisted<P>& layer, const Dynamic_Param& param)
 		{
+			// reseed the random numbers: column i draws from stream i, the sensor noise from the streams after the columns
+			if (param.random_seed != 0)
+			{
+				for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+				{
+					layer_fluent.random_number[column_i] = random::stream_seed(param.random_seed, column_i);
+				}
+				layer_fluent.noise_random_lanes.seed(param.random_seed, (P::N_COLUMNS + random::Random_Lanes::N_LANES - 1) / random::Random_Lanes::N_LANES);
+			}
+
+			// with a NUMA local page policy, the storage of a column is allocated (and first touched) by the thread that
+			// processes its chunk of columns, such that it comes from the node that thread runs on. The slabs of the distal
+			// dendrites are released; they grow again in the chunks of the time steps.
+			if ((param.n_threads > 1) && ::tools::allocator::Page_Pool::instance().enabled() && (::tools::allocator::page_policy().numa == ::tools::allocator::numa_t::LOCAL))
+			{
+				tp::priv::for_each_column_chunk<P>(param, [&](const int column_begin, const int column_end)
+				{
+					for (int column_i = column_begin; column_i < column_end; ++column_i)
+					{
+						if (P::SP_SYNAPSE_FORWARD)
+						{
+							layer.sp_pd_synapse_permanence_sf[column_i] = typename Layer_Persisted<P>::t1(P::SP_N_PD_SYNAPSES, P::SP_PD_CONNECTED_THRESHOLD);
+							layer.sp_pd_synapse_origin_sensor_sf[column_i] = typename Layer_Persisted<P>::t2(P::SP_N_PD_SYNAPSES);
+						}
+						layer.dd_synapse_permanence_sf[column_i] = typename Layer_Persisted<P>::t5();
+						layer.dd_synapse_delay_origin_sf[column_i] = typename Layer_Persisted<P>::t6();
+					}
+				});
+			}
+
 			// reset pd synapses
 			if (P::SP_SYNAPSE_FORWARD)
 			{
@@ -510,11 +593,12 @@ namespace htm
 					for (int synapse_i = 0; synapse_i < P::SP_N_PD_SYNAPSES; ++synapse_i)
 					{
 						const int random_sensor = random::rand_int32(0, P::N_SENSORS - 1, random_number);
-						synapse_origin[synapse_i] = random_sensor;
+						synapse_origin[synapse_i] = static_cast<typename P::SP_Origin>(random_sensor);
 						synapse_permanence[synapse_i] = param.SP_PD_PERMANENCE_INIT;
 					}
 					layer_fluent.random_number[column_i] = random_number;
 				}
+				if (P::SP_OVERLAP_INCREMENTAL) sp::priv::calc_overlap::incremental::init(layer_fluent, layer);
 			}
 			else
 			{
@@ -549,26 +633,47 @@ namespace htm
 				}
 			}
 
+			sp::priv::update_inhibition_radius(layer_fluent, layer, param);
+
 			//init permanence values
 			for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
 			{
 				// reset dd synapses
 				layer.dd_segment_count[column_i] = 0;
-				layer.dd_synapse_count_sf[column_i].clear();
-				layer.dd_synapse_permanence_sf[column_i].clear();
-				layer.dd_synapse_delay_origin_sf[column_i].clear();
+				tp::priv::dd_slab::clear(layer, column_i);
 				layer_fluent.dd_synapse_active_time[column_i].clear();
+				layer_fluent.dd_segment_lru[column_i].reset();
 
 				// reset activity
 				layer_fluent.active_dd_segments[column_i].reset();
 				layer_fluent.matching_dd_segments[column_i].reset();
 			}
+			tp::priv::dd_sb::clear(layer_fluent, layer);
 
 			// reset global state
 			layer_fluent.active_cells.reset();
 			layer_fluent.winner_cells.reset();
 		}
 
+		//Reset the fluent state (cells, segments and inhibition radius) without changing the persisted layer, such that
+		//a new stream can start with a trained layer.
+		template <typename P>
+		void init_fluent(Layer_Fluent<P>& layer_fluent, const Layer_Persisted<P>& layer, const Dynamic_Param& param)
+		{
+			sp::priv::update_inhibition_radius(layer_fluent, layer, param);
+			layer_fluent.sp_overlap_valid_incremental = false;
+
+			for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+			{
+				layer_fluent.dd_synapse_active_time[column_i].assign(layer.dd_synapse_count_sf[column_i].size(), 0);
+				layer_fluent.dd_segment_lru[column_i].rebuild(layer_fluent.dd_synapse_active_time[column_i], layer.dd_segment_count[column_i]);
+				layer_fluent.active_dd_segments[column_i].reset();
+				layer_fluent.matching_dd_segments[column_i].reset();
+			}
+			layer_fluent.active_cells.reset();
+			layer_fluent.winner_cells.reset();
+		}
+
 		template <typename P>
 		void one_step(
 			const typename Layer_Fluent<P>::Active_Sensors& active_sensors,
@@ -586,7 +691,7 @@ namespace htm
 		void display_info(
 			const DataStream<P>& datastream,
 			Layer_Fluent<P>& layer_fluent,
-			Layer_Persisted<P>& layer,//TODO: should have been const but ICC does not allow it
+			const Layer_Persisted<P>& layer,
 			const int time,
 			const Dynamic_Param& param,
 			const std::vector<int>& current_mismatch,
@@ -625,7 +730,7 @@ namespace htm
 			for (int time = 0; time < param.n_time_steps; ++time)
 			{
 				datastream.current_sensors(layer_fluent.active_sensors);
-				encoder::add_sensor_noise<P>(layer_fluent.active_sensors);
+				encoder::add_sensor_noise<P>(layer_fluent.active_sensors, layer_fluent.noise_random_lanes);
 				one_step(layer_fluent.active_sensors, layer_fluent, layer, time, param);
 
 				if (n_futures > 0)
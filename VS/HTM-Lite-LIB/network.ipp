@@ -16,6 +16,12 @@
 
 #pragma once
 #include <vector>
+#include <array>
+#include <tuple>
+#include <thread>
+#include <utility>
+
+#include "..\Spike-Tools-Lib\thread_pool.ipp"
 
 #include "parameters.ipp"
 #include "tools.ipp"
@@ -38,73 +44,159 @@ namespace htm
 		//HTM layer private methods
 		namespace priv
 		{
-			template <typename P1, typename P2>
-			void one_step(
-				const std::array<Dynamic_Param, 2>& param,
-				const int time,
-				Layer_Fluent<P1>& layer1_fluent, Layer_Persisted<P1>& layer1,
-				Layer_Fluent<P2>& layer2_fluent, Layer_Persisted<P2>& layer2)
+			//A chain of layers: layer i gets the (current) columns of layer i-1 as visible sensors, and the (previous)
+			//columns of layer i+1 as hidden sensors. The first layer gets its visible sensors from the datastream.
+			template <typename ... P>
+			struct Chain
 			{
-				static_assert(P1::N_COLUMNS == P2::N_SENSORS, "ERROR: layer1 and layer2 are not matched.");
+				static constexpr int N_LAYERS = sizeof...(P);
+				using P1 = std::tuple_element_t<0, std::tuple<P...>>;
+
+				const DataStream<P1>& datastream;
+				const std::array<Dynamic_Param, N_LAYERS>& param;
+				const std::tuple<Layer_Fluent<P>&...>& layer_fluent;
+				const std::tuple<Layer_Persisted<P>&...>& layer;
+				std::vector<int>& prediction_mismatch;
+				std::vector<int>& current_mismatch;
+				std::vector<int>& mismatch;
+
+				template <int I>
+				void one_step_layer(const int time) const
 				{
-					//2] concat previous layer 2 columns to become hidden sensors in layer 1
-					for (int i = 0; i < P1::N_HIDDEN_SENSORS; ++i)
+					using PI = std::tuple_element_t<I, std::tuple<P...>>;
+					auto& layer_fluent_i = std::get<I>(this->layer_fluent);
+
+					if constexpr (I == 0)
+					{
+						this->datastream.current_sensors(layer_fluent_i.active_sensors);
+						encoder::add_sensor_noise<PI>(layer_fluent_i.active_sensors, layer_fluent_i.noise_random_lanes);
+					}
+					else
+					{
+						//Current columns of layer I-1 become visible sensors in layer I
+						using P_PREV = std::tuple_element_t<I - 1, std::tuple<P...>>;
+						static_assert(PI::N_VISIBLE_SENSORS <= P_PREV::N_COLUMNS, "ERROR: layer and previous layer are not matched.");
+						const auto& active_columns = std::get<I - 1>(this->layer_fluent).active_columns;
+						for (int i = 0; i < PI::N_VISIBLE_SENSORS; ++i)
+						{
+							layer_fluent_i.active_sensors.set(i, active_columns.get(i));
+						}
+					}
+					if constexpr (I < N_LAYERS - 1)
 					{
-						layer1_fluent.active_sensors.set(P1::N_VISIBLE_SENSORS + i, layer2_fluent.active_columns.get(i));
+						//Previous columns of layer I+1 become hidden sensors in layer I
+						using P_NEXT = std::tuple_element_t<I + 1, std::tuple<P...>>;
+						static_assert(PI::N_HIDDEN_SENSORS <= P_NEXT::N_COLUMNS, "ERROR: layer and next layer are not matched.");
+						const auto& active_columns = std::get<I + 1>(this->layer_fluent).active_columns;
+						for (int i = 0; i < PI::N_HIDDEN_SENSORS; ++i)
+						{
+							layer_fluent_i.active_sensors.set(PI::N_VISIBLE_SENSORS + i, active_columns.get(i));
+						}
+					}
+					if (false) log_INFO_DEBUG("network:run: active sensors at t = ", time, ": Layer", I + 1, ":\n", print::print_active_sensors<PI>(layer_fluent_i.active_sensors, this->param[I].n_visible_sensors_dim1), "\n");
+					layer::one_step(layer_fluent_i.active_sensors, layer_fluent_i, std::get<I>(this->layer), time, this->param[I]);
+
+					if constexpr (I == 0)
+					{
+						//the mismatch only depends on the first layer; the other layers need not have done this time step.
+						if (!this->prediction_mismatch.empty())
+						{
+							layer::priv::calc_mismatch(time, layer_fluent_i, std::get<0>(this->layer), this->param[0], this->datastream, this->current_mismatch);
+							tools::add(this->prediction_mismatch, this->current_mismatch);
+							layer::display_info(this->datastream, layer_fluent_i, std::get<0>(this->layer), time, this->param[0], this->current_mismatch, this->mismatch);
+						}
+						this->datastream.advance_time();
 					}
-					if (false) log_INFO_DEBUG("network:run: active sensors at t = ", time, ": Layer1:\n", print::print_active_sensors<P1>(layer1_fluent.active_sensors, param[0].n_visible_sensors_dim1), "\n");
-					layer::one_step(layer1_fluent.active_sensors, layer1_fluent, layer1, time, param[0]);
 				}
+
+				template <std::size_t ... I>
+				void one_step(const int time, std::index_sequence<I...>) const
+				{
+					(this->one_step_layer<I>(time), ...);
+				}
+
+				//Wavefront schedule: layer I does time step t in phase 2t+I. Layer I at time t needs layer I-1 at time t 
+				//(phase 2t+I-1) and layer I+1 at time t-1 (phase 2t+I-1), and no other layer writes its columns in phase 
+				//2t+I; hence the layers of one phase (every other layer) run in parallel with the sequential results.
+				template <int I>
+				void run_phases(const int time_begin, const int time_end, ::tools::thread_pool::Barrier& barrier) const
 				{
-					for (int i = 0; i < P2::N_HIDDEN_SENSORS; ++i)
+					const int n_time_steps = time_end - time_begin;
+					const int n_phases = (n_time_steps > 0) ? (2 * (n_time_steps - 1) + N_LAYERS) : 0;
+					for (int phase = 0; phase < n_phases; ++phase)
 					{
-						layer2_fluent.active_sensors.set(P2::N_VISIBLE_SENSORS + i, layer1_fluent.active_columns.get(i));
+						const int time2 = phase - I;
+						if ((time2 >= 0) && ((time2 & 1) == 0) && ((time2 >> 1) < n_time_steps))
+						{
+							this->one_step_layer<I>(time_begin + (time2 >> 1));
+						}
+						barrier.arrive_and_wait();
 					}
-					if (false) log_INFO_DEBUG("network:run: active sensors at t = ", time, ": Layer2:\n", print::print_active_sensors<P2>(layer2_fluent.active_sensors, param[1].n_visible_sensors_dim1), "\n");
-					layer::one_step(layer2_fluent.active_sensors, layer2_fluent, layer2, time, param[1]);
 				}
-			}
 
-			template <typename P1, typename P2, typename P3>
-			void one_step(
-				const std::array<Dynamic_Param, 3>& param, 
-				const int time,
-				Layer_Fluent<P1>& layer1_fluent, Layer_Persisted<P1>& layer1,
-				Layer_Fluent<P2>& layer2_fluent, Layer_Persisted<P2>& layer2,
-				Layer_Fluent<P3>& layer3_fluent, Layer_Persisted<P3>& layer3)
+				template <std::size_t ... I>
+				void run_pipelined(const int time_begin, const int time_end, std::index_sequence<0, I...>) const
+				{
+					::tools::thread_pool::Barrier barrier(N_LAYERS);
+					std::vector<std::thread> workers;
+					(workers.emplace_back([this, time_begin, time_end, &barrier]() { this->run_phases<I>(time_begin, time_end, barrier); }), ...);
+					this->run_phases<0>(time_begin, time_end, barrier);
+					for (auto& worker : workers) worker.join();
+				}
+			};
+
+			template <typename ... P>
+			void run(
+				const DataStream<std::tuple_element_t<0, std::tuple<P...>>>& datastream,
+				const std::array<Dynamic_Param, sizeof...(P)>& param,
+				const std::tuple<Layer_Fluent<P>&...>& layer_fluent,
+				const std::tuple<Layer_Persisted<P>&...>& layer,
+				const int time_begin,
+				const int time_end,
+				const bool pipelined,
+				//out
+				std::vector<int>& prediction_mismatch)
 			{
+				const int n_futures = static_cast<int>(prediction_mismatch.size());
+				tools::clear(prediction_mismatch);
+
+				auto mismatch = std::vector<int>(n_futures, 0);
+				auto current_mismatch = std::vector<int>(n_futures, 0);
+				const Chain<P...> chain = { datastream, param, layer_fluent, layer, prediction_mismatch, current_mismatch, mismatch };
+
+				if (pipelined)
 				{
-					//Previous layer 2 columns become hidden sensors in layer 1
-					for (int i = 0; i < P1::N_HIDDEN_SENSORS; ++i)
-					{
-						layer1_fluent.active_sensors.set(P1::N_VISIBLE_SENSORS + i, layer2_fluent.active_columns.get(i));
-					}
-					if (false) log_INFO_DEBUG("network:run: active sensors at t = ", time, ": Layer1:\n", print::print_active_sensors<P1>(layer1_fluent.active_sensors, param[0].n_visible_sensors_dim1), "\n");
-					layer::one_step(layer1_fluent.active_sensors, layer1_fluent, layer1, time, param[0]);
+					chain.run_pipelined(time_begin, time_end, std::index_sequence_for<P...>());
 				}
+				else
 				{
-					//Previous layer 1 columns become visible sensors in layer 2
-					for (int i = 0; i < P2::N_VISIBLE_SENSORS; ++i)
+					for (auto time = time_begin; time < time_end; ++time)
 					{
-						layer2_fluent.active_sensors.set(i, layer1_fluent.active_columns.get(i));
+						chain.one_step(time, std::index_sequence_for<P...>());
 					}
-					//Previous layer 3 columns become hidden sensors in layer 2
-					for (int i = 0; i < P2::N_HIDDEN_SENSORS; ++i)
-					{
-						layer2_fluent.active_sensors.set(P2::N_VISIBLE_SENSORS + i, layer3_fluent.active_columns.get(i));
-					}
-					if (false) log_INFO_DEBUG("network:run: active sensors at t = ", time, ": Layer2:\n", print::print_active_sensors<P2>(layer2_fluent.active_sensors, param[1].n_visible_sensors_dim1), "\n");
-					layer::one_step(layer2_fluent.active_sensors, layer2_fluent, layer2, time, param[1]);
 				}
+				if (!param[0].quiet) std::cout << std::endl;
+			}
+
+			template <typename ... P, std::size_t ... I>
+			void init(
+				const std::tuple<Layer_Fluent<P>&...>& layer_fluent,
+				const std::tuple<Layer_Persisted<P>&...>& layer,
+				const std::array<Dynamic_Param, sizeof...(P)>& param,
+				std::index_sequence<I...>)
+			{
+				(layer::init(std::get<I>(layer_fluent), std::get<I>(layer), param[I]), ...);
+			}
+
+			//The pipelined layers call the thread pool of tp concurrently; that is only possible when they use the same pool.
+			template <int N_LAYERS>
+			bool can_pipeline(const std::array<Dynamic_Param, N_LAYERS>& param)
+			{
+				for (const auto& p : param)
 				{
-					//Previous layer 2 columns become hidden sensors in layer 3
-					for (int i = 0; i < P3::N_VISIBLE_SENSORS; ++i)
-					{
-						layer3_fluent.active_sensors.set(i, layer2_fluent.active_columns.get(i));
-					}
-					if (false) log_INFO_DEBUG("network:run: active sensors at t = ", time, ": Layer3:\n", print::print_active_sensors<P3>(layer3_fluent.active_sensors, param[2].n_visible_sensors_dim1), "\n");
-					layer::one_step(layer3_fluent.active_sensors, layer3_fluent, layer3, time, param[2]);
+					if ((p.n_threads > 1) && (p.n_threads != param[0].n_threads)) return false;
 				}
+				return true;
 			}
 		}
 
@@ -147,6 +239,91 @@ namespace htm
 			using P_L3 = Static_Param<N_COLUMNS_L3, N_BITS_CELL_L3, N_VISIBLE_SENSORS_L3, N_HIDDEN_SENSORS_L3, HISTORY_L3, ARCH>;
 		};
 
+		//Initialize a chain of layers
+		template <typename ... P>
+		void init(
+			const std::tuple<Layer_Fluent<P>&...>& layer_fluent,
+			const std::tuple<Layer_Persisted<P>&...>& layer,
+			const std::array<Dynamic_Param, sizeof...(P)>& param)
+		{
+			priv::init(layer_fluent, layer, param, std::index_sequence_for<P...>());
+		}
+
+		//Run a chain of layers (see network_2Layer and network_3Layer) on one thread.
+		template <typename ... P>
+		void run(
+			const DataStream<std::tuple_element_t<0, std::tuple<P...>>>& datastream,
+			const std::array<Dynamic_Param, sizeof...(P)>& param,
+			const std::tuple<Layer_Fluent<P>&...>& layer_fluent,
+			const std::tuple<Layer_Persisted<P>&...>& layer,
+			//out
+			std::vector<int>& prediction_mismatch)
+		{
+			priv::run(datastream, param, layer_fluent, layer, 0, param[0].n_time_steps, false, prediction_mismatch);
+		}
+
+		//Run a chain of layers for the time steps [time_begin, time_end) on one thread; a run can be continued from time_end.
+		template <typename ... P>
+		void run(
+			const DataStream<std::tuple_element_t<0, std::tuple<P...>>>& datastream,
+			const std::array<Dynamic_Param, sizeof...(P)>& param,
+			const std::tuple<Layer_Fluent<P>&...>& layer_fluent,
+			const std::tuple<Layer_Persisted<P>&...>& layer,
+			const int time_begin,
+			const int time_end,
+			//out
+			std::vector<int>& prediction_mismatch)
+		{
+			priv::run(datastream, param, layer_fluent, layer, time_begin, time_end, false, prediction_mismatch);
+		}
+
+		//Run a chain of layers with a thread per layer; the results are identical to run. Every other layer can run 
+		//concurrently, thus the throughput of n equal layers is at most (n+1)/2 (rounded down) times that of run.
+		template <typename ... P>
+		void run_pipelined(
+			const DataStream<std::tuple_element_t<0, std::tuple<P...>>>& datastream,
+			const std::array<Dynamic_Param, sizeof...(P)>& param,
+			const std::tuple<Layer_Fluent<P>&...>& layer_fluent,
+			const std::tuple<Layer_Persisted<P>&...>& layer,
+			//out
+			std::vector<int>& prediction_mismatch)
+		{
+			if (priv::can_pipeline<sizeof...(P)>(param))
+			{
+				priv::run(datastream, param, layer_fluent, layer, 0, param[0].n_time_steps, true, prediction_mismatch);
+			}
+			else
+			{
+				log_WARNING("network:run_pipelined: layers use different numbers of threads; running the layers sequentially.\n");
+				priv::run(datastream, param, layer_fluent, layer, 0, param[0].n_time_steps, false, prediction_mismatch);
+			}
+		}
+
+		//Run the provided layers a number of times, update steps as provided in param
+		template <typename ... P>
+		void run_multiple_times(
+			const DataStream<std::tuple_element_t<0, std::tuple<P...>>>& datastream,
+			const std::array<Dynamic_Param, sizeof...(P)>& param,
+			const std::tuple<Layer_Fluent<P>&...>& layer_fluent,
+			const std::tuple<Layer_Persisted<P>&...>& layer,
+			const bool pipelined,
+			//out
+			std::vector<int>& prediction_mismatch)
+		{
+			tools::clear(prediction_mismatch);
+			const int n_futures = static_cast<int>(prediction_mismatch.size());
+			auto mismatch = std::vector<int>(n_futures);
+			for (auto i = 0; i < param[0].n_times; ++i)
+			{
+				init(layer_fluent, layer, param);
+				if (pipelined)
+					run_pipelined(datastream, param, layer_fluent, layer, mismatch);
+				else
+					run(datastream, param, layer_fluent, layer, mismatch);
+				tools::add(prediction_mismatch, mismatch);
+			}
+		}
+
 		template <typename P1, typename P2>
 		void run(
 			const DataStream<P1>& datastream,
@@ -156,28 +333,19 @@ namespace htm
 			//out
 			std::vector<int>& prediction_mismatch)
 		{
-			const auto param0 = param[0];
-			const int n_futures = static_cast<int>(prediction_mismatch.size());
-			tools::clear(prediction_mismatch);
-
-			auto mismatch = std::vector<int>(n_futures, 0);
-			auto current_mismatch = std::vector<int>(n_futures, 0);
-
-			for (auto time = 0; time < param0.n_time_steps; ++time)
-			{
-				datastream.current_sensors(layer1_fluent.active_sensors);
-				encoder::add_sensor_noise<P1>(layer1_fluent.active_sensors);
-				priv::one_step(param, time, layer1_fluent, layer1, layer2_fluent, layer2);
+			run(datastream, param, std::tie(layer1_fluent, layer2_fluent), std::tie(layer1, layer2), prediction_mismatch);
+		}
 
-				if (n_futures > 0)
-				{
-					layer::priv::calc_mismatch(time, layer1_fluent, layer1, param0, datastream, current_mismatch);
-					tools::add(prediction_mismatch, current_mismatch);
-					layer::display_info(datastream, layer1_fluent, layer1, time, param0, current_mismatch, mismatch);
-				}
-				datastream.advance_time();
-			}
-			if (!param0.quiet) std::cout << std::endl;
+		template <typename P1, typename P2>
+		void run_pipelined(
+			const DataStream<P1>& datastream,
+			const std::array<Dynamic_Param, 2>& param,
+			Layer_Fluent<P1>& layer1_fluent, Layer_Persisted<P1>& layer1,
+			Layer_Fluent<P2>& layer2_fluent, Layer_Persisted<P2>& layer2,
+			//out
+			std::vector<int>& prediction_mismatch)
+		{
+			run_pipelined(datastream, param, std::tie(layer1_fluent, layer2_fluent), std::tie(layer1, layer2), prediction_mismatch);
 		}
 
 		//Run the provided layer a number of times, update steps as provided in param
@@ -190,16 +358,7 @@ namespace htm
 			//out
 			std::vector<int>& prediction_mismatch)
 		{
-			tools::clear(prediction_mismatch);
-			const int n_futures = static_cast<int>(prediction_mismatch.size());
-			auto mismatch = std::vector<int>(n_futures);
-			for (auto i = 0; i < param[0].n_times; ++i)
-			{
-				layer::init(layer1_fluent, layer1, param[0]);
-				layer::init(layer2_fluent, layer2, param[1]);
-				run(datastream, param, layer1_fluent, layer1, layer2_fluent, layer2, mismatch);
-				tools::add(prediction_mismatch, mismatch);
-			}
+			run_multiple_times(datastream, param, std::tie(layer1_fluent, layer2_fluent), std::tie(layer1, layer2), false, prediction_mismatch);
 		}
 
 		template <typename P1, typename P2, typename P3>
@@ -211,28 +370,19 @@ namespace htm
 			Layer_Fluent<P3>& layer3_fluent, Layer_Persisted<P3>& layer3,
 			std::vector<int>& prediction_mismatch)
 		{
-			const auto param0 = param[0];
-			const int n_futures = static_cast<int>(prediction_mismatch.size());
-			tools::clear(prediction_mismatch);
-
-			auto mismatch = std::vector<int>(n_futures, 0);
-			auto current_mismatch = std::vector<int>(n_futures, 0);
-
-			for (auto time = 0; time < param0.n_time_steps; ++time)
-			{
-				datastream.current_sensors(layer1_fluent.active_sensors);
-				encoder::add_sensor_noise<P1>(layer1_fluent.active_sensors);
-				priv::one_step(param, time, layer1_fluent, layer1, layer2_fluent, layer2, layer3_fluent, layer3);
+			run(datastream, param, std::tie(layer1_fluent, layer2_fluent, layer3_fluent), std::tie(layer1, layer2, layer3), prediction_mismatch);
+		}
 
-				if (n_futures > 0)
-				{
-					layer::priv::calc_mismatch(time, layer1_fluent, layer1, param0, datastream, current_mismatch);
-					tools::add(prediction_mismatch, current_mismatch);
-					layer::display_info(datastream, layer1_fluent, layer1, time, param0, current_mismatch, mismatch);
-				}
-				datastream.advance_time();
-			}
-			if (!param0.quiet) std::cout << std::endl;
+		template <typename P1, typename P2, typename P3>
+		void run_pipelined(
+			const DataStream<P1>& datastream,
+			const std::array<Dynamic_Param, 3>& param,
+			Layer_Fluent<P1>& layer1_fluent, Layer_Persisted<P1>& layer1,
+			Layer_Fluent<P2>& layer2_fluent, Layer_Persisted<P2>& layer2,
+			Layer_Fluent<P3>& layer3_fluent, Layer_Persisted<P3>& layer3,
+			std::vector<int>& prediction_mismatch)
+		{
+			run_pipelined(datastream, param, std::tie(layer1_fluent, layer2_fluent, layer3_fluent), std::tie(layer1, layer2, layer3), prediction_mismatch);
 		}
 
 		//Run the provided layer a number of times, update steps as provided in param
@@ -245,17 +395,7 @@ namespace htm
 			Layer_Fluent<P3>& layer3_fluent, Layer_Persisted<P3>& layer3,
 			std::vector<int>& prediction_mismatch)
 		{
-			tools::clear(prediction_mismatch);
-			const int n_futures = static_cast<int>(prediction_mismatch.size());
-			auto mismatch = std::vector<int>(n_futures);
-			for (auto i = 0; i < param[0].n_times; ++i)
-			{
-				layer::init(layer1_fluent, layer1, param[0]);
-				layer::init(layer2_fluent, layer2, param[1]);
-				layer::init(layer3_fluent, layer3, param[2]);
-				run(datastream, param, layer1_fluent, layer1, layer2_fluent, layer2, layer3_fluent, layer3, mismatch);
-				tools::add(prediction_mismatch, mismatch);
-			}
+			run_multiple_times(datastream, param, std::tie(layer1_fluent, layer2_fluent, layer3_fluent), std::tie(layer1, layer2, layer3), false, prediction_mismatch);
 		}
 	}
 }
\ No newline at end of file
@@ -20,9 +20,13 @@
 #include <algorithm>
 #include <iomanip>      // std::setw
 #include <ratio>
+#include <type_traits>	// std::conditional_t
 
 //#include <immintrin.h> // _may_i_use_cpu_feature
 #include <intrin.h>
+#ifndef _MSC_VER
+#include <cpuid.h>
+#endif
 
 
 #include "..\Spike-Tools-Lib\log.ipp"
@@ -30,6 +34,12 @@
 
 #include "tools.ipp"
 
+//Define TP_SYNAPSE_FORWARD_ON as 0 to use the synapse backward engine of the temporal pooler in all layers (see
+//Static_Param::TP_SYNAPSE_FORWARD); a single layer can select it with static parameters that derive from Static_Param.
+#ifndef TP_SYNAPSE_FORWARD_ON
+#define TP_SYNAPSE_FORWARD_ON 1
+#endif
+
 namespace htm
 {
 	using namespace ::tools::log;
@@ -40,25 +50,84 @@ namespace htm
 	{
 		//Reference implementation, regular c++ code
 		X64, 
+		//Explicit use of AVX2 instructions (Haswell, Zen)
+		AVX2, 
 		//Explicit use of AVX512 instructions (Skylake X)
 		AVX512, 
 		//Determine instruction set a runtime
 		RUNTIME
 	};
 
-	arch_t architecture_switch(const arch_t arch)
+	namespace priv
 	{
-		if (arch == arch_t::X64) return arch_t::X64;
-		if (arch == arch_t::AVX512) return arch_t::AVX512;
-		if (arch == arch_t::RUNTIME)
+		//Query cpuid leaf and subleaf; info = {eax, ebx, ecx, edx}
+		inline void cpuid(int info[4], const int leaf, const int subleaf)
+		{
+			#ifdef _MSC_VER
+			__cpuidex(info, leaf, subleaf);
+			#else
+			unsigned int a = 0, b = 0, c = 0, d = 0;
+			__cpuid_count(leaf, subleaf, a, b, c, d);
+			info[0] = static_cast<int>(a); info[1] = static_cast<int>(b); info[2] = static_cast<int>(c); info[3] = static_cast<int>(d);
+			#endif
+		}
+
+		//Read extended control register 0: which register states the OS saves on a context switch
+		inline unsigned long long xgetbv0()
+		{
+			#ifdef _MSC_VER
+			return _xgetbv(0);
+			#else
+			unsigned int eax = 0, edx = 0;
+			__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			return (static_cast<unsigned long long>(edx) << 32) | eax;
+			#endif
+		}
+
+		//Determine the widest instruction set that is supported by both the cpu and the OS
+		inline arch_t detect_architecture()
 		{
 			#if __INTEL_COMPILER
-			return (_may_i_use_cpu_feature(_FEATURE_AVX512F) == 1) ? arch_t::AVX512 : arch_t::X64;
+			if (_may_i_use_cpu_feature(_FEATURE_AVX512F | _FEATURE_AVX512BW | _FEATURE_AVX512DQ | _FEATURE_AVX512VL) == 1) return arch_t::AVX512;
+			if (_may_i_use_cpu_feature(_FEATURE_AVX2) == 1) return arch_t::AVX2;
+			return arch_t::X64;
 			#else
-			//log_WARNING("architecture_switch: could not determine desired architecture at runtime: assuming AVX512.\n");
-			return arch_t::AVX512;
+			int info[4];
+			cpuid(info, 0, 0);
+			if (info[0] < 7) return arch_t::X64;
+
+			cpuid(info, 1, 0);
+			const bool osxsave = (info[2] >> 27) & 1;
+			const bool avx = (info[2] >> 28) & 1;
+			if (!osxsave || !avx) return arch_t::X64;
+
+			const unsigned long long xcr0 = xgetbv0();
+			if ((xcr0 & 0x06) != 0x06) return arch_t::X64; // XMM and YMM state
+
+			cpuid(info, 7, 0);
+			const bool avx2 = (info[1] >> 5) & 1;
+			const bool avx512f = (info[1] >> 16) & 1;
+			const bool avx512dq = (info[1] >> 17) & 1;
+			const bool avx512bw = (info[1] >> 30) & 1;
+			const bool avx512vl = (info[1] >> 31) & 1;
+
+			if (avx512f && avx512dq && avx512bw && avx512vl && ((xcr0 & 0xE6) == 0xE6)) return arch_t::AVX512; // opmask and ZMM state
+			if (avx2) return arch_t::AVX2;
+			return arch_t::X64;
 			#endif
 		}
+	}
+
+	inline arch_t architecture_switch(const arch_t arch)
+	{
+		if (arch == arch_t::X64) return arch_t::X64;
+		if (arch == arch_t::AVX2) return arch_t::AVX2;
+		if (arch == arch_t::AVX512) return arch_t::AVX512;
+		if (arch == arch_t::RUNTIME)
+		{
+			static const arch_t detected = priv::detect_architecture();
+			return detected;
+		}
 		return arch_t::X64;
 	}
 
@@ -130,12 +199,21 @@ namespace htm
 		//columns are selected with respect to their local neighborhoods.
 		static constexpr bool SP_GLOBAL_INHIBITION = true;
 
+		//Topology of the columns used by local inhibition: a 2D grid (with wrap around) of SP_N_COLUMNS_DIM1
+		//by SP_N_COLUMNS_DIM2 columns, column_i = (y * SP_N_COLUMNS_DIM1) + x.
+		static constexpr int SP_N_COLUMNS_DIM1 = tools::grid_dim1(N_COLUMNS);
+		static constexpr int SP_N_COLUMNS_DIM2 = N_COLUMNS / SP_N_COLUMNS_DIM1;
+
 		//If a permanence is LARGER (NOT EQUAL) than this value, the synapse is said to be connected.
 		static constexpr Permanence SP_PD_CONNECTED_THRESHOLD = -128;
 
 		// Origin of ininstantiated (invalid) values, for debuggin purposes 
 		static constexpr int SP_PD_SYNAPSE_ORIGIN_INVALID = -2;
 
+		//Whether the origin (sensor id) of a proximal synapse is stored in 16 bits instead of 32 bits.
+		static constexpr bool SP_ORIGIN_NARROW = (N_SENSORS <= 0x7FFF);
+		using SP_Origin = std::conditional_t<SP_ORIGIN_NARROW, int16_t, int>;
+
 		//A number between 0 and 1.0, used to set a floor on how often a column
 		//should have at least stimulusThreshold active inputs. Periodically, each
 		//column looks at the overlap duty cycle of all other columns within its
@@ -168,6 +246,11 @@ namespace htm
 		//Whether the spacial pooler is computed in a forward fashion 
 		static constexpr bool SP_SYNAPSE_FORWARD = true;
 
+		//Whether the overlap of the columns is kept from the previous time step and only updated with the sensors that
+		//changed and with the synapses whose connectivity changed by learning. Requires SP_SYNAPSE_FORWARD.
+		static constexpr bool SP_OVERLAP_INCREMENTAL = false;
+		static_assert(SP_SYNAPSE_FORWARD || !SP_OVERLAP_INCREMENTAL, "ERROR: Parameters: SP_OVERLAP_INCREMENTAL requires SP_SYNAPSE_FORWARD.");
+
 		#pragma endregion
 		//========================================================================
 		#pragma region Temporal Pooler constants
@@ -197,9 +280,26 @@ namespace htm
 		static constexpr int TP_N_DD_SYNAPSES_MAX = tools::multiple_64(250);
 
 		static constexpr int TP_DD_SYNAPSE_ORIGIN_INVALID = -3;
+
+		//Whether the origin (delay and cell id) of a distal synapse is stored in 16 bits instead of 32 bits: the delay
+		//in the upper 3 bits and the cell id in the lower bits (see tools::narrow_origin). Only when all cells fit in 13
+		//bits and the invalid origin (delay 7, cell 0x1FFD) cannot be a valid origin.
+		static constexpr bool TP_ORIGIN_NARROW = (N_CELLS <= (1 << 13)) && ((HISTORY_SIZE < 7) || (N_CELLS <= 0x1FFD));
+		using TP_Origin = std::conditional_t<TP_ORIGIN_NARROW, int16_t, int>;
+		static constexpr int TP_ORIGIN_DELAY_SHIFT = (8 * sizeof(TP_Origin)) - 3;
+		static constexpr int TP_ORIGIN_CELL_MASK = (1 << TP_ORIGIN_DELAY_SHIFT) - 1;
 		static constexpr int8_t TP_DD_SEGMENT_DESTINATION_INVALID = -4;
 
-		static constexpr bool TP_SYNAPSE_FORWARD = true;
+		//Whether the temporal pooler is computed in a forward fashion only. If false, an inverse synapse index is maintained
+		//and every time step either the forward or the backward engine is used, depending on the number of active cells.
+		static constexpr bool TP_SYNAPSE_FORWARD = (TP_SYNAPSE_FORWARD_ON != 0);
+
+		//The synapse backward engine is used when the number of outgoing synapses of the active cells times this factor is
+		//smaller than the total number of synapses: a backward visit (scattered) costs about this many forward visits (streamed).
+		static constexpr int TP_DD_SB_COST_FACTOR = 4;
+
+		//Whether the active cells are stored bit packed (Bitset_Hist_Packed) instead of one byte per cell (Bitset_Hist8).
+		static constexpr bool TP_ACTIVE_CELLS_PACKED = true;
 
 		#pragma endregion
 		//========================================================================
@@ -232,6 +332,17 @@ namespace htm
 		int n_visible_sensors_dim1 = 20;
 		int n_visible_sensors_dim2 = 20;
 
+		//Number of threads (including the calling thread) used for the column parallel parts of a time step; 1 means serial.
+		int n_threads = 1;
+
+		//Number of columns one thread processes as one chunk; rounded up to a multiple of 64.
+		int n_columns_per_chunk = 256;
+
+		//Seed of the random numbers of a layer: init derives the random number of every column and the sensor noise
+		//from it, such that a run does not depend on the number of threads or on earlier runs; zero keeps the random
+		//numbers as they are.
+		uint64_t random_seed = 0;
+
 		#pragma region Spacial Pooler stuff
 
 		// if the predicted sensor influx is ABOVE (not equal) this threshold, the sensor is said to be active.
@@ -291,6 +402,10 @@ namespace htm
 		//like 4 % * 0.01 = 0.0004).
 		Permanence TP_DD_PREDICTED_SEGMENT_DEC = 10; // 10 * SP_LOCAL_AREA_DENSITY * TP_DD_PERMANENCE_INC;
 
+		//Number of learning time steps between two compactions of the distal dendrites (removal of dead synapses and
+		//empty segments, see tp::compact); zero disables compaction.
+		int TP_DD_COMPACT_INTERVAL = 1000;
+
 		#pragma endregion
 
 		static std::string header_str()
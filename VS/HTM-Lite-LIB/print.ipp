@@ -377,8 +377,8 @@ namespace htm
 			for (auto segment_i = 0; segment_i < n_segments; ++segment_i)
 			{
 				const auto n_synapses = layer.dd_synapse_count_sf[column_i][segment_i];
-				const auto& dd_synapse_permanence_segment = layer.dd_synapse_permanence_sf[column_i][segment_i];
-				const auto& dd_synapse_delay_origin_segment = layer.dd_synapse_delay_origin_sf[column_i][segment_i];
+				const Permanence * dd_synapse_permanence_segment = layer.dd_synapse_permanence_segment(column_i, segment_i);
+				const auto * dd_synapse_delay_origin_segment = layer.dd_synapse_delay_origin_segment(column_i, segment_i);
 
 				result << "Column " << std::setw(4) << column_i << ": segment " << segment_i << "/ " << n_segments << ": permanence:";
 				for (auto synapse_i = 0; synapse_i < n_synapses; ++synapse_i)
@@ -392,7 +392,7 @@ namespace htm
 					result << "Column " << std::setw(4) << column_i << ": segment " << segment_i << "/ " << n_segments << ": cell org  :";
 					for (auto synapse_i = 0; synapse_i < n_synapses; ++synapse_i)
 					{
-						const auto delay_and_cell_id = dd_synapse_delay_origin_segment[synapse_i];
+						const int delay_and_cell_id = htm::tools::widen_origin<P>(dd_synapse_delay_origin_segment[synapse_i]);
 						result << " " << std::setw(5) << htm::tools::get_global_cell_id(delay_and_cell_id);
 					}
 					result << "\n";
@@ -0,0 +1,374 @@
+// C++ port of Nupic HTM with the aim of being lite and fast
+//
+// Copyright (c) 2017 Henk-Jan Lebbink
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero Public License version 3 as
+// published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero Public License for more details.
+//
+// You should have received a copy of the GNU Affero Public License
+// along with this program.  If not, see http://www.gnu.org/licenses.
+
+#pragma once
+#include <vector>
+#include <algorithm>	// std::min
+
+#include "tools.ipp"
+#include "parameters.ipp"
+#include "types.ipp"
+
+//Hierarchical Temporal Memory (HTM)
+namespace htm
+{
+	//Set operations on sparse distributed representations (SDRs). The kernels work on the packed 32-bit words of a
+	//Bitset_Compact (bit i is bit i & 31 of word i >> 5); the bits after the size of the bitset are zero.
+	namespace sdr
+	{
+		using namespace htm::types;
+
+		//Operation of two SDRs of which the set bits are counted.
+		enum op_t
+		{
+			AND,	// overlap
+			OR,		// union
+			XOR,	// Hamming distance
+			ANDNOT	// bits of the first that are not in the second
+		};
+
+		namespace priv
+		{
+			template <op_t OP>
+			inline unsigned int op_ref(const unsigned int a, const unsigned int b)
+			{
+				if constexpr (OP == AND) return a & b;
+				else if constexpr (OP == OR) return a | b;
+				else if constexpr (OP == XOR) return a ^ b;
+				else return a & ~b;
+			}
+			template <op_t OP>
+			inline __m256i op_avx2(const __m256i a, const __m256i b)
+			{
+				if constexpr (OP == AND) return _mm256_and_si256(a, b);
+				else if constexpr (OP == OR) return _mm256_or_si256(a, b);
+				else if constexpr (OP == XOR) return _mm256_xor_si256(a, b);
+				else return _mm256_andnot_si256(b, a);
+			}
+			template <op_t OP>
+			inline __m512i op_avx512(const __m512i a, const __m512i b)
+			{
+				if constexpr (OP == AND) return _mm512_and_si512(a, b);
+				else if constexpr (OP == OR) return _mm512_or_si512(a, b);
+				else if constexpr (OP == XOR) return _mm512_xor_si512(a, b);
+				else return _mm512_andnot_si512(b, a);
+			}
+
+			//Number of set bits in every 64-bit lane: the number of set bits of the nibbles are looked up with a shuffle.
+			inline __m256i popcnt_epi64_avx2(const __m256i x)
+			{
+				const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+				const __m256i low_mask = _mm256_set1_epi8(0x0F);
+				const __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(x, low_mask));
+				const __m256i hi = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask));
+				return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+			}
+
+			//Number of set bits in every 64-bit lane: VPOPCNTQ when the compiler targets it, otherwise a shuffle as in avx2.
+			inline __m512i popcnt_epi64_avx512(const __m512i x)
+			{
+				#if defined(__AVX512VPOPCNTDQ__)
+				return _mm512_popcnt_epi64(x);
+				#else
+				const __m512i lookup = _mm512_broadcast_i32x4(_mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4));
+				const __m512i low_mask = _mm512_set1_epi8(0x0F);
+				const __m512i lo = _mm512_shuffle_epi8(lookup, _mm512_and_si512(x, low_mask));
+				const __m512i hi = _mm512_shuffle_epi8(lookup, _mm512_and_si512(_mm512_srli_epi16(x, 4), low_mask));
+				return _mm512_sad_epu8(_mm512_add_epi8(lo, hi), _mm512_setzero_si512());
+				#endif
+			}
+
+			inline int hsum_epi64_avx2(const __m256i x)
+			{
+				const __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+				return static_cast<int>(_mm_cvtsi128_si64(sum) + _mm_extract_epi64(sum, 1));
+			}
+
+			//Positions of the set bits of word, offset by base, are appended to out at n.
+			inline int append_positions(unsigned int word, const int base, int * const out, int n)
+			{
+				while (word != 0)
+				{
+					out[n++] = base + static_cast<int>(_tzcnt_u32(word));
+					word &= word - 1;
+				}
+				return n;
+			}
+
+			//Mask of the first n_bits bits of a word; n_bits in [0, 32].
+			inline unsigned int low_mask(const int n_bits)
+			{
+				return (n_bits >= 32) ? 0xFFFFFFFFu : ((1u << n_bits) - 1);
+			}
+
+			#pragma region Count
+			//Number of set bits of OP(a, b) of the first n_words words.
+			template <op_t OP>
+			int op_count_ref(const int * const a, const int * const b, const int n_words)
+			{
+				int result = 0;
+				for (int i = 0; i < n_words; ++i)
+				{
+					result += _mm_popcnt_u32(op_ref<OP>(static_cast<unsigned int>(a[i]), static_cast<unsigned int>(b[i])));
+				}
+				return result;
+			}
+
+			template <op_t OP>
+			int op_count_avx2(const int * const a, const int * const b, const int n_words)
+			{
+				__m256i sum = _mm256_setzero_si256();
+				int i = 0;
+				for (; (i + 8) <= n_words; i += 8)
+				{
+					const __m256i x = op_avx2<OP>(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(&a[i])), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&b[i])));
+					sum = _mm256_add_epi64(sum, popcnt_epi64_avx2(x));
+				}
+				return hsum_epi64_avx2(sum) + op_count_ref<OP>(&a[i], &b[i], n_words - i);
+			}
+
+			template <op_t OP>
+			int op_count_avx512(const int * const a, const int * const b, const int n_words)
+			{
+				__m512i sum = _mm512_setzero_si512();
+				for (int i = 0; i < n_words; i += 16)
+				{
+					const __mmask16 k = static_cast<__mmask16>(low_mask(std::min(16, n_words - i)));
+					const __m512i x = op_avx512<OP>(_mm512_maskz_loadu_epi32(k, &a[i]), _mm512_maskz_loadu_epi32(k, &b[i]));
+					sum = _mm512_add_epi64(sum, popcnt_epi64_avx512(x));
+				}
+				return static_cast<int>(_mm512_reduce_add_epi64(sum));
+			}
+
+			template <typename P, op_t OP>
+			int op_count(const int * const a, const int * const b, const int n_words)
+			{
+				if (architecture_switch(P::ARCH) == arch_t::X64) return op_count_ref<OP>(a, b, n_words);
+				if (architecture_switch(P::ARCH) == arch_t::AVX2) return op_count_avx2<OP>(a, b, n_words);
+				if (architecture_switch(P::ARCH) == arch_t::AVX512) return op_count_avx512<OP>(a, b, n_words);
+				return 0;
+			}
+
+			//Number of set bits of OP(a, b) of the first n_bits bits.
+			template <typename P, op_t OP>
+			int op_count_bits(const int * const a, const int * const b, const int n_bits)
+			{
+				const int n_full_words = n_bits >> 5;
+				int result = op_count<P, OP>(a, b, n_full_words);
+				if ((n_bits & 31) != 0)
+				{
+					const unsigned int last = op_ref<OP>(static_cast<unsigned int>(a[n_full_words]), static_cast<unsigned int>(b[n_full_words]));
+					result += _mm_popcnt_u32(last & low_mask(n_bits & 31));
+				}
+				return result;
+			}
+			#pragma endregion
+
+			#pragma region Conversion
+			//Write the positions of the set bits of the first n_words words in ascending order to out, which has room 
+			//for 32 * n_words positions; returns the number of positions written.
+			inline int to_sparse_ref(const int * const a, const int n_words, int * const out)
+			{
+				int n = 0;
+				for (int i = 0; i < n_words; ++i) n = append_positions(static_cast<unsigned int>(a[i]), i << 5, out, n);
+				return n;
+			}
+
+			//As ref, but blocks of 8 zero words are skipped with one test.
+			inline int to_sparse_avx2(const int * const a, const int n_words, int * const out)
+			{
+				int n = 0;
+				int i = 0;
+				for (; (i + 8) <= n_words; i += 8)
+				{
+					const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&a[i]));
+					if (_mm256_testz_si256(x, x)) continue;
+					for (int j = i; j < (i + 8); ++j) n = append_positions(static_cast<unsigned int>(a[j]), j << 5, out, n);
+				}
+				for (; i < n_words; ++i) n = append_positions(static_cast<unsigned int>(a[i]), i << 5, out, n);
+				return n;
+			}
+
+			//Blocks of 16 zero words are skipped; the positions of the set bits of every non-zero half word are written 
+			//with one compress store.
+			inline int to_sparse_avx512(const int * const a, const int n_words, int * const out)
+			{
+				const __m512i iota = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+				int n = 0;
+				for (int i = 0; i < n_words; i += 16)
+				{
+					const __mmask16 k = static_cast<__mmask16>(low_mask(std::min(16, n_words - i)));
+					const __m512i x = _mm512_maskz_loadu_epi32(k, &a[i]);
+					unsigned int non_zero_words = _mm512_test_epi32_mask(x, x);
+					while (non_zero_words != 0)
+					{
+						const int word_i = i + static_cast<int>(_tzcnt_u32(non_zero_words));
+						non_zero_words &= non_zero_words - 1;
+
+						const unsigned int word = static_cast<unsigned int>(a[word_i]);
+						const __mmask16 half0 = static_cast<__mmask16>(word);
+						const __mmask16 half1 = static_cast<__mmask16>(word >> 16);
+						if (half0 != 0)
+						{
+							_mm512_mask_compressstoreu_epi32(&out[n], half0, _mm512_add_epi32(iota, _mm512_set1_epi32(word_i << 5)));
+							n += _mm_popcnt_u32(half0);
+						}
+						if (half1 != 0)
+						{
+							_mm512_mask_compressstoreu_epi32(&out[n], half1, _mm512_add_epi32(iota, _mm512_set1_epi32((word_i << 5) + 16)));
+							n += _mm_popcnt_u32(half1);
+						}
+					}
+				}
+				return n;
+			}
+
+			template <typename P>
+			int to_sparse(const int * const a, const int n_words, int * const out)
+			{
+				if (architecture_switch(P::ARCH) == arch_t::X64) return to_sparse_ref(a, n_words, out);
+				if (architecture_switch(P::ARCH) == arch_t::AVX2) return to_sparse_avx2(a, n_words, out);
+				if (architecture_switch(P::ARCH) == arch_t::AVX512) return to_sparse_avx512(a, n_words, out);
+				return 0;
+			}
+
+			//Set the bits of the n positions in ids in the first n_words words of out; the other bits are cleared.
+			inline void from_sparse_ref(const int * const ids, const int n, const int n_words, int * const out)
+			{
+				std::fill(out, out + n_words, 0);
+				for (int i = 0; i < n; ++i) out[ids[i] >> 5] |= 1 << (ids[i] & 31);
+			}
+
+			//Bit i of out is set when values[i] is ABOVE (not equal) the threshold, for i in [0, n); the bits after n 
+			//in the last word are cleared.
+			inline void threshold_ref(const int * const values, const int n, const int threshold, int * const out)
+			{
+				for (int word_i = 0; (word_i << 5) < n; ++word_i)
+				{
+					const int begin = word_i << 5;
+					const int end = std::min(n, begin + 32);
+					unsigned int word = 0;
+					for (int i = begin; i < end; ++i) if (values[i] > threshold) word |= 1u << (i - begin);
+					out[word_i] = static_cast<int>(word);
+				}
+			}
+
+			inline void threshold_avx2(const int * const values, const int n, const int threshold, int * const out)
+			{
+				const __m256i threshold_epi32 = _mm256_set1_epi32(threshold);
+				int word_i = 0;
+				for (; ((word_i + 1) << 5) <= n; ++word_i)
+				{
+					const int * const v = &values[word_i << 5];
+					unsigned int word = 0;
+					for (int j = 0; j < 4; ++j)
+					{
+						const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&v[j << 3]));
+						const unsigned int bits = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(x, threshold_epi32))));
+						word |= bits << (j << 3);
+					}
+					out[word_i] = static_cast<int>(word);
+				}
+				if ((word_i << 5) < n) threshold_ref(&values[word_i << 5], n - (word_i << 5), threshold, &out[word_i]);
+			}
+
+			inline void threshold_avx512(const int * const values, const int n, const int threshold, int * const out)
+			{
+				const __m512i threshold_epi32 = _mm512_set1_epi32(threshold);
+				for (int word_i = 0; (word_i << 5) < n; ++word_i)
+				{
+					const int begin = word_i << 5;
+					const __mmask16 k0 = static_cast<__mmask16>(low_mask(std::max(0, std::min(16, n - begin))));
+					const __mmask16 k1 = static_cast<__mmask16>(low_mask(std::max(0, std::min(16, n - begin - 16))));
+					const __mmask16 bits0 = _mm512_mask_cmpgt_epi32_mask(k0, _mm512_maskz_loadu_epi32(k0, &values[begin]), threshold_epi32);
+					const __mmask16 bits1 = _mm512_mask_cmpgt_epi32_mask(k1, _mm512_maskz_loadu_epi32(k1, &values[begin + 16]), threshold_epi32);
+					out[word_i] = static_cast<int>(static_cast<unsigned int>(bits0) | (static_cast<unsigned int>(bits1) << 16));
+				}
+			}
+
+			template <typename P>
+			void threshold(const int * const values, const int n, const int threshold, int * const out)
+			{
+				if (architecture_switch(P::ARCH) == arch_t::X64) threshold_ref(values, n, threshold, out);
+				if (architecture_switch(P::ARCH) == arch_t::AVX2) threshold_avx2(values, n, threshold, out);
+				if (architecture_switch(P::ARCH) == arch_t::AVX512) threshold_avx512(values, n, threshold, out);
+			}
+			#pragma endregion
+		}
+
+		#pragma region Set operations
+		//Number of set bits.
+		template <typename P, int SIZE>
+		int count(const Bitset_Compact<SIZE>& a)
+		{
+			return priv::op_count_bits<P, OR>(a.data(), a.data(), SIZE);
+		}
+
+		//Number of bits set in both a and b; only the bits that both bitsets have are considered.
+		template <typename P, int SIZE1, int SIZE2>
+		int overlap(const Bitset_Compact<SIZE1>& a, const Bitset_Compact<SIZE2>& b)
+		{
+			return priv::op_count_bits<P, AND>(a.data(), b.data(), std::min(SIZE1, SIZE2));
+		}
+
+		//Number of bits set in a or b; only the bits that both bitsets have are considered.
+		template <typename P, int SIZE1, int SIZE2>
+		int union_count(const Bitset_Compact<SIZE1>& a, const Bitset_Compact<SIZE2>& b)
+		{
+			return priv::op_count_bits<P, OR>(a.data(), b.data(), std::min(SIZE1, SIZE2));
+		}
+
+		//Number of bits set in a but not in b; only the bits that both bitsets have are considered.
+		template <typename P, int SIZE1, int SIZE2>
+		int andnot_count(const Bitset_Compact<SIZE1>& a, const Bitset_Compact<SIZE2>& b)
+		{
+			return priv::op_count_bits<P, ANDNOT>(a.data(), b.data(), std::min(SIZE1, SIZE2));
+		}
+
+		//Number of bits in which a and b differ; only the bits that both bitsets have are considered, such that the 
+		//visible part of a bitset of all sensors can be compared with a bitset of the visible sensors.
+		template <typename P, int SIZE1, int SIZE2>
+		int hamming(const Bitset_Compact<SIZE1>& a, const Bitset_Compact<SIZE2>& b)
+		{
+			return priv::op_count_bits<P, XOR>(a.data(), b.data(), std::min(SIZE1, SIZE2));
+		}
+		#pragma endregion
+
+		#pragma region Conversion
+		//Write the positions of the set bits of a in ascending order to out, which has room for 
+		//(Bitset_Compact<SIZE>::N_BLOCKS << 5) positions and is reused by the caller; returns the number of positions.
+		template <typename P, int SIZE>
+		int to_sparse(const Bitset_Compact<SIZE>& a, int * const out)
+		{
+			return priv::to_sparse<P>(a.data(), Bitset_Compact<SIZE>::N_BLOCKS, out);
+		}
+
+		//Set the bits of the positions in ids; the other bits of out are cleared.
+		template <int SIZE>
+		void from_sparse(const std::vector<int>& ids, Bitset_Compact<SIZE>& out)
+		{
+			priv::from_sparse_ref(ids.data(), static_cast<int>(ids.size()), Bitset_Compact<SIZE>::N_BLOCKS, out.data());
+		}
+
+		//Set bit i of out when values[i] is ABOVE (not equal) the threshold, for all SIZE bits of out.
+		template <typename P, int SIZE>
+		void threshold(const int * const values, const int threshold, Bitset_Compact<SIZE>& out)
+		{
+			priv::threshold<P>(values, SIZE, threshold, out.data());
+		}
+		#pragma endregion
+	}
+}
\ No newline at end of file
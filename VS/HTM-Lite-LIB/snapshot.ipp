@@ -0,0 +1,936 @@
+// C++ port of Nupic HTM with the aim of being lite and fast
+//
+// Copyright (c) 2017 Henk-Jan Lebbink
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero Public License version 3 as
+// published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero Public License for more details.
+//
+// You should have received a copy of the GNU Affero Public License
+// along with this program.  If not, see http://www.gnu.org/licenses.
+
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstring>		// std::memset, std::memcmp
+#include <algorithm>	// std::max, std::sort
+#include <filesystem>	// std::filesystem::rename
+#include <type_traits>
+
+#ifdef _MSC_VER
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "..\Spike-Tools-Lib\log.ipp"
+
+#include "parameters.ipp"
+#include "types.ipp"
+#include "layer.ipp"
+
+//Hierarchical Temporal Memory (HTM)
+namespace htm
+{
+	//Binary snapshot of a trained layer. A snapshot file is a header followed by sections; every section starts
+	//at a multiple of 64 bytes such that its elements are aligned for vectorization. A section holds either one
+	//vector, or a vector of vectors as the lengths of the inner vectors followed by their elements, where every inner
+	//vector starts at a multiple of 64 bytes as well.
+	//Every section that the writer of a version writes is required by the reader of that version: a change of the
+	//sections (a new, removed or reordered section or a changed layout) is a new VERSION, and a snapshot of another
+	//version is not loaded.
+	namespace snapshot
+	{
+		using namespace ::tools::log;
+		using namespace htm::types;
+		using namespace htm::tools;
+
+		//Version of the snapshot format; snapshots with a different version are not loaded.
+		//Version 2: the random lanes of the sensor noise (NOISE_RANDOM_LANES) are saved with the learning state.
+		//Version 3: every inner vector of a section starts at a multiple of ALIGN, such that restore can use it in place.
+		static constexpr uint32_t VERSION = 3;
+
+		namespace priv
+		{
+			static constexpr uint64_t MAGIC = 0x31504E53544D5448; // "HTMTSNP1"
+			static constexpr uint64_t ALIGN = 64;
+
+			enum class section_t : uint32_t
+			{
+				//Layer_Persisted
+				DD_SEGMENT_COUNT = 1,
+				DD_SEGMENT_DESTINATION = 2,
+				DD_SYNAPSE_PERMANENCE_SF = 3,
+				DD_SYNAPSE_DELAY_ORIGIN_SF = 4,
+				DD_SEGMENT_OFFSET_SF = 5,
+				DD_SEGMENT_CAPACITY_SF = 6,
+				DD_SLAB_FREE_SF = 7,
+				DD_SYNAPSE_COUNT_SF = 8,
+				BOOST_FACTOR = 9,
+				SP_PD_SYNAPSE_PERMANENCE_SF = 10,
+				SP_PD_SYNAPSE_ORIGIN_SENSOR_SF = 11,
+				SP_PD_DESTINATION_COLUMN_SB = 12,
+				SP_PD_SYNAPSE_PERMANENCE_SB = 13,
+				SP_PD_SYNAPSE_COUNT_SB = 14,
+				DD_SYNAPSE_SB = 15,
+				DD_SYNAPSE_COUNT_TOTAL_SB = 16,
+
+				//Layer_Fluent
+				RANDOM_NUMBER = 32,
+				ITERATION_NUM = 33,
+				SP_ACTIVE_DUTY_CYCLES = 34,
+				SP_OVERLAP_DUTY_CYCLES = 35,
+				SP_MIN_OVERLAP_DUTY_CYCLES = 36,
+				SP_INHIBITION_RADIUS = 37,
+				DD_SYNAPSE_ACTIVE_TIME = 38,
+				NOISE_RANDOM_LANES = 39
+			};
+
+			//The static parameters that determine the layout of a layer; a snapshot only loads in a layer with the same layout.
+			struct Header
+			{
+				uint64_t magic;
+				uint32_t version;
+				uint32_t has_fluent;
+				int32_t n_columns;
+				int32_t n_bits_cell;
+				int32_t n_visible_sensors;
+				int32_t n_hidden_sensors;
+				int32_t history_size;
+				int32_t sp_n_pd_synapses;
+				int32_t sp_synapse_forward;
+				int32_t tp_synapse_forward;
+				int32_t sizeof_permanence;
+				int32_t n_sections;
+				uint64_t file_size;
+			};
+			static_assert(sizeof(Header) == ALIGN, "ERROR: snapshot: header is not 64 bytes.");
+
+			//Header of a section: with n_vectors zero the section is one vector of n_elements; otherwise n_vectors lengths
+			//(uint64_t) follow at the next multiple of ALIGN, and the elements of every vector after that, each at the next
+			//multiple of ALIGN.
+			struct Section
+			{
+				uint32_t id;
+				uint32_t element_size;
+				uint64_t n_vectors;
+				uint64_t n_elements;
+				uint64_t size; // bytes of the section including this header; a multiple of ALIGN
+				uint8_t padding[32];
+			};
+			static_assert(sizeof(Section) == ALIGN, "ERROR: snapshot: section header is not 64 bytes.");
+
+			constexpr uint64_t multiple_align(const uint64_t i)
+			{
+				return (i + ALIGN - 1) & ~(ALIGN - 1);
+			}
+
+			//Elements of a section with one vector, or of one inner vector of a section with vectors, in the mapping.
+			template <typename T>
+			struct View
+			{
+				const T * data = nullptr;
+				uint64_t size = 0;
+
+				const T& operator[](const uint64_t i) const
+				{
+					return this->data[i];
+				}
+			};
+
+			template <typename P>
+			Header create_header(const bool has_fluent, const int n_sections, const uint64_t file_size)
+			{
+				Header header;
+				std::memset(&header, 0, sizeof(Header));
+				header.magic = MAGIC;
+				header.version = VERSION;
+				header.has_fluent = (has_fluent) ? 1 : 0;
+				header.n_columns = P::N_COLUMNS;
+				header.n_bits_cell = P::N_BITS_CELL;
+				header.n_visible_sensors = P::N_VISIBLE_SENSORS;
+				header.n_hidden_sensors = P::N_HIDDEN_SENSORS;
+				header.history_size = P::HISTORY_SIZE;
+				header.sp_n_pd_synapses = P::SP_N_PD_SYNAPSES;
+				header.sp_synapse_forward = (P::SP_SYNAPSE_FORWARD) ? 1 : 0;
+				header.tp_synapse_forward = (P::TP_SYNAPSE_FORWARD) ? 1 : 0;
+				header.sizeof_permanence = sizeof(Permanence);
+				header.n_sections = n_sections;
+				header.file_size = file_size;
+				return header;
+			}
+
+			class Writer
+			{
+				std::ofstream file_;
+				std::string filename_;
+				uint64_t pos_ = 0;
+
+				void write(const void * data, const uint64_t n_bytes)
+				{
+					if (n_bytes > 0) this->file_.write(static_cast<const char *>(data), static_cast<std::streamsize>(n_bytes));
+					this->pos_ += n_bytes;
+				}
+				void pad()
+				{
+					static const char zeros[ALIGN] = { 0 };
+					this->write(zeros, multiple_align(this->pos_) - this->pos_);
+				}
+				void write_section_header(const section_t id, const uint32_t element_size, const uint64_t n_vectors, const uint64_t n_elements, const uint64_t n_bytes_elements)
+				{
+					Section section;
+					std::memset(&section, 0, sizeof(Section));
+					section.id = static_cast<uint32_t>(id);
+					section.element_size = element_size;
+					section.n_vectors = n_vectors;
+					section.n_elements = n_elements;
+					section.size = sizeof(Section) + ((n_vectors > 0) ? multiple_align(n_vectors * sizeof(uint64_t)) : 0) + n_bytes_elements;
+					this->write(&section, sizeof(Section));
+					this->n_sections++;
+				}
+
+			public:
+				int n_sections = 0;
+
+				//The snapshot is written to a temporary file that replaces the file by close, such that a file that is
+				//mapped by a restored layer is never truncated or rewritten in place.
+				bool open(const std::string& filename)
+				{
+					this->filename_ = filename;
+					this->file_.open(filename + ".tmp", std::ios::binary | std::ios::trunc);
+					if (!this->file_.good()) return false;
+					//placeholder for the header, written by close
+					Header header;
+					std::memset(&header, 0, sizeof(Header));
+					this->write(&header, sizeof(Header));
+					return true;
+				}
+				template <typename P>
+				bool close(const bool has_fluent)
+				{
+					const Header header = create_header<P>(has_fluent, this->n_sections, this->pos_);
+					this->file_.seekp(0);
+					this->file_.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+					this->file_.close();
+					if (this->file_.fail()) return false;
+					std::error_code error;
+					std::filesystem::rename(this->filename_ + ".tmp", this->filename_, error);
+					return !error;
+				}
+
+				//Write one vector.
+				template <typename V>
+				void vector(const section_t id, const V& v)
+				{
+					using T = typename V::value_type;
+					this->write_section_header(id, sizeof(T), 0, v.size(), multiple_align(v.size() * sizeof(T)));
+					this->write(v.data(), v.size() * sizeof(T));
+					this->pad();
+				}
+
+				//Write a vector of vectors.
+				template <typename V>
+				void vectors(const section_t id, const std::vector<V>& vv)
+				{
+					using T = typename V::value_type;
+					std::vector<uint64_t> lengths(vv.size());
+					uint64_t n_elements = 0;
+					uint64_t n_bytes_elements = 0;
+					for (size_t i = 0; i < vv.size(); ++i)
+					{
+						lengths[i] = vv[i].size();
+						n_elements += lengths[i];
+						n_bytes_elements += multiple_align(lengths[i] * sizeof(T));
+					}
+					this->write_section_header(id, sizeof(T), vv.size(), n_elements, n_bytes_elements);
+					this->write(lengths.data(), lengths.size() * sizeof(uint64_t));
+					this->pad();
+					for (const auto& v : vv)
+					{
+						this->write(v.data(), v.size() * sizeof(T));
+						this->pad();
+					}
+				}
+			};
+
+			//Read only memory mapping of a file; the file stays open such that copy on write views of the same file can
+			//be lent to the pool.
+			class Mapped_File
+			{
+				const char * data_ = nullptr;
+				uint64_t size_ = 0;
+				#ifdef _MSC_VER
+				HANDLE file_ = INVALID_HANDLE_VALUE;
+				HANDLE mapping_ = nullptr;
+				#else
+				int fd_ = -1;
+				#endif
+
+			public:
+				Mapped_File() = default;
+				Mapped_File(const Mapped_File&) = delete;
+				Mapped_File& operator=(const Mapped_File&) = delete;
+				~Mapped_File()
+				{
+					this->close();
+				}
+
+				const char * data() const { return this->data_; }
+				uint64_t size() const { return this->size_; }
+
+				bool open(const std::string& filename)
+				{
+					this->close();
+					#ifdef _MSC_VER
+					this->file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+					if (this->file_ == INVALID_HANDLE_VALUE) return false;
+					LARGE_INTEGER file_size;
+					if (!GetFileSizeEx(this->file_, &file_size) || (file_size.QuadPart == 0)) { this->close(); return false; }
+					this->mapping_ = CreateFileMappingA(this->file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+					if (this->mapping_ == nullptr) { this->close(); return false; }
+					this->data_ = static_cast<const char *>(MapViewOfFile(this->mapping_, FILE_MAP_READ, 0, 0, 0));
+					if (this->data_ == nullptr) { this->close(); return false; }
+					this->size_ = static_cast<uint64_t>(file_size.QuadPart);
+					#else
+					this->fd_ = ::open(filename.c_str(), O_RDONLY);
+					if (this->fd_ == -1) return false;
+					struct stat file_stat;
+					if ((fstat(this->fd_, &file_stat) != 0) || (file_stat.st_size == 0)) { this->close(); return false; }
+					void * ptr = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, this->fd_, 0);
+					if (ptr == MAP_FAILED) { this->close(); return false; }
+					this->data_ = static_cast<const char *>(ptr);
+					this->size_ = static_cast<uint64_t>(file_stat.st_size);
+					#endif
+					return true;
+				}
+
+				//Map a private copy on write view of the whole file and lend it to the pool (see Page_Pool::lend_mapping);
+				//returns its start, or nullptr when it could not be mapped. The view has the contents of data(): pages are
+				//read from the file, and a page is copied when it is first written. The caller releases it with
+				//Page_Pool::release_mapping.
+				char * lend_copy_on_write() const
+				{
+					char * view = nullptr;
+					#ifdef _MSC_VER
+					if (this->file_ == INVALID_HANDLE_VALUE) return nullptr;
+					HANDLE mapping = CreateFileMappingA(this->file_, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+					if (mapping == nullptr) return nullptr;
+					view = static_cast<char *>(MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0));
+					CloseHandle(mapping); // the view keeps the mapping
+					#else
+					if (this->fd_ == -1) return nullptr;
+					void * ptr = mmap(nullptr, static_cast<size_t>(this->size_), PROT_READ | PROT_WRITE, MAP_PRIVATE, this->fd_, 0);
+					if (ptr != MAP_FAILED) view = static_cast<char *>(ptr);
+					#endif
+					if (view != nullptr) ::tools::allocator::Page_Pool::instance().lend_mapping(view, static_cast<size_t>(this->size_));
+					return view;
+				}
+				void close()
+				{
+					#ifdef _MSC_VER
+					if (this->data_ != nullptr) UnmapViewOfFile(this->data_);
+					if (this->mapping_ != nullptr) CloseHandle(this->mapping_);
+					if (this->file_ != INVALID_HANDLE_VALUE) CloseHandle(this->file_);
+					this->mapping_ = nullptr;
+					this->file_ = INVALID_HANDLE_VALUE;
+					#else
+					if (this->data_ != nullptr) munmap(const_cast<char *>(this->data_), static_cast<size_t>(this->size_));
+					if (this->fd_ != -1) ::close(this->fd_);
+					this->fd_ = -1;
+					#endif
+					this->data_ = nullptr;
+					this->size_ = 0;
+				}
+			};
+
+			template <typename P>
+			void write_layer(Writer& writer, const Layer_Persisted<P>& layer)
+			{
+				writer.vector(section_t::DD_SEGMENT_COUNT, layer.dd_segment_count);
+				writer.vectors(section_t::DD_SEGMENT_DESTINATION, layer.dd_segment_destination);
+				writer.vectors(section_t::DD_SYNAPSE_PERMANENCE_SF, layer.dd_synapse_permanence_sf);
+				writer.vectors(section_t::DD_SYNAPSE_DELAY_ORIGIN_SF, layer.dd_synapse_delay_origin_sf);
+				writer.vectors(section_t::DD_SEGMENT_OFFSET_SF, layer.dd_segment_offset_sf);
+				writer.vectors(section_t::DD_SEGMENT_CAPACITY_SF, layer.dd_segment_capacity_sf);
+				writer.vectors(section_t::DD_SLAB_FREE_SF, layer.dd_slab_free_sf);
+				writer.vectors(section_t::DD_SYNAPSE_COUNT_SF, layer.dd_synapse_count_sf);
+				writer.vector(section_t::BOOST_FACTOR, layer.boost_factor);
+				if (P::SP_SYNAPSE_FORWARD)
+				{
+					writer.vectors(section_t::SP_PD_SYNAPSE_PERMANENCE_SF, layer.sp_pd_synapse_permanence_sf);
+					writer.vectors(section_t::SP_PD_SYNAPSE_ORIGIN_SENSOR_SF, layer.sp_pd_synapse_origin_sensor_sf);
+				}
+				else
+				{
+					writer.vectors(section_t::SP_PD_DESTINATION_COLUMN_SB, layer.sp_pd_destination_column_sb);
+					writer.vectors(section_t::SP_PD_SYNAPSE_PERMANENCE_SB, layer.sp_pd_synapse_permanence_sb);
+					writer.vector(section_t::SP_PD_SYNAPSE_COUNT_SB, layer.sp_pd_synapse_count_sb);
+				}
+				if (!P::TP_SYNAPSE_FORWARD)
+				{
+					writer.vectors(section_t::DD_SYNAPSE_SB, layer.dd_synapse_sb);
+					writer.vector(section_t::DD_SYNAPSE_COUNT_TOTAL_SB, std::vector<int64_t>(1, layer.dd_synapse_count_total_sb));
+				}
+			}
+
+			template <typename P>
+			void write_layer_fluent(Writer& writer, const Layer_Fluent<P>& layer_fluent)
+			{
+				writer.vector(section_t::RANDOM_NUMBER, layer_fluent.random_number);
+				writer.vector(section_t::ITERATION_NUM, std::vector<int>{ layer_fluent.iteration_num, layer_fluent.iteration_learn_num });
+				writer.vector(section_t::SP_ACTIVE_DUTY_CYCLES, layer_fluent.sp_active_duty_cycles);
+				writer.vector(section_t::SP_OVERLAP_DUTY_CYCLES, layer_fluent.sp_overlap_duty_cycles);
+				writer.vector(section_t::SP_MIN_OVERLAP_DUTY_CYCLES, layer_fluent.sp_min_overlap_duty_cycles);
+				writer.vector(section_t::SP_INHIBITION_RADIUS, std::vector<int>(1, layer_fluent.sp_inhibition_radius));
+				writer.vectors(section_t::DD_SYNAPSE_ACTIVE_TIME, layer_fluent.dd_synapse_active_time);
+				writer.vector(section_t::NOISE_RANDOM_LANES, std::vector<unsigned int>(layer_fluent.noise_random_lanes.state.begin(), layer_fluent.noise_random_lanes.state.end()));
+			}
+		}
+
+		//A snapshot file mapped in memory. One snapshot can restore any number of layers, for example all candidates
+		//of a swarm that start from the same trained layer; the file is mapped once and never written.
+		//
+		//Restoring the synapse slabs is zero copy: every restore maps a private copy on write view of the file and the
+		//slabs of the layer (the vectors of the pool allocator) adopt their blocks in it. Inference only reads the
+		//pages; learning makes the OS copy a page when it first writes it, and those copies belong to that layer only.
+		//The view is unmapped when the last slab that uses it is freed. The small per-segment and per-column vectors
+		//are copied. Saving writes a temporary file and renames it, such that a mapped snapshot is never truncated.
+		template <typename P>
+		class Snapshot
+		{
+			priv::Mapped_File file_;
+			std::vector<const priv::Section *> sections_;
+			//For every section of vectors: the offset of the elements of every inner vector from the start of the section.
+			std::vector<std::vector<uint64_t>> offsets_;
+			bool has_fluent_ = false;
+
+			int find(const priv::section_t id) const
+			{
+				for (int i = 0; i < static_cast<int>(this->sections_.size()); ++i) if (this->sections_[i]->id == static_cast<uint32_t>(id)) return i;
+				return -1;
+			}
+
+			//Check that the lengths and the elements of the provided section are within the section, and compute the
+			//offsets of the inner vectors: a damaged file must not make a read go past the mapping.
+			static bool read_layout(const priv::Section * section, std::vector<uint64_t>& offsets)
+			{
+				const uint64_t payload_size = section->size - sizeof(priv::Section);
+				if (section->element_size == 0) return false;
+				if (section->n_vectors == 0) return section->n_elements <= (payload_size / section->element_size);
+
+				if (section->n_vectors > (payload_size / sizeof(uint64_t))) return false;
+				const uint64_t lengths_size = priv::multiple_align(section->n_vectors * sizeof(uint64_t));
+				if (lengths_size > payload_size) return false;
+
+				const uint64_t * lengths = reinterpret_cast<const uint64_t *>(reinterpret_cast<const char *>(section) + sizeof(priv::Section));
+				uint64_t offset = sizeof(priv::Section) + lengths_size;
+				uint64_t n_elements = 0;
+				offsets.resize(static_cast<size_t>(section->n_vectors));
+				for (size_t i = 0; i < offsets.size(); ++i)
+				{
+					if (lengths[i] > ((section->size - offset) / section->element_size)) return false;
+					const uint64_t n_bytes = priv::multiple_align(lengths[i] * section->element_size);
+					if (n_bytes > (section->size - offset)) return false;
+					offsets[i] = offset;
+					offset += n_bytes;
+					n_elements += lengths[i];
+				}
+				return n_elements == section->n_elements;
+			}
+
+			template <typename T>
+			bool view_vector(const priv::section_t id, priv::View<T>& view) const
+			{
+				const int section_i = this->find(id);
+				if (section_i == -1) return false;
+				const priv::Section * section = this->sections_[section_i];
+				if ((section->n_vectors != 0) || (section->element_size != sizeof(T))) return false;
+				view.data = reinterpret_cast<const T *>(reinterpret_cast<const char *>(section) + sizeof(priv::Section));
+				view.size = section->n_elements;
+				return true;
+			}
+
+			template <typename T>
+			bool view_vectors(const priv::section_t id, const uint64_t n_vectors, std::vector<priv::View<T>>& views) const
+			{
+				const int section_i = this->find(id);
+				if (section_i == -1) return false;
+				const priv::Section * section = this->sections_[section_i];
+				if ((section->n_vectors != n_vectors) || (section->element_size != sizeof(T))) return false;
+				const uint64_t * lengths = reinterpret_cast<const uint64_t *>(reinterpret_cast<const char *>(section) + sizeof(priv::Section));
+				views.resize(static_cast<size_t>(n_vectors));
+				for (size_t i = 0; i < views.size(); ++i)
+				{
+					views[i].data = reinterpret_cast<const T *>(reinterpret_cast<const char *>(section) + this->offsets_[section_i][i]);
+					views[i].size = lengths[i];
+				}
+				return true;
+			}
+
+			template <typename V>
+			bool read_vector(const priv::section_t id, V& v) const
+			{
+				priv::View<typename V::value_type> view;
+				if (!this->view_vector(id, view)) return false;
+				v.assign(view.data, view.data + view.size);
+				return true;
+			}
+
+			//Read the vectors of the provided section. The vectors of the pool allocator adopt their elements in place from
+			//the provided copy on write view of the file (see Mapped_File::lend_copy_on_write); the other vectors, and
+			//all vectors without a view, copy them.
+			template <typename V>
+			bool read_vectors(const priv::section_t id, std::vector<V>& vv, char * const view) const
+			{
+				using T = typename V::value_type;
+				std::vector<priv::View<T>> views;
+				if (!this->view_vectors(id, vv.size(), views)) return false;
+				for (size_t i = 0; i < vv.size(); ++i)
+				{
+					if constexpr (std::is_same<typename V::allocator_type, ::tools::allocator::Allocator_Pool<T>>::value)
+					{
+						if (view != nullptr)
+						{
+							T * const data = reinterpret_cast<T *>(view + (reinterpret_cast<const char *>(views[i].data) - this->file_.data()));
+							if (::tools::allocator::adopt(vv[i], data, static_cast<size_t>(views[i].size))) continue;
+						}
+					}
+					vv[i].assign(views[i].data, views[i].data + views[i].size);
+				}
+				return true;
+			}
+
+			//Check the contents that the kernels use as sizes, offsets and indices, such that a damaged or tampered file
+			//cannot make a restored layer read or write outside its vectors.
+			bool check_contents(const std::string& filename) const
+			{
+				using priv::section_t;
+				using priv::View;
+				const auto damaged = [&](const auto&... args)
+				{
+					log_WARNING("snapshot::open: file ", filename, " is damaged: ", args..., ".\n");
+					return false;
+				};
+				const auto valid_origin = [](const int delay_and_cell_id)
+				{
+					const int delay = get_delay(delay_and_cell_id);
+					return (get_global_cell_id(delay_and_cell_id) < P::N_CELLS) && (delay >= 1) && (delay <= P::HISTORY_SIZE);
+				};
+
+				#pragma region distal dendrites
+				View<int> segment_count;
+				std::vector<View<int8_t>> destination;
+				std::vector<View<Permanence>> permanence;
+				std::vector<View<typename P::TP_Origin>> delay_origin;
+				std::vector<View<int>> offset;
+				std::vector<View<int>> capacity;
+				std::vector<View<uint64_t>> slab_free;
+				std::vector<View<int>> synapse_count;
+				if (!this->view_vector(section_t::DD_SEGMENT_COUNT, segment_count) || (segment_count.size != P::N_COLUMNS) ||
+					!this->view_vectors(section_t::DD_SEGMENT_DESTINATION, P::N_COLUMNS, destination) ||
+					!this->view_vectors(section_t::DD_SYNAPSE_PERMANENCE_SF, P::N_COLUMNS, permanence) ||
+					!this->view_vectors(section_t::DD_SYNAPSE_DELAY_ORIGIN_SF, P::N_COLUMNS, delay_origin) ||
+					!this->view_vectors(section_t::DD_SEGMENT_OFFSET_SF, P::N_COLUMNS, offset) ||
+					!this->view_vectors(section_t::DD_SEGMENT_CAPACITY_SF, P::N_COLUMNS, capacity) ||
+					!this->view_vectors(section_t::DD_SLAB_FREE_SF, P::N_COLUMNS, slab_free) ||
+					!this->view_vectors(section_t::DD_SYNAPSE_COUNT_SF, P::N_COLUMNS, synapse_count))
+				{
+					return damaged("a distal dendrite section is missing or does not have a vector per column");
+				}
+				for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+				{
+					const int n_segments = segment_count[column_i];
+					const uint64_t n_slots = offset[column_i].size;
+					const int64_t slab_size = static_cast<int64_t>(permanence[column_i].size);
+					if ((n_segments < 0) || (n_segments > P::TP_N_DD_SEGMENTS_MAX) || (static_cast<uint64_t>(n_segments) > n_slots) ||
+						(capacity[column_i].size != n_slots) || (synapse_count[column_i].size != n_slots) || (destination[column_i].size != n_slots) ||
+						(delay_origin[column_i].size != permanence[column_i].size))
+					{
+						return damaged("the segment vectors of column ", column_i, " do not match");
+					}
+					for (uint64_t segment_i = 0; segment_i < n_slots; ++segment_i)
+					{
+						// the chunk of every segment has to be an aligned part of the slab
+						const int64_t segment_offset = offset[column_i][segment_i];
+						const int64_t segment_capacity = capacity[column_i][segment_i];
+						const int n_synapses = synapse_count[column_i][segment_i];
+						if ((segment_offset < 0) || ((segment_offset & 0b111111) != 0) || (segment_capacity < 0) || ((segment_capacity & 0b111111) != 0) ||
+							(segment_capacity > P::TP_N_DD_SYNAPSES_MAX) || ((segment_offset + segment_capacity) > slab_size) || (n_synapses < 0) || (n_synapses > segment_capacity))
+						{
+							return damaged("segment ", segment_i, " of column ", column_i, " is not within the slab");
+						}
+						if (segment_i >= static_cast<uint64_t>(n_segments)) continue;
+
+						if ((destination[column_i][segment_i] < 0) || (destination[column_i][segment_i] >= P::N_CELLS_PC))
+						{
+							return damaged("segment ", segment_i, " of column ", column_i, " belongs to cell ", static_cast<int>(destination[column_i][segment_i]));
+						}
+						for (int synapse_i = 0; synapse_i < n_synapses; ++synapse_i)
+						{
+							const int delay_and_cell_id = widen_origin<P>(delay_origin[column_i][segment_offset + synapse_i]);
+							if ((delay_and_cell_id != P::TP_DD_SYNAPSE_ORIGIN_INVALID) && !valid_origin(delay_and_cell_id))
+							{
+								return damaged("synapse ", synapse_i, " of segment ", segment_i, " of column ", column_i, " has origin ", delay_and_cell_id);
+							}
+						}
+					}
+					for (uint64_t chunk_i = 0; chunk_i < slab_free[column_i].size; ++chunk_i)
+					{
+						const int64_t chunk_offset = tp::priv::dd_slab::get_chunk_offset(slab_free[column_i][chunk_i]);
+						const int64_t chunk_capacity = tp::priv::dd_slab::get_chunk_capacity(slab_free[column_i][chunk_i]);
+						if ((chunk_offset < 0) || ((chunk_offset & 0b111111) != 0) || (chunk_capacity <= 0) || ((chunk_capacity & 0b111111) != 0) || ((chunk_offset + chunk_capacity) > slab_size))
+						{
+							return damaged("free chunk ", chunk_i, " of column ", column_i, " is not within the slab");
+						}
+					}
+				}
+				#pragma endregion
+
+				#pragma region proximal dendrites
+				View<float> boost_factor;
+				if (!this->view_vector(section_t::BOOST_FACTOR, boost_factor) || (boost_factor.size != P::N_COLUMNS))
+				{
+					return damaged("the boost factors are missing");
+				}
+				if (P::SP_SYNAPSE_FORWARD)
+				{
+					std::vector<View<Permanence>> sp_permanence;
+					std::vector<View<typename P::SP_Origin>> sp_origin;
+					if (!this->view_vectors(section_t::SP_PD_SYNAPSE_PERMANENCE_SF, P::N_COLUMNS, sp_permanence) ||
+						!this->view_vectors(section_t::SP_PD_SYNAPSE_ORIGIN_SENSOR_SF, P::N_COLUMNS, sp_origin))
+					{
+						return damaged("a proximal dendrite section is missing or does not have a vector per column");
+					}
+					for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+					{
+						if ((sp_permanence[column_i].size != P::SP_N_PD_SYNAPSES) || (sp_origin[column_i].size != P::SP_N_PD_SYNAPSES))
+						{
+							return damaged("column ", column_i, " does not have ", P::SP_N_PD_SYNAPSES, " proximal synapses");
+						}
+						for (int synapse_i = 0; synapse_i < P::SP_N_PD_SYNAPSES; ++synapse_i)
+						{
+							const int sensor_i = sp_origin[column_i][synapse_i];
+							if ((sensor_i < 0) || (sensor_i >= P::N_SENSORS))
+							{
+								return damaged("proximal synapse ", synapse_i, " of column ", column_i, " has origin ", sensor_i);
+							}
+						}
+					}
+				}
+				else
+				{
+					std::vector<View<int>> sp_destination;
+					std::vector<View<Permanence>> sp_permanence;
+					View<int> sp_synapse_count;
+					if (!this->view_vectors(section_t::SP_PD_DESTINATION_COLUMN_SB, P::N_SENSORS, sp_destination) ||
+						!this->view_vectors(section_t::SP_PD_SYNAPSE_PERMANENCE_SB, P::N_SENSORS, sp_permanence) ||
+						!this->view_vector(section_t::SP_PD_SYNAPSE_COUNT_SB, sp_synapse_count) || (sp_synapse_count.size != P::N_SENSORS))
+					{
+						return damaged("a proximal dendrite section is missing or does not have a vector per sensor");
+					}
+					for (int sensor_i = 0; sensor_i < P::N_SENSORS; ++sensor_i)
+					{
+						const int n_synapses = sp_synapse_count[sensor_i];
+						if ((sp_permanence[sensor_i].size != sp_destination[sensor_i].size) || (n_synapses < 0) || (static_cast<uint64_t>(n_synapses) > sp_destination[sensor_i].size))
+						{
+							return damaged("the proximal synapse vectors of sensor ", sensor_i, " do not match");
+						}
+						for (int synapse_i = 0; synapse_i < n_synapses; ++synapse_i)
+						{
+							const int column_i = sp_destination[sensor_i][synapse_i];
+							if ((column_i < 0) || (column_i >= P::N_COLUMNS))
+							{
+								return damaged("proximal synapse ", synapse_i, " of sensor ", sensor_i, " has destination ", column_i);
+							}
+						}
+					}
+				}
+				#pragma endregion
+
+				#pragma region inverse distal synapse index
+				if (!P::TP_SYNAPSE_FORWARD)
+				{
+					std::vector<View<uint64_t>> synapse_sb;
+					View<int64_t> count_total;
+					if (!this->view_vectors(section_t::DD_SYNAPSE_SB, P::N_CELLS, synapse_sb) ||
+						!this->view_vector(section_t::DD_SYNAPSE_COUNT_TOTAL_SB, count_total) || (count_total.size != 1))
+					{
+						return damaged("the inverse distal synapse index is missing or does not have a vector per cell");
+					}
+					int64_t n_synapses_total = 0;
+					for (int cell_i = 0; cell_i < P::N_CELLS; ++cell_i)
+					{
+						for (uint64_t i = 0; i < synapse_sb[cell_i].size; ++i)
+						{
+							const uint64_t synapse = synapse_sb[cell_i][i];
+							const int column_i = tp::priv::dd_sb::get_column(synapse);
+							const int segment_i = tp::priv::dd_sb::get_segment(synapse);
+							const int delay = tp::priv::dd_sb::get_synapse_delay(synapse);
+							if ((column_i < 0) || (column_i >= P::N_COLUMNS) || (segment_i >= segment_count[column_i]) ||
+								(tp::priv::dd_sb::get_synapse(synapse) >= synapse_count[column_i][segment_i]) || (delay < 1) || (delay > P::HISTORY_SIZE))
+							{
+								return damaged("entry ", i, " of cell ", cell_i, " of the inverse distal synapse index is not a synapse");
+							}
+						}
+						n_synapses_total += static_cast<int64_t>(synapse_sb[cell_i].size);
+					}
+					if (n_synapses_total != count_total[0])
+					{
+						return damaged("the inverse distal synapse index has ", n_synapses_total, " synapses instead of ", count_total[0]);
+					}
+				}
+				#pragma endregion
+
+				#pragma region learning state
+				if (this->has_fluent_)
+				{
+					View<unsigned int> random_number;
+					View<float> active_duty_cycles;
+					View<float> overlap_duty_cycles;
+					View<float> min_overlap_duty_cycles;
+					View<int> inhibition_radius;
+					std::vector<View<int>> active_time;
+					if (!this->view_vector(section_t::RANDOM_NUMBER, random_number) || (random_number.size != P::N_COLUMNS) ||
+						!this->view_vector(section_t::SP_ACTIVE_DUTY_CYCLES, active_duty_cycles) || (active_duty_cycles.size != P::N_COLUMNS) ||
+						!this->view_vector(section_t::SP_OVERLAP_DUTY_CYCLES, overlap_duty_cycles) || (overlap_duty_cycles.size != P::N_COLUMNS) ||
+						!this->view_vector(section_t::SP_MIN_OVERLAP_DUTY_CYCLES, min_overlap_duty_cycles) || (min_overlap_duty_cycles.size != P::N_COLUMNS) ||
+						!this->view_vector(section_t::SP_INHIBITION_RADIUS, inhibition_radius) || (inhibition_radius.size != 1) ||
+						(inhibition_radius[0] < 0) || (inhibition_radius[0] > std::max(P::SP_N_COLUMNS_DIM1, P::SP_N_COLUMNS_DIM2)) ||
+						!this->view_vectors(section_t::DD_SYNAPSE_ACTIVE_TIME, P::N_COLUMNS, active_time))
+					{
+						return damaged("the learning state is missing or does not have a value per column");
+					}
+					for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+					{
+						if (active_time[column_i].size != offset[column_i].size)
+						{
+							return damaged("the synapse active times of column ", column_i, " do not match its segments");
+						}
+					}
+				}
+				#pragma endregion
+				return true;
+			}
+
+		public:
+			//Map the provided snapshot file and check that it was saved from a layer with the static parameters P.
+			bool open(const std::string& filename)
+			{
+				this->sections_.clear();
+				this->offsets_.clear();
+				if (!this->file_.open(filename))
+				{
+					log_WARNING("snapshot::open: could not map file ", filename, ".\n");
+					return false;
+				}
+				const auto * header = reinterpret_cast<const priv::Header *>(this->file_.data());
+				bool valid = this->file_.size() >= sizeof(priv::Header);
+				if (valid)
+				{
+					const priv::Header expected = priv::create_header<P>(header->has_fluent != 0, header->n_sections, this->file_.size());
+					valid = std::memcmp(header, &expected, sizeof(priv::Header)) == 0;
+				}
+				if (!valid)
+				{
+					log_WARNING("snapshot::open: file ", filename, " is not a version ", VERSION, " snapshot of a layer with the provided static parameters.\n");
+					this->file_.close();
+					return false;
+				}
+				uint64_t pos = sizeof(priv::Header);
+				for (int section_i = 0; section_i < header->n_sections; ++section_i)
+				{
+					const auto * section = reinterpret_cast<const priv::Section *>(this->file_.data() + pos);
+					if (((pos + sizeof(priv::Section)) > this->file_.size()) || ((pos + section->size) > this->file_.size()) || (section->size < sizeof(priv::Section)))
+					{
+						log_WARNING("snapshot::open: file ", filename, " is truncated.\n");
+						this->file_.close();
+						this->sections_.clear();
+						this->offsets_.clear();
+						return false;
+					}
+					std::vector<uint64_t> offsets;
+					if (!read_layout(section, offsets))
+					{
+						log_WARNING("snapshot::open: file ", filename, " is damaged: section ", section_i, " does not fit its elements.\n");
+						this->file_.close();
+						this->sections_.clear();
+						this->offsets_.clear();
+						return false;
+					}
+					this->sections_.push_back(section);
+					this->offsets_.push_back(std::move(offsets));
+					pos += section->size;
+				}
+				this->has_fluent_ = header->has_fluent != 0;
+				if (!this->check_contents(filename))
+				{
+					this->file_.close();
+					this->sections_.clear();
+					this->offsets_.clear();
+					return false;
+				}
+				return true;
+			}
+
+			//Whether the snapshot contains the learning state of Layer_Fluent.
+			bool has_fluent() const
+			{
+				return this->has_fluent_;
+			}
+
+			//Restore the provided layer. If the snapshot contains the learning state of Layer_Fluent (random numbers,
+			//iteration counters, duty cycles, inhibition radius, synapse activity times) it is restored as well; the
+			//activity of the previous time step (active cells and segments) is cleared as after layer::init.
+			//
+			//The synapse slabs (the vectors of the pool allocator) are not copied: every restore maps its own private
+			//copy on write view of the file, and the slabs of the layer point into it. Pages are read from the file (the
+			//page cache) when the layer first reads them, and the OS copies a page only when learning first writes it,
+			//such that layers restored from one snapshot share the pages they do not change. The view lives as long as
+			//a slab of the layer uses it, also after the snapshot is closed. The other vectors are copied.
+			bool restore(Layer_Fluent<P>& layer_fluent, Layer_Persisted<P>& layer, const Dynamic_Param& param) const
+			{
+				using priv::section_t;
+				bool ok = !this->sections_.empty();
+				char * const view = (ok) ? this->file_.lend_copy_on_write() : nullptr;
+
+				ok = ok && this->read_vector(section_t::DD_SEGMENT_COUNT, layer.dd_segment_count);
+				ok = ok && this->read_vectors(section_t::DD_SEGMENT_DESTINATION, layer.dd_segment_destination, view);
+				ok = ok && this->read_vectors(section_t::DD_SYNAPSE_PERMANENCE_SF, layer.dd_synapse_permanence_sf, view);
+				ok = ok && this->read_vectors(section_t::DD_SYNAPSE_DELAY_ORIGIN_SF, layer.dd_synapse_delay_origin_sf, view);
+				ok = ok && this->read_vectors(section_t::DD_SEGMENT_OFFSET_SF, layer.dd_segment_offset_sf, view);
+				ok = ok && this->read_vectors(section_t::DD_SEGMENT_CAPACITY_SF, layer.dd_segment_capacity_sf, view);
+				ok = ok && this->read_vectors(section_t::DD_SLAB_FREE_SF, layer.dd_slab_free_sf, view);
+				if (ok) for (auto& free_chunks : layer.dd_slab_free_sf) std::sort(free_chunks.begin(), free_chunks.end()); // older snapshots hold the free chunks in release order
+				ok = ok && this->read_vectors(section_t::DD_SYNAPSE_COUNT_SF, layer.dd_synapse_count_sf, view);
+				ok = ok && this->read_vector(section_t::BOOST_FACTOR, layer.boost_factor);
+				if (P::SP_SYNAPSE_FORWARD)
+				{
+					ok = ok && this->read_vectors(section_t::SP_PD_SYNAPSE_PERMANENCE_SF, layer.sp_pd_synapse_permanence_sf, view);
+					ok = ok && this->read_vectors(section_t::SP_PD_SYNAPSE_ORIGIN_SENSOR_SF, layer.sp_pd_synapse_origin_sensor_sf, view);
+				}
+				else
+				{
+					ok = ok && this->read_vectors(section_t::SP_PD_DESTINATION_COLUMN_SB, layer.sp_pd_destination_column_sb, view);
+					ok = ok && this->read_vectors(section_t::SP_PD_SYNAPSE_PERMANENCE_SB, layer.sp_pd_synapse_permanence_sb, view);
+					ok = ok && this->read_vector(section_t::SP_PD_SYNAPSE_COUNT_SB, layer.sp_pd_synapse_count_sb);
+				}
+				if (!P::TP_SYNAPSE_FORWARD)
+				{
+					std::vector<int64_t> count_total;
+					ok = ok && this->read_vectors(section_t::DD_SYNAPSE_SB, layer.dd_synapse_sb, view);
+					ok = ok && this->read_vector(section_t::DD_SYNAPSE_COUNT_TOTAL_SB, count_total) && (count_total.size() == 1);
+					if (ok) layer.dd_synapse_count_total_sb = count_total[0];
+				}
+
+				if (ok && this->has_fluent_)
+				{
+					std::vector<int> iteration_num;
+					std::vector<int> inhibition_radius;
+					ok = ok && this->read_vector(section_t::RANDOM_NUMBER, layer_fluent.random_number);
+					ok = ok && this->read_vector(section_t::ITERATION_NUM, iteration_num) && (iteration_num.size() == 2);
+					ok = ok && this->read_vector(section_t::SP_ACTIVE_DUTY_CYCLES, layer_fluent.sp_active_duty_cycles);
+					ok = ok && this->read_vector(section_t::SP_OVERLAP_DUTY_CYCLES, layer_fluent.sp_overlap_duty_cycles);
+					ok = ok && this->read_vector(section_t::SP_MIN_OVERLAP_DUTY_CYCLES, layer_fluent.sp_min_overlap_duty_cycles);
+					ok = ok && this->read_vector(section_t::SP_INHIBITION_RADIUS, inhibition_radius) && (inhibition_radius.size() == 1);
+					ok = ok && this->read_vectors(section_t::DD_SYNAPSE_ACTIVE_TIME, layer_fluent.dd_synapse_active_time, view);
+					std::vector<unsigned int> noise_random_lanes;
+					ok = ok && this->read_vector(section_t::NOISE_RANDOM_LANES, noise_random_lanes) && (noise_random_lanes.size() == layer_fluent.noise_random_lanes.state.size());
+					if (ok)
+					{
+						std::copy(noise_random_lanes.begin(), noise_random_lanes.end(), layer_fluent.noise_random_lanes.state.begin());
+						layer_fluent.iteration_num = iteration_num[0];
+						layer_fluent.iteration_learn_num = iteration_num[1];
+						layer_fluent.sp_inhibition_radius = inhibition_radius[0];
+					}
+				}
+				else if (ok)
+				{
+					sp::priv::update_inhibition_radius(layer_fluent, layer, param);
+					for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+					{
+						auto& active_time = layer_fluent.dd_synapse_active_time[column_i];
+						active_time.assign(layer.dd_synapse_count_sf[column_i].size(), 0);
+					}
+				}
+				if (view != nullptr) ::tools::allocator::Page_Pool::instance().release_mapping(view);
+				if (!ok)
+				{
+					log_WARNING("snapshot::restore: snapshot is incomplete; the layer is in an undefined state.\n");
+					return false;
+				}
+
+				//clear the activity of the previous time step
+				for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+				{
+					layer_fluent.dd_segment_lru[column_i].rebuild(layer_fluent.dd_synapse_active_time[column_i], layer.dd_segment_count[column_i]);
+					layer_fluent.active_dd_segments[column_i].reset();
+					layer_fluent.matching_dd_segments[column_i].reset();
+				}
+				if constexpr (!P::TP_SYNAPSE_FORWARD)
+				{
+					for (auto& changes : layer_fluent.dd_synapse_sb_changes) changes.clear();
+					std::fill(layer_fluent.dd_synapse_sb_changed_columns.begin(), layer_fluent.dd_synapse_sb_changed_columns.end(), 0);
+					tp::priv::dd_sb::rebuild_positions(layer);
+				}
+				layer_fluent.active_cells.reset();
+				layer_fluent.winner_cells.reset();
+
+				//rebuild derived state
+				if (P::SP_OVERLAP_INCREMENTAL) sp::priv::calc_overlap::incremental::init(layer_fluent, layer);
+				return true;
+			}
+		};
+
+		//Save the provided layer, and if include_fluent is true also the learning state of layer_fluent, to the provided file.
+		template <typename P>
+		bool save(
+			const std::string& filename,
+			const Layer_Fluent<P>& layer_fluent,
+			const Layer_Persisted<P>& layer,
+			const bool include_fluent = true)
+		{
+			priv::Writer writer;
+			if (!writer.open(filename))
+			{
+				log_WARNING("snapshot::save: could not open file ", filename, ".\n");
+				return false;
+			}
+			priv::write_layer(writer, layer);
+			if (include_fluent) priv::write_layer_fluent(writer, layer_fluent);
+			if (!writer.close<P>(include_fluent))
+			{
+				log_WARNING("snapshot::save: could not write file ", filename, ".\n");
+				return false;
+			}
+			return true;
+		}
+
+		//Restore the provided layer from the provided snapshot file; see Snapshot::restore.
+		template <typename P>
+		bool load(
+			const std::string& filename,
+			Layer_Fluent<P>& layer_fluent,
+			Layer_Persisted<P>& layer,
+			const Dynamic_Param& param)
+		{
+			Snapshot<P> snapshot;
+			return snapshot.open(filename) && snapshot.restore(layer_fluent, layer, param);
+		}
+	}
+}
@@ -17,6 +17,7 @@
 #pragma once
 #include <algorithm>	// std::min
 #include <limits>		// std::numeric_limits
+#include <cmath>		// std::round
 #include <tuple>
 #include <array>
 #include <vector>
@@ -25,6 +26,7 @@
 
 #include "..\Spike-Tools-Lib\log.ipp"
 #include "..\Spike-Tools-Lib\assert.ipp"
+#include "..\Spike-Tools-Lib\profiler.ipp"
 
 #include "parameters.ipp"
 #include "print.ipp"
@@ -71,7 +73,7 @@ namespace htm
 					const int inhibition_top,
 					typename Layer_Fluent<P>::Active_Columns& active_columns)
 				{
-					active_columns.reset();
+					active_columns.clear_all();
 
 					for (int i = 0; i < inhibition_top; ++i)
 					{
@@ -86,7 +88,7 @@ namespace htm
 								best_i = column_i;
 							}
 						}
-						if (best_i != -1) active_columns.set(best_i);
+						if (best_i != -1) active_columns.set(best_i, true);
 					}
 					#if _DEBUG
 					Layer_Fluent<P>::Active_Columns active_columns2;
@@ -107,10 +109,12 @@ namespace htm
 				void active_columns_ref3(
 					const std::vector<float>& boosted_overlap, //N_COLUMNS
 					const int inhibition_top,
-					typename Layer_Fluent<P>::Active_Columns& active_columns)
+					typename Layer_Fluent<P>::Active_Columns& active_columns,
+					//scratch
+					std::vector<float>& tmp)
 				{
-					active_columns.reset();
-					std::vector<float> tmp = std::vector<float>(boosted_overlap);
+					active_columns.clear_all();
+					tmp.assign(boosted_overlap.begin(), boosted_overlap.end());
 
 					for (int i = 0; i < inhibition_top; ++i)
 					{
@@ -127,7 +131,7 @@ namespace htm
 						}
 						if (best_i != -1)
 						{
-							active_columns.set(best_i);
+							active_columns.set(best_i, true);
 							tmp[best_i] = -1;
 						}
 					}
@@ -151,10 +155,12 @@ namespace htm
 				void active_columns_ref4(
 					const std::vector<float>& boosted_overlap, //N_COLUMNS
 					const int inhibition_top,
-					typename Layer_Fluent<P>::Active_Columns& active_columns)
+					typename Layer_Fluent<P>::Active_Columns& active_columns,
+					//scratch
+					std::vector<float>& boosted_overlap_copy)
 				{
 					active_columns.clear_all();
-					std::vector<float> boosted_overlap_copy = std::vector<float>(boosted_overlap);
+					boosted_overlap_copy.assign(boosted_overlap.begin(), boosted_overlap.end());
 
 					std::nth_element(boosted_overlap_copy.begin(), boosted_overlap_copy.begin() + inhibition_top, boosted_overlap_copy.end(), std::greater<float>());
 					const float nth = boosted_overlap_copy[inhibition_top];
@@ -181,9 +187,475 @@ namespace htm
 					#endif
 				}
 
+				#pragma region Local inhibition
+				//Radius along the first and second dimension of the column grid; the radius is clipped such that
+				//an inhibition window never wraps around onto itself.
+				template <typename P>
+				std::tuple<int, int> local_radius(const int inhibition_radius)
+				{
+					const int radius1 = std::max(0, std::min(inhibition_radius, (P::SP_N_COLUMNS_DIM1 - 1) / 2));
+					const int radius2 = std::max(0, std::min(inhibition_radius, (P::SP_N_COLUMNS_DIM2 - 1) / 2));
+					return std::make_tuple(radius1, radius2);
+				}
+
+				//Number of winning columns in an inhibition window, as in Nupic: int(0.5 + density * window_size).
+				inline int local_inhibition_top(const int window_size, const float density)
+				{
+					return static_cast<int>(0.5f + (density * window_size));
+				}
+
+				//Number of columns in the (wrapping) window around column (x, y) that have a larger boosted overlap than oa;
+				//counting stops at max_count.
+				template <typename P>
+				int count_larger(
+					const std::vector<float>& boosted_overlap, //N_COLUMNS
+					const int x,
+					const int y,
+					const int radius1,
+					const int radius2,
+					const float oa,
+					const int max_count)
+				{
+					constexpr int D1 = P::SP_N_COLUMNS_DIM1;
+					constexpr int D2 = P::SP_N_COLUMNS_DIM2;
+					int sum = 0;
+
+					for (int dy = -radius2; dy <= radius2; ++dy)
+					{
+						const float * const row = &boosted_overlap[((y + dy + D2) % D2) * D1];
+						int x2 = (x - radius1 + D1) % D1;
+						for (int dx = -radius1; dx <= radius1; ++dx)
+						{
+							sum += (row[x2] > oa);
+							if (++x2 == D1) x2 = 0;
+						}
+						if (sum >= max_count) break;
+					}
+					return sum;
+				}
+
+				//Local inhibition: a column is active if fewer than inhibition_top columns in its window
+				//(2*radius+1 by 2*radius+1 columns) have a larger boosted overlap. O(N_COLUMNS * radius^2).
+				template <typename P>
+				void active_columns_local_ref(
+					const std::vector<float>& boosted_overlap, //N_COLUMNS
+					const int inhibition_radius,
+					const float density,
+					typename Layer_Fluent<P>::Active_Columns& active_columns)
+				{
+					const auto tup = local_radius<P>(inhibition_radius);
+					const int radius1 = std::get<0>(tup);
+					const int radius2 = std::get<1>(tup);
+					const int inhibition_top = local_inhibition_top((2 * radius1 + 1) * (2 * radius2 + 1), density);
+
+					for (int y = 0; y < P::SP_N_COLUMNS_DIM2; ++y)
+					{
+						for (int x = 0; x < P::SP_N_COLUMNS_DIM1; ++x)
+						{
+							const int column_i = (y * P::SP_N_COLUMNS_DIM1) + x;
+							const int sum = count_larger<P>(boosted_overlap, x, y, radius1, radius2, boosted_overlap[column_i], std::numeric_limits<int>::max());
+							active_columns.set(column_i, sum < inhibition_top);
+						}
+					}
+				}
+
+				//Return the k-th largest (k >= 1) boosted overlap in the (wrapping) rectangle that starts at (x, y) with the
+				//provided width and height, or the lowest float when the rectangle has fewer than k columns.
+				template <typename P>
+				float kth_largest(
+					const std::vector<float>& boosted_overlap, //N_COLUMNS
+					const int x,
+					const int y,
+					const int width,
+					const int height,
+					const int k,
+					//scratch
+					std::vector<float>& values)
+				{
+					constexpr int D1 = P::SP_N_COLUMNS_DIM1;
+					constexpr int D2 = P::SP_N_COLUMNS_DIM2;
+					constexpr int SMALL_K = 64;
+
+					if ((width * height) < k) return std::numeric_limits<float>::lowest();
+
+					if (k <= SMALL_K) // keep the k largest values sorted in a small buffer; most values are rejected by one compare
+					{
+						values.assign(k, std::numeric_limits<float>::lowest());
+						for (int i2 = 0; i2 < height; ++i2)
+						{
+							const float * const row = &boosted_overlap[(((y + i2) % D2 + D2) % D2) * D1];
+							int x2 = (x % D1 + D1) % D1;
+							for (int i1 = 0; i1 < width; ++i1)
+							{
+								const float f = row[x2];
+								if (f > values[k - 1])
+								{
+									int i = k - 1;
+									for (; (i > 0) && (values[i - 1] < f); --i) values[i] = values[i - 1];
+									values[i] = f;
+								}
+								if (++x2 == D1) x2 = 0;
+							}
+						}
+						return values[k - 1];
+					}
+					else
+					{
+						values.clear();
+						for (int i2 = 0; i2 < height; ++i2)
+						{
+							const float * const row = &boosted_overlap[(((y + i2) % D2 + D2) % D2) * D1];
+							int x2 = (x % D1 + D1) % D1;
+							for (int i1 = 0; i1 < width; ++i1)
+							{
+								values.push_back(row[x2]);
+								if (++x2 == D1) x2 = 0;
+							}
+						}
+						std::nth_element(values.begin(), values.begin() + (k - 1), values.end(), std::greater<float>());
+						return values[k - 1];
+					}
+				}
+
+				//Same result as active_columns_local_ref, but with tiled k-selection: the grid is split into tiles of
+				//radius by radius columns. The windows of all columns in a tile contain the tile core (the intersection
+				//of the windows) and are contained in the tile hull (the union of the windows). With lo the k-th largest
+				//value in the core, and hi the k-th largest value in the hull, a column with a value below lo is
+				//inhibited and a column with a value above hi is active; only the columns in between are counted.
+				template <typename P>
+				void active_columns_local(
+					const std::vector<float>& boosted_overlap, //N_COLUMNS
+					const int inhibition_radius,
+					const float density,
+					typename Layer_Fluent<P>::Active_Columns& active_columns,
+					//scratch
+					std::vector<float>& values)
+				{
+					constexpr int D1 = P::SP_N_COLUMNS_DIM1;
+					constexpr int D2 = P::SP_N_COLUMNS_DIM2;
+
+					const auto tup = local_radius<P>(inhibition_radius);
+					const int radius1 = std::get<0>(tup);
+					const int radius2 = std::get<1>(tup);
+					const int inhibition_top = local_inhibition_top((2 * radius1 + 1) * (2 * radius2 + 1), density);
+
+					active_columns.clear_all();
+					if (inhibition_top <= 0) return;
+
+					const int tile_size1 = std::max(1, radius1);
+					const int tile_size2 = std::max(1, radius2);
+
+					values.reserve(std::min(P::N_COLUMNS, (2 * radius1 + tile_size1) * (2 * radius2 + tile_size2)));
+
+					for (int y0 = 0; y0 < D2; y0 += tile_size2)
+					{
+						const int tile_height = std::min(tile_size2, D2 - y0);
+						for (int x0 = 0; x0 < D1; x0 += tile_size1)
+						{
+							const int tile_width = std::min(tile_size1, D1 - x0);
+
+							const float lo = kth_largest<P>(boosted_overlap, x0 + tile_width - 1 - radius1, y0 + tile_height - 1 - radius2, (2 * radius1) + 2 - tile_width, (2 * radius2) + 2 - tile_height, inhibition_top, values);
+							const float hi = kth_largest<P>(boosted_overlap, x0 - radius1, y0 - radius2, std::min(D1, (2 * radius1) + tile_width), std::min(D2, (2 * radius2) + tile_height), inhibition_top, values);
+
+							for (int y = y0; y < (y0 + tile_height); ++y)
+							{
+								for (int x = x0; x < (x0 + tile_width); ++x)
+								{
+									const int column_i = (y * D1) + x;
+									const float oa = boosted_overlap[column_i];
+									if (oa < lo) continue;
+									if ((oa > hi) || (count_larger<P>(boosted_overlap, x, y, radius1, radius2, oa, inhibition_top) < inhibition_top))
+									{
+										active_columns.set(column_i, true);
+									}
+								}
+							}
+						}
+					}
+
+					#if _DEBUG
+					typename Layer_Fluent<P>::Active_Columns active_columns2;
+					active_columns_local_ref<P>(boosted_overlap, inhibition_radius, density, active_columns2);
+					for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i) if (active_columns2.get(column_i) != active_columns.get(column_i))
+					{
+						log_ERROR("SP:active_columns_local: column ", column_i, " is not equal (inhibition_radius=", inhibition_radius, "; inhibition_top=", inhibition_top, ")");
+					}
+					#endif
+				}
+				#pragma endregion
+
+				#pragma region Top k selection
+				//Order preserving integer image of a float: for floats a < b, float_key(a) < float_key(b). The
+				//selection on keys is thus exact; no precision of the boosted overlap is lost.
+				inline uint32_t float_key(const uint32_t float_bits)
+				{
+					return float_bits ^ (static_cast<uint32_t>(static_cast<int32_t>(float_bits) >> 31) | 0x80000000u);
+				}
+
+				template <typename P>
+				void calc_keys_ref(
+					const std::vector<float>& boosted_overlap, //N_COLUMNS
+					//out
+					std::vector<uint32_t>& keys) //N_COLUMNS
+				{
+					const uint32_t * const float_bits = reinterpret_cast<const uint32_t *>(boosted_overlap.data());
+					for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i) keys[column_i] = float_key(float_bits[column_i]);
+				}
+
+				template <typename P>
+				void calc_keys_avx2(
+					const std::vector<float>& boosted_overlap, //N_COLUMNS
+					//out
+					std::vector<uint32_t>& keys) //N_COLUMNS
+				{
+					const __m256i sign_epi32 = _mm256_set1_epi32(0x80000000);
+					for (int column_i = 0; column_i < P::N_COLUMNS; column_i += 8)
+					{
+						const __m256i float_bits = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&boosted_overlap[column_i]));
+						const __m256i flip = _mm256_or_si256(_mm256_srai_epi32(float_bits, 31), sign_epi32);
+						_mm256_storeu_si256(reinterpret_cast<__m256i *>(&keys[column_i]), _mm256_xor_si256(float_bits, flip));
+					}
+				}
+
+				template <typename P>
+				void calc_keys_avx512(
+					const std::vector<float>& boosted_overlap, //N_COLUMNS
+					//out
+					std::vector<uint32_t>& keys) //N_COLUMNS
+				{
+					const __m512i sign_epi32 = _mm512_set1_epi32(0x80000000);
+					for (int column_i = 0; column_i < P::N_COLUMNS; column_i += 16)
+					{
+						const __m512i float_bits = _mm512_loadu_si512(&boosted_overlap[column_i]);
+						const __m512i flip = _mm512_or_si512(_mm512_srai_epi32(float_bits, 31), sign_epi32);
+						_mm512_storeu_si512(&keys[column_i], _mm512_xor_si512(float_bits, flip));
+					}
+				}
+
+				//Radix select: return the k-th largest key (1 <= k <= N_COLUMNS) and the number of columns with exactly
+				//that key that are selected. The keys are processed in three digits of 11, 11 and 10 bits; after the
+				//first digit only the candidates that share the prefix of the k-th largest key are processed.
+				template <typename P>
+				std::tuple<uint32_t, int> select_threshold(
+					const std::vector<uint32_t>& keys, //N_COLUMNS
+					const int k,
+					//scratch
+					std::vector<uint32_t>& candidates, //N_COLUMNS
+					std::vector<int>& histogram) //2048
+				{
+					constexpr int SHIFT[3] = { 21, 10, 0 };
+					constexpr int N_BINS[3] = { 1 << 11, 1 << 11, 1 << 10 };
+
+					const uint32_t * source = keys.data();
+					int n_source = P::N_COLUMNS;
+					int k_remaining = k;
+					uint32_t threshold = 0;
+					int n_equal = 0;
+
+					for (int pass = 0; pass < 3; ++pass)
+					{
+						const int shift = SHIFT[pass];
+						const int n_bins = N_BINS[pass];
+						const uint32_t digit_mask = n_bins - 1;
+
+						std::fill(histogram.begin(), histogram.begin() + n_bins, 0);
+						for (int i = 0; i < n_source; ++i) histogram[(source[i] >> shift) & digit_mask]++;
+
+						//find the digit of the k-th largest key, counting from the largest digit down
+						int digit = n_bins - 1;
+						for (; histogram[digit] < k_remaining; --digit) k_remaining -= histogram[digit];
+
+						threshold |= static_cast<uint32_t>(digit) << shift;
+						n_equal = histogram[digit];
+
+						if (pass < 2)
+						{
+							int n_candidates = 0;
+							for (int i = 0; i < n_source; ++i)
+							{
+								const uint32_t key = source[i];
+								candidates[n_candidates] = key;
+								n_candidates += (((key >> shift) & digit_mask) == static_cast<uint32_t>(digit));
+							}
+							source = candidates.data();
+							n_source = n_candidates;
+						}
+					}
+					if (false) log_INFO("SP:select_threshold: k = ", k, "; threshold = ", threshold, "; columns with threshold = ", n_equal, "; selected = ", k_remaining, ".\n");
+					return std::make_tuple(threshold, (k_remaining == n_equal) ? -1 : k_remaining);
+				}
+
+				//Select the columns with a key equal to the threshold in column order until n_equal columns are selected;
+				//ties are thus broken deterministically in favour of the lowest column.
+				template <typename P>
+				void select_equal(
+					const std::vector<uint32_t>& keys, //N_COLUMNS
+					const uint32_t threshold,
+					int n_equal,
+					//out
+					typename Layer_Fluent<P>::Active_Columns& active_columns)
+				{
+					for (int column_i = 0; (column_i < P::N_COLUMNS) && (n_equal > 0); ++column_i)
+					{
+						if (keys[column_i] == threshold)
+						{
+							active_columns.set(column_i, true);
+							n_equal--;
+						}
+					}
+				}
+
+				//Select the k columns with the largest boosted overlap; exactly k columns are selected.
+				template <typename P>
+				void active_columns_top_k_ref(
+					const std::vector<float>& boosted_overlap, //N_COLUMNS
+					const int k,
+					Layer_Fluent<P>& layer_fluent,
+					//out
+					typename Layer_Fluent<P>::Active_Columns& active_columns)
+				{
+					auto& keys = layer_fluent.sp_inhibition_key;
+					calc_keys_ref<P>(boosted_overlap, keys);
+					const auto tup = select_threshold<P>(keys, k, layer_fluent.sp_inhibition_candidates, layer_fluent.sp_inhibition_histogram);
+					const uint32_t threshold = std::get<0>(tup);
+					const int n_equal = std::get<1>(tup); // -1 means all columns with the threshold are selected
+
+					const bool all_equal = (n_equal == -1);
+					int * const data = active_columns.data();
+					for (int block_i = 0; block_i < tools::n_blocks_32(P::N_COLUMNS); ++block_i)
+					{
+						unsigned int block = 0;
+						for (int i = 0; i < 32; ++i)
+						{
+							const uint32_t key = keys[(block_i << 5) + i];
+							block |= static_cast<unsigned int>((key > threshold) || (all_equal && (key == threshold))) << i;
+						}
+						data[block_i] = static_cast<int>(block);
+					}
+					if (n_equal != -1) select_equal<P>(keys, threshold, n_equal, active_columns);
+				}
+
+				template <typename P>
+				void active_columns_top_k_avx2(
+					const std::vector<float>& boosted_overlap, //N_COLUMNS
+					const int k,
+					Layer_Fluent<P>& layer_fluent,
+					//out
+					typename Layer_Fluent<P>::Active_Columns& active_columns)
+				{
+					auto& keys = layer_fluent.sp_inhibition_key;
+					calc_keys_avx2<P>(boosted_overlap, keys);
+					const auto tup = select_threshold<P>(keys, k, layer_fluent.sp_inhibition_candidates, layer_fluent.sp_inhibition_histogram);
+					const uint32_t threshold = std::get<0>(tup);
+					const int n_equal = std::get<1>(tup); // -1 means all columns with the threshold are selected
+
+					//unsigned key > threshold is computed as signed (key ^ sign) > (threshold ^ sign)
+					const __m256i sign_epi32 = _mm256_set1_epi32(0x80000000);
+					const __m256i threshold_epi32 = _mm256_set1_epi32(static_cast<int>(threshold));
+					const __m256i threshold_signed_epi32 = _mm256_xor_si256(threshold_epi32, sign_epi32);
+					const __m256i all_equal_epi32 = _mm256_set1_epi32((n_equal == -1) ? -1 : 0);
+					int * const data = active_columns.data();
+
+					for (int block_i = 0; block_i < tools::n_blocks_32(P::N_COLUMNS); ++block_i)
+					{
+						const __m256i * const ptr = reinterpret_cast<const __m256i *>(&keys[block_i << 5]);
+						unsigned int block = 0;
+						for (int i = 0; i < 4; ++i)
+						{
+							const __m256i key_epi32 = _mm256_loadu_si256(ptr + i);
+							const __m256i larger = _mm256_cmpgt_epi32(_mm256_xor_si256(key_epi32, sign_epi32), threshold_signed_epi32);
+							const __m256i equal = _mm256_and_si256(_mm256_cmpeq_epi32(key_epi32, threshold_epi32), all_equal_epi32);
+							const int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_or_si256(larger, equal)));
+							block |= static_cast<unsigned int>(mask) << (i << 3);
+						}
+						data[block_i] = static_cast<int>(block);
+					}
+					if (n_equal != -1) select_equal<P>(keys, threshold, n_equal, active_columns);
+				}
+
+				template <typename P>
+				void active_columns_top_k_avx512(
+					const std::vector<float>& boosted_overlap, //N_COLUMNS
+					const int k,
+					Layer_Fluent<P>& layer_fluent,
+					//out
+					typename Layer_Fluent<P>::Active_Columns& active_columns)
+				{
+					auto& keys = layer_fluent.sp_inhibition_key;
+					calc_keys_avx512<P>(boosted_overlap, keys);
+					const auto tup = select_threshold<P>(keys, k, layer_fluent.sp_inhibition_candidates, layer_fluent.sp_inhibition_histogram);
+					const uint32_t threshold = std::get<0>(tup);
+					const int n_equal = std::get<1>(tup); // -1 means all columns with the threshold are selected
+
+					const __m512i threshold_epi32 = _mm512_set1_epi32(static_cast<int>(threshold));
+					int * const data = active_columns.data();
+
+					for (int block_i = 0; block_i < tools::n_blocks_32(P::N_COLUMNS); ++block_i)
+					{
+						const __m512i key_lo = _mm512_loadu_si512(&keys[block_i << 5]);
+						const __m512i key_hi = _mm512_loadu_si512(&keys[(block_i << 5) + 16]);
+						const __mmask16 mask_lo = (n_equal == -1) ? _mm512_cmpge_epu32_mask(key_lo, threshold_epi32) : _mm512_cmpgt_epu32_mask(key_lo, threshold_epi32);
+						const __mmask16 mask_hi = (n_equal == -1) ? _mm512_cmpge_epu32_mask(key_hi, threshold_epi32) : _mm512_cmpgt_epu32_mask(key_hi, threshold_epi32);
+						data[block_i] = static_cast<int>(static_cast<unsigned int>(mask_lo) | (static_cast<unsigned int>(mask_hi) << 16));
+					}
+					if (n_equal != -1) select_equal<P>(keys, threshold, n_equal, active_columns);
+				}
+
+				//Exactly k columns are selected and no unselected column has a larger boosted overlap than a selected column.
+				template <typename P>
+				void check_top_k(
+					const std::vector<float>& boosted_overlap, //N_COLUMNS
+					const int k,
+					const typename Layer_Fluent<P>::Active_Columns& active_columns,
+					const std::string& name)
+				{
+					float min_selected = std::numeric_limits<float>::max();
+					float max_unselected = std::numeric_limits<float>::lowest();
+					for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+					{
+						if (active_columns.get(column_i))
+							min_selected = std::min(min_selected, boosted_overlap[column_i]);
+						else
+							max_unselected = std::max(max_unselected, boosted_overlap[column_i]);
+					}
+					if (active_columns.count() != k) log_ERROR("SP:", name, ": selected ", active_columns.count(), " columns instead of ", k, ".\n");
+					if (max_unselected > min_selected) log_ERROR("SP:", name, ": unselected column with boosted overlap ", max_unselected, " is larger than selected column with ", min_selected, ".\n");
+				}
+
+				//Select the k columns with the largest boosted overlap; ties are broken in favour of the lowest column.
+				//Does not allocate: the scratch is in layer_fluent.
+				template <typename P>
+				void active_columns_top_k(
+					const std::vector<float>& boosted_overlap, //N_COLUMNS
+					const int k,
+					Layer_Fluent<P>& layer_fluent,
+					//out
+					typename Layer_Fluent<P>::Active_Columns& active_columns)
+				{
+					if (k <= 0)
+					{
+						active_columns.clear_all();
+						return;
+					}
+					if (k >= P::N_COLUMNS)
+					{
+						std::fill(active_columns._data.begin(), active_columns._data.end(), -1);
+						return;
+					}
+					if (architecture_switch(P::ARCH) == arch_t::X64) active_columns_top_k_ref<P>(boosted_overlap, k, layer_fluent, active_columns);
+					if (architecture_switch(P::ARCH) == arch_t::AVX2) active_columns_top_k_avx2<P>(boosted_overlap, k, layer_fluent, active_columns);
+					if (architecture_switch(P::ARCH) == arch_t::AVX512) active_columns_top_k_avx512<P>(boosted_overlap, k, layer_fluent, active_columns);
+
+					#if _DEBUG
+					check_top_k<P>(boosted_overlap, k, active_columns, "active_columns_top_k");
+					#endif
+				}
+				#pragma endregion
+
 				template <typename P>
 				void d(
 					const std::vector<float>& boosted_overlap, //N_COLUMNS
+					Layer_Fluent<P>& layer_fluent,
 					const Dynamic_Param& param,
 					typename Layer_Fluent<P>::Active_Columns& active_columns)
 				{
@@ -192,11 +664,13 @@ namespace htm
 					if (P::SP_GLOBAL_INHIBITION)
 					{
 						//active_columns_ref1<P>(boosted_overlap, inhibition_top, active_columns);
-						active_columns_ref4<P>(boosted_overlap, inhibition_top, active_columns);
+						//active_columns_ref4<P>(boosted_overlap, inhibition_top, active_columns, layer_fluent.sp_inhibition_values);
+						active_columns_top_k<P>(boosted_overlap, inhibition_top, layer_fluent, active_columns);
 					}
 					else
 					{
-						log_ERROR("SP::active_columns: not implemented yet.");
+						//active_columns_local_ref<P>(boosted_overlap, layer_fluent.sp_inhibition_radius, param.SP_LOCAL_AREA_DENSITY, active_columns);
+						active_columns_local<P>(boosted_overlap, layer_fluent.sp_inhibition_radius, param.SP_LOCAL_AREA_DENSITY, active_columns, layer_fluent.sp_inhibition_values);
 					}
 
 					#if _DEBUG
@@ -205,6 +679,42 @@ namespace htm
 				}
 			}
 
+			//Load 16 origins of proximal synapses (aligned at 16 origins) in 32-bit lanes.
+			template <typename P>
+			__m512i load_origin_epi32(const typename P::SP_Origin * origin)
+			{
+				if constexpr (P::SP_ORIGIN_NARROW)
+					return _mm512_cvtepi16_epi32(_mm256_load_si256(reinterpret_cast<const __m256i *>(origin)));
+				else
+					return _mm512_load_si512(origin);
+			}
+
+			//Load 32 origins of proximal synapses (aligned at 32 origins) in 16-bit lanes; wide origins are truncated.
+			template <typename P>
+			__m512i load_origin_epi16(const typename P::SP_Origin * origin)
+			{
+				if constexpr (P::SP_ORIGIN_NARROW)
+				{
+					return _mm512_load_si512(origin);
+				}
+				else
+				{
+					const __m512i origin_epu16_A = _mm512_castsi256_si512(_mm512_cvtepi32_epi16(_mm512_load_si512(origin)));
+					const __m512i origin_epu16_B = _mm512_castsi256_si512(_mm512_cvtepi32_epi16(_mm512_load_si512(origin + 16)));
+					return _mm512_shuffle_i64x2(origin_epu16_A, origin_epu16_B, 0b01000100);
+				}
+			}
+
+			//AVX2 variant of load_origin_epi32: load 8 origins (aligned at 8 origins).
+			template <typename P>
+			__m256i load_origin_avx2_epi32(const typename P::SP_Origin * origin)
+			{
+				if constexpr (P::SP_ORIGIN_NARROW)
+					return _mm256_cvtepi16_epi32(_mm_load_si128(reinterpret_cast<const __m128i *>(origin)));
+				else
+					return _mm256_load_si256(reinterpret_cast<const __m256i *>(origin));
+			}
+
 			namespace calc_overlap
 			{
 				namespace synapse_backward
@@ -325,7 +835,7 @@ namespace htm
 						for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
 						{
 							auto permanence_epi8_ptr = reinterpret_cast<const __m512i *>(layer.sp_pd_synapse_permanence_sf[column_i].data());
-							auto origin_epi32_ptr = reinterpret_cast<const __m512i *>(layer.sp_pd_synapse_origin_sensor_sf[column_i].data());
+							const typename P::SP_Origin * origin_ptr = layer.sp_pd_synapse_origin_sensor_sf[column_i].data();
 
 							__m512i overlap_epi32 = _mm512_setzero_epi32();
 
@@ -337,25 +847,25 @@ namespace htm
 								{
 									const int i = 0;
 									const __mmask16 mask_16 = _mm_cmpgt_epi8_mask(_mm512_extracti64x2_epi64(permanence_epi8, i), connected_threshold_epi8);
-									const __m512i origin_epi32 = _mm512_load_si512(&origin_epi32_ptr[(block * 4) + i]);
+									const __m512i origin_epi32 = load_origin_epi32<P>(&origin_ptr[(block * 64) + (i * 16)]);
 									overlap_epi32 = _mm512_add_epi32(overlap_epi32, get_sensors_epi32(mask_16, origin_epi32, active_sensors_ptr));
 								}
 								{
 									const int i = 1;
 									const __mmask16 mask_16 = _mm_cmpgt_epi8_mask(_mm512_extracti64x2_epi64(permanence_epi8, i), connected_threshold_epi8);
-									const __m512i origin_epi32 = _mm512_load_si512(&origin_epi32_ptr[(block * 4) + i]);
+									const __m512i origin_epi32 = load_origin_epi32<P>(&origin_ptr[(block * 64) + (i * 16)]);
 									overlap_epi32 = _mm512_add_epi32(overlap_epi32, get_sensors_epi32(mask_16, origin_epi32, active_sensors_ptr));
 								}
 								{
 									const int i = 2;
 									const __mmask16 mask_16 = _mm_cmpgt_epi8_mask(_mm512_extracti64x2_epi64(permanence_epi8, i), connected_threshold_epi8);
-									const __m512i origin_epi32 = _mm512_load_si512(&origin_epi32_ptr[(block * 4) + i]);
+									const __m512i origin_epi32 = load_origin_epi32<P>(&origin_ptr[(block * 64) + (i * 16)]);
 									overlap_epi32 = _mm512_add_epi32(overlap_epi32, get_sensors_epi32(mask_16, origin_epi32, active_sensors_ptr));
 								}
 								{
 									const int i = 3;
 									const __mmask16 mask_16 = _mm_cmpgt_epi8_mask(_mm512_extracti64x2_epi64(permanence_epi8, i), connected_threshold_epi8);
-									const __m512i origin_epi32 = _mm512_load_si512(&origin_epi32_ptr[(block * 4) + i]);
+									const __m512i origin_epi32 = load_origin_epi32<P>(&origin_ptr[(block * 64) + (i * 16)]);
 									overlap_epi32 = _mm512_add_epi32(overlap_epi32, get_sensors_epi32(mask_16, origin_epi32, active_sensors_ptr));
 								}
 							}
@@ -374,6 +884,64 @@ namespace htm
 						}
 						#endif
 					}
+
+					__m256i get_sensors_avx2_epi32(
+						const __m256i mask_epi32,
+						const __m256i origin_epi32,
+						const void * active_sensors_ptr)
+					{
+						const __m256i int_addr = _mm256_srli_epi32(origin_epi32, 5);
+						const __m256i pos_in_int = _mm256_and_si256(origin_epi32, _mm256_set1_epi32(0b11111));
+						const __m256i sensor_int = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int *>(active_sensors_ptr), int_addr, mask_epi32, 4);
+						const __m256i sensors = _mm256_srlv_epi32(sensor_int, pos_in_int);
+						return _mm256_and_si256(sensors, _mm256_set1_epi32(1));
+					}
+
+					template <typename P>
+					void calc_overlap_sf_avx2(
+						const Layer_Persisted<P>& layer,
+						const Dynamic_Param& param,
+						const typename Layer_Fluent<P>::Active_Sensors& active_sensors,
+						//out 
+						std::vector<int>& overlaps) //size = P::N_COLUMNS
+					{
+						const __m256i connected_threshold_epi8 = _mm256_set1_epi8(P::SP_PD_PERMANENCE_THRESHOLD);
+						auto active_sensors_ptr = active_sensors.data();
+						const int n_blocks = htm::tools::n_blocks_32(P::SP_N_PD_SYNAPSES);
+
+						for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+						{
+							auto permanence_epi8_ptr = reinterpret_cast<const __m256i *>(layer.sp_pd_synapse_permanence_sf[column_i].data());
+							const typename P::SP_Origin * origin_ptr = layer.sp_pd_synapse_origin_sensor_sf[column_i].data();
+
+							__m256i overlap_epi32 = _mm256_setzero_si256();
+
+							for (int block = 0; block < n_blocks; ++block)
+							{
+								const __m256i permanence_epi8 = _mm256_load_si256(&permanence_epi8_ptr[block]); //load 32 permanence values
+								const __m256i connected_epi8 = _mm256_cmpgt_epi8(permanence_epi8, connected_threshold_epi8);
+								if (_mm256_testz_si256(connected_epi8, connected_epi8)) continue;
+
+								overlap_epi32 = _mm256_add_epi32(overlap_epi32, get_sensors_avx2_epi32(htm::tools::expand_mask_epi8_epi32<0>(connected_epi8), load_origin_avx2_epi32<P>(&origin_ptr[(block * 32) + 0]), active_sensors_ptr));
+								overlap_epi32 = _mm256_add_epi32(overlap_epi32, get_sensors_avx2_epi32(htm::tools::expand_mask_epi8_epi32<1>(connected_epi8), load_origin_avx2_epi32<P>(&origin_ptr[(block * 32) + 8]), active_sensors_ptr));
+								overlap_epi32 = _mm256_add_epi32(overlap_epi32, get_sensors_avx2_epi32(htm::tools::expand_mask_epi8_epi32<2>(connected_epi8), load_origin_avx2_epi32<P>(&origin_ptr[(block * 32) + 16]), active_sensors_ptr));
+								overlap_epi32 = _mm256_add_epi32(overlap_epi32, get_sensors_avx2_epi32(htm::tools::expand_mask_epi8_epi32<3>(connected_epi8), load_origin_avx2_epi32<P>(&origin_ptr[(block * 32) + 24]), active_sensors_ptr));
+							}
+							const int overlap_int = htm::tools::reduce_add_epi32(overlap_epi32);
+							if (false) log_INFO_DEBUG("SP:calc_overlap_avx2: column ", column_i, " has overlap = ", overlap_int, ".\n");
+							overlaps[column_i] = (overlap_int < P::SP_STIMULUS_THRESHOLD) ? 0 : overlap_int;
+						}
+						#if _DEBUG
+						std::vector<int> overlaps_ref = std::vector<int>(P::N_COLUMNS);
+						calc_overlap_sf_ref(layer, param, active_sensors, overlaps_ref);
+						for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+						{
+							const int overlap_ref = overlaps_ref[column_i];
+							const int overlap_avx2 = overlaps[column_i];
+							if (overlap_ref != overlap_avx2) log_ERROR("SP:calc_overlap_avx2:: UNEQUAL: column ", column_i, "; overlap ref ", overlap_ref, " != avx2 ", overlap_avx2, ".\n");
+						}
+						#endif
+					}
 					
 					// P::N_SENSORS < 512
 					template <typename P>
@@ -387,7 +955,7 @@ namespace htm
 						assert_msg(P::N_SENSORS < 512, "ERROR: calc_overlap_avx512_small: N_SENSORS is larger than 512");
 
 						const __m128i connected_threshold_epi8 = _mm_set1_epi8(P::SP_PD_PERMANENCE_THRESHOLD);
-						std::array<int, 16> t = { 0 };
+						alignas(64) std::array<int, 16> t = { 0 }; // aligned for _mm512_load_epi32
 						for (int i = 0; i < active_sensors.N_BLOCKS; ++i)
 						{
 							t[i] = active_sensors._data[i];
@@ -398,7 +966,7 @@ namespace htm
 						for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
 						{
 							auto permanence_epi8_ptr = reinterpret_cast<const __m512i *>(layer.sp_pd_synapse_permanence_sf[column_i].data());
-							auto origin_epi32_ptr = reinterpret_cast<const __m512i *>(layer.sp_pd_synapse_origin_sensor_sf[column_i].data());
+							const typename P::SP_Origin * origin_ptr = layer.sp_pd_synapse_origin_sensor_sf[column_i].data();
 
 							__m512i overlap_epi32 = _mm512_setzero_epi32();
 
@@ -410,25 +978,25 @@ namespace htm
 								{
 									const int i = 0;
 									const __mmask16 connected_mask_16_i = _mm_cmpgt_epi8_mask(_mm512_extracti64x2_epi64(permanence_epi8, i), connected_threshold_epi8);
-									const __m512i origin_epi32_i = _mm512_load_si512(&origin_epi32_ptr[(block * 4) + i]);
+									const __m512i origin_epi32_i = load_origin_epi32<P>(&origin_ptr[(block * 64) + (i * 16)]);
 									overlap_epi32 = _mm512_add_epi32(overlap_epi32, get_sensors_epi32(connected_mask_16_i, origin_epi32_i, active_sensors_epi32));
 								}
 								{
 									const int i = 1;
 									const __mmask16 connected_mask_16_i = _mm_cmpgt_epi8_mask(_mm512_extracti64x2_epi64(permanence_epi8, i), connected_threshold_epi8);
-									const __m512i origin_epi32_i = _mm512_load_si512(&origin_epi32_ptr[(block * 4) + i]);
+									const __m512i origin_epi32_i = load_origin_epi32<P>(&origin_ptr[(block * 64) + (i * 16)]);
 									overlap_epi32 = _mm512_add_epi32(overlap_epi32, get_sensors_epi32(connected_mask_16_i, origin_epi32_i, active_sensors_epi32));
 								}
 								{
 									const int i = 2;
 									const __mmask16 connected_mask_16_i = _mm_cmpgt_epi8_mask(_mm512_extracti64x2_epi64(permanence_epi8, i), connected_threshold_epi8);
-									const __m512i origin_epi32_i = _mm512_load_si512(&origin_epi32_ptr[(block * 4) + i]);
+									const __m512i origin_epi32_i = load_origin_epi32<P>(&origin_ptr[(block * 64) + (i * 16)]);
 									overlap_epi32 = _mm512_add_epi32(overlap_epi32, get_sensors_epi32(connected_mask_16_i, origin_epi32_i, active_sensors_epi32));
 								}
 								{
 									const int i = 3;
 									const __mmask16 connected_mask_16_i = _mm_cmpgt_epi8_mask(_mm512_extracti64x2_epi64(permanence_epi8, i), connected_threshold_epi8);
-									const __m512i origin_epi32_i = _mm512_load_si512(&origin_epi32_ptr[(block * 4) + i]);
+									const __m512i origin_epi32_i = load_origin_epi32<P>(&origin_ptr[(block * 64) + (i * 16)]);
 									overlap_epi32 = _mm512_add_epi32(overlap_epi32, get_sensors_epi32(connected_mask_16_i, origin_epi32_i, active_sensors_epi32));
 								}
 							}
@@ -461,7 +1029,7 @@ namespace htm
 
 						const __m256i connected_threshold_epi8 = _mm256_set1_epi8(P::SP_PD_PERMANENCE_THRESHOLD);
 
-						std::array<int, 16> t = { 0 };
+						alignas(64) std::array<int, 16> t = { 0 }; // aligned for _mm512_load_epi32
 						for (int i = 0; i < active_sensors.N_BLOCKS; ++i)
 						{
 							t[i] = active_sensors._data[i];
@@ -472,7 +1040,7 @@ namespace htm
 						for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
 						{
 							auto permanence_epi8_ptr = reinterpret_cast<const __m512i *>(layer.sp_pd_synapse_permanence_sf[column_i].data());
-							auto origin_epi32_ptr = reinterpret_cast<const __m512i *>(layer.sp_pd_synapse_origin_sensor_sf[column_i].data());
+							const typename P::SP_Origin * origin_ptr = layer.sp_pd_synapse_origin_sensor_sf[column_i].data();
 
 							__m512i overlap_epu16_AB = _mm512_setzero_si512(); // contains 32 overlap values of 16bits
 							__m512i overlap_epu16_CD = _mm512_setzero_si512(); // contains 32 overlap values of 16bits
@@ -483,19 +1051,11 @@ namespace htm
 								const __m512i permanence_epi8 = _mm512_load_si512(&permanence_epi8_ptr[block]); //load 64 permanence values
 								
 								const __mmask32 mask_32_A = _mm256_cmpgt_epi8_mask(_mm512_extracti64x4_epi64(permanence_epi8, 0), connected_threshold_epi8);
-								const __m512i origin_epi32_A = _mm512_load_si512(&origin_epi32_ptr[(block * 4) + 0]);
-								const __m512i origin_epi32_B = _mm512_load_si512(&origin_epi32_ptr[(block * 4) + 1]);
-								const __m512i origin_epu16_A = _mm512_castsi256_si512(_mm512_cvtepi32_epi16(origin_epi32_A));
-								const __m512i origin_epu16_B = _mm512_castsi256_si512(_mm512_cvtepi32_epi16(origin_epi32_B));
-								const __m512i origin_epu16_AB = _mm512_shuffle_i64x2(origin_epu16_A, origin_epu16_B, 0b01000100);
+								const __m512i origin_epu16_AB = load_origin_epi16<P>(&origin_ptr[(block * 64) + 0]);
 								overlap_epu16_AB = _mm512_adds_epu16(overlap_epu16_AB, get_sensors_epi16(mask_32_A, origin_epu16_AB, active_sensors_epi32));
 
 								const __mmask32 mask_32_B = _mm256_cmpgt_epi8_mask(_mm512_extracti64x4_epi64(permanence_epi8, 1), connected_threshold_epi8);
-								const __m512i origin_epi32_C = _mm512_load_si512(&origin_epi32_ptr[(block * 4) + 2]);
-								const __m512i origin_epi32_D = _mm512_load_si512(&origin_epi32_ptr[(block * 4) + 3]);
-								const __m512i origin_epu16_C = _mm512_castsi256_si512(_mm512_cvtepi32_epi16(origin_epi32_C));
-								const __m512i origin_epu16_D = _mm512_castsi256_si512(_mm512_cvtepi32_epi16(origin_epi32_D));
-								const __m512i origin_epu16_CD = _mm512_shuffle_i64x2(origin_epu16_C, origin_epu16_D, 0b01000100);
+								const __m512i origin_epu16_CD = load_origin_epi16<P>(&origin_ptr[(block * 64) + 32]);
 								overlap_epu16_CD = _mm512_adds_epu16(overlap_epu16_CD, get_sensors_epi16(mask_32_B, origin_epu16_CD, active_sensors_epi32));
 							}
 							const __m512i overlap_epu16 = _mm512_adds_epu16(overlap_epu16_AB, overlap_epu16_CD);
@@ -518,6 +1078,135 @@ namespace htm
 					}
 				}
 
+				//Incremental overlap: the overlap of the previous time step is updated with the sensors that turned on or off,
+				//which costs the number of changed sensors times their connected fan-out instead of the number of columns times
+				//synapses. Learning only changes the synapses of the active columns; the synapses whose connectivity flipped
+				//update the inverse index and the overlap.
+				namespace incremental
+				{
+					//Build the inverse index of the connected synapses and invalidate the overlap.
+					template <typename P>
+					void init(
+						Layer_Fluent<P>& layer_fluent,
+						Layer_Persisted<P>& layer)
+					{
+						for (auto& columns : layer.sp_pd_connected_index_sf) columns.clear();
+						for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+						{
+							const auto& permanence = layer.sp_pd_synapse_permanence_sf[column_i];
+							const auto& synapse_origin = layer.sp_pd_synapse_origin_sensor_sf[column_i];
+							auto& connected = layer.sp_pd_connected_sf[column_i];
+
+							connected.clear_all();
+							for (auto synapse_i = 0; synapse_i < P::SP_N_PD_SYNAPSES; ++synapse_i)
+							{
+								if (permanence[synapse_i] > P::SP_PD_PERMANENCE_THRESHOLD)
+								{
+									connected.set(synapse_i, true);
+									layer.sp_pd_connected_index_sf[synapse_origin[synapse_i]].push_back(column_i);
+								}
+							}
+						}
+						layer_fluent.sp_overlap_valid_incremental = false;
+					}
+
+					//Apply the connectivity changes of the synapses of the active columns (that have just learned) to the
+					//inverse index and to the overlap.
+					template <typename P>
+					void update_connectivity(
+						Layer_Fluent<P>& layer_fluent,
+						Layer_Persisted<P>& layer,
+						const typename Layer_Fluent<P>::Active_Columns& active_columns)
+					{
+						const auto& active_sensors_prev = layer_fluent.sp_active_sensors_incremental;
+
+						for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+						{
+							if (active_columns.get(column_i))
+							{
+								const auto& permanence = layer.sp_pd_synapse_permanence_sf[column_i];
+								const auto& synapse_origin = layer.sp_pd_synapse_origin_sensor_sf[column_i];
+								auto& connected = layer.sp_pd_connected_sf[column_i];
+
+								for (auto synapse_i = 0; synapse_i < P::SP_N_PD_SYNAPSES; ++synapse_i)
+								{
+									const bool is_connected = permanence[synapse_i] > P::SP_PD_PERMANENCE_THRESHOLD;
+									if (is_connected == connected.get(synapse_i)) continue;
+
+									connected.set(synapse_i, is_connected);
+									const int sensor_i = synapse_origin[synapse_i];
+									auto& columns = layer.sp_pd_connected_index_sf[sensor_i];
+									if (is_connected)
+									{
+										columns.push_back(column_i);
+									}
+									else
+									{
+										const auto it = std::find(columns.begin(), columns.end(), column_i);
+										assert_msg(it != columns.end(), "SP:update_connectivity: column ", column_i, "; synapse ", synapse_i, " is not in the connected index of sensor ", sensor_i);
+										if (it != columns.end())
+										{
+											*it = columns.back();
+											columns.pop_back();
+										}
+									}
+									if (active_sensors_prev.get(sensor_i)) layer_fluent.sp_overlap_incremental[column_i] += (is_connected) ? 1 : -1;
+								}
+							}
+						}
+					}
+
+					template <typename P>
+					void calc_overlap_incremental(
+						Layer_Fluent<P>& layer_fluent,
+						const Layer_Persisted<P>& layer,
+						const Dynamic_Param& param,
+						const typename Layer_Fluent<P>::Active_Sensors& active_sensors,
+						//out
+						std::vector<int>& overlaps) //size = P::N_COLUMNS
+					{
+						auto& overlap_incremental = layer_fluent.sp_overlap_incremental;
+						auto& active_sensors_prev = layer_fluent.sp_active_sensors_incremental;
+
+						if (!layer_fluent.sp_overlap_valid_incremental)
+						{
+							std::fill(overlap_incremental.begin(), overlap_incremental.end(), 0);
+							active_sensors_prev.clear_all();
+							layer_fluent.sp_overlap_valid_incremental = true;
+						}
+
+						// apply the sensors that changed since the previous time step
+						for (auto block = 0; block < htm::tools::n_blocks_32(P::N_SENSORS); ++block)
+						{
+							unsigned int changed = static_cast<unsigned int>(active_sensors._data[block] ^ active_sensors_prev._data[block]);
+							while (changed != 0)
+							{
+								const int sensor_i = (block << 5) + static_cast<int>(_tzcnt_u32(changed));
+								changed &= changed - 1;
+
+								const int delta = (active_sensors.get(sensor_i)) ? 1 : -1;
+								for (const int column_i : layer.sp_pd_connected_index_sf[sensor_i]) overlap_incremental[column_i] += delta;
+							}
+						}
+						active_sensors_prev._data = active_sensors._data;
+
+						for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+						{
+							const int overlap = overlap_incremental[column_i];
+							overlaps[column_i] = (overlap < P::SP_STIMULUS_THRESHOLD) ? 0 : overlap;
+						}
+
+						#if _DEBUG
+						std::vector<int> overlaps_ref = std::vector<int>(P::N_COLUMNS);
+						synapse_forward::calc_overlap_sf_ref(layer, param, active_sensors, overlaps_ref);
+						for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+						{
+							if (overlaps_ref[column_i] != overlaps[column_i]) log_ERROR("SP:calc_overlap_incremental:: UNEQUAL: column ", column_i, "; overlap ref ", overlaps_ref[column_i], " != incremental ", overlaps[column_i], ".\n");
+						}
+						#endif
+					}
+				}
+
 				template <typename P>
 				void d(
 					const Layer_Persisted<P>& layer,
@@ -529,6 +1218,7 @@ namespace htm
 					if (P::SP_SYNAPSE_FORWARD)
 					{
 						if (architecture_switch(P::ARCH) == arch_t::X64) synapse_forward::calc_overlap_sf_ref(layer, param, active_sensors, overlaps);
+						if (architecture_switch(P::ARCH) == arch_t::AVX2) synapse_forward::calc_overlap_sf_avx2(layer, param, active_sensors, overlaps);
 						if (architecture_switch(P::ARCH) == arch_t::AVX512)
 						{
 							if constexpr (P::N_SENSORS < 512)
@@ -547,6 +1237,7 @@ namespace htm
 					else
 					{
 						if (architecture_switch(P::ARCH) == arch_t::X64) synapse_backward::calc_overlap_sb_ref(layer, param, active_sensors, overlaps);
+						if (architecture_switch(P::ARCH) == arch_t::AVX2) synapse_backward::calc_overlap_sb_ref(layer, param, active_sensors, overlaps);
 						if (architecture_switch(P::ARCH) == arch_t::AVX512) synapse_backward::calc_overlap_sb_ref(layer, param, active_sensors, overlaps);
 					}
 				}
@@ -701,6 +1392,64 @@ namespace htm
 							}
 						}
 					}
+
+					template <typename P>
+					void update_synapses_sf_avx2(
+						Layer_Persisted<P>& layer,
+						const Dynamic_Param& param,
+						const typename Layer_Fluent<P>::Active_Columns& active_columns,
+						const typename Layer_Fluent<P>::Active_Sensors& active_sensors)
+					{
+						#if _DEBUG
+						const auto permanence_org = layer.sp_pd_synapse_permanence_sf;
+						#endif
+
+						const __m256i inc_epi8 = _mm256_set1_epi8(param.SP_PD_PERMANENCE_INC);
+						const __m256i dec_epi8 = _mm256_set1_epi8(param.SP_PD_PERMANENCE_DEC);
+						const __m256i all_epi32 = _mm256_set1_epi32(-1);
+						const __m256i zero_epi32 = _mm256_setzero_si256();
+						auto active_sensors_ptr = active_sensors.data();
+						const int n_blocks = htm::tools::n_blocks_32(P::SP_N_PD_SYNAPSES);
+
+						for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+						{
+							if (active_columns.get(column_i))
+							{
+								auto permanence_epi8_ptr = reinterpret_cast<__m256i *>(layer.sp_pd_synapse_permanence_sf[column_i].data());
+								const typename P::SP_Origin * origin_ptr = layer.sp_pd_synapse_origin_sensor_sf[column_i].data();
+
+								for (int block = 0; block < n_blocks; ++block)
+								{
+									const __m256i active_0 = _mm256_cmpgt_epi32(calc_overlap::synapse_forward::get_sensors_avx2_epi32(all_epi32, load_origin_avx2_epi32<P>(&origin_ptr[(block * 32) + 0]), active_sensors_ptr), zero_epi32);
+									const __m256i active_1 = _mm256_cmpgt_epi32(calc_overlap::synapse_forward::get_sensors_avx2_epi32(all_epi32, load_origin_avx2_epi32<P>(&origin_ptr[(block * 32) + 8]), active_sensors_ptr), zero_epi32);
+									const __m256i active_2 = _mm256_cmpgt_epi32(calc_overlap::synapse_forward::get_sensors_avx2_epi32(all_epi32, load_origin_avx2_epi32<P>(&origin_ptr[(block * 32) + 16]), active_sensors_ptr), zero_epi32);
+									const __m256i active_3 = _mm256_cmpgt_epi32(calc_overlap::synapse_forward::get_sensors_avx2_epi32(all_epi32, load_origin_avx2_epi32<P>(&origin_ptr[(block * 32) + 24]), active_sensors_ptr), zero_epi32);
+									const __m256i active_epi8 = htm::tools::pack_mask_epi32_epi8(active_0, active_1, active_2, active_3);
+
+									const __m256i old_permanence_epi8 = _mm256_load_si256(&permanence_epi8_ptr[block]);
+									const __m256i new_permanence_epi8 = _mm256_blendv_epi8(
+										_mm256_subs_epi8(old_permanence_epi8, dec_epi8),
+										_mm256_adds_epi8(old_permanence_epi8, inc_epi8),
+										active_epi8);
+									_mm256_store_si256(&permanence_epi8_ptr[block], new_permanence_epi8);
+								}
+							}
+						}
+						#if _DEBUG
+						auto permanence_avx2 = layer.sp_pd_synapse_permanence_sf;
+						layer.sp_pd_synapse_permanence_sf = permanence_org;
+						update_synapses_sf_ref(layer, param, active_columns, active_sensors);
+						for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+						{
+							for (auto synapse_i = 0; synapse_i < P::SP_N_PD_SYNAPSES; ++synapse_i)
+							{
+								const int permanence_ref = layer.sp_pd_synapse_permanence_sf[column_i][synapse_i];
+								const int permanence_new = permanence_avx2[column_i][synapse_i];
+								if (permanence_ref != permanence_new) log_ERROR("SP:update_synapses_sf_avx2:: UNEQUAL: column ", column_i, "; synapse ", synapse_i, "; permanence ref ", permanence_ref, " != avx2 ", permanence_new, ".\n");
+							}
+						}
+						#endif
+					}
 				}
 
 				template <typename P>
@@ -713,11 +1462,13 @@ namespace htm
 					if (P::SP_SYNAPSE_FORWARD)
 					{
 						if (architecture_switch(P::ARCH) == arch_t::X64) synapse_forward::update_synapses_sf_ref(layer, param, active_columns, active_sensors);
+						if (architecture_switch(P::ARCH) == arch_t::AVX2) synapse_forward::update_synapses_sf_avx2(layer, param, active_columns, active_sensors);
 						if (architecture_switch(P::ARCH) == arch_t::AVX512) synapse_forward::update_synapses_sf_ref(layer, param, active_columns, active_sensors);
 					}
 					else
 					{
 						if (architecture_switch(P::ARCH) == arch_t::X64) synapse_backward::update_synapses_sb_ref(layer, param, active_columns, active_sensors);
+						if (architecture_switch(P::ARCH) == arch_t::AVX2) synapse_backward::update_synapses_sb_ref(layer, param, active_columns, active_sensors);
 						if (architecture_switch(P::ARCH) == arch_t::AVX512) synapse_backward::update_synapses_sb_ref(layer, param, active_columns, active_sensors);
 					}
 				}
@@ -755,6 +1506,7 @@ namespace htm
 				Layer_Persisted<P>& layer,
 				const int column_i,
 				const Dynamic_Param& param,
+				const int inhibition_radius,
 				const float active_duty_cycle)
 			{
 				/*
@@ -772,6 +1524,11 @@ namespace htm
 				}
 				else
 				{
+					const auto tup = inhibit_columns::local_radius<P>(inhibition_radius);
+					const int inhibition_area = ((2 * std::get<0>(tup)) + 1) * ((2 * std::get<1>(tup)) + 1);
+					const int inhibition_top = inhibit_columns::local_inhibition_top(inhibition_area, param.SP_LOCAL_AREA_DENSITY);
+					const float target_desity = std::min(0.5f, static_cast<float>(inhibition_top) / inhibition_area);
+					layer.boost_factor[column_i] = exp((target_desity - active_duty_cycle) * P::SP_BOOST_STRENGTH);
 					/*
 						UInt inhibitionArea = pow((Real) (2 * inhibitionRadius_ + 1), (Real) columnDimensions_.size());
 						inhibitionArea = min(inhibitionArea, numColumns_);
@@ -814,17 +1571,84 @@ namespace htm
 				}
 			}
 
+			//Update the inhibition radius as Nupic does: the average span (in visible sensors) of the connected synapses
+			//of the columns, times the average number of columns per visible sensor.
 			template <typename P>
 			void update_inhibition_radius(
-				const Layer_Fluent<P>& layer)
+				Layer_Fluent<P>& layer_fluent,
+				const Layer_Persisted<P>& layer,
+				const Dynamic_Param& param)
 			{
 				if (P::SP_GLOBAL_INHIBITION)
 				{
-					//TODO
+					layer_fluent.sp_inhibition_radius = std::max(P::SP_N_COLUMNS_DIM1, P::SP_N_COLUMNS_DIM2);
 				}
 				else
 				{
-					//TODO
+					const int sensor_dim1 = std::max(1, param.n_visible_sensors_dim1);
+					const int sensor_dim2 = std::max(1, param.n_visible_sensors_dim2);
+
+					//bounding box of the connected visible sensors of every column
+					auto& min_x = layer_fluent.sp_span_min_x;
+					auto& min_y = layer_fluent.sp_span_min_y;
+					auto& max_x = layer_fluent.sp_span_max_x;
+					auto& max_y = layer_fluent.sp_span_max_y;
+					std::fill(min_x.begin(), min_x.end(), std::numeric_limits<int>::max());
+					std::fill(min_y.begin(), min_y.end(), std::numeric_limits<int>::max());
+					std::fill(max_x.begin(), max_x.end(), -1);
+					std::fill(max_y.begin(), max_y.end(), -1);
+
+					auto add_sensor = [&](const int column_i, const int sensor_i)
+					{
+						if (sensor_i < P::N_VISIBLE_SENSORS)
+						{
+							const int x = sensor_i % sensor_dim1;
+							const int y = sensor_i / sensor_dim1;
+							min_x[column_i] = std::min(min_x[column_i], x);
+							max_x[column_i] = std::max(max_x[column_i], x);
+							min_y[column_i] = std::min(min_y[column_i], y);
+							max_y[column_i] = std::max(max_y[column_i], y);
+						}
+					};
+
+					if (P::SP_SYNAPSE_FORWARD)
+					{
+						for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+						{
+							const auto& origin = layer.sp_pd_synapse_origin_sensor_sf[column_i];
+							const auto& permanence = layer.sp_pd_synapse_permanence_sf[column_i];
+							for (auto synapse_i = 0; synapse_i < P::SP_N_PD_SYNAPSES; ++synapse_i)
+							{
+								if (permanence[synapse_i] > P::SP_PD_PERMANENCE_THRESHOLD) add_sensor(column_i, origin[synapse_i]);
+							}
+						}
+					}
+					else
+					{
+						for (auto sensor_i = 0; sensor_i < P::N_VISIBLE_SENSORS; ++sensor_i)
+						{
+							const auto& destination = layer.sp_pd_destination_column_sb[sensor_i];
+							const auto& permanence = layer.sp_pd_synapse_permanence_sb[sensor_i];
+							for (auto synapse_i = 0; synapse_i < layer.sp_pd_synapse_count_sb[sensor_i]; ++synapse_i)
+							{
+								if (permanence[synapse_i] > P::SP_PD_PERMANENCE_THRESHOLD) add_sensor(destination[synapse_i], sensor_i);
+							}
+						}
+					}
+
+					//columns without connected synapses have span zero
+					float span_sum = 0;
+					for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+					{
+						if (max_x[column_i] >= 0) span_sum += 0.5f * ((max_x[column_i] - min_x[column_i] + 1) + (max_y[column_i] - min_y[column_i] + 1));
+					}
+					const float avg_connected_span = span_sum / P::N_COLUMNS;
+					const float avg_columns_per_sensor = 0.5f * ((static_cast<float>(P::SP_N_COLUMNS_DIM1) / sensor_dim1) + (static_cast<float>(P::SP_N_COLUMNS_DIM2) / sensor_dim2));
+					const float diameter = avg_connected_span * avg_columns_per_sensor;
+					const float radius = std::max(1.0f, (diameter - 1) / 2);
+
+					layer_fluent.sp_inhibition_radius = static_cast<int>(std::round(radius));
+					if (false) log_INFO("SP:update_inhibition_radius: avg_connected_span = ", avg_connected_span, "; inhibition_radius = ", layer_fluent.sp_inhibition_radius, ".\n");
 				}
 			}
 
@@ -864,33 +1688,34 @@ namespace htm
 			}
 		}
 
+		//Select the active columns given the overlap in layer_fluent.sp_overlap: boost, inhibit and, when LEARN, update
+		//the synapses and duty cycles. The overlap is computed by compute_sp, or by a caller that computes the overlap
+		//of a batch of streams in one pass (see inference.ipp).
 		template <bool LEARN, typename P>
-		void compute_sp(
+		void compute_sp_columns(
 			const typename Layer_Fluent<P>::Active_Sensors& active_sensors,
-			Layer_Fluent<P>& layer_fluent, 
+			Layer_Fluent<P>& layer_fluent,
 			Layer_Persisted_C<LEARN, P>& layer,
 			const Dynamic_Param& param,
 			//out
 			typename Layer_Fluent<P>::Active_Columns& active_columns)
 		{
-			//local variables
-			auto overlap_local = std::vector<int>(P::N_COLUMNS);
-			auto boosted_overlap_local = std::vector<float>(P::N_COLUMNS);
-
-			layer_fluent.iteration_num++;
-			if (LEARN) layer_fluent.iteration_learn_num++;
-
-			priv::calc_overlap::d(layer, param, active_sensors, overlap_local);
+			//local variables; scratch in layer_fluent
+			const auto& overlap_local = layer_fluent.sp_overlap;
+			auto& boosted_overlap_local = layer_fluent.sp_boosted_overlap;
 
-			// update the boost factors
-			//#pragma ivdep // ignore write after write dependency in rand_float
-			for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
 			{
-				const int overlap = overlap_local[column_i];
+				::tools::profiler::Scope scope_boost("sp.boost");
+				// update the boost factors
+				//#pragma ivdep // ignore write after write dependency in rand_float
+				for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+				{
+					const int overlap = overlap_local[column_i];
 
-				//add a small random number seems to improve learning speed
-				const float r = random::rand_float(0.1f, layer_fluent.random_number[column_i]);
-				boosted_overlap_local[column_i] = ((LEARN) ? (overlap * layer.boost_factor[column_i]) : overlap) + r;
+					//add a small random number seems to improve learning speed
+					const float r = random::rand_float(0.1f, layer_fluent.random_number[column_i]);
+					boosted_overlap_local[column_i] = ((LEARN) ? (overlap * layer.boost_factor[column_i]) : overlap) + r;
+				}
 			}
 
 			#if _DEBUG
@@ -898,25 +1723,34 @@ namespace htm
 			if (false) log_INFO("SP:compute_sp: boosted_overlap:", print::print_float_array(boosted_overlap_local, P::N_COLUMNS));
 			#endif
 
-			priv::inhibit_columns::d<P>(boosted_overlap_local, param, active_columns);
+			{
+				::tools::profiler::Scope scope_inhibition("sp.inhibition");
+				priv::inhibit_columns::d<P>(boosted_overlap_local, layer_fluent, param, active_columns);
+			}
+			if constexpr (::tools::profiler::ON) ::tools::profiler::count("sp.active_columns", active_columns.count());
 
-			if (LEARN)
+			if constexpr (LEARN)
 			{
+				::tools::profiler::Scope scope_learning("sp.learning");
 				priv::update_synapses::d(layer, param, active_columns, active_sensors);
+				if constexpr (P::SP_OVERLAP_INCREMENTAL) priv::calc_overlap::incremental::update_connectivity(layer_fluent, layer, active_columns);
 
 				if (true)
 				{
 					for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
 					{
 						priv::update_duty_cycles(layer_fluent, column_i, overlap_local[column_i], active_columns.get(column_i));
-						priv::update_boost_factors(layer, column_i, param, layer_fluent.sp_active_duty_cycles[column_i]);
+						priv::update_boost_factors(layer, column_i, param, layer_fluent.sp_inhibition_radius, layer_fluent.sp_active_duty_cycles[column_i]);
+					}
+					if (!P::SP_GLOBAL_INHIBITION && priv::is_update_round(layer_fluent))
+					{
+						priv::update_inhibition_radius(layer_fluent, layer, param);
 					}
 					if (false)
 					{
 						priv::bump_up_weak_columns(layer, param, layer_fluent.sp_overlap_duty_cycles, layer_fluent.sp_min_overlap_duty_cycles);
 						if (priv::is_update_round(layer_fluent))
 						{
-							priv::update_inhibition_radius(layer_fluent);
 							priv::update_min_duty_cycles(layer_fluent);
 						}
 					}
@@ -930,5 +1764,40 @@ namespace htm
 			if (false) log_INFO("SP:compute_sp: active columns OUT:", print::print_bitset(active_columns));
 			#endif
 		}
+
+		template <bool LEARN, typename P>
+		void compute_sp(
+			const typename Layer_Fluent<P>::Active_Sensors& active_sensors,
+			Layer_Fluent<P>& layer_fluent, 
+			Layer_Persisted_C<LEARN, P>& layer,
+			const Dynamic_Param& param,
+			//out
+			typename Layer_Fluent<P>::Active_Columns& active_columns)
+		{
+			::tools::profiler::Scope scope("sp");
+
+			//local variables; scratch in layer_fluent
+			auto& overlap_local = layer_fluent.sp_overlap;
+			std::fill(overlap_local.begin(), overlap_local.end(), 0);
+
+			layer_fluent.iteration_num++;
+			if (LEARN) layer_fluent.iteration_learn_num++;
+
+			{
+				::tools::profiler::Scope scope_overlap("sp.overlap");
+				if constexpr (P::SP_OVERLAP_INCREMENTAL)
+					priv::calc_overlap::incremental::calc_overlap_incremental(layer_fluent, layer, param, active_sensors, overlap_local);
+				else
+					priv::calc_overlap::d(layer, param, active_sensors, overlap_local);
+			}
+
+			compute_sp_columns<LEARN>(
+				active_sensors,
+				layer_fluent,
+				layer,
+				param,
+				//out
+				active_columns);
+		}
 	}
 }
\ No newline at end of file
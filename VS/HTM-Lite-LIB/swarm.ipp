@@ -22,16 +22,19 @@
 #include <random>
 #include <mutex>
 #include <iomanip>        // std::setw
-#include <atomic>         // std::atomic_flag
 #include <thread>         // std::thread
 #include <algorithm>
+#include <memory>
+#include <tuple>
 
 #include "..\Spike-Tools-Lib\log.ipp"
+#include "..\Spike-Tools-Lib\thread_pool.ipp"
 
 #include "parameters.ipp"
 #include "types.ipp"
 #include "datastream.ipp"
 #include "layer.ipp"
+#include "network.ipp"
 
 namespace htm
 {
@@ -49,6 +52,20 @@ namespace htm
 			int n_epochs;
 			float mutation_rate;
 			mutable std::ofstream outputfile;
+
+			// successive halving: a configuration is evaluated in n_rungs rungs of increasing length (the last rung 
+			// ends at n_time_steps); after every rung only the best 1/halving_rate configurations continue.
+			int n_rungs = 3;
+			int halving_rate = 3;
+
+			// seed of the genetic algorithm (the random configurations and the offspring), such that a search can be
+			// repeated; zero seeds it from std::random_device.
+			uint64_t random_seed = 0;
+
+			std::default_random_engine::result_type seed() const
+			{
+				return (this->random_seed != 0) ? static_cast<std::default_random_engine::result_type>(this->random_seed) : std::random_device()();
+			}
 			
 			void writeline_outputfile(const std::string& str) const
 			{
@@ -65,8 +82,8 @@ namespace htm
 		template <int N_LAYERS>
 		struct Configuration
 		{
-			bool flag;
 			float mismatch;
+			int rung; // last rung that has been completed; -1 if the configuration has not been evaluated.
 			std::array<Dynamic_Param, N_LAYERS> param;
 
 			static constexpr float MISMATCH_INVALID = 4533234.0f; // just a high random number
@@ -75,7 +92,7 @@ namespace htm
 				param(param)
 			{
 				this->mismatch = MISMATCH_INVALID;
-				this->flag = false;
+				this->rung = -1;
 			}
 			static std::string header_str()
 			{
@@ -110,9 +127,10 @@ namespace htm
 				template <int SIZE>
 				struct Configuration_better
 				{
+					// a configuration that completed more rungs is better; the mismatch of different rungs cannot be compared.
 					constexpr bool operator()(const Configuration<SIZE>& left, const Configuration<SIZE>& right) const
 					{
-						return (left.mismatch < right.mismatch);
+						return (left.rung != right.rung) ? (left.rung > right.rung) : (left.mismatch < right.mismatch);
 					}
 				};
 
@@ -129,12 +147,12 @@ namespace htm
 					else
 					{
 						std::nth_element(pool.begin(), pool.begin() + selection_size, pool.end(), Configuration_better<SIZE>());
-						const float nth_element_mismatch = pool[selection_size].mismatch;
-						if (false) log_INFO("swarm:get_best: nth_element_mismatch=", nth_element_mismatch,"\n");
+						const auto& nth_element = pool[selection_size];
+						if (false) log_INFO("swarm:get_best: nth_element_mismatch=", nth_element.mismatch,"\n");
 
 						for (int i = 0; i < selection_size; ++i)
 						{
-							if (pool[i].mismatch <= nth_element_mismatch)
+							if (!Configuration_better<SIZE>()(nth_element, pool[i]))
 							{
 								if (false) log_INFO("swarm:get_best:", i, ": ", pool[i].mismatch, "\n");
 								results.push_back(pool[i]);
@@ -322,136 +340,235 @@ namespace htm
 				return Configuration<SIZE>(rand_param);
 			}
 
-			template <typename P>
-			void do_work(
-				const DataStream<P>& datastream,
-				Layer_Fluent<P>& layer_fluent, Layer_Persisted<P>& layer,
-				Swarm_Options& options,
-				Configuration<1>& result)
+			//Last time step (exclusive) of the provided rung; every rung is halving_rate times longer than the previous
+			//and the last rung ends at n_time_steps.
+			inline int rung_time_end(const int rung, const int n_rungs, const int halving_rate, const int n_time_steps)
 			{
-				if (!result.flag)
-				{
-					result.flag = true; // using std::atomic_flag would be better...
-					auto total_mismatch = std::vector<int>(1);
+				int time = n_time_steps;
+				for (int i = rung + 1; i < n_rungs; ++i) time /= halving_rate;
+				return std::max(1, time);
+			}
 
-					htm::layer::init(layer_fluent, layer, result.param[0]);
-					htm::layer::run(datastream, result.param[0], layer_fluent, layer, total_mismatch);
+			//Asynchronous successive halving: a configuration that completed rung k continues with rung k+1 only when its
+			//mismatch is within the best 1/halving_rate of the mismatches of all configurations that completed rung k. 
+			//Configurations never wait for each other; the first halving_rate configurations of a rung always continue.
+			class Rungs
+			{
+			public:
+				Rungs(const int n_rungs, const int halving_rate)
+					: halving_rate_(std::max(2, halving_rate))
+					, mismatch_(std::max(1, n_rungs))
+				{}
 
-					if (result.mismatch != Configuration<1>::MISMATCH_INVALID)
-					{
-						log_WARNING("swarm:do_work: concurrency problem: but not serious, you just did some duplicate work.\n");
-					}
-					result.mismatch = static_cast<float>(total_mismatch[0]) / (result.param[0].n_time_steps * result.param[0].n_times);
-					if (!options.quiet) log_INFO(result.str(), "\n");
-					options.writeline_outputfile(result.str());
+				int n_rungs() const
+				{
+					return static_cast<int>(this->mismatch_.size());
+				}
+				int halving_rate() const
+				{
+					return this->halving_rate_;
 				}
-			}
 
-			template <typename P1, typename P2>
-			void do_work(
-				const DataStream<P1>& datastream,
-				Layer_Fluent<P1>& layer1_fluent, Layer_Persisted<P1>& layer1,
-				Layer_Fluent<P2>& layer2_fluent, Layer_Persisted<P2>& layer2,
-				const Swarm_Options& options,
-				Configuration<2>& result)
+				bool promote(const int rung, const float mismatch)
+				{
+					std::lock_guard<std::mutex> lock(this->mutex_);
+					auto& rung_mismatch = this->mismatch_[rung];
+					rung_mismatch.push_back(mismatch);
+
+					const int n = static_cast<int>(rung_mismatch.size());
+					if (n <= this->halving_rate_) return true;
+					const int n_better = static_cast<int>(std::count_if(rung_mismatch.begin(), rung_mismatch.end(), [mismatch](const float m) { return m < mismatch; }));
+					return n_better < ((n + this->halving_rate_ - 1) / this->halving_rate_);
+				}
+
+			private:
+				const int halving_rate_;
+				std::mutex mutex_;
+				std::vector<std::vector<float>> mismatch_;
+			};
+
+			//Layers (and a copy of the datastream) of a chain of layers in which configurations are evaluated one after 
+			//the other; the layers are reused for every configuration.
+			template <typename ... P>
+			class Candidate
 			{
-				if (!result.flag)
+			public:
+				static constexpr int N_LAYERS = sizeof...(P);
+				using P1 = std::tuple_element_t<0, std::tuple<P...>>;
+
+				Candidate(const DataStream<P1>& datastream)
+					: datastream_(datastream)
+					, layer_fluent_(std::make_unique<Layer_Fluent<P>>()...)
+					, layer_(std::make_unique<Layer_Persisted<P>>()...)
+				{}
+
+				//Evaluate the configuration in n_rungs rungs; after every rung but the last, promote(rung, mismatch) 
+				//decides whether the evaluation continues. Returns true when all rungs have been completed.
+				template <typename Promote>
+				bool evaluate(
+					Configuration<N_LAYERS>& config,
+					const int n_threads,
+					const int n_rungs,
+					const int halving_rate,
+					const Promote& promote)
 				{
-					result.flag = true; // using std::atomic_flag would be better...
-					auto total_mismatch = std::vector<int>(1);
+					auto param = config.param;
+					for (auto& p : param) p.n_threads = n_threads;
+
+					// every configuration starts from the same random numbers, whichever thread (and reused layers) evaluates it
+					for (int layer_i = 0; layer_i < N_LAYERS; ++layer_i)
+					{
+						if (param[layer_i].random_seed == 0) param[layer_i].random_seed = layer_i + 1;
+					}
+
+					const auto layer_fluent = std::apply([](auto& ... l) { return std::tie(*l...); }, this->layer_fluent_);
+					const auto layer = std::apply([](auto& ... l) { return std::tie(*l...); }, this->layer_);
+					htm::network::init(layer_fluent, layer, param);
+					this->datastream_.reset_time();
 
-					htm::layer::init(layer1_fluent, layer1, result.get_param(0));
-					htm::layer::init(layer2_fluent, layer2, result.get_param(1));
-					htm::network::run(datastream, result.param, layer1_fluent, layer1, layer2_fluent, layer2, total_mismatch);
+					auto mismatch = std::vector<int>(1);
+					int total_mismatch = 0;
+					int time = 0;
 
-					if (result.mismatch != Configuration<2>::MISMATCH_INVALID)
+					for (int rung = 0; rung < n_rungs; ++rung)
 					{
-						log_WARNING("swarm:do_work: concurrency problem: but not serious, you just did some duplicate work.\n");
+						const int time_end = rung_time_end(rung, n_rungs, halving_rate, param[0].n_time_steps);
+						htm::network::run(this->datastream_, param, layer_fluent, layer, time, time_end, mismatch);
+						total_mismatch += mismatch[0];
+						time = time_end;
+
+						config.rung = rung;
+						config.mismatch = static_cast<float>(total_mismatch) / (time * param[0].n_times);
+						if ((rung < n_rungs - 1) && !promote(rung, config.mismatch))
+						{
+							if (false) log_INFO("swarm:evaluate: terminated at rung ", rung, ": ", config.str(), "\n");
+							return false;
+						}
 					}
-					result.mismatch = static_cast<float>(total_mismatch[0]) / (result.param[0].n_time_steps * result.param[0].n_times);
-					if (!options.quiet) log_INFO(result.str(), "\n");
-					options.writeline_outputfile(result.str());
+					return true;
 				}
-			}
 
-			template <typename P1, typename P2, typename P3>
-			void do_work(
-				const DataStream<P1>& datastream,
-				Layer_Fluent<P1>& layer1_fluent, Layer_Persisted<P1>& layer1,
-				Layer_Fluent<P2>& layer2_fluent, Layer_Persisted<P2>& layer2,
-				Layer_Fluent<P3>& layer3_fluent, Layer_Persisted<P3>& layer3,
-				const Swarm_Options& options,
-				Configuration<3>& result)
+			private:
+				DataStream<P1> datastream_;
+				std::tuple<std::unique_ptr<Layer_Fluent<P>>...> layer_fluent_;
+				std::tuple<std::unique_ptr<Layer_Persisted<P>>...> layer_;
+			};
+
+			//Evaluate configurations of a chain of layers with the threads of the (persistent) thread pool. Every thread
+			//claims the next configuration when it is done, and reuses the layers (and datastream) of a previous task.
+			template <typename ... P>
+			class Evaluator
 			{
-				if (!result.flag)
+			public:
+				static constexpr int N_LAYERS = sizeof...(P);
+				using P1 = std::tuple_element_t<0, std::tuple<P...>>;
+
+				Evaluator(const DataStream<P1>& datastream, const Swarm_Options& options)
+					: datastream_(datastream)
+					, options_(options)
+					, rungs_(options.n_rungs, options.halving_rate)
+					, n_threads_(std::max(1, static_cast<int>(std::thread::hardware_concurrency())))
+				{}
+
+				int n_threads() const
+				{
+					return this->n_threads_;
+				}
+
+				void evaluate(std::vector<Configuration<N_LAYERS>>& configs)
 				{
-					result.flag = true; // using std::atomic_flag would be better...
-					auto total_mismatch = std::vector<int>(1);
+					::tools::thread_pool::get_pool(this->n_threads_).parallel_for(static_cast<int>(configs.size()), 1, [&](const int begin, const int end)
+					{
+						auto candidate = this->acquire();
+						for (int i = begin; i < end; ++i) this->evaluate(*candidate, configs[i]);
+						this->release(std::move(candidate));
+					});
+				}
 
-					htm::layer::init(layer1_fluent, layer1, result.get_param(0));
-					htm::layer::init(layer2_fluent, layer2, result.get_param(1));
-					htm::layer::init(layer3_fluent, layer3, result.get_param(2));
-					htm::network::run(datastream, result.param, layer1_fluent, layer1, layer2_fluent, layer2, layer3_fluent, layer3, total_mismatch);
+			private:
+				const DataStream<P1>& datastream_;
+				const Swarm_Options& options_;
+				Rungs rungs_;
+				const int n_threads_;
 
-					if (result.mismatch != Configuration<1>::MISMATCH_INVALID)
+				std::mutex candidate_mutex_;
+				std::vector<std::unique_ptr<Candidate<P...>>> candidates_;
+
+				std::unique_ptr<Candidate<P...>> acquire()
+				{
 					{
-						log_WARNING("swarm:do_work: concurrency problem: but not serious, you just did some duplicate work.\n");
+						std::lock_guard<std::mutex> lock(this->candidate_mutex_);
+						if (!this->candidates_.empty())
+						{
+							auto candidate = std::move(this->candidates_.back());
+							this->candidates_.pop_back();
+							return candidate;
+						}
 					}
-					result.mismatch = static_cast<float>(total_mismatch[0]) / (result.param[0].n_time_steps * result.param[0].n_times);
-					if (!options.quiet) log_INFO(result.str(), "\n");
-					options.writeline_outputfile(result.str());
+					return std::make_unique<Candidate<P...>>(this->datastream_);
+				}
+				void release(std::unique_ptr<Candidate<P...>> candidate)
+				{
+					std::lock_guard<std::mutex> lock(this->candidate_mutex_);
+					this->candidates_.push_back(std::move(candidate));
 				}
-			}
 
-			template <typename P>
-			void do_work_all(
-				const DataStream<P>& datastream,
-				const int start_pos,
-				Swarm_Options& options,
-				std::vector<Configuration<1>>& results)
-			{
-				Layer_Fluent<P> layer_fluent;
-				Layer_Persisted<P> layer;
-				const int nResults = static_cast<int>(results.size());
+				void evaluate(Candidate<P...>& candidate, Configuration<N_LAYERS>& config)
+				{
+					// the layers already run in a thread of the pool
+					const bool completed = candidate.evaluate(config, 1, this->rungs_.n_rungs(), this->rungs_.halving_rate(),
+						[this](const int rung, const float mismatch) { return this->rungs_.promote(rung, mismatch); });
+					if (!completed) return;
 
-				for (int i = start_pos; i < nResults; ++i) do_work(datastream, layer_fluent, layer, options, results[i]);
-				for (int i = 0; i < nResults; ++i) do_work(datastream, layer_fluent, layer, options, results[i]);
-			}
+					if (!this->options_.quiet) log_INFO(config.str(), "\n");
+					this->options_.writeline_outputfile(config.str());
+				}
+			};
 
-			template <typename P1, typename P2>
-			void do_work_all(
-				const DataStream<P1>& datastream,
-				const int start_pos,
-				Swarm_Options& options,
-				std::vector<Configuration<2>>& results)
+			template <typename ... P>
+			std::vector<Configuration<sizeof...(P)>> run_ga(
+				const DataStream<std::tuple_element_t<0, std::tuple<P...>>>& datastream,
+				const std::array<Dynamic_Param, sizeof...(P)>& param,
+				Swarm_Options& options)
 			{
-				Layer_Fluent<P1> layer1_fluent;
-				Layer_Persisted<P1> layer1;
-				Layer_Fluent<P2> layer2_fluent;
-				Layer_Persisted<P2> layer2;
-				const int nResults = static_cast<int>(results.size());
-
-				for (int i = start_pos; i < nResults; ++i) do_work(datastream, layer1_fluent, layer1, layer2_fluent, layer2, options, results[i]);
-				for (int i = 0; i < nResults; ++i) do_work(datastream, layer1_fluent, layer1, layer2_fluent, layer2, options, results[i]);
-			}
+				constexpr int N_LAYERS = sizeof...(P);
+				Evaluator<P...> evaluator(datastream, options);
 
-			template <typename P1, typename P2, typename P3>
-			void do_work_all(
-				const DataStream<P1>& datastream,
-				const int start_pos,
-				Swarm_Options& options,
-				std::vector<Configuration<3>>& results)
-			{
-				Layer_Fluent<P1> layer1_fluent;
-				Layer_Persisted<P1> layer1;
-				Layer_Fluent<P2> layer2_fluent;
-				Layer_Persisted<P2> layer2;
-				Layer_Fluent<P3> layer3_fluent;
-				Layer_Persisted<P3> layer3;
-				const int nResults = static_cast<int>(results.size());
-
-				for (int i = start_pos; i < nResults; ++i) do_work(datastream, layer1_fluent, layer1, layer2_fluent, layer2, layer3_fluent, layer3, options, results[i]);
-				for (int i = 0; i < nResults; ++i) do_work(datastream, layer1_fluent, layer1, layer2_fluent, layer2, layer3_fluent, layer3, options, results[i]);
+				if (true) log_INFO("swarm:run_ga: running ga swarm with ", evaluator.n_threads(), " threads.\n");
+				if (true) log_INFO(Configuration<N_LAYERS>::header_str(), "\n");
+
+				options.writeline_outputfile(Configuration<N_LAYERS>::header_str());
+
+				std::default_random_engine random_engine(options.seed());
+				std::uniform_int_distribution<int> individual_dist(0, options.population_size - 1);
+
+				std::vector<Configuration<N_LAYERS>> pool;
+				std::vector<Configuration<N_LAYERS>> results;
+
+				// initialize the pool with random individuals
+				for (int i = 0; i < options.population_size; ++i)
+				{
+					pool.push_back(priv::random_config(param, random_engine));
+				}
+				evaluator.evaluate(pool);
+
+				for (int epoch = 0; epoch < options.n_epochs; ++epoch)
+				{
+					if (!options.quiet) log_INFO("swarm:run_ga: epoch ", epoch, "\n");
+
+					results.clear();
+					const auto best_indiduals = priv::ga::get_best(options.population_size, pool);
+					for (int i = 0; i < options.population_size; ++i)
+					{
+						const auto parent1 = best_indiduals[individual_dist(random_engine)].param;
+						const auto parent2 = best_indiduals[individual_dist(random_engine)].param;
+						const auto child = priv::ga::cross_over(parent1, parent2, options.mutation_rate, random_engine);
+						results.push_back(Configuration<N_LAYERS>(child));
+					}
+					evaluator.evaluate(results);
+					for (const auto& config : results) pool.push_back(config);
+				}
+				return pool;
 			}
 		}
 
@@ -461,12 +578,11 @@ namespace htm
 			const std::array<Dynamic_Param, 1>& param,
 			Swarm_Options& options)
 		{
-			const int nThreads = static_cast<int>(std::thread::hardware_concurrency());
-			if (!options.quiet) log_INFO("swarm:run_random: running random swarm with ", nThreads, " threads.");
+			priv::Evaluator<P> evaluator(datastream, options);
+			if (!options.quiet) log_INFO("swarm:run_random: running random swarm with ", evaluator.n_threads(), " threads.");
 			if (!options.quiet) std::cout << Configuration<1>::header_str() << std::endl;
 
-			std::random_device r;
-			std::default_random_engine random_engine(r());
+			std::default_random_engine random_engine(options.seed());
 			std::vector<Configuration<1>> results;
 
 			// initialize the pool with random individuals
@@ -474,13 +590,7 @@ namespace htm
 			{
 				results.push_back(priv::random_config(param, random_engine));
 			}
-
-			std::vector<std::thread> workers;
-			for (int thread = 0; thread < nThreads; ++thread)
-			{
-				workers.push_back(std::thread(priv::do_work_all<P>, datastream, thread * 4, std::ref(options), std::ref(results)));
-			}
-			for (auto& t : workers) if (t.joinable()) t.join();
+			evaluator.evaluate(results);
 			return results;
 		}
 
@@ -490,49 +600,7 @@ namespace htm
 			const std::array<Dynamic_Param, 1>& param,
 			Swarm_Options& options)
 		{
-			const int nThreads = static_cast<int>(std::thread::hardware_concurrency());
-			if (true) log_INFO("swarm:run_ga: running ga swarm with ", nThreads, " threads.\n");
-			if (true) log_INFO(Configuration<1>::header_str(), "\n");
-
-			options.writeline_outputfile(Configuration<1>::header_str());
-
-			std::random_device r;
-			std::default_random_engine random_engine(r());
-			std::uniform_int_distribution<int> individual_dist(0, options.population_size-1);
-
-			std::vector<Configuration<1>> pool = run_random<P>(datastream, param, options);
-			std::vector<Configuration<1>> results;
-			std::vector<std::thread> workers;
-
-			// initialize the pool with random individuals
-			for (int i = 0; i < options.population_size; ++i)
-			{
-				results.push_back(priv::random_config(param, random_engine));
-			}
-
-			for (int epoch = 0; epoch < options.n_epochs; ++epoch)
-			{
-				if (!options.quiet) log_INFO("swarm:run_ga: epoch ", epoch, "\n");
-
-				results.clear();
-				const auto best_indiduals = priv::ga::get_best(options.population_size, pool);
-				for (int i = 0; i < options.population_size; ++i)
-				{
-					const auto parent1 = best_indiduals[individual_dist(random_engine)].param;
-					const auto parent2 = best_indiduals[individual_dist(random_engine)].param;
-					const auto child = priv::ga::cross_over(parent1, parent2, options.mutation_rate, random_engine);
-					results.push_back(Configuration<1>(child));
-				}
-
-				workers.clear();
-				for (int thread = 0; thread < nThreads; ++thread)
-				{
-					workers.push_back(std::thread(priv::do_work_all<P>, datastream, thread * 4, std::ref(options), std::ref(results)));
-				}
-				for (auto& t : workers) if (t.joinable()) t.join();
-				for (const auto& config : results) pool.push_back(config);
-			}
-			return pool;
+			return priv::run_ga<P>(datastream, param, options);
 		}
 		
 		template <typename P1, typename P2>
@@ -541,49 +609,7 @@ namespace htm
 			const std::array<Dynamic_Param, 2>& param,
 			Swarm_Options& options)
 		{
-			const int nThreads = static_cast<int>(std::thread::hardware_concurrency());
-			if (true) log_INFO("swarm:run_ga: running ga swarm with ", nThreads, " threads.\n");
-			if (true) log_INFO(Configuration<2>::header_str(), "\n");
-
-			options.writeline_outputfile(Configuration<2>::header_str());
-
-			std::random_device r;
-			std::default_random_engine random_engine(r());
-			std::uniform_int_distribution<int> individual_dist(0, options.population_size - 1);
-
-			std::vector<Configuration<2>> pool;// = run_random<P1>(input_filename, param, options);
-			std::vector<Configuration<2>> results;
-			std::vector<std::thread> workers;
-
-			// initialize the pool with random individuals
-			for (int i = 0; i < options.population_size; ++i)
-			{
-				pool.push_back(priv::random_config(param, random_engine));
-			}
-
-			for (int epoch = 0; epoch < options.n_epochs; ++epoch)
-			{
-				if (!options.quiet) log_INFO("swarm:run_ga: epoch ", epoch, "\n");
-
-				results.clear();
-				const auto best_indiduals = priv::ga::get_best(options.population_size, pool);
-				for (int i = 0; i < options.population_size; ++i)
-				{
-					const auto parent1 = best_indiduals[individual_dist(random_engine)].param;
-					const auto parent2 = best_indiduals[individual_dist(random_engine)].param;
-					const auto child = priv::ga::cross_over(parent1, parent2, options.mutation_rate, random_engine);
-					results.push_back(Configuration<2>(child));
-				}
-
-				workers.clear();
-				for (int thread = 0; thread < nThreads; ++thread)
-				{
-					workers.push_back(std::thread(priv::do_work_all<P1, P2>, datastream, thread * 4, std::ref(options), std::ref(results)));
-				}
-				for (auto& t : workers) if (t.joinable()) t.join();
-				for (const auto& config : results) pool.push_back(config);
-			}
-			return pool;
+			return priv::run_ga<P1, P2>(datastream, param, options);
 		}
 		
 		template <typename P1, typename P2, typename P3>
@@ -592,49 +618,7 @@ namespace htm
 			const std::array<Dynamic_Param, 3>& param, 
 			Swarm_Options& options)
 		{
-			const int nThreads = static_cast<int>(std::thread::hardware_concurrency());
-			if (true) log_INFO("swarm:run_ga: running ga swarm with ", nThreads, " threads.\n");
-			if (true) log_INFO(Configuration<3>::header_str(), "\n");
-
-			options.writeline_outputfile(Configuration<3>::header_str());
-
-			std::random_device r;
-			std::default_random_engine random_engine(r());
-			std::uniform_int_distribution<int> individual_dist(0, options.population_size - 1);
-
-			std::vector<Configuration<3>> pool;// = run_random<P1>(input_filename, param, options);
-			std::vector<Configuration<3>> results;
-			std::vector<std::thread> workers;
-
-			// initialize the pool with random individuals
-			for (int i = 0; i < options.population_size; ++i)
-			{
-				pool.push_back(priv::random_config(param, random_engine));
-			}
-
-			for (int epoch = 0; epoch < options.n_epochs; ++epoch)
-			{
-				if (!options.quiet) log_INFO("swarm:run_ga: epoch ", epoch, "\n");
-
-				results.clear();
-				const auto best_indiduals = priv::ga::get_best(options.population_size, pool);
-				for (int i = 0; i < options.population_size; ++i)
-				{
-					const auto parent1 = best_indiduals[individual_dist(random_engine)].param;
-					const auto parent2 = best_indiduals[individual_dist(random_engine)].param;
-					const auto child = priv::ga::cross_over(parent1, parent2, options.mutation_rate, random_engine);
-					results.push_back(Configuration<3>(child));
-				}
-
-				workers.clear();
-				for (int thread = 0; thread < nThreads; ++thread)
-				{
-					workers.push_back(std::thread(priv::do_work_all<P1, P2, P3>, datastream, thread * 4, std::ref(options), std::ref(results)));
-				}
-				for (auto& t : workers) if (t.joinable()) t.join();
-				for (const auto& config : results) pool.push_back(config);
-			}
-			return pool;
+			return priv::run_ga<P1, P2, P3>(datastream, param, options);
 		}
 	}
 }
\ No newline at end of file
@@ -0,0 +1,547 @@
+// C++ port of Nupic HTM with the aim of being lite and fast
+//
+// Copyright (c) 2017 Henk-Jan Lebbink
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero Public License version 3 as
+// published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero Public License for more details.
+//
+// You should have received a copy of the GNU Affero Public License
+// along with this program.  If not, see http://www.gnu.org/licenses.
+
+#pragma once
+#include <string>
+#include <vector>
+#include <array>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <cstdio>		// std::rename, std::remove
+
+#include "..\Spike-Tools-Lib\log.ipp"
+#include "..\Spike-Tools-Lib\socket.ipp"
+
+#include "parameters.ipp"
+#include "types.ipp"
+#include "datastream.ipp"
+#include "swarm.ipp"
+
+//Hierarchical Temporal Memory (HTM)
+namespace htm
+{
+	namespace swarm
+	{
+		//Swarm over several processes (on one or more hosts). A coordinator owns the population of the genetic
+		//algorithm and hands out one configuration at a time to every connected worker; a worker evaluates the
+		//configuration with its own layers and reports the mismatch after every rung (successive halving is decided
+		//by the coordinator). A worker that disconnects or times out loses its configuration to another worker.
+		//
+		//Protocol: lines of text over a TCP connection.
+		//	worker:      HELLO <protocol version> <number of layers>
+		//	coordinator: TASK <task> <n_rungs> <halving_rate> <Dynamic_Param of every layer>
+		//	worker:      RUNG <task> <rung> <mismatch>		after every rung but the last
+		//	coordinator: CONTINUE <task> | STOP <task>
+		//	worker:      DONE <task> <rung> <mismatch>		after the last rung
+		//	coordinator: QUIT								when the search has finished
+		namespace distributed
+		{
+			using namespace ::tools::log;
+			using namespace htm::types;
+			using namespace htm::datastream;
+
+			//Versions of the messages and of the checkpoint file; both change when the serialized fields of Dynamic_Param change.
+			static constexpr int PROTOCOL_VERSION = 3;
+			static constexpr int CHECKPOINT_VERSION = 4;
+
+			struct Distributed_Options
+			{
+				//Port on which the coordinator accepts workers.
+				int port = 5701;
+
+				//Accept workers from other hosts; by default only workers on the local host can connect.
+				bool accept_remote = false;
+
+				//File with the state of the search, rewritten after every evaluated configuration. When the file exists
+				//the search resumes from it. Empty means no checkpoint.
+				std::string checkpoint_filename;
+
+				//A worker that does not report a rung within this number of seconds is disconnected.
+				int task_timeout_sec = 3600;
+			};
+
+			namespace priv
+			{
+				//Write all fields of the parameters (in declaration order) separated by spaces.
+				inline void write_param(std::ostream& stream, const Dynamic_Param& param)
+				{
+					stream << param.learn << " " << param.n_time_steps << " " << param.n_times << " " << param.quiet << " "
+						<< param.show_input_and_prediction_interval << " " << param.show_mismatch_interval << " " << param.show_mismatch_n_futures << " "
+						<< param.n_visible_sensors_dim1 << " " << param.n_visible_sensors_dim2 << " "
+						<< param.n_threads << " " << param.n_columns_per_chunk << " "
+						<< param.random_seed << " "
+						<< param.sensor_threshold << " "
+						<< static_cast<int>(param.SP_PD_PERMANENCE_INIT) << " "
+						<< static_cast<int>(param.SP_PD_PERMANENCE_INC) << " "
+						<< static_cast<int>(param.SP_PD_PERMANENCE_DEC) << " "
+						<< static_cast<int>(param.SP_PD_PERMANENCE_INC_WEAK) << " "
+						<< std::setprecision(9) << param.SP_LOCAL_AREA_DENSITY << " "
+						<< param.TP_DD_SEGMENT_ACTIVE_THRESHOLD << " " << param.TP_MIN_DD_ACTIVATION_THRESHOLD << " " << param.TP_DD_MAX_NEW_SYNAPSE_COUNT << " "
+						<< static_cast<int>(param.TP_DD_PERMANENCE_INIT) << " "
+						<< static_cast<int>(param.TP_DD_PERMANENCE_INC) << " "
+						<< static_cast<int>(param.TP_DD_PERMANENCE_DEC) << " "
+						<< static_cast<int>(param.TP_DD_PREDICTED_SEGMENT_DEC) << " "
+						<< param.TP_DD_COMPACT_INTERVAL;
+				}
+
+				inline bool read_param(std::istream& stream, Dynamic_Param& param)
+				{
+					int permanence[8];
+					stream >> param.learn >> param.n_time_steps >> param.n_times >> param.quiet
+						>> param.show_input_and_prediction_interval >> param.show_mismatch_interval >> param.show_mismatch_n_futures
+						>> param.n_visible_sensors_dim1 >> param.n_visible_sensors_dim2
+						>> param.n_threads >> param.n_columns_per_chunk
+						>> param.random_seed
+						>> param.sensor_threshold
+						>> permanence[0] >> permanence[1] >> permanence[2] >> permanence[3]
+						>> param.SP_LOCAL_AREA_DENSITY
+						>> param.TP_DD_SEGMENT_ACTIVE_THRESHOLD >> param.TP_MIN_DD_ACTIVATION_THRESHOLD >> param.TP_DD_MAX_NEW_SYNAPSE_COUNT
+						>> permanence[4] >> permanence[5] >> permanence[6] >> permanence[7]
+						>> param.TP_DD_COMPACT_INTERVAL;
+					if (stream.fail()) return false;
+
+					param.SP_PD_PERMANENCE_INIT = static_cast<Permanence>(permanence[0]);
+					param.SP_PD_PERMANENCE_INC = static_cast<Permanence>(permanence[1]);
+					param.SP_PD_PERMANENCE_DEC = static_cast<Permanence>(permanence[2]);
+					param.SP_PD_PERMANENCE_INC_WEAK = static_cast<Permanence>(permanence[3]);
+					param.TP_DD_PERMANENCE_INIT = static_cast<Permanence>(permanence[4]);
+					param.TP_DD_PERMANENCE_INC = static_cast<Permanence>(permanence[5]);
+					param.TP_DD_PERMANENCE_DEC = static_cast<Permanence>(permanence[6]);
+					param.TP_DD_PREDICTED_SEGMENT_DEC = static_cast<Permanence>(permanence[7]);
+					return true;
+				}
+
+				template <int N_LAYERS>
+				void write_config(std::ostream& stream, const Configuration<N_LAYERS>& config)
+				{
+					stream << config.rung << " " << std::setprecision(9) << config.mismatch;
+					for (const auto& param : config.param)
+					{
+						stream << " ";
+						write_param(stream, param);
+					}
+				}
+
+				template <int N_LAYERS>
+				bool read_config(std::istream& stream, Configuration<N_LAYERS>& config)
+				{
+					stream >> config.rung >> config.mismatch;
+					for (auto& param : config.param)
+					{
+						if (!read_param(stream, param)) return false;
+					}
+					return !stream.fail();
+				}
+
+				//State of a search: the evaluated population and the batch of configurations that is being evaluated.
+				//Batch 0 is the initial (random) population, batch i is the offspring of epoch i. The random engine of
+				//the genetic algorithm is part of it, such that a resumed search creates the same offspring.
+				template <int N_LAYERS>
+				struct Search_State
+				{
+					int n_batches = 0; // number of batches that have been added to the pool
+					std::default_random_engine random_engine;
+					std::vector<Configuration<N_LAYERS>> pool;
+					std::vector<Configuration<N_LAYERS>> batch;
+
+					//Write the state to a temporary file that replaces the file, such that a crash leaves the previous state.
+					bool save(const std::string& filename) const
+					{
+						const std::string tmp_filename = filename + ".tmp";
+						{
+							std::ofstream file(tmp_filename, std::ios::out | std::ios::trunc);
+							file << "HTM_SWARM_CHECKPOINT " << CHECKPOINT_VERSION << " " << N_LAYERS << " " << this->n_batches << "\n";
+							file << this->random_engine << "\n";
+							file << this->pool.size() << "\n";
+							for (const auto& config : this->pool)
+							{
+								write_config(file, config);
+								file << "\n";
+							}
+							file << this->batch.size() << "\n";
+							for (const auto& config : this->batch)
+							{
+								write_config(file, config);
+								file << "\n";
+							}
+							if (!file.good())
+							{
+								log_WARNING("swarm:Search_State:save: could not write file ", tmp_filename, ".\n");
+								return false;
+							}
+						}
+						std::remove(filename.c_str());
+						return std::rename(tmp_filename.c_str(), filename.c_str()) == 0;
+					}
+
+					bool load(const std::string& filename)
+					{
+						std::ifstream file(filename);
+						if (!file.good()) return false;
+
+						std::string magic;
+						int version = 0;
+						int n_layers = 0;
+						file >> magic >> version >> n_layers >> this->n_batches;
+						if ((magic != "HTM_SWARM_CHECKPOINT") || (version != CHECKPOINT_VERSION) || (n_layers != N_LAYERS))
+						{
+							log_WARNING("swarm:Search_State:load: file ", filename, " is not a checkpoint of a swarm with ", N_LAYERS, " layers.\n");
+							return false;
+						}
+						file >> std::ws >> this->random_engine; // the engine does not skip white space itself
+						if (file.fail())
+						{
+							log_WARNING("swarm:Search_State:load: file ", filename, " is corrupt.\n");
+							return false;
+						}
+						for (auto * configs : { &this->pool, &this->batch })
+						{
+							size_t size = 0;
+							file >> size;
+							configs->assign(size, Configuration<N_LAYERS>(std::array<Dynamic_Param, N_LAYERS>()));
+							for (auto& config : *configs)
+							{
+								if (!read_config(file, config))
+								{
+									log_WARNING("swarm:Search_State:load: file ", filename, " is corrupt.\n");
+									return false;
+								}
+							}
+						}
+						return true;
+					}
+				};
+
+				template <int N_LAYERS>
+				class Coordinator
+				{
+				public:
+					Coordinator(
+						const std::array<Dynamic_Param, N_LAYERS>& param,
+						const Swarm_Options& options,
+						const Distributed_Options& distributed_options)
+						: param_(param)
+						, options_(options)
+						, distributed_options_(distributed_options)
+						, rungs_(options.n_rungs, options.halving_rate)
+					{}
+
+					std::vector<Configuration<N_LAYERS>> run()
+					{
+						const std::string& checkpoint = this->distributed_options_.checkpoint_filename;
+						if (!checkpoint.empty() && this->state_.load(checkpoint))
+						{
+							log_INFO("swarm:run_coordinator: resuming from file ", checkpoint, " at batch ", this->state_.n_batches, ".\n");
+						}
+						else
+						{
+							this->state_ = Search_State<N_LAYERS>();
+							this->state_.random_engine.seed(this->options_.seed());
+							for (int i = 0; i < this->options_.population_size; ++i)
+							{
+								this->state_.batch.push_back(swarm::priv::random_config(this->param_, this->state_.random_engine));
+							}
+						}
+						this->running_.assign(this->state_.batch.size(), false);
+
+						if (!this->listener_.listen(this->distributed_options_.port, !this->distributed_options_.accept_remote))
+						{
+							log_WARNING("swarm:run_coordinator: could not listen on port ", this->distributed_options_.port, ".\n");
+							return this->state_.pool;
+						}
+						log_INFO("swarm:run_coordinator: waiting for workers on port ", this->distributed_options_.port, ".\n");
+						this->options_.writeline_outputfile(Configuration<N_LAYERS>::header_str());
+
+						while (true)
+						{
+							if (this->batch_done())
+							{
+								if (!this->next_batch()) break;
+								this->save_checkpoint();
+							}
+							this->poll();
+							this->assign_tasks();
+						}
+						for (auto& worker : this->workers_) worker.connection.send_line("QUIT");
+						return this->state_.pool;
+					}
+
+				private:
+					struct Worker
+					{
+						::tools::socket::Connection connection;
+						bool greeted = false;
+						int task = -1;
+						std::chrono::steady_clock::time_point task_start;
+					};
+
+					const std::array<Dynamic_Param, N_LAYERS> param_;
+					const Swarm_Options& options_;
+					const Distributed_Options& distributed_options_;
+					swarm::priv::Rungs rungs_;
+
+					Search_State<N_LAYERS> state_;
+					std::vector<bool> running_; // whether a batch configuration is being evaluated by a worker
+					::tools::socket::Listener listener_;
+					std::vector<Worker> workers_;
+
+					bool batch_done() const
+					{
+						return std::all_of(this->state_.batch.begin(), this->state_.batch.end(), [](const Configuration<N_LAYERS>& c) { return c.rung >= 0; });
+					}
+
+					//Add the batch to the pool and create the offspring of the next epoch; returns false when all epochs are done.
+					bool next_batch()
+					{
+						auto& state = this->state_;
+						for (const auto& config : state.batch) state.pool.push_back(config);
+						state.batch.clear();
+						state.n_batches++;
+						if (state.n_batches > this->options_.n_epochs) return false;
+
+						if (!this->options_.quiet) log_INFO("swarm:run_coordinator: epoch ", state.n_batches - 1, "\n");
+						std::uniform_int_distribution<int> individual_dist(0, this->options_.population_size - 1);
+						const auto best_indiduals = swarm::priv::ga::get_best(this->options_.population_size, state.pool);
+						for (int i = 0; i < this->options_.population_size; ++i)
+						{
+							const auto parent1 = best_indiduals[individual_dist(state.random_engine)].param;
+							const auto parent2 = best_indiduals[individual_dist(state.random_engine)].param;
+							state.batch.push_back(Configuration<N_LAYERS>(swarm::priv::ga::cross_over(parent1, parent2, this->options_.mutation_rate, state.random_engine)));
+						}
+						this->running_.assign(state.batch.size(), false);
+						return true;
+					}
+
+					void save_checkpoint() const
+					{
+						if (!this->distributed_options_.checkpoint_filename.empty()) this->state_.save(this->distributed_options_.checkpoint_filename);
+					}
+
+					//Accept new workers and handle the messages of the connected workers; waits at most 100 ms.
+					void poll()
+					{
+						std::vector<::tools::socket::Handle> handles{ this->listener_.handle() };
+						for (const auto& worker : this->workers_) handles.push_back(worker.connection.handle());
+						const auto readable = ::tools::socket::wait_readable(handles, 100);
+
+						for (size_t i = 0; i < this->workers_.size(); ++i)
+						{
+							auto& worker = this->workers_[i];
+							if (readable[i + 1])
+							{
+								if (worker.connection.receive_available())
+								{
+									std::string line;
+									while (worker.connection.is_open() && worker.connection.next_line(line)) this->handle_message(worker, line);
+								}
+								else
+								{
+									this->disconnect(worker, "disconnected");
+								}
+							}
+							if ((worker.task >= 0) && (std::chrono::steady_clock::now() - worker.task_start > std::chrono::seconds(this->distributed_options_.task_timeout_sec)))
+							{
+								this->disconnect(worker, "timed out");
+							}
+						}
+						this->workers_.erase(std::remove_if(this->workers_.begin(), this->workers_.end(), [](const Worker& w) { return !w.connection.is_open(); }), this->workers_.end());
+
+						if (readable[0])
+						{
+							Worker worker;
+							worker.connection = this->listener_.accept();
+							if (worker.connection.is_open()) this->workers_.push_back(std::move(worker));
+						}
+					}
+
+					//Close the connection of the worker; its configuration is handed out again.
+					void disconnect(Worker& worker, const std::string& reason)
+					{
+						log_WARNING("swarm:run_coordinator: worker ", reason, "; task ", worker.task, " is reassigned.\n");
+						if (worker.task >= 0) this->running_[worker.task] = false;
+						worker.task = -1;
+						worker.connection.close();
+					}
+
+					void handle_message(Worker& worker, const std::string& line)
+					{
+						std::istringstream message(line);
+						std::string type;
+						message >> type;
+
+						if (type == "HELLO")
+						{
+							int version = 0;
+							int n_layers = 0;
+							message >> version >> n_layers;
+							if ((version != PROTOCOL_VERSION) || (n_layers != N_LAYERS))
+							{
+								log_WARNING("swarm:run_coordinator: worker with protocol ", version, " and ", n_layers, " layers is refused.\n");
+								worker.connection.close();
+								return;
+							}
+							worker.greeted = true;
+							return;
+						}
+
+						int task = -1;
+						int rung = -1;
+						float mismatch = Configuration<N_LAYERS>::MISMATCH_INVALID;
+						message >> task >> rung >> mismatch;
+						if (message.fail() || (worker.task < 0) || (task != worker.task) || ((type != "RUNG") && (type != "DONE")))
+						{
+							this->disconnect(worker, "sent an invalid message \"" + line + "\"");
+							return;
+						}
+						// the rung indexes the rung table (and is stored in the configuration): a worker must not make it read out of range
+						if ((rung < 0) || (rung >= this->rungs_.n_rungs()))
+						{
+							this->disconnect(worker, "sent an invalid message \"" + line + "\"");
+							return;
+						}
+
+						if (type == "RUNG")
+						{
+							const bool promote = this->rungs_.promote(rung, mismatch);
+							worker.connection.send_line(std::string(promote ? "CONTINUE " : "STOP ") + std::to_string(task));
+							worker.task_start = std::chrono::steady_clock::now();
+							if (promote) return;
+						}
+
+						auto& config = this->state_.batch[task];
+						config.rung = rung;
+						config.mismatch = mismatch;
+						this->running_[task] = false;
+						worker.task = -1;
+						if (type == "DONE")
+						{
+							if (!this->options_.quiet) log_INFO(config.str(), "\n");
+							this->options_.writeline_outputfile(config.str());
+						}
+						this->save_checkpoint();
+					}
+
+					void assign_tasks()
+					{
+						auto& batch = this->state_.batch;
+						size_t task = 0;
+						for (auto& worker : this->workers_)
+						{
+							if (!worker.greeted || (worker.task >= 0)) continue;
+							while ((task < batch.size()) && (this->running_[task] || (batch[task].rung >= 0))) task++;
+							if (task == batch.size()) return;
+
+							std::ostringstream message;
+							message << "TASK " << task << " " << this->rungs_.n_rungs() << " " << this->rungs_.halving_rate();
+							for (const auto& param : batch[task].param)
+							{
+								message << " ";
+								write_param(message, param);
+							}
+							worker.task = static_cast<int>(task);
+							worker.task_start = std::chrono::steady_clock::now();
+							this->running_[task] = true;
+							if (!worker.connection.send_line(message.str())) this->disconnect(worker, "disconnected");
+						}
+					}
+				};
+			}
+
+			//Run the genetic algorithm of swarm::run_ga with configurations that are evaluated by worker processes
+			//(see run_worker). Returns the evaluated population.
+			template <int N_LAYERS>
+			std::vector<Configuration<N_LAYERS>> run_coordinator(
+				const std::array<Dynamic_Param, N_LAYERS>& param,
+				const Swarm_Options& options,
+				const Distributed_Options& distributed_options)
+			{
+				return priv::Coordinator<N_LAYERS>(param, options, distributed_options).run();
+			}
+
+			//Evaluate configurations of the coordinator at host:port until the coordinator has finished. The layers
+			//use n_threads threads for a time step. Returns false when no coordinator could be reached within
+			//connect_timeout_sec seconds, or when the connection broke before the coordinator finished.
+			template <typename ... P>
+			bool run_worker(
+				const DataStream<std::tuple_element_t<0, std::tuple<P...>>>& datastream,
+				const std::string& host,
+				const int port,
+				const int n_threads = 1,
+				const int connect_timeout_sec = 60)
+			{
+				constexpr int N_LAYERS = sizeof...(P);
+
+				::tools::socket::Connection connection;
+				const auto start_time = std::chrono::steady_clock::now();
+				while (true)
+				{
+					connection = ::tools::socket::connect(host, port);
+					if (connection.is_open()) break;
+					if (std::chrono::steady_clock::now() - start_time > std::chrono::seconds(connect_timeout_sec))
+					{
+						log_WARNING("swarm:run_worker: could not connect to ", host, ":", port, ".\n");
+						return false;
+					}
+					std::this_thread::sleep_for(std::chrono::milliseconds(500));
+				}
+				connection.send_line("HELLO " + std::to_string(PROTOCOL_VERSION) + " " + std::to_string(N_LAYERS));
+
+				auto candidate = std::make_unique<swarm::priv::Candidate<P...>>(datastream);
+				std::string line;
+				while (connection.receive_line(line))
+				{
+					std::istringstream message(line);
+					std::string type;
+					int task = -1;
+					int n_rungs = 1;
+					int halving_rate = 2;
+					message >> type;
+					if (type == "QUIT") return true;
+
+					auto config = Configuration<N_LAYERS>(std::array<Dynamic_Param, N_LAYERS>());
+					message >> task >> n_rungs >> halving_rate;
+					for (auto& param : config.param) priv::read_param(message, param);
+					if ((type != "TASK") || message.fail())
+					{
+						log_WARNING("swarm:run_worker: invalid message \"", line, "\".\n");
+						return false;
+					}
+
+					const bool completed = candidate->evaluate(config, n_threads, n_rungs, halving_rate, [&](const int rung, const float mismatch)
+					{
+						std::ostringstream report;
+						report << "RUNG " << task << " " << rung << " " << std::setprecision(9) << mismatch;
+						std::string reply;
+						return connection.send_line(report.str()) && connection.receive_line(reply) && (reply.compare(0, 8, "CONTINUE") == 0);
+					});
+					if (completed)
+					{
+						std::ostringstream report;
+						report << "DONE " << task << " " << config.rung << " " << std::setprecision(9) << config.mismatch;
+						if (!connection.send_line(report.str())) break;
+						if (false) log_INFO("swarm:run_worker: ", config.str(), "\n");
+					}
+				}
+				log_WARNING("swarm:run_worker: lost the connection to ", host, ":", port, ".\n");
+				return false;
+			}
+		}
+	}
+}
@@ -58,6 +58,14 @@ namespace htm
 			return ((i & 0b111111) == 0) ? i : i + (0b1000000 - (i & 0b111111));
 		}
 
+		//Return the largest divisor of i that is not larger than the square root of i: the width of the most square grid with i elements.
+		constexpr int grid_dim1(const int i)
+		{
+			int result = 1;
+			for (int d = 2; (d * d) <= i; ++d) if ((i % d) == 0) result = d;
+			return result;
+		}
+
 		constexpr int get_global_cell_id(const int delay_and_cell_id)
 		{
 			return delay_and_cell_id & 0x1FFFFFFF;
@@ -71,6 +79,37 @@ namespace htm
 			return (static_cast<unsigned int>(delay) << (32 - 3)) | global_cell_id;
 		}
 
+		//Convert the stored origin of a distal synapse (P::TP_Origin) to a delay and cell id as made by create_delay_and_cell_id.
+		template <typename P>
+		constexpr int widen_origin(const typename P::TP_Origin origin)
+		{
+			if constexpr (P::TP_ORIGIN_NARROW)
+			{
+				if (origin == P::TP_DD_SYNAPSE_ORIGIN_INVALID) return P::TP_DD_SYNAPSE_ORIGIN_INVALID;
+				const int origin_u16 = static_cast<uint16_t>(origin);
+				return create_delay_and_cell_id(origin_u16 & P::TP_ORIGIN_CELL_MASK, origin_u16 >> P::TP_ORIGIN_DELAY_SHIFT);
+			}
+			else
+			{
+				return origin;
+			}
+		}
+
+		//Convert a delay and cell id as made by create_delay_and_cell_id to the stored origin of a distal synapse (P::TP_Origin).
+		template <typename P>
+		constexpr typename P::TP_Origin narrow_origin(const int delay_and_cell_id)
+		{
+			if constexpr (P::TP_ORIGIN_NARROW)
+			{
+				if (delay_and_cell_id == P::TP_DD_SYNAPSE_ORIGIN_INVALID) return static_cast<typename P::TP_Origin>(P::TP_DD_SYNAPSE_ORIGIN_INVALID);
+				return static_cast<typename P::TP_Origin>((get_delay(delay_and_cell_id) << P::TP_ORIGIN_DELAY_SHIFT) | get_global_cell_id(delay_and_cell_id));
+			}
+			else
+			{
+				return delay_and_cell_id;
+			}
+		}
+
 
 
 		template <int N_COLUMNS>
@@ -168,5 +207,31 @@ namespace htm
 			for (int i = 0; i < static_cast<int>(a.size()); ++i) a[i] = 0;
 		}
 
+		//Return the sum of the 8 epi32 elements.
+		inline int reduce_add_epi32(const __m256i a)
+		{
+			const __m128i x = _mm_add_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+			const __m128i y = _mm_add_epi32(x, _mm_shuffle_epi32(x, 0b01001110));
+			const __m128i z = _mm_add_epi32(y, _mm_shuffle_epi32(y, 0b10110001));
+			return _mm_cvtsi128_si32(z);
+		}
+		//Sign extend the 8 epi8 mask elements that start at element 8*i of the provided 32 elements to 8 epi32 mask elements.
+		template <int I>
+		inline __m256i expand_mask_epi8_epi32(const __m256i mask_epi8)
+		{
+			static_assert(I >= 0 && I < 4, "expand_mask_epi8_epi32: I out of range");
+			const __m128i half = _mm256_extracti128_si256(mask_epi8, I >> 1);
+			return _mm256_cvtepi8_epi32((I & 1) ? _mm_srli_si128(half, 8) : half);
+		}
+		//Pack four masks with 8 epi32 elements (elements 0-7, 8-15, 16-23 and 24-31) into one mask with 32 epi8 elements.
+		inline __m256i pack_mask_epi32_epi8(const __m256i a, const __m256i b, const __m256i c, const __m256i d)
+		{
+			// packs operates per 128-bit lane; the permute restores the element order
+			const __m256i ab_epi16 = _mm256_packs_epi32(a, b);
+			const __m256i cd_epi16 = _mm256_packs_epi32(c, d);
+			const __m256i abcd_epi8 = _mm256_packs_epi16(ab_epi16, cd_epi16);
+			return _mm256_permutevar8x32_epi32(abcd_epi8, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+		}
+
 	}
 }
\ No newline at end of file
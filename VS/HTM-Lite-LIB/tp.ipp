@@ -15,7 +15,7 @@
 // along with this program.  If not, see http://www.gnu.org/licenses.
 
 #pragma once
-#include <algorithm>	// std::min
+#include <algorithm>	// std::min, std::lower_bound
 #include <limits>		// std::numeric_limits
 #include <tuple>
 #include <array>
@@ -23,10 +23,13 @@
 #include <map>
 #include <set>
 #include <bitset>
+#include <atomic>
 
 #include "..\Spike-Tools-Lib\log.ipp"
 #include "..\Spike-Tools-Lib\assert.ipp"
 #include "..\Spike-Tools-Lib\random.ipp"
+#include "..\Spike-Tools-Lib\thread_pool.ipp"
+#include "..\Spike-Tools-Lib\profiler.ipp"
 
 #include "parameters.ipp"
 #include "print.ipp"
@@ -52,6 +55,527 @@ namespace htm
 		//HTM Temporal Pooler private methods
 		namespace priv
 		{
+			//Management of the distal dendrite slab of a column: segments get chunks of the slab; chunks of recycled
+			//or relocated segments are kept in a free-list such that the slab does not grow when segments are replaced.
+			namespace dd_slab
+			{
+				constexpr uint64_t pack_chunk(const int offset, const int capacity)
+				{
+					return (static_cast<uint64_t>(offset) << 32) | static_cast<uint64_t>(capacity);
+				}
+				constexpr int get_chunk_offset(const uint64_t chunk)
+				{
+					return static_cast<int>(chunk >> 32);
+				}
+				constexpr int get_chunk_capacity(const uint64_t chunk)
+				{
+					return static_cast<int>(chunk & 0xFFFFFFFF);
+				}
+
+				//Reserve a chunk with the provided capacity (a multiple of 64) in the slab of the provided column, and return its offset.
+				//The chunk is filled with unconnected synapses. Note that the slab may be reallocated.
+				template <typename P>
+				int allocate(
+					Layer_Persisted<P>& layer,
+					const int column_i,
+					const int capacity)
+				{
+					assert_msg((capacity & 0b111111) == 0, "TP:dd_slab:allocate: capacity ", capacity, " is not a multiple of 64.");
+
+					auto& free_chunks = layer.dd_slab_free_sf[column_i];
+					auto& permanence = layer.dd_synapse_permanence_sf[column_i];
+					auto& delay_origin = layer.dd_synapse_delay_origin_sf[column_i];
+
+					int offset = -1;
+					for (auto i = 0; i < static_cast<int>(free_chunks.size()); ++i)
+					{// first fit
+						const int chunk_capacity = get_chunk_capacity(free_chunks[i]);
+						if (chunk_capacity >= capacity)
+						{
+							offset = get_chunk_offset(free_chunks[i]);
+							if (chunk_capacity == capacity)
+							{// keep the free chunks in offset order
+								free_chunks.erase(free_chunks.begin() + i);
+							}
+							else
+							{
+								free_chunks[i] = pack_chunk(offset + capacity, chunk_capacity - capacity);
+							}
+							break;
+						}
+					}
+					if (offset == -1)
+					{// no free chunk available: append a chunk at the end of the slab
+						offset = static_cast<int>(permanence.size());
+						permanence.resize(offset + capacity);
+						delay_origin.resize(offset + capacity);
+						if constexpr (!P::TP_SYNAPSE_FORWARD) layer.dd_synapse_position_sb[column_i].resize(offset + capacity);
+					}
+
+					std::fill_n(permanence.data() + offset, capacity, static_cast<Permanence>(P::TP_DD_CONNECTED_THRESHOLD));
+					std::fill_n(delay_origin.data() + offset, capacity, static_cast<typename P::TP_Origin>(P::TP_DD_SYNAPSE_ORIGIN_INVALID)); // init with invalid number for debugging purposes
+					if constexpr (!P::TP_SYNAPSE_FORWARD) std::fill_n(layer.dd_synapse_position_sb[column_i].data() + offset, capacity, -1);
+					return offset;
+				}
+
+				//Return the chunk with the provided offset and capacity to the slab of the provided column. The free chunks
+				//are kept in offset order and the chunk is merged with a free chunk directly before or after it, such that
+				//freed neighbours can be reused by a larger segment; no free chunk ends at the end of the slab.
+				template <typename P>
+				void release(
+					Layer_Persisted<P>& layer,
+					const int column_i,
+					const int offset,
+					const int capacity)
+				{
+					auto& free_chunks = layer.dd_slab_free_sf[column_i];
+					auto& permanence = layer.dd_synapse_permanence_sf[column_i];
+
+					int begin = offset;
+					int end = offset + capacity;
+					auto next = std::lower_bound(free_chunks.begin(), free_chunks.end(), pack_chunk(offset, 0));
+					if ((next != free_chunks.end()) && (get_chunk_offset(*next) == end))
+					{// merge with the free chunk after
+						end += get_chunk_capacity(*next);
+						next = free_chunks.erase(next);
+					}
+					if ((next != free_chunks.begin()) && ((get_chunk_offset(*(next - 1)) + get_chunk_capacity(*(next - 1))) == begin))
+					{// merge with the free chunk before
+						begin = get_chunk_offset(*(next - 1));
+						next = free_chunks.erase(next - 1);
+					}
+
+					if (end == static_cast<int>(permanence.size()))
+					{// chunk is at the end of the slab: shrink the slab, the memory stays reserved
+						permanence.resize(begin);
+						layer.dd_synapse_delay_origin_sf[column_i].resize(begin);
+						if constexpr (!P::TP_SYNAPSE_FORWARD) layer.dd_synapse_position_sb[column_i].resize(begin);
+					}
+					else
+					{
+						free_chunks.insert(next, pack_chunk(begin, end - begin));
+					}
+				}
+
+				//Move the synapses of the provided segment to a chunk with the provided capacity.
+				template <typename P>
+				void relocate(
+					Layer_Persisted<P>& layer,
+					const int column_i,
+					const int segment_i,
+					const int new_capacity)
+				{
+					const int old_offset = layer.dd_segment_offset_sf[column_i][segment_i];
+					const int old_capacity = layer.dd_segment_capacity_sf[column_i][segment_i];
+					const int n_synapses = layer.dd_synapse_count_sf[column_i][segment_i];
+					assert_msg(n_synapses <= new_capacity, "TP:dd_slab:relocate: new_capacity ", new_capacity, " is too small for ", n_synapses, " synapses.");
+
+					const int new_offset = allocate(layer, column_i, new_capacity);
+					auto permanence_ptr = layer.dd_synapse_permanence_sf[column_i].data();
+					auto delay_origin_ptr = layer.dd_synapse_delay_origin_sf[column_i].data();
+					std::copy_n(permanence_ptr + old_offset, n_synapses, permanence_ptr + new_offset);
+					std::copy_n(delay_origin_ptr + old_offset, n_synapses, delay_origin_ptr + new_offset);
+					if constexpr (!P::TP_SYNAPSE_FORWARD)
+					{
+						auto position_ptr = layer.dd_synapse_position_sb[column_i].data();
+						std::copy_n(position_ptr + old_offset, n_synapses, position_ptr + new_offset);
+					}
+
+					release(layer, column_i, old_offset, old_capacity);
+					layer.dd_segment_offset_sf[column_i][segment_i] = new_offset;
+					layer.dd_segment_capacity_sf[column_i][segment_i] = new_capacity;
+				}
+
+				template <typename P>
+				void clear(
+					Layer_Persisted<P>& layer,
+					const int column_i)
+				{
+					layer.dd_synapse_permanence_sf[column_i].clear();
+					layer.dd_synapse_delay_origin_sf[column_i].clear();
+					layer.dd_segment_offset_sf[column_i].clear();
+					layer.dd_segment_capacity_sf[column_i].clear();
+					layer.dd_slab_free_sf[column_i].clear();
+					layer.dd_synapse_count_sf[column_i].clear();
+					if constexpr (!P::TP_SYNAPSE_FORWARD) layer.dd_synapse_position_sb[column_i].clear();
+				}
+			}
+
+			//Maintenance of the inverse synapse index (Layer_Persisted::dd_synapse_sb) used by the synapse backward engine.
+			//Columns record their changes in Layer_Fluent::dd_synapse_sb_changes; apply_changes merges them in the index.
+			namespace dd_sb
+			{
+				constexpr uint64_t pack_synapse(const int column_i, const int segment_i, const int synapse_i, const int delay)
+				{
+					return (static_cast<uint64_t>(column_i) << 32) | (static_cast<uint64_t>(segment_i) << 16) | (static_cast<uint64_t>(synapse_i) << 3) | static_cast<uint64_t>(delay);
+				}
+				constexpr int get_column(const uint64_t synapse)
+				{
+					return static_cast<int>(synapse >> 32);
+				}
+				constexpr int get_segment(const uint64_t synapse)
+				{
+					return static_cast<int>((synapse >> 16) & 0xFFFF);
+				}
+				constexpr int get_synapse(const uint64_t synapse)
+				{
+					return static_cast<int>((synapse >> 3) & 0x1FFF);
+				}
+				constexpr int get_synapse_delay(const uint64_t synapse)
+				{
+					return static_cast<int>(synapse & 0b111);
+				}
+
+				// a change holds the add flag (1 bit) and the presynaptic cell (31 bits) in the upper 32 bits, and the synapse without the column in the lower 32 bits
+				constexpr uint64_t ADD_FLAG = 1ull << 63;
+
+				// a removed synapse in the index of a cell, until apply_changes moves the last synapse of the cell in its place
+				constexpr uint64_t REMOVED = ~0ull;
+
+				//Position in the index of the synapse in the provided slot (see Layer_Persisted::dd_synapse_position_sb).
+				template <typename P>
+				int& position(
+					Layer_Persisted<P>& layer,
+					const int column_i,
+					const int segment_i,
+					const int synapse_i)
+				{
+					return layer.dd_synapse_position_sb[column_i][layer.dd_segment_offset_sf[column_i][segment_i] + synapse_i];
+				}
+
+				template <typename P>
+				void record(
+					Layer_Fluent<P>& layer_fluent,
+					const int column_i,
+					const uint64_t change,
+					const int position)
+				{
+					auto& changes = layer_fluent.dd_synapse_sb_changes[column_i];
+					if (changes.empty()) layer_fluent.dd_synapse_sb_changed_columns[column_i >> 6] |= 1ull << (column_i & 0b111111);
+					changes.push_back({ change, position });
+				}
+
+				//Record that the provided synapse of the provided column now originates from delay_and_cell_id.
+				template <typename P>
+				void add(
+					Layer_Fluent<P>& layer_fluent,
+					Layer_Persisted<P>& layer,
+					const int column_i,
+					const int segment_i,
+					const int synapse_i,
+					const int delay_and_cell_id)
+				{
+					static_assert(P::TP_N_DD_SEGMENTS_MAX <= 0x10000, "ERROR: TP:dd_sb: TP_N_DD_SEGMENTS_MAX does not fit in 16 bits.");
+					static_assert(P::TP_N_DD_SYNAPSES_MAX <= 0x2000, "ERROR: TP:dd_sb: TP_N_DD_SYNAPSES_MAX does not fit in 13 bits.");
+					if constexpr (!P::TP_SYNAPSE_FORWARD)
+					{
+						const uint64_t synapse = pack_synapse(0, segment_i, synapse_i, get_delay(delay_and_cell_id));
+						record(layer_fluent, column_i, ADD_FLAG | (static_cast<uint64_t>(get_global_cell_id(delay_and_cell_id)) << 32) | synapse, -1);
+						position(layer, column_i, segment_i, synapse_i) = -1; // known when the change is applied
+					}
+				}
+
+				//Record that the provided synapse of the provided column no longer originates from delay_and_cell_id.
+				template <typename P>
+				void remove(
+					Layer_Fluent<P>& layer_fluent,
+					Layer_Persisted<P>& layer,
+					const int column_i,
+					const int segment_i,
+					const int synapse_i,
+					const int delay_and_cell_id)
+				{
+					if constexpr (!P::TP_SYNAPSE_FORWARD)
+					{
+						if (delay_and_cell_id == P::TP_DD_SYNAPSE_ORIGIN_INVALID) return;
+						const uint64_t synapse = pack_synapse(0, segment_i, synapse_i, get_delay(delay_and_cell_id));
+						record(layer_fluent, column_i, (static_cast<uint64_t>(get_global_cell_id(delay_and_cell_id)) << 32) | synapse, position(layer, column_i, segment_i, synapse_i));
+					}
+				}
+
+				//Merge the changes recorded by the columns in the inverse synapse index; the changes of a column are applied in
+				//recorded order. Only the columns with changes are visited, and a removed synapse is found by its recorded
+				//position (only a synapse that was added in the same time step is searched), such that the cost is in the
+				//number of changes.
+				template <typename P>
+				void apply_changes(
+					Layer_Fluent<P>& layer_fluent,
+					Layer_Persisted<P>& layer)
+				{
+					auto& changed_columns = layer_fluent.dd_synapse_sb_changed_columns;
+
+					// first pass: append the added synapses and mark the removed synapses; no synapse moves, such that the
+					// recorded positions stay valid
+					for (int block_i = 0; block_i < static_cast<int>(changed_columns.size()); ++block_i)
+					{
+						for (uint64_t columns = changed_columns[block_i]; columns != 0; columns &= columns - 1)
+						{
+							const int column_i = (block_i << 6) + static_cast<int>(_tzcnt_u64(columns));
+							for (auto& change : layer_fluent.dd_synapse_sb_changes[column_i])
+							{
+								const int global_cell_id = static_cast<int>((change.change >> 32) & 0x7FFFFFFF);
+								const uint64_t synapse = (static_cast<uint64_t>(column_i) << 32) | (change.change & 0xFFFFFFFF);
+								auto& synapses = layer.dd_synapse_sb[global_cell_id];
+								const int segment_i = get_segment(synapse);
+								const int synapse_i = get_synapse(synapse);
+
+								if (change.change & ADD_FLAG)
+								{// the segment may have been recycled after the add: only the synapses in the segment have a slot
+									if (synapse_i < layer.dd_synapse_count_sf[column_i][segment_i]) position(layer, column_i, segment_i, synapse_i) = static_cast<int>(synapses.size());
+									synapses.push_back(synapse);
+									layer.dd_synapse_count_total_sb++;
+								}
+								else
+								{
+									int pos = change.position;
+									if ((pos < 0) || (pos >= static_cast<int>(synapses.size())) || (synapses[pos] != synapse))
+									{// the synapse was added in this time step
+										pos = static_cast<int>(std::find(synapses.begin(), synapses.end(), synapse) - synapses.begin());
+									}
+									assert_msg(pos < static_cast<int>(synapses.size()), "TP:dd_sb:apply_changes: column ", column_i, "; synapse ", synapse_i, " of segment ", segment_i, " is not in the index of cell ", global_cell_id);
+									if (pos < static_cast<int>(synapses.size()))
+									{
+										synapses[pos] = REMOVED;
+										layer.dd_synapse_count_total_sb--;
+										change.position = pos;
+									}
+									else change.position = -1;
+								}
+							}
+						}
+					}
+
+					// second pass: move the last synapse of a cell into every removed position of that cell
+					for (int block_i = 0; block_i < static_cast<int>(changed_columns.size()); ++block_i)
+					{
+						for (uint64_t columns = changed_columns[block_i]; columns != 0; columns &= columns - 1)
+						{
+							const int column_i = (block_i << 6) + static_cast<int>(_tzcnt_u64(columns));
+							auto& changes = layer_fluent.dd_synapse_sb_changes[column_i];
+							for (const auto& change : changes)
+							{
+								if ((change.change & ADD_FLAG) || (change.position == -1)) continue;
+								auto& synapses = layer.dd_synapse_sb[static_cast<int>((change.change >> 32) & 0x7FFFFFFF)];
+								while (!synapses.empty() && (synapses.back() == REMOVED)) synapses.pop_back();
+								if (change.position < static_cast<int>(synapses.size()))
+								{// synapses.back() is not removed, hence it is behind the removed position
+									const uint64_t moved = synapses.back();
+									synapses[change.position] = moved;
+									synapses.pop_back();
+									position(layer, get_column(moved), get_segment(moved), get_synapse(moved)) = change.position;
+								}
+							}
+							changes.clear();
+						}
+						changed_columns[block_i] = 0;
+					}
+				}
+
+				//Rebuild Layer_Persisted::dd_synapse_position_sb from the inverse synapse index.
+				template <typename P>
+				void rebuild_positions(
+					Layer_Persisted<P>& layer)
+				{
+					if constexpr (!P::TP_SYNAPSE_FORWARD)
+					{
+						for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+						{
+							layer.dd_synapse_position_sb[column_i].assign(layer.dd_synapse_permanence_sf[column_i].size(), -1);
+						}
+						for (const auto& synapses : layer.dd_synapse_sb)
+						{
+							for (int i = 0; i < static_cast<int>(synapses.size()); ++i)
+							{
+								position(layer, get_column(synapses[i]), get_segment(synapses[i]), get_synapse(synapses[i])) = i;
+							}
+						}
+					}
+				}
+
+				template <typename P>
+				void clear(
+					Layer_Fluent<P>& layer_fluent,
+					Layer_Persisted<P>& layer)
+				{
+					if constexpr (!P::TP_SYNAPSE_FORWARD)
+					{
+						for (auto& synapses : layer.dd_synapse_sb) synapses.clear();
+						for (auto& changes : layer_fluent.dd_synapse_sb_changes) changes.clear();
+						std::fill(layer_fluent.dd_synapse_sb_changed_columns.begin(), layer_fluent.dd_synapse_sb_changed_columns.end(), 0);
+						layer.dd_synapse_count_total_sb = 0;
+					}
+				}
+
+				//Rebuild the inverse synapse index from the slabs; needed after synapses have been moved by compact_column.
+				template <typename P>
+				void rebuild(
+					Layer_Fluent<P>& layer_fluent,
+					Layer_Persisted<P>& layer)
+				{
+					if constexpr (!P::TP_SYNAPSE_FORWARD)
+					{
+						clear(layer_fluent, layer);
+						for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+						{
+							for (int segment_i = 0; segment_i < layer.dd_segment_count[column_i]; ++segment_i)
+							{
+								const typename P::TP_Origin * delay_origin_segment = layer.dd_synapse_delay_origin_segment(column_i, segment_i);
+								for (int synapse_i = 0; synapse_i < layer.dd_synapse_count_sf[column_i][segment_i]; ++synapse_i)
+								{
+									const int delay_and_cell_id = widen_origin<P>(delay_origin_segment[synapse_i]);
+									if (delay_and_cell_id == P::TP_DD_SYNAPSE_ORIGIN_INVALID) continue;
+									layer.dd_synapse_sb[get_global_cell_id(delay_and_cell_id)].push_back(pack_synapse(column_i, segment_i, synapse_i, get_delay(delay_and_cell_id)));
+									layer.dd_synapse_count_total_sb++;
+								}
+							}
+						}
+						rebuild_positions(layer);
+					}
+				}
+			}
+
+			//Remove the dead synapses (permanence at or below TP_DD_CONNECTED_THRESHOLD; grow_DD_synapses only reuses
+			//their slots) and the segments without live synapses from the provided column, and repack the slab such that
+			//it has no free chunks and every segment has the smallest capacity (a multiple of 64) for its synapses.
+			//Segments keep their order; new_segment_index is scratch. Returns the number of removed synapses and segments.
+			template <typename P>
+			std::tuple<int, int> compact_column(
+				Layer_Fluent<P>& layer_fluent,
+				Layer_Persisted<P>& layer,
+				const int column_i,
+				std::vector<int>& new_segment_index)
+			{
+				const int n_segments = layer.dd_segment_count[column_i];
+				auto& synapse_count = layer.dd_synapse_count_sf[column_i];
+				auto& offset = layer.dd_segment_offset_sf[column_i];
+				auto& capacity = layer.dd_segment_capacity_sf[column_i];
+				const auto& permanence = layer.dd_synapse_permanence_sf[column_i];
+				const auto& delay_origin = layer.dd_synapse_delay_origin_sf[column_i];
+
+				//count the live synapses; nothing to do when the column has no dead synapses, empty segments or free chunks
+				new_segment_index.resize(n_segments);
+				int n_removed_synapses = 0;
+				int n_removed_segments = 0;
+				int new_slab_size = 0;
+				bool tight = layer.dd_slab_free_sf[column_i].empty();
+				for (int segment_i = 0; segment_i < n_segments; ++segment_i)
+				{
+					int n_live = 0;
+					for (int synapse_i = 0; synapse_i < synapse_count[segment_i]; ++synapse_i)
+					{
+						if (permanence[offset[segment_i] + synapse_i] > P::TP_DD_CONNECTED_THRESHOLD) n_live++;
+					}
+					n_removed_synapses += synapse_count[segment_i] - n_live;
+					if (n_live == 0)
+					{
+						new_segment_index[segment_i] = -1;
+						n_removed_segments++;
+						tight = false;
+					}
+					else
+					{
+						new_segment_index[segment_i] = segment_i - n_removed_segments;
+						new_slab_size += htm::tools::multiple_64(n_live);
+						if (capacity[segment_i] != htm::tools::multiple_64(n_live)) tight = false;
+					}
+				}
+				if (tight && (n_removed_synapses == 0)) return std::make_tuple(0, 0);
+
+				//copy the live synapses to a new slab of exactly the needed size, such that the memory of the old slab is freed
+				typename Layer_Persisted<P>::t5 new_permanence(new_slab_size, static_cast<Permanence>(P::TP_DD_CONNECTED_THRESHOLD));
+				typename Layer_Persisted<P>::t6 new_delay_origin(new_slab_size, static_cast<typename P::TP_Origin>(P::TP_DD_SYNAPSE_ORIGIN_INVALID));
+				std::vector<int> new_position((P::TP_SYNAPSE_FORWARD) ? 0 : new_slab_size, -1);
+				int new_offset = 0;
+				for (int segment_i = 0; segment_i < n_segments; ++segment_i)
+				{
+					const int new_segment_i = new_segment_index[segment_i];
+					if (new_segment_i == -1) continue;
+
+					int n_live = 0;
+					for (int synapse_i = 0; synapse_i < synapse_count[segment_i]; ++synapse_i)
+					{
+						const int old_i = offset[segment_i] + synapse_i;
+						if (permanence[old_i] > P::TP_DD_CONNECTED_THRESHOLD)
+						{
+							new_permanence[new_offset + n_live] = permanence[old_i];
+							new_delay_origin[new_offset + n_live] = delay_origin[old_i];
+							if constexpr (!P::TP_SYNAPSE_FORWARD) new_position[new_offset + n_live] = layer.dd_synapse_position_sb[column_i][old_i];
+							n_live++;
+						}
+					}
+					// new_segment_i <= segment_i: the per segment vectors are compacted in place
+					synapse_count[new_segment_i] = n_live;
+					offset[new_segment_i] = new_offset;
+					capacity[new_segment_i] = htm::tools::multiple_64(n_live);
+					layer.dd_segment_destination[column_i][new_segment_i] = layer.dd_segment_destination[column_i][segment_i];
+					layer_fluent.dd_synapse_active_time[column_i][new_segment_i] = layer_fluent.dd_synapse_active_time[column_i][segment_i];
+					new_offset += capacity[new_segment_i];
+				}
+				layer.dd_synapse_permanence_sf[column_i].swap(new_permanence);
+				layer.dd_synapse_delay_origin_sf[column_i].swap(new_delay_origin);
+				layer.dd_slab_free_sf[column_i] = std::vector<uint64_t>();
+				if constexpr (!P::TP_SYNAPSE_FORWARD) layer.dd_synapse_position_sb[column_i].swap(new_position); // moved along; rebuilt when synapses are removed
+
+				if (n_removed_segments > 0)
+				{
+					const int n_segments_new = n_segments - n_removed_segments;
+					layer.dd_segment_count[column_i] = n_segments_new;
+					synapse_count.resize(n_segments_new);
+					offset.resize(n_segments_new);
+					capacity.resize(n_segments_new);
+					layer.dd_segment_destination[column_i].resize(n_segments_new);
+					layer_fluent.dd_synapse_active_time[column_i].resize(n_segments_new);
+
+					layer_fluent.dd_segment_lru[column_i].remap(new_segment_index);
+					for (auto* segments : { &layer_fluent.active_dd_segments[column_i], &layer_fluent.matching_dd_segments[column_i] })
+					{
+						segments->current().remap(new_segment_index);
+						segments->prev().remap(new_segment_index);
+					}
+				}
+				return std::make_tuple(n_removed_synapses, n_removed_segments);
+			}
+
+			//Load 16 origins of distal synapses (aligned at 16 origins) in 32-bit lanes: narrow origins are zero extended such
+			//that the cell id is in the bits of P::TP_ORIGIN_CELL_MASK and the delay starts at bit P::TP_ORIGIN_DELAY_SHIFT.
+			template <typename P>
+			__m512i load_origin_epi32(const typename P::TP_Origin * origin)
+			{
+				if constexpr (P::TP_ORIGIN_NARROW)
+					return _mm512_cvtepu16_epi32(_mm256_load_si256(reinterpret_cast<const __m256i *>(origin)));
+				else
+					return _mm512_load_si512(origin);
+			}
+
+			//AVX2 variant of load_origin_epi32: load 8 origins (aligned at 8 origins).
+			template <typename P>
+			__m256i load_origin_avx2_epi32(const typename P::TP_Origin * origin)
+			{
+				if constexpr (P::TP_ORIGIN_NARROW)
+					return _mm256_cvtepu16_epi32(_mm_load_si128(reinterpret_cast<const __m128i *>(origin)));
+				else
+					return _mm256_load_si256(reinterpret_cast<const __m256i *>(origin));
+			}
+
+			//Call func(column_begin, column_end) for chunks of columns that together cover all columns. With param.n_threads
+			//equal to one, func is called once with all columns (the serial path); otherwise the chunks are distributed over
+			//the shared thread pool. Chunks are multiples of 64 columns such that threads do not write to the same cache lines.
+			template <typename P, typename F>
+			void for_each_column_chunk(
+				const Dynamic_Param& param,
+				const F& func)
+			{
+				if (param.n_threads <= 1)
+				{
+					func(0, P::N_COLUMNS);
+				}
+				else
+				{
+					const int chunk_size = htm::tools::multiple_64(std::max(1, param.n_columns_per_chunk));
+					::tools::thread_pool::get_pool(param.n_threads).parallel_for(P::N_COLUMNS, chunk_size, func);
+				}
+			}
+
 			namespace activate_cells
 			{
 				template <typename P>
@@ -64,7 +588,7 @@ namespace htm
 					const typename Layer_Fluent<P>::Winner_Cells& winner_cells,
 					const int select_size,
 					//out
-					std::vector<int>& selected_delay_and_cells) // assumes that selected_cells has sufficient capacity (size >= select_size)
+					int * selected_delay_and_cells) // assumes that selected_cells has sufficient capacity (size >= select_size)
 				{
 					assert_msg(segment_i < layer.dd_segment_count[column_i], "TP:select_cell_to_learn_on: segment_i=", segment_i + " is too large. dd_segment_count=", layer.dd_segment_count[column_i]);
 
@@ -77,7 +601,7 @@ namespace htm
 
 					unsigned int random_number = layer_fluent.random_number[column_i];
 
-					const auto& dd_synapse_delay_origin_segment = layer.dd_synapse_delay_origin_sf[column_i][segment_i];
+					const typename P::TP_Origin * dd_synapse_delay_origin_segment = layer.dd_synapse_delay_origin_segment(column_i, segment_i);
 					const auto n_synapses = layer.dd_synapse_count_sf[column_i][segment_i];
 
 					int selected_cells_count = 0;
@@ -114,7 +638,7 @@ namespace htm
 						{
 							for (auto synapse_i = 0; synapse_i < n_synapses; ++synapse_i)
 							{// search the existing synapses whether the cell already has a pathway to this segment
-								if (get_global_cell_id(dd_synapse_delay_origin_segment[synapse_i]) == delay_and_cell_id)
+								if (get_global_cell_id(widen_origin<P>(dd_synapse_delay_origin_segment[synapse_i])) == delay_and_cell_id)
 								{
 									already_present = true; // found it
 									break;
@@ -155,12 +679,12 @@ namespace htm
 						const typename Layer_Fluent<P>::Active_Cells& active_cells,
 						const Permanence permanence_dec)
 					{
-						const auto& dd_synapse_delay_origin_segment = layer.dd_synapse_delay_origin_sf[column_i][segment_i];
-						auto& dd_synapse_permanence_segment = layer.dd_synapse_permanence_sf[column_i][segment_i];
+						const typename P::TP_Origin * dd_synapse_delay_origin_segment = layer.dd_synapse_delay_origin_segment(column_i, segment_i);
+						Permanence * dd_synapse_permanence_segment = layer.dd_synapse_permanence_segment(column_i, segment_i);
 
 						for (auto synapse_i = 0; synapse_i < layer.dd_synapse_count_sf[column_i][segment_i]; ++synapse_i)
 						{
-							const auto delay_cell_id = dd_synapse_delay_origin_segment[synapse_i];
+							const int delay_cell_id = widen_origin<P>(dd_synapse_delay_origin_segment[synapse_i]);
 							const int global_cell_id = get_global_cell_id(delay_cell_id);
 							const int delay = get_delay(delay_cell_id);
 							const bool b = active_cells.get(global_cell_id, delay);
@@ -177,15 +701,15 @@ namespace htm
 						const Permanence permanence_inc,
 						const Permanence permanence_dec)
 					{
-						const auto& dd_synapse_delay_origin_segment = layer.dd_synapse_delay_origin_sf[column_i][segment_i];
-						auto& dd_synapse_permanence_segment = layer.dd_synapse_permanence_sf[column_i][segment_i];
+						const typename P::TP_Origin * dd_synapse_delay_origin_segment = layer.dd_synapse_delay_origin_segment(column_i, segment_i);
+						Permanence * dd_synapse_permanence_segment = layer.dd_synapse_permanence_segment(column_i, segment_i);
 						
 						for (auto synapse_i = 0; synapse_i < layer.dd_synapse_count_sf[column_i][segment_i]; ++synapse_i)
 						{
 							const Permanence old_permanence = dd_synapse_permanence_segment[synapse_i];
 							if (old_permanence > P::TP_DD_CONNECTED_THRESHOLD)
 							{
-								const auto delay_and_cell_id = dd_synapse_delay_origin_segment[synapse_i];
+								const int delay_and_cell_id = widen_origin<P>(dd_synapse_delay_origin_segment[synapse_i]);
 								const int global_cell_id = get_global_cell_id(delay_and_cell_id);
 								const int delay = get_delay(delay_and_cell_id);
 								const bool b = active_cells.get(global_cell_id, delay); // deadly gather here!
@@ -197,18 +721,20 @@ namespace htm
 						}
 					}
 
+					template <typename P>
 					__mmask16 get_sensors_mask(
 						const __mmask16 mask,
 						const __m512i delay_and_origin,
 						const void * active_sensors_ptr)
 					{
-						const __m512i global_cell_id = _mm512_and_epi32(delay_and_origin, _mm512_set1_epi32(0x1FFFFFFF));
-						const __m512i byte_pos_in_int = _mm512_and_epi32(delay_and_origin, _mm512_set1_epi32(0b11));
-						const __m512i delay = _mm512_srli_epi32(delay_and_origin, 32 - 3);
+						using Active_Cells = typename Layer_Fluent<P>::Active_Cells;
+						const __m512i global_cell_id = _mm512_and_epi32(delay_and_origin, _mm512_set1_epi32(P::TP_ORIGIN_CELL_MASK));
+						const __m512i cell_pos_in_int = _mm512_and_epi32(delay_and_origin, _mm512_set1_epi32((1 << Active_Cells::CELLS_PER_WORD_LOG2) - 1));
+						const __m512i delay = _mm512_srli_epi32(delay_and_origin, P::TP_ORIGIN_DELAY_SHIFT);
 
-						const __m512i int_addr = _mm512_srli_epi32(global_cell_id, 2);
+						const __m512i int_addr = _mm512_srli_epi32(global_cell_id, Active_Cells::CELLS_PER_WORD_LOG2);
 						const __m512i sensor_int = _mm512_mask_i32gather_epi32(_mm512_setzero_epi32(), mask, int_addr, active_sensors_ptr, 4);
-						const __m512i pos_in_int = _mm512_slli_epi32(byte_pos_in_int, 3);
+						const __m512i pos_in_int = _mm512_slli_epi32(cell_pos_in_int, Active_Cells::BITS_PER_CELL_LOG2);
 						const __m512i delay_shift = _mm512_add_epi32(delay, pos_in_int);
 						const __m512i delay_mask = _mm512_sllv_epi32(_mm512_set1_epi32(1), delay_shift);
 						return _mm512_cmpeq_epi32_mask(_mm512_and_epi32(sensor_int, delay_mask), delay_mask);
@@ -223,28 +749,30 @@ namespace htm
 						const Permanence permanence_inc,
 						const Permanence permanence_dec)
 					{
+						const int n_synapses = layer.dd_synapse_count_sf[column_i][segment_i];
+						Permanence * dd_synapse_permanence_segment = layer.dd_synapse_permanence_segment(column_i, segment_i);
+
+						const bool compare_to_ref = DEBUG_ON;
+						std::vector<Permanence> permanence_ref;
 						if constexpr (DEBUG_ON) {
-							const bool compare_to_ref = true;
-							std::vector<Permanence, types::priv::Allocator<Permanence>> permanence_org;
-							std::vector<Permanence, types::priv::Allocator<Permanence>> permanence_ref;
 							if (compare_to_ref)
 							{
-								permanence_org = layer.dd_synapse_permanence_sf[column_i][segment_i];
+								const std::vector<Permanence> permanence_org(dd_synapse_permanence_segment, dd_synapse_permanence_segment + n_synapses);
 								adapt_segment_ref(layer, column_i, segment_i, active_cells, permanence_inc, permanence_dec);
-								permanence_ref = layer.dd_synapse_permanence_sf[column_i][segment_i];
-								layer.dd_synapse_permanence_sf[column_i][segment_i] = permanence_org;
+								permanence_ref.assign(dd_synapse_permanence_segment, dd_synapse_permanence_segment + n_synapses);
+								std::copy(permanence_org.begin(), permanence_org.end(), dd_synapse_permanence_segment);
 							}
 						}
 
-						auto permanence_epi8_ptr = reinterpret_cast<__m512i *>(layer.dd_synapse_permanence_sf[column_i][segment_i].data());
-						auto delay_origin_epi32_ptr = reinterpret_cast<const __m512i *>(layer.dd_synapse_delay_origin_sf[column_i][segment_i].data());
+						auto permanence_epi8_ptr = reinterpret_cast<__m512i *>(dd_synapse_permanence_segment);
+						const typename P::TP_Origin * delay_origin_ptr = layer.dd_synapse_delay_origin_segment(column_i, segment_i);
 						auto active_cells_ptr = active_cells.data();
 
 						const __m512i connected_threshold_epi8 = _mm512_set1_epi8(P::TP_DD_CONNECTED_THRESHOLD);
 						const __m512i inc_epi8 = _mm512_set1_epi8(permanence_inc);
 						const __m512i dec_epi8 = _mm512_set1_epi8(-permanence_dec);
 
-						const int n_blocks = tools::n_blocks_64(layer.dd_synapse_count_sf[column_i][segment_i]);
+						const int n_blocks = tools::n_blocks_64(n_synapses);
 
 						for (int block = 0; block < n_blocks; ++block)
 						{
@@ -257,7 +785,7 @@ namespace htm
 									const __mmask16 connected_mask_16 = static_cast<__mmask16>(connected_mask_64 >> (i * 16));
 									if (connected_mask_16 != 0)
 									{
-										const __mmask64 tmp_mask_64 = get_sensors_mask(connected_mask_16, delay_origin_epi32_ptr[(block * 4) + i], active_cells_ptr);
+										const __mmask64 tmp_mask_64 = get_sensors_mask<P>(connected_mask_16, load_origin_epi32<P>(&delay_origin_ptr[(block * 64) + (i * 16)]), active_cells_ptr);
 										active_cells_mask_64 |= tmp_mask_64 << (i * 16);
 									}
 								}
@@ -269,9 +797,9 @@ namespace htm
 						if constexpr (DEBUG_ON) {
 							if (compare_to_ref)
 							{
-								const auto& permanence_avx512 = layer.dd_synapse_permanence_sf[column_i][segment_i];
+								const Permanence * permanence_avx512 = dd_synapse_permanence_segment;
 
-								for (auto synapse_i = 0; synapse_i < layer.dd_synapse_count_sf[column_i][segment_i]; ++synapse_i)
+								for (auto synapse_i = 0; synapse_i < n_synapses; ++synapse_i)
 								{
 									if (permanence_ref[synapse_i] != permanence_avx512[synapse_i])
 									{
@@ -282,6 +810,95 @@ namespace htm
 						}
 					}
 
+					//Return mask with all bits set for the synapses whose origin cell is active with the delay of the synapse
+					template <typename P>
+					__m256i get_sensors_mask_avx2(
+						const __m256i mask,
+						const __m256i delay_and_origin,
+						const void * active_sensors_ptr)
+					{
+						using Active_Cells = typename Layer_Fluent<P>::Active_Cells;
+						const __m256i global_cell_id = _mm256_and_si256(delay_and_origin, _mm256_set1_epi32(P::TP_ORIGIN_CELL_MASK));
+						const __m256i cell_pos_in_int = _mm256_and_si256(delay_and_origin, _mm256_set1_epi32((1 << Active_Cells::CELLS_PER_WORD_LOG2) - 1));
+						const __m256i delay = _mm256_srli_epi32(delay_and_origin, P::TP_ORIGIN_DELAY_SHIFT);
+
+						const __m256i int_addr = _mm256_srli_epi32(global_cell_id, Active_Cells::CELLS_PER_WORD_LOG2);
+						const __m256i sensor_int = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int *>(active_sensors_ptr), int_addr, mask, 4);
+						const __m256i pos_in_int = _mm256_slli_epi32(cell_pos_in_int, Active_Cells::BITS_PER_CELL_LOG2);
+						const __m256i delay_shift = _mm256_add_epi32(delay, pos_in_int);
+						const __m256i delay_mask = _mm256_sllv_epi32(_mm256_set1_epi32(1), delay_shift);
+						return _mm256_and_si256(mask, _mm256_cmpeq_epi32(_mm256_and_si256(sensor_int, delay_mask), delay_mask));
+					}
+
+					template <typename P>
+					void adapt_segment_avx2(
+						Layer_Persisted<P>& layer,
+						const int column_i,
+						const int segment_i,
+						const typename Layer_Fluent<P>::Active_Cells& active_cells,
+						const Permanence permanence_inc,
+						const Permanence permanence_dec)
+					{
+						const int n_synapses = layer.dd_synapse_count_sf[column_i][segment_i];
+						Permanence * dd_synapse_permanence_segment = layer.dd_synapse_permanence_segment(column_i, segment_i);
+
+						const bool compare_to_ref = DEBUG_ON;
+						std::vector<Permanence> permanence_ref;
+						if constexpr (DEBUG_ON) {
+							if (compare_to_ref)
+							{
+								const std::vector<Permanence> permanence_org(dd_synapse_permanence_segment, dd_synapse_permanence_segment + n_synapses);
+								adapt_segment_ref(layer, column_i, segment_i, active_cells, permanence_inc, permanence_dec);
+								permanence_ref.assign(dd_synapse_permanence_segment, dd_synapse_permanence_segment + n_synapses);
+								std::copy(permanence_org.begin(), permanence_org.end(), dd_synapse_permanence_segment);
+							}
+						}
+
+						auto permanence_epi8_ptr = reinterpret_cast<__m256i *>(dd_synapse_permanence_segment);
+						const typename P::TP_Origin * delay_origin_ptr = layer.dd_synapse_delay_origin_segment(column_i, segment_i);
+						auto active_cells_ptr = active_cells.data();
+
+						const __m256i connected_threshold_epi8 = _mm256_set1_epi8(P::TP_DD_CONNECTED_THRESHOLD);
+						const __m256i inc_epi8 = _mm256_set1_epi8(permanence_inc);
+						const __m256i dec_epi8 = _mm256_set1_epi8(permanence_dec);
+
+						const int n_blocks = tools::n_blocks_32(n_synapses);
+
+						for (int block = 0; block < n_blocks; ++block)
+						{
+							const __m256i old_permanence_epi8 = _mm256_load_si256(&permanence_epi8_ptr[block]); //load 32 permanence values
+							const __m256i connected_epi8 = _mm256_cmpgt_epi8(old_permanence_epi8, connected_threshold_epi8);
+							if (_mm256_testz_si256(connected_epi8, connected_epi8)) continue;
+
+							const __m256i active_cells_epi8 = tools::pack_mask_epi32_epi8(
+								get_sensors_mask_avx2<P>(tools::expand_mask_epi8_epi32<0>(connected_epi8), load_origin_avx2_epi32<P>(&delay_origin_ptr[(block * 32) + 0]), active_cells_ptr),
+								get_sensors_mask_avx2<P>(tools::expand_mask_epi8_epi32<1>(connected_epi8), load_origin_avx2_epi32<P>(&delay_origin_ptr[(block * 32) + 8]), active_cells_ptr),
+								get_sensors_mask_avx2<P>(tools::expand_mask_epi8_epi32<2>(connected_epi8), load_origin_avx2_epi32<P>(&delay_origin_ptr[(block * 32) + 16]), active_cells_ptr),
+								get_sensors_mask_avx2<P>(tools::expand_mask_epi8_epi32<3>(connected_epi8), load_origin_avx2_epi32<P>(&delay_origin_ptr[(block * 32) + 24]), active_cells_ptr));
+
+							const __m256i new_permanence_epi8 = _mm256_blendv_epi8(
+								_mm256_subs_epi8(old_permanence_epi8, dec_epi8),
+								_mm256_adds_epi8(old_permanence_epi8, inc_epi8),
+								active_cells_epi8);
+							_mm256_store_si256(&permanence_epi8_ptr[block], _mm256_blendv_epi8(old_permanence_epi8, new_permanence_epi8, connected_epi8));
+						}
+
+						if constexpr (DEBUG_ON) {
+							if (compare_to_ref)
+							{
+								const Permanence * permanence_avx2 = dd_synapse_permanence_segment;
+
+								for (auto synapse_i = 0; synapse_i < n_synapses; ++synapse_i)
+								{
+									if (permanence_ref[synapse_i] != permanence_avx2[synapse_i])
+									{
+										log_ERROR("TP:adapt_segment_avx2:: UNEQUAL permanence for synapse_i ", synapse_i, ": ref ", static_cast<int>(permanence_ref[synapse_i]), "; avx2 ", static_cast<int>(permanence_avx2[synapse_i]));
+									}
+								}
+							}
+						}
+					}
+
 					template <typename P>
 					void d(
 						Layer_Persisted<P>& layer,
@@ -293,8 +910,10 @@ namespace htm
 					{
 						assert_msg(segment_i < layer.dd_segment_count[column_i], "TP:grow_DD_synapses: segment_i=", segment_i + " is too large. dd_segment_count=", layer.dd_segment_count[column_i]);
 						if (false) log_INFO_DEBUG("TP:adapt_segment: column ", column_i, "; segment_i ", segment_i);
+						::tools::profiler::Scope scope("tp.adapt_segment");
 
 						if (architecture_switch(P::ARCH) == arch_t::X64) return adapt_segment_ref(layer, column_i, segment_i, active_cells, permanence_inc, permanence_dec);
+						if (architecture_switch(P::ARCH) == arch_t::AVX2) return adapt_segment_avx2(layer, column_i, segment_i, active_cells, permanence_inc, permanence_dec);
 						if (architecture_switch(P::ARCH) == arch_t::AVX512) return adapt_segment_avx512(layer, column_i, segment_i, active_cells, permanence_inc, permanence_dec);
 					}
 
@@ -308,6 +927,7 @@ namespace htm
 					{
 						assert_msg(segment_i < layer.dd_segment_count[column_i], "TP:grow_DD_synapses: segment_i=", segment_i, " is too large. dd_segment_count=", layer.dd_segment_count[column_i]);
 						if (false) log_INFO_DEBUG("TP:adapt_segment: column ", column_i, "; segment_i ", segment_i);
+						::tools::profiler::Scope scope("tp.adapt_segment");
 						return adapt_segment_ref(layer, column_i, segment_i, active_cells, permanence_dec);
 					}
 				}
@@ -321,7 +941,7 @@ namespace htm
 						Layer_Persisted<P>& layer,
 						const int column_i,
 						const int segment_i,
-						const int n_desired_new_synapses,
+						const int n_desired_new_synapses_in,
 						const Dynamic_Param& param,
 						const typename Layer_Fluent<P>::Winner_Cells& winner_cells)
 					{
@@ -330,16 +950,17 @@ namespace htm
 						}
 						assert_msg(segment_i < layer.dd_segment_count[column_i], "TP:grow_DD_synapses_ref: segment=", segment_i, " is too large; dd_segment_count=", layer.dd_segment_count[column_i]);
 
-						if (n_desired_new_synapses <= 0) return; // nothing to do
+						if (n_desired_new_synapses_in <= 0) return; // nothing to do
 
-						auto& dd_synapse_permanence_segment = layer.dd_synapse_permanence_sf[column_i][segment_i];
-						auto& dd_synapse_delay_origin_segment = layer.dd_synapse_delay_origin_sf[column_i][segment_i];
-						assert_msg(dd_synapse_permanence_segment.size() == dd_synapse_delay_origin_segment.size(), "TP:grow_DD_synapses_ref: bug A.");
+						// a segment cannot hold more than TP_N_DD_SYNAPSES_MAX synapses, which bounds the buffers on the stack
+						const int n_desired_new_synapses = std::min(n_desired_new_synapses_in, P::TP_N_DD_SYNAPSES_MAX);
 
 						const int old_size = layer.dd_synapse_count_sf[column_i][segment_i];
+						const Permanence * dd_synapse_permanence_segment = layer.dd_synapse_permanence_segment(column_i, segment_i);
 
 						//find indices that will be overwritten with new values
-						std::vector<int> indices_to_update = std::vector<int>(n_desired_new_synapses, -1);
+						std::array<int, P::TP_N_DD_SYNAPSES_MAX> indices_to_update;
+						if constexpr (DEBUG_ON) indices_to_update.fill(-1);
 
 						//log_INFO_DEBUG("TP:grow_DD_synapses_ref: Start: old_size=", old_size, "; n_desired_new_synapses=", n_desired_new_synapses);
 
@@ -387,18 +1008,16 @@ namespace htm
 							}
 							if (k > 0)
 							{
-								const int old_capacity = static_cast<int>(dd_synapse_permanence_segment.size());
+								const int old_capacity = layer.dd_segment_capacity_sf[column_i][segment_i];
 								assert_msg(old_size <= old_capacity, "TP:grow_DD_synapses_ref: bug B.");
 								const int new_size = old_size + k;
 								if (new_size > old_capacity)
-								{
-									dd_synapse_permanence_segment.resize(htm::tools::multiple_64(new_size), P::TP_DD_CONNECTED_THRESHOLD);
-									dd_synapse_delay_origin_segment.resize(htm::tools::multiple_64(new_size), P::TP_DD_SYNAPSE_ORIGIN_INVALID);
+								{// the chunk of this segment is full: move the segment to a larger chunk in the slab
+									dd_slab::relocate(layer, column_i, segment_i, htm::tools::multiple_64(new_size));
 								}
 								layer.dd_synapse_count_sf[column_i][segment_i] = new_size;
 
-								assert_msg(new_size <= dd_synapse_permanence_segment.size(), "TP:grow_DD_synapses_ref: invalid new_size=", new_size, "; while dd_synapse_permanence_segment.size()=", dd_synapse_permanence_segment.size());
-								assert_msg(new_size <= dd_synapse_delay_origin_segment.size(), "TP:grow_DD_synapses_ref: invalid new_size=", new_size, "; while dd_synapse_origin_segment.size()=", dd_synapse_delay_origin_segment.size());
+								assert_msg(new_size <= layer.dd_segment_capacity_sf[column_i][segment_i], "TP:grow_DD_synapses_ref: invalid new_size=", new_size, "; while capacity=", layer.dd_segment_capacity_sf[column_i][segment_i]);
 								assert_msg(new_size <= P::TP_N_DD_SYNAPSES_MAX, "TP:grow_DD_synapses_ref: invalid new_size=", new_size, "; TP_N_DD_SYNAPSES_MAX=", P::TP_N_DD_SYNAPSES_MAX);
 							}
 						}
@@ -412,21 +1031,28 @@ namespace htm
 						}
 						else
 						{
-							std::vector<int> selected_delay_and_cells(n_exact_new_synapses);
-							select_delay_and_cell_to_learn_on(layer_fluent, layer, column_i, segment_i, winner_cells, n_exact_new_synapses, selected_delay_and_cells);
-							
+							std::array<int, P::TP_N_DD_SYNAPSES_MAX> selected_delay_and_cells;
+							select_delay_and_cell_to_learn_on(layer_fluent, layer, column_i, segment_i, winner_cells, n_exact_new_synapses, selected_delay_and_cells.data());
+
+							// the segment may have been relocated: get the pointers into the slab after the resize
+							Permanence * dd_synapse_permanence_segment = layer.dd_synapse_permanence_segment(column_i, segment_i);
+							typename P::TP_Origin * dd_synapse_delay_origin_segment = layer.dd_synapse_delay_origin_segment(column_i, segment_i);
+
 							for (int i = 0; i < n_exact_new_synapses; ++i)
 							{
 								const int synapse_i = indices_to_update[i];
+								dd_sb::remove(layer_fluent, layer, column_i, segment_i, synapse_i, widen_origin<P>(dd_synapse_delay_origin_segment[synapse_i]));
 								dd_synapse_permanence_segment[synapse_i] = param.TP_DD_PERMANENCE_INIT;
-								dd_synapse_delay_origin_segment[synapse_i] = selected_delay_and_cells[i];
+								dd_synapse_delay_origin_segment[synapse_i] = narrow_origin<P>(selected_delay_and_cells[i]);
+								dd_sb::add(layer_fluent, layer, column_i, segment_i, synapse_i, selected_delay_and_cells[i]);
 							}
 						}
 
 						if constexpr (DEBUG_ON) {
+							const typename P::TP_Origin * dd_synapse_delay_origin_segment = layer.dd_synapse_delay_origin_segment(column_i, segment_i);
 							for (auto synapse_i = 0; synapse_i < layer.dd_synapse_count_sf[column_i][segment_i]; ++synapse_i)
 							{
-								const auto origin = get_global_cell_id(dd_synapse_delay_origin_segment[synapse_i]);
+								const auto origin = get_global_cell_id(widen_origin<P>(dd_synapse_delay_origin_segment[synapse_i]));
 								assert_msg(origin >= 0, "TP:grow_DD_synapses_ref: invalid origin ", origin);
 								assert_msg(origin < P::N_CELLS, "TP:grow_DD_synapses_ref: invalid origin ", origin);
 							}
@@ -446,6 +1072,7 @@ namespace htm
 						const typename Layer_Fluent<P>::Winner_Cells& winner_cells)
 					{
 						assert_msg(segment_i < layer.dd_segment_count[column_i], "TP:grow_DD_synapses: segment_i=", segment_i + " is too large. dd_segment_count=", layer.dd_segment_count[column_i]);
+						::tools::profiler::Scope scope("tp.grow_synapses");
 						grow_DD_synapses_ref(layer_fluent, layer, column_i, segment_i, n_desired_new_synapses, param, winner_cells);
 					}
 				}
@@ -517,91 +1144,94 @@ namespace htm
 					const typename Layer_Fluent<P>::Winner_Cells& winner_cells)
 				{
 					if (n_desired_new_synapses <= 0) return; // nothing to do
+					::tools::profiler::Scope scope("tp.create_segment");
 
-					auto& synapse_permanence = layer.dd_synapse_permanence_sf[column_i];
-					auto& synapse_delay_origin = layer.dd_synapse_delay_origin_sf[column_i];
 					auto& synapse_count = layer.dd_synapse_count_sf[column_i];
 
-
 					int new_segment_i = -1;
 
 					if (layer.dd_segment_count[column_i] >= P::TP_N_DD_SEGMENTS_MAX) // no empty segments available, use the least recent used one
 					{
-						const auto& active_time = layer_fluent.dd_synapse_active_time[column_i];
-
-						int least_recent_used_time = active_time[0];
-						new_segment_i = 0;
-
-						for (int segment_i = 1; segment_i < layer.dd_segment_count[column_i]; ++segment_i)
+						new_segment_i = layer_fluent.dd_segment_lru[column_i].least_recent();
+						assert_msg(new_segment_i != -1, "TP:create_DD_segment: column ", column_i, " has no least recent used segment.");
+						if (false) log_INFO("TP:create_DD_segment: column ", column_i, ", has no segment slots left, recycling segment ", new_segment_i, " with least recent used time ", layer_fluent.dd_synapse_active_time[column_i][new_segment_i]);
+						// cleanup the old synapses: remove them from the inverse index and return the chunk of the old segment to the slab
+						const typename P::TP_Origin * old_delay_origin_segment = layer.dd_synapse_delay_origin_segment(column_i, new_segment_i);
+						for (int synapse_i = 0; synapse_i < synapse_count[new_segment_i]; ++synapse_i)
 						{
-							const int time = active_time[segment_i];
-							if (time < least_recent_used_time)
-							{
-								least_recent_used_time = time;
-								new_segment_i = segment_i;
-							}
+							dd_sb::remove(layer_fluent, layer, column_i, new_segment_i, synapse_i, widen_origin<P>(old_delay_origin_segment[synapse_i]));
 						}
-						if (false) log_INFO("TP:create_DD_segment: column ", column_i, ", has no segment slots left, recycling segment ", new_segment_i, " with least recent used time ", least_recent_used_time);
-						// cleanup the old synapses
-						synapse_permanence[new_segment_i].clear();
-						synapse_delay_origin[new_segment_i].clear();
+						dd_slab::release(layer, column_i, layer.dd_segment_offset_sf[column_i][new_segment_i], layer.dd_segment_capacity_sf[column_i][new_segment_i]);
 						synapse_count[new_segment_i] = 0;
+						if constexpr (::tools::profiler::ON) ::tools::profiler::count("tp.segments_recycled", 1);
 					}
 					else
 					{
 						new_segment_i = layer.dd_segment_count[column_i];
 						layer.dd_segment_count[column_i]++;
+						if constexpr (::tools::profiler::ON) ::tools::profiler::count("tp.segments_created", 1);
 					}
 
 					assert_msg(new_segment_i != -1, "TP:create_DD_segment: error A; new_segment_i = ", new_segment_i);
 					if (false) log_INFO_DEBUG("TP:create_new_DD_segment: column ", column_i, "; adding a new segment (", new_segment_i, ") to cell ", static_cast<int>(cell), "; new_segment_idx = ", new_segment_i, ".");
 
-					const int n_new_synapses = n_desired_new_synapses;
+					const int n_new_synapses = std::min(n_desired_new_synapses, P::TP_N_DD_SYNAPSES_MAX);
 
 					#pragma region Resize Synapses
 					// this is the only place where synapse space is created
-					assert_msg(synapse_permanence.size() == synapse_delay_origin.size(), "TP:create_new_DD_segment: Bug A.");
-					if (synapse_permanence.size() <= new_segment_i)
+					if (static_cast<int>(synapse_count.size()) <= new_segment_i)
 					{
 						const int new_capacity = new_segment_i + 1;
-						synapse_permanence.resize(new_capacity);
-						synapse_delay_origin.resize(new_capacity);
 						synapse_count.resize(new_capacity, 0);
+						layer.dd_segment_offset_sf[column_i].resize(new_capacity);
+						layer.dd_segment_capacity_sf[column_i].resize(new_capacity);
 
 						layer.dd_segment_destination[column_i].resize(new_capacity);
 						layer_fluent.dd_synapse_active_time[column_i].resize(new_capacity);
+
+						// grow the segment sets and the lru list along with the segment vectors, such that activating and
+						// touching segments does not allocate
+						const int segment_capacity = static_cast<int>(synapse_count.capacity());
+						layer_fluent.active_dd_segments[column_i].reserve(segment_capacity);
+						layer_fluent.matching_dd_segments[column_i].reserve(segment_capacity);
+						layer_fluent.dd_segment_lru[column_i].reserve(segment_capacity);
+						if constexpr (!P::TP_SYNAPSE_FORWARD)
+						{
+							layer_fluent.dd_segment_potential_sb[column_i].resize(new_capacity, 0);
+							layer_fluent.dd_segment_active_sb[column_i].resize(new_capacity, 0);
+						}
 					}
+					const int n_new_synapses_capacity = htm::tools::multiple_64(n_new_synapses); // multiple of 64 needed for vectorization;
+					layer.dd_segment_offset_sf[column_i][new_segment_i] = dd_slab::allocate(layer, column_i, n_new_synapses_capacity);
+					layer.dd_segment_capacity_sf[column_i][new_segment_i] = n_new_synapses_capacity;
 					#pragma endregion
 
-					auto& dd_synapse_permanence_segment = synapse_permanence[new_segment_i];
-					auto& dd_synapse_delay_origin_segment = synapse_delay_origin[new_segment_i];
-
-					const int n_new_synapsed_capacity = htm::tools::multiple_64(n_new_synapses); // multiple of 16 needed for vectorization;
-					dd_synapse_permanence_segment.resize(n_new_synapsed_capacity, P::TP_DD_CONNECTED_THRESHOLD);
-					dd_synapse_delay_origin_segment.resize(n_new_synapsed_capacity, P::TP_DD_SYNAPSE_ORIGIN_INVALID); // init with invalid number for debugging purposes
-
 					layer.dd_segment_destination[column_i][new_segment_i] = cell;
 
-					std::vector<int> selected_delay_and_cells(n_new_synapses, layer_fluent.random_number[column_i]);
-					select_delay_and_cell_to_learn_on(layer_fluent, layer, column_i, new_segment_i, winner_cells, n_new_synapses, selected_delay_and_cells);
+					std::array<int, P::TP_N_DD_SYNAPSES_MAX> selected_delay_and_cells;
+					select_delay_and_cell_to_learn_on(layer_fluent, layer, column_i, new_segment_i, winner_cells, n_new_synapses, selected_delay_and_cells.data());
+
+					Permanence * dd_synapse_permanence_segment = layer.dd_synapse_permanence_segment(column_i, new_segment_i);
+					typename P::TP_Origin * dd_synapse_delay_origin_segment = layer.dd_synapse_delay_origin_segment(column_i, new_segment_i);
 
 					for (auto synapse_i = 0; synapse_i < n_new_synapses; ++synapse_i)
 					{
 						dd_synapse_permanence_segment[synapse_i] = param.TP_DD_PERMANENCE_INIT;
-						dd_synapse_delay_origin_segment[synapse_i] = selected_delay_and_cells[synapse_i];
+						dd_synapse_delay_origin_segment[synapse_i] = narrow_origin<P>(selected_delay_and_cells[synapse_i]);
+						dd_sb::add(layer_fluent, layer, column_i, new_segment_i, synapse_i, selected_delay_and_cells[synapse_i]);
 					}
 
 					synapse_count[new_segment_i] = n_new_synapses;
-					assert_msg(n_new_synapses <= dd_synapse_permanence_segment.size(), "TP:create_DD_segment: n_new_synapses=", n_new_synapses, "; while dd_synapse_permanence_segment.size()=", dd_synapse_permanence_segment.size());
-					assert_msg(n_new_synapses <= dd_synapse_delay_origin_segment.size(), "TP:create_DD_segment: n_new_synapses=", n_new_synapses, "; while dd_synapse_origin_segment.size()=", dd_synapse_delay_origin_segment.size());
+					assert_msg(n_new_synapses <= layer.dd_segment_capacity_sf[column_i][new_segment_i], "TP:create_DD_segment: n_new_synapses=", n_new_synapses, "; while capacity=", layer.dd_segment_capacity_sf[column_i][new_segment_i]);
 
 					layer_fluent.dd_synapse_active_time[column_i][new_segment_i] = time;
+					layer_fluent.dd_segment_lru[column_i].touch(new_segment_i);
 				}
 
 				template <bool LEARN, typename P>
 				void burst_column(
 					Layer_Fluent<P>& layer_fluent,
-					Layer_Persisted<P>& layer,
+					Layer_Persisted_C<LEARN, P>& layer,
 					const int column_i,
 					const int time,
 					const Dynamic_Param& param,
@@ -676,7 +1306,7 @@ namespace htm
 						current_active_cells.set(cell, true);
 						current_winner_cells.set(cell, true);
 
-						if (LEARN)
+						if constexpr (LEARN)
 						{
 							adapt_segment::d(layer, column_i, segment_i, active_cells, param.TP_DD_PERMANENCE_INC, param.TP_DD_PERMANENCE_DEC);
 
@@ -759,7 +1389,7 @@ namespace htm
 					{
 						current_active_cells.clear_all();
 						current_winner_cells.clear_all();
-						if (LEARN) punish_predicted_column(
+						if constexpr (LEARN) punish_predicted_column(
 							layer_fluent,
 							layer,
 							column_i,
@@ -780,28 +1410,39 @@ namespace htm
 					typename Layer_Fluent<P>::Active_Cells& active_cells,
 					typename Layer_Fluent<P>::Winner_Cells& winner_cells)
 				{
-					Bitset2<P::N_COLUMNS, P::N_CELLS_PC> active_cells_all_2D;
-					Bitset2<P::N_COLUMNS, P::N_CELLS_PC> winner_cells_all_2D;
+					// every column overwrites its row in both bitsets
+					auto& active_cells_all_2D = layer_fluent.tp_active_cells_2D;
+					auto& winner_cells_all_2D = layer_fluent.tp_winner_cells_2D;
 
-					for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+					// the sparse history of the winner cells is cached lazily: build it before the columns read it concurrently
+					if constexpr (LEARN) winner_cells.get_sparse_history();
+
+					// columns only write their own state (segments, slab, random number and row in the 2D bitsets), hence the
+					// chunks can be executed in any order and by any thread and yield identical results.
+					for_each_column_chunk<P>(param, [&](const int column_begin, const int column_end)
 					{
-						layer_fluent.active_dd_segments[column_i].advance_time();
-						layer_fluent.matching_dd_segments[column_i].advance_time();
+						for (int column_i = column_begin; column_i < column_end; ++column_i)
+						{
+							layer_fluent.active_dd_segments[column_i].advance_time();
+							layer_fluent.matching_dd_segments[column_i].advance_time();
 
-						activate_cells_per_column<LEARN>(
-							layer_fluent,
-							layer,
-							column_i,
-							time,
-							param,
-							//in
-							active_columns.get(column_i),
-							active_cells,
-							winner_cells,
-							//out
-							active_cells_all_2D[column_i],
-							winner_cells_all_2D[column_i]);
-					}
+							activate_cells_per_column<LEARN>(
+								layer_fluent,
+								layer,
+								column_i,
+								time,
+								param,
+								//in
+								active_columns.get(column_i),
+								active_cells,
+								winner_cells,
+								//out
+								active_cells_all_2D[column_i],
+								winner_cells_all_2D[column_i]);
+						}
+					});
+
+					if constexpr (LEARN && !P::TP_SYNAPSE_FORWARD) dd_sb::apply_changes(layer_fluent, layer);
 
 					active_cells.set_current(active_cells_all_2D);
 					copy(winner_cells.current(), winner_cells_all_2D);
@@ -814,35 +1455,61 @@ namespace htm
 				{
 					namespace priv
 					{
-						//Identical to get_sensors_epi32_B, but with a but, but that bug does not seem to be a issue.
+						//Return 1 for the synapses whose origin cell was active one time step before the delay of the synapse.
+						template <typename P>
 						__m512i get_sensors_epi32(
 							const __mmask16 mask,
 							const __m512i delay_and_origin_epi32,
 							const void * active_cells_ptr)
 						{
-							const __m512i global_cell_id = _mm512_and_epi32(delay_and_origin_epi32, _mm512_set1_epi32(0x1FFFFFFF));
-							const __m512i delay_epi32 = _mm512_sub_epi32(_mm512_srli_epi32(delay_and_origin_epi32, 32 - 3), _mm512_set1_epi32(1));
+							using Active_Cells = typename Layer_Fluent<P>::Active_Cells;
+							const __m512i global_cell_id = _mm512_and_epi32(delay_and_origin_epi32, _mm512_set1_epi32(P::TP_ORIGIN_CELL_MASK));
+							const __m512i cell_pos_in_int = _mm512_and_epi32(delay_and_origin_epi32, _mm512_set1_epi32((1 << Active_Cells::CELLS_PER_WORD_LOG2) - 1));
+							const __m512i delay_epi32 = _mm512_sub_epi32(_mm512_srli_epi32(delay_and_origin_epi32, P::TP_ORIGIN_DELAY_SHIFT), _mm512_set1_epi32(1));
 
-							const __m512i byte_addr = global_cell_id;
-							const __m512i sensor_int = _mm512_mask_i32gather_epi32(_mm512_setzero_epi32(), mask, byte_addr, active_cells_ptr, 1); //bug here! reading 3bytes past array
-							return _mm512_and_epi32(_mm512_srlv_epi32(sensor_int, delay_epi32), _mm512_set1_epi32(1));
+							const __m512i int_addr = _mm512_srli_epi32(global_cell_id, Active_Cells::CELLS_PER_WORD_LOG2);
+							const __m512i sensor_int = _mm512_mask_i32gather_epi32(_mm512_setzero_epi32(), mask, int_addr, active_cells_ptr, 4);
+							const __m512i pos_in_int = _mm512_slli_epi32(cell_pos_in_int, Active_Cells::BITS_PER_CELL_LOG2);
+							const __m512i delay_shift = _mm512_add_epi32(delay_epi32, pos_in_int);
+							return _mm512_and_epi32(_mm512_srlv_epi32(sensor_int, delay_shift), _mm512_set1_epi32(1));
 						}
 
-						//Identical to get_sensors_epi32 but without the bug
-						__m512i get_sensors_epi32_B(
-							const __mmask16 mask,
-							const __m512i delay_and_origin_epi32,
+						//AVX2 variant of get_sensors_epi32
+						template <typename P>
+						__m256i get_sensors_avx2_epi32(
+							const __m256i mask,
+							const __m256i delay_and_origin_epi32,
 							const void * active_cells_ptr)
 						{
-							const __m512i global_cell_id = _mm512_and_epi32(delay_and_origin_epi32, _mm512_set1_epi32(0x1FFFFFFF));
-							const __m512i byte_pos_in_int = _mm512_and_epi32(delay_and_origin_epi32, _mm512_set1_epi32(0b11));
-							const __m512i delay_epi32 = _mm512_sub_epi32(_mm512_srli_epi32(delay_and_origin_epi32, 32 - 3), _mm512_set1_epi32(1));
+							using Active_Cells = typename Layer_Fluent<P>::Active_Cells;
+							const __m256i global_cell_id = _mm256_and_si256(delay_and_origin_epi32, _mm256_set1_epi32(P::TP_ORIGIN_CELL_MASK));
+							const __m256i cell_pos_in_int = _mm256_and_si256(delay_and_origin_epi32, _mm256_set1_epi32((1 << Active_Cells::CELLS_PER_WORD_LOG2) - 1));
+							const __m256i delay_epi32 = _mm256_sub_epi32(_mm256_srli_epi32(delay_and_origin_epi32, P::TP_ORIGIN_DELAY_SHIFT), _mm256_set1_epi32(1));
+
+							const __m256i int_addr = _mm256_srli_epi32(global_cell_id, Active_Cells::CELLS_PER_WORD_LOG2);
+							const __m256i sensor_int = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), reinterpret_cast<const int *>(active_cells_ptr), int_addr, mask, 4);
+							const __m256i pos_in_int = _mm256_slli_epi32(cell_pos_in_int, Active_Cells::BITS_PER_CELL_LOG2);
+							const __m256i delay_shift = _mm256_add_epi32(delay_epi32, pos_in_int);
+							return _mm256_and_si256(_mm256_srlv_epi32(sensor_int, delay_shift), _mm256_set1_epi32(1));
+						}
 
-							const __m512i int_addr = _mm512_srli_epi32(global_cell_id, 2);
-							const __m512i sensor_int = _mm512_mask_i32gather_epi32(_mm512_setzero_epi32(), mask, int_addr, active_cells_ptr, 4);
-							const __m512i pos_in_int = _mm512_slli_epi32(byte_pos_in_int, 3);
-							const __m512i delay_shift = _mm512_add_epi32(delay_epi32, pos_in_int);
-							return _mm512_and_epi32(_mm512_srlv_epi32(sensor_int, delay_shift), _mm512_set1_epi32(1));
+						//Count the potential and active synapses of the I-th group of 8 synapses in a block of 32 synapses
+						template <typename P, int I>
+						void count_synapses_avx2(
+							const __m256i connected_epi8,
+							const __m256i active_epi8,
+							const __m256i delay_origin_epi32,
+							const void * active_cells_ptr,
+							__m256i& n_potential_synapses,
+							__m256i& n_active_synapses)
+						{
+							const __m256i connected_mask = htm::tools::expand_mask_epi8_epi32<I>(connected_epi8);
+							if (!_mm256_testz_si256(connected_mask, connected_mask))
+							{
+								const __m256i sensors_epi32 = get_sensors_avx2_epi32<P>(connected_mask, delay_origin_epi32, active_cells_ptr);
+								n_potential_synapses = _mm256_add_epi32(n_potential_synapses, sensors_epi32);
+								n_active_synapses = _mm256_add_epi32(n_active_synapses, _mm256_and_si256(sensors_epi32, htm::tools::expand_mask_epi8_epi32<I>(active_epi8)));
+							}
 						}
 
 						/*
@@ -869,54 +1536,63 @@ namespace htm
 						const typename Layer_Fluent<P>::Active_Cells& active_cells,
 						const Dynamic_Param& param)
 					{
-						for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+						for_each_column_chunk<P>(param, [&](const int column_begin, const int column_end)
 						{
-							auto& active_segments_current = layer_fluent.active_dd_segments[column_i].current();
-							auto& matching_segments_current = layer_fluent.matching_dd_segments[column_i].current();
-							const int n_segments = layer.dd_segment_count[column_i];
-							auto& active_time = layer_fluent.dd_synapse_active_time[column_i];
-							const auto& permanence_segment = layer.dd_synapse_permanence_sf[column_i];
-							const auto& delay_origin_segment = layer.dd_synapse_delay_origin_sf[column_i];
-							const auto& synapse_count_segment = layer.dd_synapse_count_sf[column_i];
-
-							active_segments_current.reset();
-							matching_segments_current.reset();
-
-							for (auto segment_i = 0; segment_i < n_segments; ++segment_i)
+							for (int column_i = column_begin; column_i < column_end; ++column_i)
 							{
-								const auto& dd_synapse_permanence_segment = permanence_segment[segment_i];
-								const auto& dd_synapse_delay_origin_segment = delay_origin_segment[segment_i];
-								const int n_synpases = synapse_count_segment[segment_i];
+								auto& active_segments_current = layer_fluent.active_dd_segments[column_i].current();
+								auto& matching_segments_current = layer_fluent.matching_dd_segments[column_i].current();
+								const int n_segments = layer.dd_segment_count[column_i];
+								auto& active_time = layer_fluent.dd_synapse_active_time[column_i];
+								auto& lru = layer_fluent.dd_segment_lru[column_i];
+								const Permanence * permanence_slab = layer.dd_synapse_permanence_sf[column_i].data();
+								const typename P::TP_Origin * delay_origin_slab = layer.dd_synapse_delay_origin_sf[column_i].data();
+								const auto& offset_segment = layer.dd_segment_offset_sf[column_i];
+								const auto& synapse_count_segment = layer.dd_synapse_count_sf[column_i];
+
+								active_segments_current.reset();
+								matching_segments_current.reset();
+
+								for (auto segment_i = 0; segment_i < n_segments; ++segment_i)
+								{
+									const Permanence * dd_synapse_permanence_segment = &permanence_slab[offset_segment[segment_i]];
+									const typename P::TP_Origin * dd_synapse_delay_origin_segment = &delay_origin_slab[offset_segment[segment_i]];
+									const int n_synpases = synapse_count_segment[segment_i];
 
-								int n_potential_synapses = 0;
-								int n_active_synapses = 0;
+									int n_potential_synapses = 0;
+									int n_active_synapses = 0;
 
-								for (auto synapse_i = 0; synapse_i < n_synpases; ++synapse_i)
-								{
-									const Permanence permanence = dd_synapse_permanence_segment[synapse_i];
-									if (permanence > P::TP_DD_CONNECTED_THRESHOLD)
+									for (auto synapse_i = 0; synapse_i < n_synpases; ++synapse_i)
 									{
-										const auto delay_and_cell_id = dd_synapse_delay_origin_segment[synapse_i];
-										const int global_cell_id = get_global_cell_id(delay_and_cell_id);
-										const int delay = get_delay(delay_and_cell_id) - 1; // can we remove the minus one here: very confusing
-										if (active_cells.get(global_cell_id, delay)) // deadly gather here!
+										const Permanence permanence = dd_synapse_permanence_segment[synapse_i];
+										if (permanence > P::TP_DD_CONNECTED_THRESHOLD)
 										{
-											n_potential_synapses++;
-											n_active_synapses += (permanence > P::TP_DD_PERMANENCE_THRESHOLD);
+											const int delay_and_cell_id = widen_origin<P>(dd_synapse_delay_origin_segment[synapse_i]);
+											const int global_cell_id = get_global_cell_id(delay_and_cell_id);
+											const int delay = get_delay(delay_and_cell_id) - 1; // can we remove the minus one here: very confusing
+											if (active_cells.get(global_cell_id, delay)) // deadly gather here!
+											{
+												n_potential_synapses++;
+												n_active_synapses += (permanence > P::TP_DD_PERMANENCE_THRESHOLD);
+											}
+										}
+									}
+									if (n_potential_synapses > param.TP_MIN_DD_ACTIVATION_THRESHOLD)
+									{
+										matching_segments_current.add(segment_i, n_potential_synapses);
+									}
+									if (n_active_synapses > param.TP_DD_SEGMENT_ACTIVE_THRESHOLD)
+									{
+										active_segments_current.add(segment_i, n_active_synapses);
+										if (LEARN)
+										{
+											active_time[segment_i] = time;
+											lru.touch(segment_i);
 										}
 									}
-								}
-								if (n_potential_synapses > param.TP_MIN_DD_ACTIVATION_THRESHOLD)
-								{
-									matching_segments_current.add(segment_i, n_potential_synapses);
-								}
-								if (n_active_synapses > param.TP_DD_SEGMENT_ACTIVE_THRESHOLD)
-								{
-									active_segments_current.add(segment_i, n_active_synapses);
-									if (LEARN) active_time[segment_i] = time;
 								}
 							}
-						}
+						});
 					}
 
 					//Activate dendrites: synapse forward reference implementation
@@ -929,9 +1605,9 @@ namespace htm
 						const typename Layer_Fluent<P>::Active_Cells& active_cells,
 						const Dynamic_Param& param)
 					{
+						std::vector<Segments_Set> active_segments_current_org;
+						std::vector<Segments_Set> matching_segments_current_org;
 						if constexpr (DEBUG_ON) {
-							std::vector<Segments_Set> active_segments_current_org;
-							std::vector<Segments_Set> matching_segments_current_org;
 							for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
 							{
 								active_segments_current_org.push_back(Segments_Set(layer_fluent.active_dd_segments[column_i].current()));
@@ -942,112 +1618,121 @@ namespace htm
 						const __m128i connected_threshold_epi8 = _mm_set1_epi8(P::TP_DD_CONNECTED_THRESHOLD);
 						const __m128i active_threshold_epi8 = _mm_set1_epi8(P::TP_DD_PERMANENCE_THRESHOLD);
 
-						for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+						for_each_column_chunk<P>(param, [&](const int column_begin, const int column_end)
 						{
-							auto& active_segments_current = layer_fluent.active_dd_segments[column_i].current();
-							auto& matching_segments_current = layer_fluent.matching_dd_segments[column_i].current();
-							const int n_segments = layer.dd_segment_count[column_i];
-							auto& active_time = layer_fluent.dd_synapse_active_time[column_i];
-							const auto& permanence_segment = layer.dd_synapse_permanence_sf[column_i];
-							const auto& delay_origin_segment = layer.dd_synapse_delay_origin_sf[column_i];
-							const auto& synapse_count_segment = layer.dd_synapse_count_sf[column_i];
-							const auto active_cells_ptr = active_cells.data();
-
-							active_segments_current.reset();
-							matching_segments_current.reset();
-
-							#pragma ivdep // assumed vector dependencies are ignored
-							for (int segment_i = 0; segment_i < n_segments; ++segment_i)
+							for (int column_i = column_begin; column_i < column_end; ++column_i)
 							{
-								auto permanence_epi8_ptr = reinterpret_cast<const __m512i *>(permanence_segment[segment_i].data());
-								auto delay_origin_epi32_ptr = reinterpret_cast<const __m512i *>(delay_origin_segment[segment_i].data());
-
-								__m512i n_potential_synapses = _mm512_setzero_si512();
-								__m512i n_active_synapses = _mm512_setzero_si512();
-
-								const int n_synapses = synapse_count_segment[segment_i];
-								const int n_blocks = htm::tools::n_blocks_64(n_synapses);
+								auto& active_segments_current = layer_fluent.active_dd_segments[column_i].current();
+								auto& matching_segments_current = layer_fluent.matching_dd_segments[column_i].current();
+								const int n_segments = layer.dd_segment_count[column_i];
+								auto& active_time = layer_fluent.dd_synapse_active_time[column_i];
+								auto& lru = layer_fluent.dd_segment_lru[column_i];
+								const Permanence * permanence_slab = layer.dd_synapse_permanence_sf[column_i].data();
+								const typename P::TP_Origin * delay_origin_slab = layer.dd_synapse_delay_origin_sf[column_i].data();
+								const auto& offset_segment = layer.dd_segment_offset_sf[column_i];
+								const auto& synapse_count_segment = layer.dd_synapse_count_sf[column_i];
+								const auto active_cells_ptr = active_cells.data();
+
+								active_segments_current.reset();
+								matching_segments_current.reset();
 
 								#pragma ivdep // assumed vector dependencies are ignored
-								for (int block = 0; block < n_blocks; ++block)
+								for (int segment_i = 0; segment_i < n_segments; ++segment_i)
 								{
-									//const __m512i permanence_epi8 = _mm512_stream_load_si512(&permanence_epi8_ptr[block]); //load 64 permanence values
-									const __m512i permanence_epi8 = _mm512_load_si512(&permanence_epi8_ptr[block]); //load 64 permanence values
+									auto permanence_epi8_ptr = reinterpret_cast<const __m512i *>(&permanence_slab[offset_segment[segment_i]]);
+									const typename P::TP_Origin * delay_origin_ptr = &delay_origin_slab[offset_segment[segment_i]];
+
+									__m512i n_potential_synapses = _mm512_setzero_si512();
+									__m512i n_active_synapses = _mm512_setzero_si512();
 
+									const int n_synapses = synapse_count_segment[segment_i];
+									const int n_blocks = htm::tools::n_blocks_64(n_synapses);
+
+									#pragma ivdep // assumed vector dependencies are ignored
+									for (int block = 0; block < n_blocks; ++block)
 									{
-										const int i = 0;
-										const __m128i permanence_epi8_i = _mm512_extracti64x2_epi64(permanence_epi8, i);
-										const __mmask16 connected_mask_16 = _mm_cmpgt_epi8_mask(permanence_epi8_i, connected_threshold_epi8);
+										//const __m512i permanence_epi8 = _mm512_stream_load_si512(&permanence_epi8_ptr[block]); //load 64 permanence values
+										const __m512i permanence_epi8 = _mm512_load_si512(&permanence_epi8_ptr[block]); //load 64 permanence values
 
-										if (connected_mask_16 != 0)
 										{
-											const __mmask16 active_mask_16 = _mm_cmpgt_epi8_mask(permanence_epi8_i, active_threshold_epi8);
-											const __m512i delay_origin = _mm512_load_si512(&delay_origin_epi32_ptr[(block * 4) + i]);
-											const __m512i sensors_epi32 = priv::get_sensors_epi32(connected_mask_16, delay_origin, active_cells_ptr);
-											n_potential_synapses = _mm512_add_epi32(n_potential_synapses, sensors_epi32);
-											n_active_synapses = _mm512_mask_add_epi32(n_active_synapses, active_mask_16, n_active_synapses, sensors_epi32);
+											const int i = 0;
+											const __m128i permanence_epi8_i = _mm512_extracti64x2_epi64(permanence_epi8, i);
+											const __mmask16 connected_mask_16 = _mm_cmpgt_epi8_mask(permanence_epi8_i, connected_threshold_epi8);
+
+											if (connected_mask_16 != 0)
+											{
+												const __mmask16 active_mask_16 = _mm_cmpgt_epi8_mask(permanence_epi8_i, active_threshold_epi8);
+												const __m512i delay_origin = load_origin_epi32<P>(&delay_origin_ptr[(block * 64) + (i * 16)]);
+												const __m512i sensors_epi32 = priv::get_sensors_epi32<P>(connected_mask_16, delay_origin, active_cells_ptr);
+												n_potential_synapses = _mm512_add_epi32(n_potential_synapses, sensors_epi32);
+												n_active_synapses = _mm512_mask_add_epi32(n_active_synapses, active_mask_16, n_active_synapses, sensors_epi32);
+											}
 										}
-									}
-									{
-										const int i = 1;
-										const __m128i permanence_epi8_i = _mm512_extracti64x2_epi64(permanence_epi8, i);
-										const __mmask16 connected_mask_16 = _mm_cmpgt_epi8_mask(permanence_epi8_i, connected_threshold_epi8);
-
-										if (connected_mask_16 != 0)
 										{
-											const __mmask16 active_mask_16 = _mm_cmpgt_epi8_mask(permanence_epi8_i, active_threshold_epi8);
-											const __m512i delay_origin = _mm512_load_si512(&delay_origin_epi32_ptr[(block * 4) + i]);
-											const __m512i sensors_epi32 = priv::get_sensors_epi32(connected_mask_16, delay_origin, active_cells_ptr);
-											n_potential_synapses = _mm512_add_epi32(n_potential_synapses, sensors_epi32);
-											n_active_synapses = _mm512_mask_add_epi32(n_active_synapses, active_mask_16, n_active_synapses, sensors_epi32);
+											const int i = 1;
+											const __m128i permanence_epi8_i = _mm512_extracti64x2_epi64(permanence_epi8, i);
+											const __mmask16 connected_mask_16 = _mm_cmpgt_epi8_mask(permanence_epi8_i, connected_threshold_epi8);
+
+											if (connected_mask_16 != 0)
+											{
+												const __mmask16 active_mask_16 = _mm_cmpgt_epi8_mask(permanence_epi8_i, active_threshold_epi8);
+												const __m512i delay_origin = load_origin_epi32<P>(&delay_origin_ptr[(block * 64) + (i * 16)]);
+												const __m512i sensors_epi32 = priv::get_sensors_epi32<P>(connected_mask_16, delay_origin, active_cells_ptr);
+												n_potential_synapses = _mm512_add_epi32(n_potential_synapses, sensors_epi32);
+												n_active_synapses = _mm512_mask_add_epi32(n_active_synapses, active_mask_16, n_active_synapses, sensors_epi32);
+											}
 										}
-									}
-									{
-										const int i = 2;
-										const __m128i permanence_epi8_i = _mm512_extracti64x2_epi64(permanence_epi8, i);
-										const __mmask16 connected_mask_16 = _mm_cmpgt_epi8_mask(permanence_epi8_i, connected_threshold_epi8);
-
-										if (connected_mask_16 != 0)
 										{
-											const __mmask16 active_mask_16 = _mm_cmpgt_epi8_mask(permanence_epi8_i, active_threshold_epi8);
-											const __m512i delay_origin = _mm512_load_si512(&delay_origin_epi32_ptr[(block * 4) + i]);
-											const __m512i sensors_epi32 = priv::get_sensors_epi32(connected_mask_16, delay_origin, active_cells_ptr);
-											n_potential_synapses = _mm512_add_epi32(n_potential_synapses, sensors_epi32);
-											n_active_synapses = _mm512_mask_add_epi32(n_active_synapses, active_mask_16, n_active_synapses, sensors_epi32);
+											const int i = 2;
+											const __m128i permanence_epi8_i = _mm512_extracti64x2_epi64(permanence_epi8, i);
+											const __mmask16 connected_mask_16 = _mm_cmpgt_epi8_mask(permanence_epi8_i, connected_threshold_epi8);
+
+											if (connected_mask_16 != 0)
+											{
+												const __mmask16 active_mask_16 = _mm_cmpgt_epi8_mask(permanence_epi8_i, active_threshold_epi8);
+												const __m512i delay_origin = load_origin_epi32<P>(&delay_origin_ptr[(block * 64) + (i * 16)]);
+												const __m512i sensors_epi32 = priv::get_sensors_epi32<P>(connected_mask_16, delay_origin, active_cells_ptr);
+												n_potential_synapses = _mm512_add_epi32(n_potential_synapses, sensors_epi32);
+												n_active_synapses = _mm512_mask_add_epi32(n_active_synapses, active_mask_16, n_active_synapses, sensors_epi32);
+											}
 										}
-									}
-									{
-										const int i = 3;
-										const __m128i permanence_epi8_i = _mm512_extracti64x2_epi64(permanence_epi8, i);
-										const __mmask16 connected_mask_16 = _mm_cmpgt_epi8_mask(permanence_epi8_i, connected_threshold_epi8);
-
-										if (connected_mask_16 != 0)
 										{
-											const __mmask16 active_mask_16 = _mm_cmpgt_epi8_mask(permanence_epi8_i, active_threshold_epi8);
-											const __m512i delay_origin = _mm512_load_si512(&delay_origin_epi32_ptr[(block * 4) + i]);
-											const __m512i sensors_epi32 = priv::get_sensors_epi32(connected_mask_16, delay_origin, active_cells_ptr);
-											n_potential_synapses = _mm512_add_epi32(n_potential_synapses, sensors_epi32);
-											n_active_synapses = _mm512_mask_add_epi32(n_active_synapses, active_mask_16, n_active_synapses, sensors_epi32);
+											const int i = 3;
+											const __m128i permanence_epi8_i = _mm512_extracti64x2_epi64(permanence_epi8, i);
+											const __mmask16 connected_mask_16 = _mm_cmpgt_epi8_mask(permanence_epi8_i, connected_threshold_epi8);
+
+											if (connected_mask_16 != 0)
+											{
+												const __mmask16 active_mask_16 = _mm_cmpgt_epi8_mask(permanence_epi8_i, active_threshold_epi8);
+												const __m512i delay_origin = load_origin_epi32<P>(&delay_origin_ptr[(block * 64) + (i * 16)]);
+												const __m512i sensors_epi32 = priv::get_sensors_epi32<P>(connected_mask_16, delay_origin, active_cells_ptr);
+												n_potential_synapses = _mm512_add_epi32(n_potential_synapses, sensors_epi32);
+												n_active_synapses = _mm512_mask_add_epi32(n_active_synapses, active_mask_16, n_active_synapses, sensors_epi32);
+											}
 										}
 									}
-								}
 
-								const int n_potential_synapses_int = _mm512_reduce_add_epi32(n_potential_synapses);
-								const int n_active_synapses_int = _mm512_reduce_add_epi32(n_active_synapses);
+									const int n_potential_synapses_int = _mm512_reduce_add_epi32(n_potential_synapses);
+									const int n_active_synapses_int = _mm512_reduce_add_epi32(n_active_synapses);
 
-								if (false) log_INFO_DEBUG("TP:count_active_potential_DD_synapses_avx512: column ", column_i, "; segment_i ", segment_i, " has ", n_synapses, " synapses and ", n_active_synapses_int, " active synapses.\n");
+									if (false) log_INFO_DEBUG("TP:count_active_potential_DD_synapses_avx512: column ", column_i, "; segment_i ", segment_i, " has ", n_synapses, " synapses and ", n_active_synapses_int, " active synapses.\n");
 
-								if (n_potential_synapses_int > param.TP_MIN_DD_ACTIVATION_THRESHOLD)
-								{
-									matching_segments_current.add(segment_i, n_potential_synapses_int);
-								}
-								if (n_active_synapses_int > param.TP_DD_SEGMENT_ACTIVE_THRESHOLD)
-								{
-									active_segments_current.add(segment_i, n_active_synapses_int);
-									if (LEARN) active_time[segment_i] = time;
+									if (n_potential_synapses_int > param.TP_MIN_DD_ACTIVATION_THRESHOLD)
+									{
+										matching_segments_current.add(segment_i, n_potential_synapses_int);
+									}
+									if (n_active_synapses_int > param.TP_DD_SEGMENT_ACTIVE_THRESHOLD)
+									{
+										active_segments_current.add(segment_i, n_active_synapses_int);
+										if (LEARN)
+										{
+											active_time[segment_i] = time;
+											lru.touch(segment_i);
+										}
+									}
 								}
 							}
-						}
+						});
 
 						if constexpr (DEBUG_ON) {
 							std::vector<Segments_Set> active_segments_current_avx512;
@@ -1078,11 +1763,151 @@ namespace htm
 							}
 						}
 					}
+
+					//Activate dendrites: synapse forward AVX2 implementation
+					template <bool LEARN, typename P>
+					void activate_dendrites_sf_avx2(
+						Layer_Fluent<P>& layer_fluent,
+						const Layer_Persisted<P>& layer,
+						const int time,
+						//in
+						const typename Layer_Fluent<P>::Active_Cells& active_cells,
+						const Dynamic_Param& param)
+					{
+						std::vector<Segments_Set> active_segments_current_org;
+						std::vector<Segments_Set> matching_segments_current_org;
+						if constexpr (DEBUG_ON) {
+							for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+							{
+								active_segments_current_org.push_back(Segments_Set(layer_fluent.active_dd_segments[column_i].current()));
+								matching_segments_current_org.push_back(Segments_Set(layer_fluent.matching_dd_segments[column_i].current()));
+							}
+						}
+
+						const __m256i connected_threshold_epi8 = _mm256_set1_epi8(P::TP_DD_CONNECTED_THRESHOLD);
+						const __m256i active_threshold_epi8 = _mm256_set1_epi8(P::TP_DD_PERMANENCE_THRESHOLD);
+
+						for_each_column_chunk<P>(param, [&](const int column_begin, const int column_end)
+						{
+							for (int column_i = column_begin; column_i < column_end; ++column_i)
+							{
+								auto& active_segments_current = layer_fluent.active_dd_segments[column_i].current();
+								auto& matching_segments_current = layer_fluent.matching_dd_segments[column_i].current();
+								const int n_segments = layer.dd_segment_count[column_i];
+								auto& active_time = layer_fluent.dd_synapse_active_time[column_i];
+								auto& lru = layer_fluent.dd_segment_lru[column_i];
+								const Permanence * permanence_slab = layer.dd_synapse_permanence_sf[column_i].data();
+								const typename P::TP_Origin * delay_origin_slab = layer.dd_synapse_delay_origin_sf[column_i].data();
+								const auto& offset_segment = layer.dd_segment_offset_sf[column_i];
+								const auto& synapse_count_segment = layer.dd_synapse_count_sf[column_i];
+								const auto active_cells_ptr = active_cells.data();
+
+								active_segments_current.reset();
+								matching_segments_current.reset();
+
+								for (int segment_i = 0; segment_i < n_segments; ++segment_i)
+								{
+									auto permanence_epi8_ptr = reinterpret_cast<const __m256i *>(&permanence_slab[offset_segment[segment_i]]);
+									const typename P::TP_Origin * delay_origin_ptr = &delay_origin_slab[offset_segment[segment_i]];
+
+									__m256i n_potential_synapses = _mm256_setzero_si256();
+									__m256i n_active_synapses = _mm256_setzero_si256();
+
+									const int n_synapses = synapse_count_segment[segment_i];
+									const int n_blocks = htm::tools::n_blocks_32(n_synapses);
+
+									for (int block = 0; block < n_blocks; ++block)
+									{
+										const __m256i permanence_epi8 = _mm256_load_si256(&permanence_epi8_ptr[block]); //load 32 permanence values
+										const __m256i connected_epi8 = _mm256_cmpgt_epi8(permanence_epi8, connected_threshold_epi8);
+										if (_mm256_testz_si256(connected_epi8, connected_epi8)) continue;
+										const __m256i active_epi8 = _mm256_cmpgt_epi8(permanence_epi8, active_threshold_epi8);
+
+										priv::count_synapses_avx2<P, 0>(connected_epi8, active_epi8, load_origin_avx2_epi32<P>(&delay_origin_ptr[(block * 32) + 0]), active_cells_ptr, n_potential_synapses, n_active_synapses);
+										priv::count_synapses_avx2<P, 1>(connected_epi8, active_epi8, load_origin_avx2_epi32<P>(&delay_origin_ptr[(block * 32) + 8]), active_cells_ptr, n_potential_synapses, n_active_synapses);
+										priv::count_synapses_avx2<P, 2>(connected_epi8, active_epi8, load_origin_avx2_epi32<P>(&delay_origin_ptr[(block * 32) + 16]), active_cells_ptr, n_potential_synapses, n_active_synapses);
+										priv::count_synapses_avx2<P, 3>(connected_epi8, active_epi8, load_origin_avx2_epi32<P>(&delay_origin_ptr[(block * 32) + 24]), active_cells_ptr, n_potential_synapses, n_active_synapses);
+									}
+
+									const int n_potential_synapses_int = htm::tools::reduce_add_epi32(n_potential_synapses);
+									const int n_active_synapses_int = htm::tools::reduce_add_epi32(n_active_synapses);
+
+									if (false) log_INFO_DEBUG("TP:count_active_potential_DD_synapses_avx2: column ", column_i, "; segment_i ", segment_i, " has ", n_synapses, " synapses and ", n_active_synapses_int, " active synapses.\n");
+
+									if (n_potential_synapses_int > param.TP_MIN_DD_ACTIVATION_THRESHOLD)
+									{
+										matching_segments_current.add(segment_i, n_potential_synapses_int);
+									}
+									if (n_active_synapses_int > param.TP_DD_SEGMENT_ACTIVE_THRESHOLD)
+									{
+										active_segments_current.add(segment_i, n_active_synapses_int);
+										if (LEARN)
+										{
+											active_time[segment_i] = time;
+											lru.touch(segment_i);
+										}
+									}
+								}
+							}
+						});
+
+						if constexpr (DEBUG_ON) {
+							std::vector<Segments_Set> active_segments_current_avx2;
+							std::vector<Segments_Set> matching_segments_current_avx2;
+							for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+							{
+								active_segments_current_avx2.push_back(Segments_Set(layer_fluent.active_dd_segments[column_i].current()));
+								matching_segments_current_avx2.push_back(Segments_Set(layer_fluent.matching_dd_segments[column_i].current()));
+
+								layer_fluent.active_dd_segments[column_i].current()._data = active_segments_current_org[column_i]._data;
+								layer_fluent.matching_dd_segments[column_i].current()._data = matching_segments_current_org[column_i]._data;
+							}
+							activate_dendrites_sf_ref<LEARN>(layer_fluent, layer, time, active_cells, param);
+							for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+							{
+								const auto& active_segments_ref = layer_fluent.active_dd_segments[column_i].current()._data;
+								const auto& active_segments_avx2 = active_segments_current_avx2[column_i]._data;
+								for (auto i = 0; i < active_segments_ref.size(); ++i)
+								{
+									if (active_segments_ref[i] != active_segments_avx2[i]) log_ERROR("SP:activate_dendrites_sf_avx2:: UNEQUAL: column ", column_i, "; active_segments_ref ", active_segments_ref[i], " != active_segments_avx2 ", active_segments_avx2[i], ".\n");
+								}
+								const auto& matching_segments_ref = layer_fluent.matching_dd_segments[column_i].current()._data;
+								const auto& matching_segments_avx2 = matching_segments_current_avx2[column_i]._data;
+								for (auto i = 0; i < matching_segments_ref.size(); ++i)
+								{
+									if (matching_segments_ref[i] != matching_segments_avx2[i]) log_ERROR("SP:activate_dendrites_sf_avx2:: UNEQUAL: column ", column_i, "; matching_segments_ref ", matching_segments_ref[i], " != matching_segments_avx2 ", matching_segments_avx2[i], ".\n");
+								}
+							}
+						}
+					}
 				}
 
 				namespace synapse_backward
 				{
-					//Activate dendrites: synapse backward reference implementation
+					//Collect the cells that are active with a delay that can be observed by a synapse, and return the number
+					//of synapses that originate from these cells (that is, the number of synapses the backward engine visits).
+					template <typename P>
+					int64_t collect_active_cells(
+						const Layer_Persisted<P>& layer,
+						//in
+						const typename Layer_Fluent<P>::Active_Cells& active_cells,
+						//out
+						std::vector<int>& active_cell_ids)
+					{
+						constexpr unsigned int history_mask = (1u << P::HISTORY_SIZE) - 1;
+						active_cells.collect_active(history_mask, active_cell_ids);
+
+						int64_t n_synapses = 0;
+						for (const int global_cell_id : active_cell_ids)
+						{
+							n_synapses += static_cast<int64_t>(layer.dd_synapse_sb[global_cell_id].size());
+						}
+						return n_synapses;
+					}
+
+					//Activate dendrites: synapse backward reference implementation: only the synapses that originate from the
+					//provided active cells are visited; their activity is accumulated per segment and the segments of the touched
+					//columns are added in segment order, such that the result is identical to the synapse forward implementation.
 					template <bool LEARN, typename P>
 					void activate_dendrites_sb_ref(
 						Layer_Fluent<P>& layer_fluent,
@@ -1090,44 +1915,97 @@ namespace htm
 						const int time,
 						//in
 						const typename Layer_Fluent<P>::Active_Cells& active_cells,
+						const std::vector<int>& active_cell_ids,
 						const Dynamic_Param& param)
 					{
-						//TODO: investigate whether it is faster to loop over the active cells and determine the synapsic activity
-						/*
-						std::vector<std::vector<int>> segment_activity_local;
-						std::vector<std::vector<int>> segment_matching_local;
+						auto& touched_columns = layer_fluent.touched_columns_sb;
+						auto& column_touched = layer_fluent.column_touched_sb;
 
-						for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+						for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
 						{
-							const int n_segments = layer.dd_segment_count[column_i];
-							segment_activity_local.push_back(std::vector<int>(n_segments, 0));
-							segment_matching_local.push_back(std::vector<int>(n_segments, 0));
+							layer_fluent.active_dd_segments[column_i].current().reset();
+							layer_fluent.matching_dd_segments[column_i].current().reset();
 						}
 
-
-						std::vector<int> active_cell_ids_t1 = std::vector<int>(0);
-						int delay = 1;
-
-						for (int global_cell_id : active_cell_ids_t1)
+						for (const int global_cell_id : active_cell_ids)
 						{
-							const int n_synapses = layer.dd_synapse_count_sb[delay][global_cell_id];
-							const auto& permanences = layer.dd_synapse_permanence_sb[delay][global_cell_id];
-
-							for (auto synapse_i = 0; synapse_i < n_synapses; ++synapse_i)
+							for (const uint64_t synapse : layer.dd_synapse_sb[global_cell_id])
 							{
-								const Permanence permanence = permanences[synapse_i];
-								if (permanence > P::TP_DD_CONNECTED_THRESHOLD)
+								const int delay = dd_sb::get_synapse_delay(synapse) - 1;
+								if (active_cells.get(global_cell_id, delay))
 								{
-									const int column_i = global_2_local_cell
-										int segment_i =
+									const int column_i = dd_sb::get_column(synapse);
+									const int segment_i = dd_sb::get_segment(synapse);
+									const Permanence permanence = layer.dd_synapse_permanence_segment(column_i, segment_i)[dd_sb::get_synapse(synapse)];
+									if (permanence > P::TP_DD_CONNECTED_THRESHOLD)
+									{
+										auto& n_potential_synapses = layer_fluent.dd_segment_potential_sb[column_i];
+										auto& n_active_synapses = layer_fluent.dd_segment_active_sb[column_i];
+										if (!column_touched[column_i])
+										{
+											column_touched[column_i] = 1;
+											touched_columns.push_back(column_i);
+											const int n_segments = layer.dd_segment_count[column_i];
+											if (static_cast<int>(n_potential_synapses.size()) < n_segments)
+											{
+												n_potential_synapses.resize(n_segments, 0);
+												n_active_synapses.resize(n_segments, 0);
+											}
+										}
+										n_potential_synapses[segment_i]++;
+										n_active_synapses[segment_i] += (permanence > P::TP_DD_PERMANENCE_THRESHOLD);
+									}
+								}
+							}
+						}
 
+						for (const int column_i : touched_columns)
+						{
+							auto& active_segments_current = layer_fluent.active_dd_segments[column_i].current();
+							auto& matching_segments_current = layer_fluent.matching_dd_segments[column_i].current();
+							auto& active_time = layer_fluent.dd_synapse_active_time[column_i];
+							auto& lru = layer_fluent.dd_segment_lru[column_i];
+							auto& n_potential_synapses = layer_fluent.dd_segment_potential_sb[column_i];
+							auto& n_active_synapses = layer_fluent.dd_segment_active_sb[column_i];
+							const int n_segments = layer.dd_segment_count[column_i];
 
-										n_potential_synapses++;
-									n_active_synapses += (permanence >= param.TP_DD_PERMANENCE_THRESHOLD);
+							for (int segment_i = 0; segment_i < n_segments; ++segment_i)
+							{
+								if (n_potential_synapses[segment_i] > param.TP_MIN_DD_ACTIVATION_THRESHOLD)
+								{
+									matching_segments_current.add(segment_i, n_potential_synapses[segment_i]);
+								}
+								if (n_active_synapses[segment_i] > param.TP_DD_SEGMENT_ACTIVE_THRESHOLD)
+								{
+									active_segments_current.add(segment_i, n_active_synapses[segment_i]);
+									if (LEARN)
+									{
+										active_time[segment_i] = time;
+										lru.touch(segment_i);
+									}
 								}
+								n_potential_synapses[segment_i] = 0;
+								n_active_synapses[segment_i] = 0;
+							}
+							column_touched[column_i] = 0;
+						}
+						touched_columns.clear();
+
+						if constexpr (DEBUG_ON) {
+							std::vector<Segments_Set> active_segments_current_sb;
+							std::vector<Segments_Set> matching_segments_current_sb;
+							for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+							{
+								active_segments_current_sb.push_back(Segments_Set(layer_fluent.active_dd_segments[column_i].current()));
+								matching_segments_current_sb.push_back(Segments_Set(layer_fluent.matching_dd_segments[column_i].current()));
+							}
+							synapse_forward::activate_dendrites_sf_ref<LEARN>(layer_fluent, layer, time, active_cells, param);
+							for (auto column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+							{
+								if (layer_fluent.active_dd_segments[column_i].current()._data != active_segments_current_sb[column_i]._data) log_ERROR("TP:activate_dendrites_sb_ref: UNEQUAL: column ", column_i, "; active segments of ref and sb differ.\n");
+								if (layer_fluent.matching_dd_segments[column_i].current()._data != matching_segments_current_sb[column_i]._data) log_ERROR("TP:activate_dendrites_sb_ref: UNEQUAL: column ", column_i, "; matching segments of ref and sb differ.\n");
 							}
 						}
-						*/
 					}
 				}
 
@@ -1142,18 +2020,34 @@ namespace htm
 				{
 					//log_INFO("activate_dendrites_sf_ref: n_active_cells=", active_cells.count(), "; N_CELLS=", P::N_CELLS, "\n");
 
-					if constexpr (P::TP_SYNAPSE_FORWARD)
+					if constexpr (!P::TP_SYNAPSE_FORWARD)
 					{
-						switch (architecture_switch(P::ARCH))
+						// synapse backward only visits the synapses of the active cells, but a visit is a scattered access: use it
+						// when the active cells have few outgoing synapses compared to the number of synapses of the forward scan.
+						auto& active_cell_ids = layer_fluent.active_cell_ids_sb;
+						const int64_t n_synapses_sb = synapse_backward::collect_active_cells(layer, active_cells, active_cell_ids);
+						if ((n_synapses_sb * P::TP_DD_SB_COST_FACTOR) < layer.dd_synapse_count_total_sb)
 						{
-							case arch_t::X64: return synapse_forward::activate_dendrites_sf_ref<LEARN>(layer_fluent, layer, time, active_cells, param);
-							case arch_t::AVX512: return synapse_forward::activate_dendrites_sf_avx512<LEARN>(layer_fluent, layer, time, active_cells, param);
-							default: return synapse_forward::activate_dendrites_sf_ref<LEARN>(layer_fluent, layer, time, active_cells, param);
+							if constexpr (::tools::profiler::ON) ::tools::profiler::count("tp.synapses_scanned", n_synapses_sb);
+							if (false) log_INFO("TP:activate_dendrites: time ", time, "; synapse backward: ", n_synapses_sb, " of ", layer.dd_synapse_count_total_sb, " synapses.\n");
+							return synapse_backward::activate_dendrites_sb_ref<LEARN>(layer_fluent, layer, time, active_cells, active_cell_ids, param);
 						}
 					}
-					else
+					if constexpr (::tools::profiler::ON)
 					{
-						synapse_backward::activate_dendrites_sb_ref<LEARN>(layer_fluent, layer, time, active_cells, param);
+						int64_t n_synapses = 0;
+						for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+						{
+							for (int segment_i = 0; segment_i < layer.dd_segment_count[column_i]; ++segment_i) n_synapses += layer.dd_synapse_count_sf[column_i][segment_i];
+						}
+						::tools::profiler::count("tp.synapses_scanned", n_synapses);
+					}
+					switch (architecture_switch(P::ARCH))
+					{
+						case arch_t::X64: return synapse_forward::activate_dendrites_sf_ref<LEARN>(layer_fluent, layer, time, active_cells, param);
+						case arch_t::AVX2: return synapse_forward::activate_dendrites_sf_avx2<LEARN>(layer_fluent, layer, time, active_cells, param);
+						case arch_t::AVX512: return synapse_forward::activate_dendrites_sf_avx512<LEARN>(layer_fluent, layer, time, active_cells, param);
+						default: return synapse_forward::activate_dendrites_sf_ref<LEARN>(layer_fluent, layer, time, active_cells, param);
 					}
 				}
 			}
@@ -1171,37 +2065,100 @@ namespace htm
 			typename Layer_Fluent<P>::Active_Cells& active_cells,
 			typename Layer_Fluent<P>::Winner_Cells& winner_cells)
 		{
+			::tools::profiler::Scope scope("tp");
 			if constexpr (DEBUG_ON) {
 				//if (false) log_INFO("TP:compute_tp: prev_winner_cells: ", print::print_active_cells(winner_cells.prev()));
 				//if (false) log_INFO("TP:compute_tp: prev_active_cells: ", print::print_active_cells(active_cells.prev()));
 			}
 
-			priv::activate_cells::d<LEARN>(
-				layer_fluent,
-				layer,
-				time,
-				param,
-				//in
-				active_columns,
-				//inout
-				active_cells,
-				winner_cells);
+			{
+				::tools::profiler::Scope scope_activate_cells("tp.activate_cells");
+				priv::activate_cells::d<LEARN>(
+					layer_fluent,
+					layer,
+					time,
+					param,
+					//in
+					active_columns,
+					//inout
+					active_cells,
+					winner_cells);
+			}
 
 			if constexpr (DEBUG_ON) {
 				//if (true) log_INFO("TP:compute_tp: active_cells current: time = ", time, ":", print::print_active_cells<P>(active_cells));
 				//if (false) log_INFO("TP:compute_tp: winner_cells current: time = ", time, ":", print::print_active_cells(winner_cells.current()));
 			}
 
-			priv::activate_dendrites::d<LEARN>(
-				layer_fluent,
-				layer,
-				time,
-				active_cells,
-				param);
+			{
+				::tools::profiler::Scope scope_activate_dendrites("tp.activate_dendrites");
+				priv::activate_dendrites::d<LEARN>(
+					layer_fluent,
+					layer,
+					time,
+					active_cells,
+					param);
+			}
+			if constexpr (::tools::profiler::ON)
+			{
+				int64_t n_active_segments = 0;
+				int64_t n_matching_segments = 0;
+				for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+				{
+					n_active_segments += layer_fluent.active_dd_segments[column_i].current().count();
+					n_matching_segments += layer_fluent.matching_dd_segments[column_i].current().count();
+				}
+				::tools::profiler::count("tp.active_segments", n_active_segments);
+				::tools::profiler::count("tp.matching_segments", n_matching_segments);
+			}
 
 			if constexpr (DEBUG_ON) {
 				if (false) log_INFO("TP:compute_tp: all synapses: time = ", time, ":", print::print_dd_synapses(layer));
 			}
 		}
+
+		//Compact the distal dendrites of all columns (see priv::compact_column); returns the number of removed synapses
+		//and segments. Segment ids change, thus no other layer_fluent may use the layer (eg. inference::Streams).
+		template <typename P>
+		std::tuple<int64_t, int64_t> compact(
+			Layer_Fluent<P>& layer_fluent,
+			Layer_Persisted<P>& layer,
+			const Dynamic_Param& param)
+		{
+			::tools::profiler::Scope scope("tp.compact");
+			if constexpr (!P::TP_SYNAPSE_FORWARD)
+			{
+				priv::dd_sb::apply_changes(layer_fluent, layer);
+			}
+
+			std::atomic<int64_t> n_removed_synapses(0);
+			std::atomic<int64_t> n_removed_segments(0);
+			priv::for_each_column_chunk<P>(param, [&](const int column_begin, const int column_end)
+			{
+				std::vector<int> new_segment_index;
+				int64_t n_synapses = 0;
+				int64_t n_segments = 0;
+				for (int column_i = column_begin; column_i < column_end; ++column_i)
+				{
+					const auto tup = priv::compact_column(layer_fluent, layer, column_i, new_segment_index);
+					n_synapses += std::get<0>(tup);
+					n_segments += std::get<1>(tup);
+				}
+				n_removed_synapses += n_synapses;
+				n_removed_segments += n_segments;
+			});
+
+			if constexpr (!P::TP_SYNAPSE_FORWARD)
+			{
+				if ((n_removed_synapses > 0) || (n_removed_segments > 0)) priv::dd_sb::rebuild(layer_fluent, layer);
+			}
+			if constexpr (::tools::profiler::ON)
+			{
+				::tools::profiler::count("tp.compact.synapses_removed", n_removed_synapses);
+				::tools::profiler::count("tp.compact.segments_removed", n_removed_segments);
+			}
+			if (false) log_INFO("TP:compact: removed ", n_removed_synapses.load(), " synapses and ", n_removed_segments.load(), " segments.\n");
+			return std::make_tuple(n_removed_synapses.load(), n_removed_segments.load());
+		}
 	}
 }
\ No newline at end of file
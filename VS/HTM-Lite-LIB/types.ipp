@@ -17,6 +17,9 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <type_traits>
+#include <algorithm>		// std::stable_sort
+#include <cstring>		// std::memcpy
 
 #include "..\Spike-Tools-LIB\assert.ipp"
 #include "..\Spike-Tools-LIB\allocator.ipp"
@@ -34,7 +37,8 @@ namespace htm
 		{
 			template <typename T>
 			//using Allocator = std::allocator<T>;
-			using Allocator = ::tools::allocator::Allocator_AVX512<T>;
+			//using Allocator = ::tools::allocator::Allocator_AVX512<T>;
+			using Allocator = ::tools::allocator::Allocator_Pool<T>;
 
 			template <int SIZE> struct basetype {};
 
@@ -166,6 +170,11 @@ namespace htm
 			{
 				this->_data.clear();
 			}
+			//Reserve space for n set bits such that setting up to n bits does not allocate.
+			void reserve(const int n)
+			{
+				this->_data.reserve(n);
+			}
 		};
 
 		//========================================================================
@@ -207,19 +216,22 @@ namespace htm
 			{
 				this->_data = 0;
 			}
+			//The bits as an unsigned word, without the sign extension of the (signed) internal type.
+			uint64_t bits() const
+			{
+				return static_cast<uint64_t>(static_cast<typename std::make_unsigned<internal_type>::type>(this->_data)) & static_cast<uint64_t>(MASK);
+			}
 			bool any() const
 			{
-				return this->_data > 0;
+				return this->_data != 0;
 			}
 			bool empty() const
 			{
-				return this->_data == 0
+				return this->_data == 0;
 			}
 			int count() const
 			{
-				int counter = 0;
-				for (int i = 0; i < SIZE; ++i) if (this->get(i)) counter++;
-				return counter;
+				return static_cast<int>(_mm_popcnt_u64(this->bits()));
 			}
 		};
 
@@ -347,7 +359,7 @@ namespace htm
 			}
 			bool any() const
 			{
-				for (int i = 0; i < N_BLOCKS; ++i) if (this->_data[i] > 0) return true;
+				for (int i = 0; i < N_BLOCKS; ++i) if (this->_data[i] != 0) return true;
 				return false;
 			}
 			//count the number of set bits.
@@ -411,6 +423,107 @@ namespace htm
 			{
 				this->_data.clear();
 			}
+			//Reserve space for n segments such that adding up to n segments does not allocate.
+			void reserve(const int n)
+			{
+				this->_data.reserve(n);
+			}
+			//Renumber the segments with new_index (segment id -> new id, -1 for a removed segment); new_index is
+			//monotonic such that the order of the set does not change.
+			void remap(const std::vector<int>& new_index)
+			{
+				int n = 0;
+				for (int i = 0; i < this->count(); ++i)
+				{
+					const int new_id = new_index[this->get_id(i)];
+					if (new_id != -1) this->_data[n++] = static_cast<uint64_t>(new_id) << 32 | static_cast<uint64_t>(this->get_activity(i));
+				}
+				this->_data.resize(n);
+			}
+		};
+
+		//========================================================================
+		//Segments of one column in least recently used order: an intrusive doubly linked list over the segment ids,
+		//such that touching a segment and getting the least recently used segment take constant time.
+		struct Segments_LRU
+		{
+			std::vector<int> _prev;
+			std::vector<int> _next;
+			int _head = -1; //least recently used
+			int _tail = -1; //most recently used
+
+			bool contains(const int segment_i) const
+			{
+				return (segment_i < static_cast<int>(this->_prev.size())) && ((this->_prev[segment_i] != -1) || (this->_head == segment_i));
+			}
+			//Make the provided segment the most recently used; a segment that is not in the list is added.
+			void touch(const int segment_i)
+			{
+				if (this->_tail == segment_i) return;
+				if (this->contains(segment_i))
+				{
+					this->unlink(segment_i);
+				}
+				else if (segment_i >= static_cast<int>(this->_prev.size()))
+				{
+					this->_prev.resize(segment_i + 1, -1);
+					this->_next.resize(segment_i + 1, -1);
+				}
+				this->_prev[segment_i] = this->_tail;
+				this->_next[segment_i] = -1;
+				if (this->_tail == -1) this->_head = segment_i; else this->_next[this->_tail] = segment_i;
+				this->_tail = segment_i;
+			}
+			//Least recently used segment; -1 when the list is empty.
+			int least_recent() const
+			{
+				return this->_head;
+			}
+			//Reserve space for n segments such that touching segments with an id below n does not allocate.
+			void reserve(const int n)
+			{
+				this->_prev.reserve(n);
+				this->_next.reserve(n);
+			}
+			void reset()
+			{
+				this->_prev.clear();
+				this->_next.clear();
+				this->_head = -1;
+				this->_tail = -1;
+			}
+			//Rebuild the list from the last active time of the first n_segments segments: least recent first, ties in
+			//segment order.
+			void rebuild(const std::vector<int>& active_time, const int n_segments)
+			{
+				std::vector<int> order(n_segments);
+				for (int i = 0; i < n_segments; ++i) order[i] = i;
+				std::stable_sort(order.begin(), order.end(), [&](const int a, const int b) { return active_time[a] < active_time[b]; });
+				this->reset();
+				for (const int segment_i : order) this->touch(segment_i);
+			}
+			//Renumber the segments with new_index (segment id -> new id, -1 for a removed segment) keeping the order.
+			void remap(const std::vector<int>& new_index)
+			{
+				std::vector<int> order;
+				for (int segment_i = this->_head; segment_i != -1; segment_i = this->_next[segment_i])
+				{
+					if (new_index[segment_i] != -1) order.push_back(new_index[segment_i]);
+				}
+				this->reset();
+				for (const int segment_i : order) this->touch(segment_i);
+			}
+
+		private:
+			void unlink(const int segment_i)
+			{
+				const int prev = this->_prev[segment_i];
+				const int next = this->_next[segment_i];
+				if (prev == -1) this->_head = next; else this->_next[prev] = next;
+				if (next == -1) this->_tail = prev; else this->_prev[next] = prev;
+				this->_prev[segment_i] = -1;
+				this->_next[segment_i] = -1;
+			}
 		};
 
 		//========================================================================
@@ -467,6 +580,10 @@ namespace htm
 			{
 				return this->_data[this->get_prev_index(this->_current_index)];
 			}
+			base_type& prev()
+			{
+				return this->_data[this->get_prev_index(this->_current_index)];
+			}
 			const base_type& prev(const int delay) const
 			{
 				if (delay == 1)
@@ -487,6 +604,16 @@ namespace htm
 				this->_uptodate = false;
 				for (int i = 0; i < SIZE; ++i) this->_data[i].reset();
 			}
+			//Reserve space for n elements in every time step of the history.
+			void reserve(const int n)
+			{
+				for (int i = 0; i < SIZE; ++i) this->_data[i].reserve(n);
+			}
+			//Reserve space for n elements in the sparse history of the previous time steps (see get_sparse_history).
+			void reserve_sparse_history(const int n)
+			{
+				this->_sparse_history.reserve(n);
+			}
 			template <int SIZE1, int SIZE2>
 			void set_current(const Bitset2<SIZE1, SIZE2>& current)
 			{
@@ -532,6 +659,8 @@ namespace htm
 			}
 		};
 
+		//Bitset with history: one byte per cell, bit d of the byte is the state of d time steps ago. Seen as 32-bit words,
+		//a word holds 4 cells with 8 bits each; the bytes are followed by a zeroed guard of 64 bytes for vector gathers.
 		template <int SIZE_IN, int HISTORY_SIZE_IN>
 		class Bitset_Hist8
 		{
@@ -541,12 +670,16 @@ namespace htm
 			static_assert(HISTORY_SIZE >= 1, "invalid HISTORY_SIZE_IN");
 			static_assert(HISTORY_SIZE <= 8, "invalid HISTORY_SIZE_IN");
 
+			static constexpr int BITS_PER_CELL_LOG2 = 3;
+			static constexpr int CELLS_PER_WORD_LOG2 = 2;
+			static constexpr int N_GUARD_BYTES = 64;
+
 			std::vector<char> _data;
 
 			// default constructor
 			Bitset_Hist8()
 			{
-				this->_data = std::vector<char>(SIZE);
+				this->_data = std::vector<char>(SIZE + N_GUARD_BYTES);
 			}
 			char& operator[] (int i)
 			{
@@ -582,14 +715,13 @@ namespace htm
 			template <int SIZE1, int SIZE2>
 			void set_current(const Bitset2<SIZE1, SIZE2>& current)
 			{
-				auto counter = 0;
 				for (auto column_i = 0; column_i < SIZE1; ++column_i)
 				{
-					const auto & a2 = current[column_i];
-					for (auto cell_i = 0; cell_i < SIZE2; ++cell_i)
+					uint64_t cells = current[column_i].bits();
+					while (cells != 0)
 					{
-						if (a2.get(cell_i)) this->_data[counter] |= 1;
-						counter++;
+						this->_data[(column_i * SIZE2) + static_cast<int>(_tzcnt_u64(cells))] |= 1;
+						cells &= cells - 1;
 					}
 				}
 			}
@@ -606,6 +738,126 @@ namespace htm
 				for (int i = 0; i < SIZE; ++i) if (this->_data[i]) counter++;
 				return counter;
 			}
+			//Collect the ids of the cells that are active at one of the delays in the provided history mask.
+			void collect_active(const unsigned int history_mask, std::vector<int>& ids) const
+			{
+				const char mask = static_cast<char>(history_mask);
+				ids.clear();
+				for (int i = 0; i < SIZE; ++i) if (this->_data[i] & mask) ids.push_back(i);
+			}
+		};
+
+		//Bitset with history, bit packed: the history of a cell occupies a field of 2^BITS_PER_CELL_LOG2 >= HISTORY_SIZE bits
+		//and one 32-bit word holds the fields of 2^CELLS_PER_WORD_LOG2 neighbouring cells. The state of cell i, d time steps ago,
+		//is bit ((i & (CELLS_PER_WORD - 1)) << BITS_PER_CELL_LOG2) + d of word (i >> CELLS_PER_WORD_LOG2). Compared to
+		//Bitset_Hist8, one gather serves 32 / 2^BITS_PER_CELL_LOG2 cells and the memory footprint is 8 / 2^BITS_PER_CELL_LOG2
+		//times smaller. The words are followed by a zeroed guard of 64 bytes for vector gathers.
+		template <int SIZE_IN, int HISTORY_SIZE_IN>
+		class Bitset_Hist_Packed
+		{
+		public:
+			static constexpr int SIZE = SIZE_IN;
+			static constexpr int HISTORY_SIZE = HISTORY_SIZE_IN;
+			static_assert(HISTORY_SIZE >= 1, "invalid HISTORY_SIZE_IN");
+			static_assert(HISTORY_SIZE <= 8, "invalid HISTORY_SIZE_IN");
+
+			static constexpr int BITS_PER_CELL_LOG2 = (HISTORY_SIZE <= 1) ? 0 : (HISTORY_SIZE <= 2) ? 1 : (HISTORY_SIZE <= 4) ? 2 : 3;
+			static constexpr int CELLS_PER_WORD_LOG2 = 5 - BITS_PER_CELL_LOG2;
+			static constexpr int BITS_PER_CELL = 1 << BITS_PER_CELL_LOG2;
+			static constexpr int CELLS_PER_WORD = 1 << CELLS_PER_WORD_LOG2;
+			static constexpr int N_WORDS = (SIZE + CELLS_PER_WORD - 1) >> CELLS_PER_WORD_LOG2;
+			static constexpr int N_GUARD_WORDS = 16;
+
+			//Lowest bit of the field of every cell in a word.
+			static constexpr unsigned int FIELD_LOW_BITS =
+				(BITS_PER_CELL_LOG2 == 0) ? 0xFFFFFFFFu :
+				(BITS_PER_CELL_LOG2 == 1) ? 0x55555555u :
+				(BITS_PER_CELL_LOG2 == 2) ? 0x11111111u : 0x01010101u;
+			//All bits of the field of the first cell in a word.
+			static constexpr unsigned int FIELD_MASK = (1u << BITS_PER_CELL) - 1;
+
+			std::vector<unsigned int, priv::Allocator<unsigned int>> _data;
+
+			// default constructor
+			Bitset_Hist_Packed()
+			{
+				this->_data = std::vector<unsigned int, priv::Allocator<unsigned int>>(N_WORDS + N_GUARD_WORDS, 0);
+			}
+			unsigned int * data()
+			{
+				return this->_data.data();
+			}
+			unsigned int const * data() const
+			{
+				return this->_data.data();
+			}
+			void reset()
+			{
+				std::fill(this->_data.begin(), this->_data.end(), 0);
+			}
+			void advance_time()
+			{
+				// the oldest bit of a field is shifted into the next field: clear it
+				for (int i = 0; i < N_WORDS; ++i) this->_data[i] = (this->_data[i] << 1) & ~FIELD_LOW_BITS;
+			}
+
+			bool get(const int i, const int delay) const
+			{
+				assert_msg(delay < HISTORY_SIZE, "ERROR:Bitset_Hist_Packed: invalid delay ", delay, "; HISTORY_SIZE = ", HISTORY_SIZE);
+				const int pos = ((i & (CELLS_PER_WORD - 1)) << BITS_PER_CELL_LOG2) + delay;
+				return ((this->_data[i >> CELLS_PER_WORD_LOG2] >> pos) & 1) != 0;
+			}
+
+			template <int SIZE1, int SIZE2>
+			void set_current(const Bitset2<SIZE1, SIZE2>& current)
+			{
+				for (auto column_i = 0; column_i < SIZE1; ++column_i)
+				{
+					uint64_t cells = current[column_i].bits();
+					while (cells != 0)
+					{
+						const int cell_id = (column_i * SIZE2) + static_cast<int>(_tzcnt_u64(cells));
+						this->_data[cell_id >> CELLS_PER_WORD_LOG2] |= 1u << ((cell_id & (CELLS_PER_WORD - 1)) << BITS_PER_CELL_LOG2);
+						cells &= cells - 1;
+					}
+				}
+			}
+
+			bool any() const
+			{
+				for (int i = 0; i < N_WORDS; ++i) if (this->_data[i]) return true;
+				return false;
+			}
+			//count the number of cells with a set bit.
+			int count() const
+			{
+				int counter = 0;
+				for (int i = 0; i < N_WORDS; ++i)
+				{
+					unsigned int x = this->_data[i];
+					if (BITS_PER_CELL_LOG2 >= 1) x |= x >> 1;
+					if (BITS_PER_CELL_LOG2 >= 2) x |= x >> 2;
+					if (BITS_PER_CELL_LOG2 >= 3) x |= x >> 4;
+					counter += _mm_popcnt_u32(x & FIELD_LOW_BITS);
+				}
+				return counter;
+			}
+			//Collect the ids of the cells that are active at one of the delays in the provided history mask.
+			void collect_active(const unsigned int history_mask, std::vector<int>& ids) const
+			{
+				const unsigned int field_mask = history_mask & FIELD_MASK;
+				const unsigned int word_mask = field_mask * FIELD_LOW_BITS;
+				ids.clear();
+				for (int word_i = 0; word_i < N_WORDS; ++word_i)
+				{
+					const unsigned int word = this->_data[word_i] & word_mask;
+					if (word == 0) continue;
+					for (int j = 0; j < CELLS_PER_WORD; ++j)
+					{
+						if ((word >> (j << BITS_PER_CELL_LOG2)) & field_mask) ids.push_back((word_i << CELLS_PER_WORD_LOG2) + j);
+					}
+				}
+			}
 		};
 
 		//========================================================================
@@ -613,7 +865,9 @@ namespace htm
 		template <typename P>
 		struct Layer_Fluent
 		{
-			using Active_Cells = Bitset_Hist8<P::N_CELLS, P::HISTORY_SIZE + 1>;
+			using Active_Cells = std::conditional_t<P::TP_ACTIVE_CELLS_PACKED,
+				Bitset_Hist_Packed<P::N_CELLS, P::HISTORY_SIZE + 1>,
+				Bitset_Hist8<P::N_CELLS, P::HISTORY_SIZE + 1>>;
 			using Winner_Cells = History<Bitset_Sparse<P::N_CELLS>, P::HISTORY_SIZE + 1>;
 			using Active_Columns = Bitset_Compact<P::N_COLUMNS>;
 			using Active_Sensors = Bitset_Compact<P::N_SENSORS>;
@@ -624,6 +878,9 @@ namespace htm
 			//Pseudo random number used only by the column.
 			std::vector<unsigned int> random_number;
 
+			//Random streams of the sensor noise of this layer.
+			::tools::random::Random_Lanes noise_random_lanes;
+
 			Active_Cells active_cells; //32MB for 1M columns times History
 			Winner_Cells winner_cells;
 
@@ -636,6 +893,10 @@ namespace htm
 			//Last time step synapse was active.
 			std::vector<std::vector<int>> dd_synapse_active_time = std::vector<std::vector<int>>(P::N_COLUMNS);
 
+			//Segments per column in order of dd_synapse_active_time: the least recently used segment is recycled
+			//when a column has TP_N_DD_SEGMENTS_MAX segments.
+			std::vector<Segments_LRU> dd_segment_lru = std::vector<Segments_LRU>(P::N_COLUMNS);
+
 
 			#pragma region Used by SP only
 			//Number of iterations.
@@ -656,11 +917,131 @@ namespace htm
 			std::vector<float> sp_overlap_duty_cycles = std::vector<float>(P::N_COLUMNS, 0.0f);
 			std::vector<float> sp_min_overlap_duty_cycles = std::vector<float>(P::N_COLUMNS, 0.0f);
 
+			//Radius (in columns) of the neighbourhood in which columns inhibit each other; only used with local inhibition.
+			int sp_inhibition_radius = 0;
+
+			//Scratch of compute_sp such that a time step does not allocate: the overlap and boosted overlap of every column,
+			//for the top k column selection the key of every column, the candidates of a radix pass and a digit histogram,
+			//and for the local inhibition the boosted overlaps of an inhibition window.
+			std::vector<int> sp_overlap = std::vector<int>(P::N_COLUMNS);
+			std::vector<float> sp_boosted_overlap = std::vector<float>(P::N_COLUMNS);
+			std::vector<uint32_t> sp_inhibition_key = std::vector<uint32_t>(P::N_COLUMNS);
+			std::vector<uint32_t> sp_inhibition_candidates = std::vector<uint32_t>(P::N_COLUMNS);
+			std::vector<int> sp_inhibition_histogram = std::vector<int>(1 << 11);
+			std::vector<float> sp_inhibition_values;
+
+			#pragma region Used by SP local inhibition only
+			//Scratch of update_inhibition_radius: the bounding box of the connected visible sensors of every column.
+			std::vector<int> sp_span_min_x;
+			std::vector<int> sp_span_min_y;
+			std::vector<int> sp_span_max_x;
+			std::vector<int> sp_span_max_y;
+			#pragma endregion
+
+			//Scratch of compute_tp: the active and winner cells of the current time step, one row per column such that
+			//the columns can write them concurrently.
+			Bitset2<P::N_COLUMNS, P::N_CELLS_PC> tp_active_cells_2D;
+			Bitset2<P::N_COLUMNS, P::N_CELLS_PC> tp_winner_cells_2D;
+
+			//Scratch of the sensor prediction: the number of predicted columns per sensor, and the actual and predicted
+			//sensors of every future; the latter two are sized on first use.
+			std::vector<int> predicted_sensor_activity = std::vector<int>(P::N_SENSORS);
+			std::vector<Active_Sensors> future_actual_sensors;
+			std::vector<Active_Visible_Sensors> future_predicted_sensors;
+
+			#pragma region Used by SP incremental overlap only
+			//Overlap of the columns (before the stimulus threshold) with sp_active_sensors_incremental.
+			std::vector<int> sp_overlap_incremental;
+
+			//Sensors of the previous time step.
+			Active_Sensors sp_active_sensors_incremental;
+
+			//Whether sp_overlap_incremental is valid; false after init.
+			bool sp_overlap_valid_incremental = false;
+			#pragma endregion
+
+			#pragma region Used by TP synapse backward only
+			//A change to the inverse synapse index: the add flag (1 bit) and the presynaptic cell (31 bits) in the upper
+			//32 bits and the synapse without the column in the lower 32 bits (see tp::priv::dd_sb); position is the
+			//position of a removed synapse in the index of its cell, or -1 when it is not known.
+			struct DD_Synapse_SB_Change
+			{
+				uint64_t change;
+				int position;
+			};
+
+			//Changes to the inverse synapse index made by a column in the current time step; they are applied
+			//to Layer_Persisted::dd_synapse_sb after all columns are done, such that columns can run concurrently.
+			std::vector<std::vector<DD_Synapse_SB_Change>> dd_synapse_sb_changes;
+
+			//Bitset of the columns with changes in dd_synapse_sb_changes: one word per 64 columns, such that the columns of
+			//one chunk (a multiple of 64 columns, see tp::priv::for_each_column_chunk) only write their own words.
+			std::vector<uint64_t> dd_synapse_sb_changed_columns;
+
+			//Cells that are active with any delay in the current time step.
+			std::vector<int> active_cell_ids_sb;
+
+			//Number of potential and active synapses per segment; all zero outside activate_dendrites_sb.
+			std::vector<std::vector<int>> dd_segment_potential_sb;
+			std::vector<std::vector<int>> dd_segment_active_sb;
+
+			//Columns with at least one segment with a non zero count in dd_segment_potential_sb.
+			std::vector<int> touched_columns_sb;
+			std::vector<char> column_touched_sb;
+			#pragma endregion
+
+			#pragma region Used by lookahead only
+			//The state that a time step without learning changes (the sp and tp scratch excluded). layer::priv::Fork saves
+			//it here before the layer looks ahead, and swaps it back afterwards.
+			struct Fork_State
+			{
+				Active_Cells active_cells;
+				Winner_Cells winner_cells;
+				Active_Columns active_columns;
+				std::vector<Active_Segments> active_dd_segments = std::vector<Active_Segments>(P::N_COLUMNS);
+				std::vector<Matching_Segments> matching_dd_segments = std::vector<Matching_Segments>(P::N_COLUMNS);
+				std::vector<unsigned int> random_number;
+				int iteration_num = 0;
+				std::vector<int> sp_overlap_incremental;
+				Active_Sensors sp_active_sensors_incremental;
+				bool sp_overlap_valid_incremental = false;
+			};
+
+			//Empty until the first fork, such that a layer that does not look ahead does not pay for it.
+			std::vector<Fork_State> fork_state;
+			#pragma endregion
+
 			// default constructor
 			Layer_Fluent()
 			{
 				this->random_number = std::vector<unsigned int>(P::N_COLUMNS);
 				for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i) this->random_number[column_i] = random::rdrand32();
+
+				// every cell can be a winner: the winner cells and their sparse history never allocate in a time step
+				this->winner_cells.reserve(P::N_CELLS);
+				this->winner_cells.reserve_sparse_history(P::HISTORY_SIZE * P::N_CELLS);
+
+				if (!P::SP_GLOBAL_INHIBITION)
+				{
+					this->sp_span_min_x = std::vector<int>(P::N_COLUMNS);
+					this->sp_span_min_y = std::vector<int>(P::N_COLUMNS);
+					this->sp_span_max_x = std::vector<int>(P::N_COLUMNS);
+					this->sp_span_max_y = std::vector<int>(P::N_COLUMNS);
+				}
+				if (P::SP_OVERLAP_INCREMENTAL)
+				{
+					this->sp_overlap_incremental = std::vector<int>(P::N_COLUMNS, 0);
+				}
+				if (!P::TP_SYNAPSE_FORWARD)
+				{
+					this->dd_synapse_sb_changes = std::vector<std::vector<DD_Synapse_SB_Change>>(P::N_COLUMNS);
+					this->dd_synapse_sb_changed_columns = std::vector<uint64_t>(P::N_COLUMNS >> 6, 0);
+					this->dd_segment_potential_sb = std::vector<std::vector<int>>(P::N_COLUMNS);
+					this->dd_segment_active_sb = std::vector<std::vector<int>>(P::N_COLUMNS);
+					this->column_touched_sb = std::vector<char>(P::N_COLUMNS, 0);
+					this->touched_columns_sb.reserve(P::N_COLUMNS);
+					this->active_cell_ids_sb.reserve(P::N_CELLS);
+				}
 			}
 		};
 
@@ -674,17 +1055,49 @@ namespace htm
 			//Cell to which this segment belongs to.
 			std::vector<std::vector<int8_t>> dd_segment_destination = std::vector<std::vector<int8_t>>(P::N_COLUMNS);
 
-			using t5 = std::vector<std::vector<Permanence, priv::Allocator<Permanence>>>;
-			//Permanence of the synapses of the the provided segment index.
+			#pragma region distal dendrite slab
+			//The synapses of all segments of one column are stored in one 64-byte aligned slab (per column).
+			//A segment occupies a chunk of the slab that starts at dd_segment_offset_sf and has dd_segment_capacity_sf
+			//synapse slots; both are multiples of 64 such that every chunk is aligned for vectorization.
+
+			using t5 = std::vector<Permanence, priv::Allocator<Permanence>>;
+			//Permanence of the synapses of all segments of the provided column.
 			std::vector<t5> dd_synapse_permanence_sf = std::vector<t5>(P::N_COLUMNS);
 
-			using t6 = std::vector<std::vector<int, priv::Allocator<int>>>;
-			//Originating cell id of the synapses of the provided segment index.
+			using t6 = std::vector<typename P::TP_Origin, priv::Allocator<typename P::TP_Origin>>;
+			//Originating delay and cell id of the synapses of all segments of the provided column (see tools::widen_origin).
 			std::vector<t6> dd_synapse_delay_origin_sf = std::vector<t6>(P::N_COLUMNS);
 
-			//Number of synapses this column currently has in use; this int is smaller than TP_N_DD_SYNAPSES.
+			//Offset in the slab of the first synapse of the provided segment index.
+			std::vector<std::vector<int>> dd_segment_offset_sf = std::vector<std::vector<int>>(P::N_COLUMNS);
+
+			//Number of synapse slots reserved in the slab for the provided segment index.
+			std::vector<std::vector<int>> dd_segment_capacity_sf = std::vector<std::vector<int>>(P::N_COLUMNS);
+
+			//Chunks of the slab that can be reused by segments: offset in the upper 32 bits, capacity in the lower 32 bits.
+			std::vector<std::vector<uint64_t>> dd_slab_free_sf = std::vector<std::vector<uint64_t>>(P::N_COLUMNS);
+
+			//Number of synapses the provided segment index currently has in use; this int is smaller than TP_N_DD_SYNAPSES_MAX.
 			std::vector<std::vector<int>> dd_synapse_count_sf = std::vector<std::vector<int>>(P::N_COLUMNS);
 
+			Permanence * dd_synapse_permanence_segment(const int column_i, const int segment_i)
+			{
+				return this->dd_synapse_permanence_sf[column_i].data() + this->dd_segment_offset_sf[column_i][segment_i];
+			}
+			const Permanence * dd_synapse_permanence_segment(const int column_i, const int segment_i) const
+			{
+				return this->dd_synapse_permanence_sf[column_i].data() + this->dd_segment_offset_sf[column_i][segment_i];
+			}
+			typename P::TP_Origin * dd_synapse_delay_origin_segment(const int column_i, const int segment_i)
+			{
+				return this->dd_synapse_delay_origin_sf[column_i].data() + this->dd_segment_offset_sf[column_i][segment_i];
+			}
+			const typename P::TP_Origin * dd_synapse_delay_origin_segment(const int column_i, const int segment_i) const
+			{
+				return this->dd_synapse_delay_origin_sf[column_i].data() + this->dd_segment_offset_sf[column_i][segment_i];
+			}
+			#pragma endregion
+
 			//Current boost factor.
 			std::vector<float> boost_factor = std::vector<float>(P::N_COLUMNS, 1.0f);
 
@@ -693,9 +1106,16 @@ namespace htm
 			//Proximal dendrite synapse permanence: iterate over columns: column pushes
 			std::vector<t1> sp_pd_synapse_permanence_sf;
 
-			using t2 = std::vector<int, priv::Allocator<int>>;
+			using t2 = std::vector<typename P::SP_Origin, priv::Allocator<typename P::SP_Origin>>;
 			//Proximal dendrite synapse origin cell ID: iterate over columns: column pushes
 			std::vector<t2> sp_pd_synapse_origin_sensor_sf;
+
+			//Inverse index of the connected proximal dendrite synapses, only maintained when SP_OVERLAP_INCREMENTAL: for every
+			//sensor the columns with a connected synapse that originates from it (a column occurs once per synapse).
+			std::vector<std::vector<int>> sp_pd_connected_index_sf;
+
+			//Connectivity of the proximal dendrite synapses as reflected by sp_pd_connected_index_sf.
+			std::vector<Bitset_Compact<P::SP_N_PD_SYNAPSES>> sp_pd_connected_sf;
 			#pragma endregion
 
 			#pragma region synapse backward
@@ -711,13 +1131,33 @@ namespace htm
 			std::vector<int> sp_pd_synapse_count_sb;
 			#pragma endregion
 
+			#pragma region distal dendrite synapse backward
+			//Inverse index of the distal dendrite synapses, only maintained when TP_SYNAPSE_FORWARD is false: iterate over cells:
+			//cell pushes. For every presynaptic cell the synapses that originate from it, packed as column (32 bits), segment
+			//(16 bits), synapse (13 bits) and delay (3 bits); see tp::priv::dd_sb.
+			std::vector<std::vector<uint64_t>> dd_synapse_sb;
+
+			//Number of synapses in dd_synapse_sb.
+			int64_t dd_synapse_count_total_sb = 0;
+
+			//Position in dd_synapse_sb of the synapse in every slot of the slab of a column (parallel to dd_synapse_permanence_sf),
+			//or -1, such that a removed synapse is found without searching the index of its cell. Not saved in snapshots: it
+			//follows from dd_synapse_sb (see tp::priv::dd_sb::rebuild_positions).
+			std::vector<std::vector<int>> dd_synapse_position_sb;
+			#pragma endregion
+
 			// default constructor
 			Layer_Persisted()
 			{
 				if (P::SP_SYNAPSE_FORWARD)
 				{
 					this->sp_pd_synapse_permanence_sf = std::vector<t1>(P::N_COLUMNS, t1(P::SP_N_PD_SYNAPSES, P::SP_PD_CONNECTED_THRESHOLD));
-					this->sp_pd_synapse_origin_sensor_sf = std::vector<t2>(P::N_COLUMNS, t2(P::SP_N_PD_SYNAPSES, P::SP_PD_SYNAPSE_ORIGIN_INVALID));
+					this->sp_pd_synapse_origin_sensor_sf = std::vector<t2>(P::N_COLUMNS, t2(P::SP_N_PD_SYNAPSES, static_cast<typename P::SP_Origin>(P::SP_PD_SYNAPSE_ORIGIN_INVALID)));
+					if (P::SP_OVERLAP_INCREMENTAL)
+					{
+						this->sp_pd_connected_index_sf = std::vector<std::vector<int>>(P::N_SENSORS);
+						this->sp_pd_connected_sf = std::vector<Bitset_Compact<P::SP_N_PD_SYNAPSES>>(P::N_COLUMNS);
+					}
 				}
 				else
 				{
@@ -725,12 +1165,18 @@ namespace htm
 					this->sp_pd_synapse_permanence_sb = std::vector<t4>(P::N_SENSORS);
 					this->sp_pd_synapse_count_sb = std::vector<int>(P::N_SENSORS);
 				}
+				if (!P::TP_SYNAPSE_FORWARD)
+				{
+					this->dd_synapse_sb = std::vector<std::vector<uint64_t>>(P::N_CELLS);
+					this->dd_synapse_position_sb = std::vector<std::vector<int>>(P::N_COLUMNS);
+				}
 			}
 		};
 
+		//The persisted properties as seen by a time step: const when the time step does not learn, such that one trained
+		//layer can be shared by streams that only infer.
 		template <bool LEARN, typename P>
-		//using Layer_Persisted_C = typename std::conditional<LEARN, Layer_Persisted<P>, const Layer_Persisted<P>>::type;
-		using Layer_Persisted_C = typename std::conditional<LEARN, Layer_Persisted<P>, Layer_Persisted<P>>::type;
+		using Layer_Persisted_C = typename std::conditional<LEARN, Layer_Persisted<P>, const Layer_Persisted<P>>::type;
 
 
 		#pragma region Copy
@@ -739,17 +1185,13 @@ namespace htm
 		void copy(Bitset_Compact<SIZE1 * SIZE2>& out, const Bitset2<SIZE1, SIZE2>& in)
 		{
 			out.clear_all();
-			auto counter = 0;
-
-			//TODO: this can be done by just copying in to the correct position in out
-
 			for (auto column_i = 0; column_i < SIZE1; ++column_i)
 			{
-				const auto & a2 = in[column_i];
-				for (auto cell_i = 0; cell_i < SIZE2; ++cell_i)
+				uint64_t cells = in[column_i].bits();
+				while (cells != 0)
 				{
-					if (a2.get(cell_i)) out.set(counter);
-					counter++;
+					out.set((column_i * SIZE2) + static_cast<int>(_tzcnt_u64(cells)), true);
+					cells &= cells - 1;
 				}
 			}
 
@@ -762,15 +1204,13 @@ namespace htm
 		void copy(Bitset_Sparse<SIZE1 * SIZE2>& out, const Bitset2<SIZE1, SIZE2>& in)
 		{
 			out.reset();
-			auto counter = 0;
-
 			for (auto column_i = 0; column_i < SIZE1; ++column_i)
 			{
-				const auto & a2 = in[column_i];
-				for (auto cell_i = 0; cell_i < SIZE2; ++cell_i)
+				uint64_t cells = in[column_i].bits();
+				while (cells != 0)
 				{
-					if (a2.get(cell_i)) out.set(counter);
-					counter++;
+					out.set((column_i * SIZE2) + static_cast<int>(_tzcnt_u64(cells)));
+					cells &= cells - 1;
 				}
 			}
 
@@ -801,6 +1241,14 @@ namespace htm
 			}
 		}
 
+		//Copy the packed blocks of a Bitset_Compact<SIZE2> that live outside a Bitset (eg. in the ring of a binary stream).
+		template <int SIZE2, int SIZE1>
+		void copy_partial(Bitset_Compact<SIZE1>& out, const int * const in)
+		{
+			static_assert(SIZE2 <= SIZE1, "ERROR: copy_partial: Bitset in is larger than Bitset out.");
+			std::memcpy(out._data.data(), in, Bitset_Compact<SIZE2>::N_BLOCKS * sizeof(int));
+		}
+
 		template <int SIZE>
 		void copy(Bitset_Tiny<SIZE>& out, const Bitset_Tiny<SIZE>& in)
 		{
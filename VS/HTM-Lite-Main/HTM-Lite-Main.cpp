@@ -20,13 +20,17 @@
 #include "..\Spike-Tools-Lib\log.ipp"
 #include "..\Spike-Tools-Lib\timing.ipp"
 #include "..\Spike-Tools-Lib\profiler.ipp"
+#include "..\Spike-Tools-Lib\alloc_counter.ipp"
 
 #include "..\HTM-Lite-LIB\parameters.ipp"
 #include "..\HTM-Lite-LIB\types.ipp"
 #include "..\HTM-Lite-LIB\layer.ipp"
 #include "..\HTM-Lite-LIB\datastream.ipp"
 #include "..\HTM-Lite-LIB\swarm.ipp"
+#include "..\HTM-Lite-LIB\swarm_distributed.ipp"
 #include "..\HTM-Lite-LIB\network.ipp"
+#include "..\HTM-Lite-LIB\snapshot.ipp"
+#include "..\HTM-Lite-LIB\inference.ipp"
 
 using namespace htm;
 using namespace htm::types;
@@ -189,6 +193,1493 @@ inline void test_1layer()
 	htm::layer::run_multiple_times(datastream, layer_fluent, layer, param1, prediction_mismatch);
 }
 
+inline void test_1layer_threads()
+{
+	// scaling of the column parallel temporal pooler: the same layer is run with 1, 2, 4, 8 and 16 threads;
+	// the prediction mismatch has to be identical for all thread counts, only the elapsed time differs.
+
+	constexpr int N_SENSORS_DIM1 = 40;
+	constexpr int N_SENSORS_DIM2 = 40;
+	constexpr int N_VISIBLE_SENSORS = N_SENSORS_DIM1 * N_SENSORS_DIM2;
+	constexpr int N_HIDDEN_SENSORS = 0;
+
+	constexpr int N_BLOCKS = 64 * 8;
+	constexpr int N_COLUMNS = 64 * N_BLOCKS;
+	constexpr int N_BITS_CELL = 4;
+	constexpr int HISTORY_SIZE = 1;
+
+	constexpr arch_t ARCH = arch_t::RUNTIME;
+
+	Dynamic_Param param1;
+	param1.learn = true;
+	param1.n_time_steps = 1000;
+	param1.n_times = 1;
+	param1.n_visible_sensors_dim1 = N_SENSORS_DIM1;
+	param1.n_visible_sensors_dim2 = N_SENSORS_DIM2;
+	param1.quiet = true;
+	param1.SP_LOCAL_AREA_DENSITY = 0.02f;
+
+	using P = Static_Param<N_COLUMNS, N_BITS_CELL, N_VISIBLE_SENSORS, N_HIDDEN_SENSORS, HISTORY_SIZE, ARCH>;
+	DataStream<P> datastream;
+	datastream.load_from_file("../../Misc/data/JumpingBall_40x40/input.txt", param1);
+
+	// all runs start from the same random numbers of the columns
+	const auto layer_fluent_init = std::make_unique<Layer_Fluent<P>>();
+	int prediction_mismatch_1thread = -1;
+
+	for (const int n_threads : { 1, 2, 4, 8, 16 })
+	{
+		param1.n_threads = n_threads;
+		auto layer = std::make_unique<Layer_Persisted<P>>();
+		auto layer_fluent = std::make_unique<Layer_Fluent<P>>(*layer_fluent_init);
+
+		std::vector<int> prediction_mismatch(1);
+		const auto start_time = std::chrono::system_clock::now();
+		htm::layer::run_multiple_times(datastream, *layer_fluent, *layer, param1, prediction_mismatch);
+		const auto end_time = std::chrono::system_clock::now();
+
+		if (n_threads == 1) prediction_mismatch_1thread = prediction_mismatch[0];
+		const double seconds = std::chrono::duration<double>(end_time - start_time).count();
+		log_INFO("test_1layer_threads: n_threads ", n_threads, "; steps/sec ", param1.n_time_steps / seconds, "; mismatch ", prediction_mismatch[0], ((prediction_mismatch[0] == prediction_mismatch_1thread) ? "" : " DIFFERS FROM SERIAL"), "\n");
+	}
+}
+
+inline void test_1layer_lookahead()
+{
+	// multi step prediction by a fork of the fluent state: the layer has to learn exactly as without lookahead (the
+	// mismatch of the next time step is equal), and the mismatch of every further future is reported.
+	constexpr int N_COLUMNS = 64 * 64;
+	constexpr int N_VISIBLE_SENSORS = 40 * 40;
+	using P = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::RUNTIME>;
+
+	Dynamic_Param param1;
+	param1.learn = true;
+	param1.n_time_steps = 1000;
+	param1.n_times = 1;
+	param1.n_visible_sensors_dim1 = 40;
+	param1.n_visible_sensors_dim2 = 40;
+	param1.quiet = true;
+	param1.SP_LOCAL_AREA_DENSITY = 0.02f;
+
+	DataStream<P> datastream;
+	datastream.load_from_file("../../Misc/data/JumpingBall_40x40/input.txt", param1);
+
+	// both runs start from the same random numbers of the columns
+	const auto layer_fluent_init = std::make_unique<Layer_Fluent<P>>();
+	int prediction_mismatch_1future = -1;
+
+	for (const int n_futures : { 1, 5, 10 })
+	{
+		auto layer = std::make_unique<Layer_Persisted<P>>();
+		auto layer_fluent = std::make_unique<Layer_Fluent<P>>(*layer_fluent_init);
+
+		std::vector<int> prediction_mismatch(n_futures);
+		const auto start_time = std::chrono::system_clock::now();
+		htm::layer::run_multiple_times(datastream, *layer_fluent, *layer, param1, prediction_mismatch);
+		const double seconds = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+		if (n_futures == 1) prediction_mismatch_1future = prediction_mismatch[0];
+		std::ostringstream mismatch;
+		for (int future = 0; future < n_futures; ++future) mismatch << " " << prediction_mismatch[future];
+		log_INFO("test_1layer_lookahead: n_futures ", n_futures, "; steps/sec ", param1.n_time_steps / seconds, "; mismatch per future", mismatch.str(), ((prediction_mismatch[0] == prediction_mismatch_1future) ? "" : " (NEXT STEP DIFFERS)"), "\n");
+	}
+}
+
+inline void test_1layer_compaction()
+{
+	// the memory of the distal dendrites and the prediction mismatch without and with periodic compaction.
+	constexpr int N_COLUMNS = 64 * 64;
+	constexpr int N_VISIBLE_SENSORS = 40 * 40;
+	using P = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::RUNTIME>;
+
+	Dynamic_Param param1;
+	param1.learn = true;
+	param1.n_time_steps = 5000;
+	param1.n_times = 1;
+	param1.n_visible_sensors_dim1 = 40;
+	param1.n_visible_sensors_dim2 = 40;
+	param1.quiet = true;
+	param1.SP_LOCAL_AREA_DENSITY = 0.02f;
+
+	DataStream<P> datastream;
+	datastream.load_from_file("../../Misc/data/JumpingBall_40x40/input.txt", param1);
+
+	// both runs start from the same random numbers of the columns
+	const auto layer_fluent_init = std::make_unique<Layer_Fluent<P>>();
+
+	for (const int compact_interval : { 0, 1000, 100 })
+	{
+		param1.TP_DD_COMPACT_INTERVAL = compact_interval;
+		auto layer = std::make_unique<Layer_Persisted<P>>();
+		auto layer_fluent = std::make_unique<Layer_Fluent<P>>(*layer_fluent_init);
+
+		std::vector<int> prediction_mismatch(1);
+		const auto start_time = std::chrono::system_clock::now();
+		htm::layer::run_multiple_times(datastream, *layer_fluent, *layer, param1, prediction_mismatch);
+		const double seconds = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+		int64_t n_segments = 0;
+		int64_t n_synapses = 0;
+		int64_t n_slab_slots = 0;
+		int64_t n_slab_bytes = 0;
+		for (int column_i = 0; column_i < N_COLUMNS; ++column_i)
+		{
+			n_segments += layer->dd_segment_count[column_i];
+			for (int segment_i = 0; segment_i < layer->dd_segment_count[column_i]; ++segment_i) n_synapses += layer->dd_synapse_count_sf[column_i][segment_i];
+			n_slab_slots += layer->dd_synapse_permanence_sf[column_i].size();
+			n_slab_bytes += layer->dd_synapse_permanence_sf[column_i].capacity() * (sizeof(Permanence) + sizeof(int));
+		}
+		log_INFO("test_1layer_compaction: compact interval ", compact_interval, "; steps/sec ", param1.n_time_steps / seconds, "; mismatch ", prediction_mismatch[0], "; segments ", n_segments, "; synapses ", n_synapses, "; slab slots ", n_slab_slots, "; slab MB ", n_slab_bytes / (1024.0 * 1024.0), "\n");
+	}
+}
+
+inline void test_1layer_profiler()
+{
+	// phase timings and per step counters of a layer; compile with PROFILER_ON defined as 1.
+	if (!::tools::profiler::ON)
+	{
+		log_WARNING("test_1layer_profiler: the profiler is compiled out; define PROFILER_ON as 1.\n");
+		return;
+	}
+
+	constexpr int N_SENSORS_DIM1 = 40;
+	constexpr int N_SENSORS_DIM2 = 40;
+	constexpr int N_VISIBLE_SENSORS = N_SENSORS_DIM1 * N_SENSORS_DIM2;
+	constexpr int N_HIDDEN_SENSORS = 0;
+	constexpr int N_COLUMNS = 64 * 64;
+	constexpr int N_BITS_CELL = 4;
+	constexpr int HISTORY_SIZE = 1;
+	constexpr arch_t ARCH = arch_t::RUNTIME;
+
+	Dynamic_Param param1;
+	param1.learn = true;
+	param1.n_time_steps = 1000;
+	param1.n_times = 1;
+	param1.n_visible_sensors_dim1 = N_SENSORS_DIM1;
+	param1.n_visible_sensors_dim2 = N_SENSORS_DIM2;
+	param1.quiet = true;
+	param1.SP_LOCAL_AREA_DENSITY = 0.02f;
+	param1.n_threads = 2;
+
+	using P = Static_Param<N_COLUMNS, N_BITS_CELL, N_VISIBLE_SENSORS, N_HIDDEN_SENSORS, HISTORY_SIZE, ARCH>;
+	DataStream<P> datastream;
+	datastream.load_from_file("../../Misc/data/JumpingBall_40x40/input.txt", param1);
+
+	auto layer = std::make_unique<Layer_Persisted<P>>();
+	auto layer_fluent = std::make_unique<Layer_Fluent<P>>();
+	std::vector<int> prediction_mismatch(1);
+
+	::tools::profiler::reset();
+	htm::layer::run_multiple_times(datastream, *layer_fluent, *layer, param1, prediction_mismatch);
+
+	log_INFO("test_1layer_profiler: mismatch ", prediction_mismatch[0], "\n", ::tools::profiler::summary_str());
+	const std::string trace_filename = "htm_trace.json";
+	if (::tools::profiler::write_trace(trace_filename)) log_INFO("test_1layer_profiler: wrote trace to ", trace_filename, "\n");
+}
+
+//Count the heap allocations of a layer in steady state: after a warm up, every time step (with and without learning)
+//is run under the allocation counter.
+template <typename P>
+void test_zero_alloc(const std::string& name)
+{
+	constexpr int N_SENSORS_DIM1 = 40;
+	constexpr int N_SENSORS_DIM2 = 40;
+	constexpr int N_WARM_UP_STEPS = 2000;
+	constexpr int N_STEPS = 500;
+
+	Dynamic_Param param1;
+	param1.learn = true;
+	param1.n_time_steps = N_WARM_UP_STEPS;
+	param1.n_times = 1;
+	param1.n_visible_sensors_dim1 = N_SENSORS_DIM1;
+	param1.n_visible_sensors_dim2 = N_SENSORS_DIM2;
+	param1.quiet = true;
+	param1.SP_LOCAL_AREA_DENSITY = 0.02f;
+	param1.n_threads = 2;
+
+	DataStream<P> datastream;
+	datastream.load_from_file("../../Misc/data/JumpingBall_40x40/input.txt", param1);
+
+	auto layer = std::make_unique<Layer_Persisted<P>>();
+	auto layer_fluent = std::make_unique<Layer_Fluent<P>>();
+	std::vector<int> prediction_mismatch(1);
+	htm::layer::run_multiple_times(datastream, *layer_fluent, *layer, param1, prediction_mismatch);
+
+	std::vector<int> mismatch(1);
+	for (const bool learn : { true, false })
+	{
+		param1.learn = learn;
+		int64_t n_allocations_one_step = 0;
+		int64_t n_allocations_mismatch = 0;
+		int n_steps_with_allocations = 0;
+
+		for (int time = N_WARM_UP_STEPS; time < (N_WARM_UP_STEPS + N_STEPS); ++time)
+		{
+			datastream.current_sensors(layer_fluent->active_sensors);
+			{
+				const ::tools::alloc_counter::Scope alloc_scope;
+				htm::layer::one_step(layer_fluent->active_sensors, *layer_fluent, *layer, time, param1);
+				n_allocations_one_step += alloc_scope.n_allocations();
+				if (alloc_scope.n_allocations() > 0) n_steps_with_allocations++;
+			}
+			{
+				const ::tools::alloc_counter::Scope alloc_scope;
+				htm::layer::priv::calc_mismatch(time, *layer_fluent, *layer, param1, datastream, mismatch);
+				n_allocations_mismatch += alloc_scope.n_allocations();
+			}
+			datastream.advance_time();
+		}
+		log_INFO(name, ": learn ", learn, ": ", n_allocations_one_step, " allocations in one_step (", n_steps_with_allocations, " of ", N_STEPS, " steps); ", n_allocations_mismatch, " allocations in calc_mismatch\n");
+		if (!learn && ((n_allocations_one_step + n_allocations_mismatch) > 0)) log_ERROR(name, ": a time step without learning allocated ", n_allocations_one_step + n_allocations_mismatch, " times in ", N_STEPS, " steps.\n");
+	}
+}
+
+// run a fresh layer with sensor noise from the seed in param; returns the mismatch and the random numbers of the columns
+template <typename P>
+std::tuple<int, std::vector<unsigned int>> test_1layer_seeded(
+	const DataStream<P>& datastream,
+	const Dynamic_Param& param)
+{
+	datastream.reset_time();
+	auto layer = std::make_unique<Layer_Persisted<P>>();
+	auto layer_fluent = std::make_unique<Layer_Fluent<P>>();
+	std::vector<int> prediction_mismatch(1);
+	htm::layer::run_multiple_times(datastream, *layer_fluent, *layer, param, prediction_mismatch);
+	return std::make_tuple(prediction_mismatch[0], layer_fluent->random_number);
+}
+
+inline void test_1layer_random_streams()
+{
+	// random streams: the bulk generators of the reference, AVX2 and AVX512 kernels have to give the same numbers as
+	// rand_int32 on every lane; a seeded layer with sensor noise has to give the same mismatch and random numbers for
+	// any number of threads.
+	using ::tools::random::Random_Lanes;
+	constexpr int N_NUMBERS = 1000003;
+	const arch_t arch = architecture_switch(arch_t::RUNTIME);
+
+	for (const auto& min_max : { std::make_tuple(0, 1), std::make_tuple(0, 199), std::make_tuple(-5, 4095), std::make_tuple(0, 0x7FFFFFFF) })
+	{
+		const int min = std::get<0>(min_max);
+		const int max = std::get<1>(min_max);
+		std::vector<int> numbers_rand_int32(N_NUMBERS);
+		std::vector<int> numbers_ref(N_NUMBERS);
+		std::vector<int> numbers_avx2(N_NUMBERS);
+		std::vector<int> numbers_avx512(N_NUMBERS);
+
+		Random_Lanes lanes_rand_int32(42);
+		for (int i = 0; i < N_NUMBERS; ++i)
+		{
+			numbers_rand_int32[i] = ::tools::random::rand_int32(min, max, lanes_rand_int32.state[i % Random_Lanes::N_LANES]);
+		}
+		Random_Lanes lanes_ref(42);
+		auto start_time = std::chrono::system_clock::now();
+		::tools::random::fill_rand_int32_ref(min, max, N_NUMBERS, numbers_ref.data(), lanes_ref);
+		const double seconds_ref = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+		bool equal = (numbers_ref == numbers_rand_int32);
+		double seconds_avx2 = 0;
+		double seconds_avx512 = 0;
+		if ((arch == arch_t::AVX2) || (arch == arch_t::AVX512))
+		{
+			Random_Lanes lanes_avx2(42);
+			start_time = std::chrono::system_clock::now();
+			::tools::random::fill_rand_int32_avx2(min, max, N_NUMBERS, numbers_avx2.data(), lanes_avx2);
+			seconds_avx2 = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+			equal = equal && (numbers_avx2 == numbers_ref) && (lanes_avx2.state == lanes_ref.state);
+		}
+		if (arch == arch_t::AVX512)
+		{
+			Random_Lanes lanes_avx512(42);
+			start_time = std::chrono::system_clock::now();
+			::tools::random::fill_rand_int32_avx512(min, max, N_NUMBERS, numbers_avx512.data(), lanes_avx512);
+			seconds_avx512 = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+			equal = equal && (numbers_avx512 == numbers_ref) && (lanes_avx512.state == lanes_ref.state);
+		}
+		log_INFO("test_1layer_random_streams: fill [", min, ", ", max, "]: M numbers/s ref ", N_NUMBERS / seconds_ref / 1000000, "; avx2 ", N_NUMBERS / seconds_avx2 / 1000000, "; avx512 ", N_NUMBERS / seconds_avx512 / 1000000, ((equal) ? "" : "; DIFFERS"), "\n");
+	}
+
+	constexpr int N_COLUMNS = 64 * 64;
+	constexpr int N_VISIBLE_SENSORS = 40 * 40;
+	using P = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::RUNTIME, std::ratio<1, 100>>;
+
+	Dynamic_Param param1;
+	param1.learn = true;
+	param1.n_time_steps = 1000;
+	param1.n_times = 1;
+	param1.n_visible_sensors_dim1 = 40;
+	param1.n_visible_sensors_dim2 = 40;
+	param1.quiet = true;
+	param1.SP_LOCAL_AREA_DENSITY = 0.02f;
+	param1.random_seed = 42;
+
+	DataStream<P> datastream;
+	datastream.load_from_file("../../Misc/data/JumpingBall_40x40/input.txt", param1);
+
+	param1.n_threads = 1;
+	const auto result_ref = test_1layer_seeded<P>(datastream, param1);
+	for (const int n_threads : { 1, 2, 4, 8 })
+	{
+		param1.n_threads = n_threads;
+		std::srand(n_threads); // the seed replaces the random numbers the constructor of Layer_Fluent draws
+		const auto result = test_1layer_seeded<P>(datastream, param1);
+		const bool equal = (std::get<0>(result) == std::get<0>(result_ref)) && (std::get<1>(result) == std::get<1>(result_ref));
+		log_INFO("test_1layer_random_streams: seed ", param1.random_seed, "; threads ", n_threads, "; mismatch ", std::get<0>(result), ((equal) ? "" : "; DIFFERS"), "\n");
+	}
+}
+
+//Static parameters with the active cells stored one byte per cell instead of bit packed.
+template <typename P_IN>
+struct Static_Param_Hist8 : P_IN
+{
+	static constexpr bool TP_ACTIVE_CELLS_PACKED = false;
+};
+
+//Static parameters with the synapse origins stored as 32-bit ids, whatever the size of the layer.
+template <typename P_IN>
+struct Static_Param_Wide_Origin : P_IN
+{
+	static constexpr bool SP_ORIGIN_NARROW = false;
+	using SP_Origin = int;
+	static constexpr bool TP_ORIGIN_NARROW = false;
+	using TP_Origin = int;
+	static constexpr int TP_ORIGIN_DELAY_SHIFT = 29;
+	static constexpr int TP_ORIGIN_CELL_MASK = (1 << TP_ORIGIN_DELAY_SHIFT) - 1;
+};
+
+//Static parameters with the incremental spatial pooler overlap.
+template <typename P_IN>
+struct Static_Param_Overlap_Incremental : P_IN
+{
+	static constexpr bool SP_OVERLAP_INCREMENTAL = true;
+};
+
+//Run one layer on the jumping ball input; the columns are seeded with the provided random numbers such that runs with
+//different static parameters can be compared. The first run sets the reference prediction mismatch.
+template <typename P>
+void test_1layer_jumping_ball(
+	const std::string& name,
+	const std::vector<unsigned int>& random_number,
+	int& prediction_mismatch_ref)
+{
+	Dynamic_Param param1;
+	param1.learn = true;
+	param1.n_time_steps = 1000;
+	param1.n_times = 1;
+	param1.n_visible_sensors_dim1 = 40;
+	param1.n_visible_sensors_dim2 = 40;
+	param1.quiet = true;
+	param1.SP_LOCAL_AREA_DENSITY = 0.02f;
+
+	DataStream<P> datastream;
+	datastream.load_from_file("../../Misc/data/JumpingBall_40x40/input.txt", param1);
+
+	auto layer = std::make_unique<Layer_Persisted<P>>();
+	auto layer_fluent = std::make_unique<Layer_Fluent<P>>();
+	layer_fluent->random_number = random_number;
+
+	std::vector<int> prediction_mismatch(1);
+	const auto start_time = std::chrono::system_clock::now();
+	htm::layer::run_multiple_times(datastream, *layer_fluent, *layer, param1, prediction_mismatch);
+	const auto end_time = std::chrono::system_clock::now();
+
+	if (prediction_mismatch_ref == -1) prediction_mismatch_ref = prediction_mismatch[0];
+	const double seconds = std::chrono::duration<double>(end_time - start_time).count();
+	log_INFO(name, ": steps/sec ", param1.n_time_steps / seconds, "; active cells ", sizeof(layer_fluent->active_cells._data[0]) * layer_fluent->active_cells._data.size(), " bytes; mismatch ", prediction_mismatch[0], ((prediction_mismatch[0] == prediction_mismatch_ref) ? "" : " DIFFERS"), "\n");
+}
+
+inline void test_1layer_arch()
+{
+	// parity of the instruction set kernels: the same layer is run with the reference, AVX2 and AVX512 kernels 
+	// (as far as supported by the cpu); the prediction mismatch has to be identical, only the elapsed time differs.
+
+	constexpr int N_COLUMNS = 64 * 64;
+	constexpr int N_VISIBLE_SENSORS = 40 * 40;
+	std::vector<unsigned int> random_number(N_COLUMNS);
+	for (auto& r : random_number) r = ::tools::random::rdrand32();
+
+	const arch_t arch = architecture_switch(arch_t::RUNTIME);
+	int prediction_mismatch_ref = -1;
+	test_1layer_jumping_ball<Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::X64>>("test_1layer_arch: X64", random_number, prediction_mismatch_ref);
+	if ((arch == arch_t::AVX2) || (arch == arch_t::AVX512)) test_1layer_jumping_ball<Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::AVX2>>("test_1layer_arch: AVX2", random_number, prediction_mismatch_ref);
+	if (arch == arch_t::AVX512) test_1layer_jumping_ball<Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::AVX512>>("test_1layer_arch: AVX512", random_number, prediction_mismatch_ref);
+}
+
+inline void test_1layer_active_cells()
+{
+	// layout of the active cells: the same layer is run with one byte per cell and with the bit packed active cells, 
+	// for every instruction set; the prediction mismatch has to be identical, only the elapsed time differs.
+
+	constexpr int N_COLUMNS = 64 * 256;
+	constexpr int N_VISIBLE_SENSORS = 40 * 40;
+	constexpr int HISTORY_SIZE = 1;
+	std::vector<unsigned int> random_number(N_COLUMNS);
+	for (auto& r : random_number) r = ::tools::random::rdrand32();
+
+	using P_X64 = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, HISTORY_SIZE, arch_t::X64>;
+	using P_AVX2 = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, HISTORY_SIZE, arch_t::AVX2>;
+	using P_AVX512 = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, HISTORY_SIZE, arch_t::AVX512>;
+
+	const arch_t arch = architecture_switch(arch_t::RUNTIME);
+	int prediction_mismatch_ref = -1;
+	test_1layer_jumping_ball<Static_Param_Hist8<P_X64>>("test_1layer_active_cells: X64 hist8", random_number, prediction_mismatch_ref);
+	test_1layer_jumping_ball<P_X64>("test_1layer_active_cells: X64 packed", random_number, prediction_mismatch_ref);
+	if ((arch == arch_t::AVX2) || (arch == arch_t::AVX512))
+	{
+		test_1layer_jumping_ball<Static_Param_Hist8<P_AVX2>>("test_1layer_active_cells: AVX2 hist8", random_number, prediction_mismatch_ref);
+		test_1layer_jumping_ball<P_AVX2>("test_1layer_active_cells: AVX2 packed", random_number, prediction_mismatch_ref);
+	}
+	if (arch == arch_t::AVX512)
+	{
+		test_1layer_jumping_ball<Static_Param_Hist8<P_AVX512>>("test_1layer_active_cells: AVX512 hist8", random_number, prediction_mismatch_ref);
+		test_1layer_jumping_ball<P_AVX512>("test_1layer_active_cells: AVX512 packed", random_number, prediction_mismatch_ref);
+	}
+}
+
+inline void test_1layer_narrow_origins()
+{
+	// width of the synapse origins: the same layer is run with 16-bit and with 32-bit synapse origins, for every
+	// instruction set; 512 columns of 16 cells keep the distal origins within 16 bits. The prediction mismatch has to
+	// be identical, only the elapsed time and the size of the synapse origins differ.
+
+	constexpr int N_COLUMNS = 64 * 8;
+	constexpr int N_VISIBLE_SENSORS = 40 * 40;
+	constexpr int HISTORY_SIZE = 1;
+	std::vector<unsigned int> random_number(N_COLUMNS);
+	for (auto& r : random_number) r = ::tools::random::rdrand32();
+
+	using P_X64 = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, HISTORY_SIZE, arch_t::X64>;
+	using P_AVX2 = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, HISTORY_SIZE, arch_t::AVX2>;
+	using P_AVX512 = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, HISTORY_SIZE, arch_t::AVX512>;
+	static_assert(P_X64::SP_ORIGIN_NARROW && P_X64::TP_ORIGIN_NARROW, "test_1layer_narrow_origins: expected a layer with narrow synapse origins");
+
+	log_INFO("test_1layer_narrow_origins: proximal origins ", sizeof(P_X64::SP_Origin), " vs ", sizeof(Static_Param_Wide_Origin<P_X64>::SP_Origin), 
+		" bytes; distal origins ", sizeof(P_X64::TP_Origin), " vs ", sizeof(Static_Param_Wide_Origin<P_X64>::TP_Origin), " bytes\n");
+
+	const arch_t arch = architecture_switch(arch_t::RUNTIME);
+	int prediction_mismatch_ref = -1;
+	test_1layer_jumping_ball<Static_Param_Wide_Origin<P_X64>>("test_1layer_narrow_origins: X64 wide", random_number, prediction_mismatch_ref);
+	test_1layer_jumping_ball<P_X64>("test_1layer_narrow_origins: X64 narrow", random_number, prediction_mismatch_ref);
+	if ((arch == arch_t::AVX2) || (arch == arch_t::AVX512))
+	{
+		test_1layer_jumping_ball<Static_Param_Wide_Origin<P_AVX2>>("test_1layer_narrow_origins: AVX2 wide", random_number, prediction_mismatch_ref);
+		test_1layer_jumping_ball<P_AVX2>("test_1layer_narrow_origins: AVX2 narrow", random_number, prediction_mismatch_ref);
+	}
+	if (arch == arch_t::AVX512)
+	{
+		test_1layer_jumping_ball<Static_Param_Wide_Origin<P_AVX512>>("test_1layer_narrow_origins: AVX512 wide", random_number, prediction_mismatch_ref);
+		test_1layer_jumping_ball<P_AVX512>("test_1layer_narrow_origins: AVX512 narrow", random_number, prediction_mismatch_ref);
+	}
+}
+
+//Fill a layer with seeded random synapses for test_kernel_parity: every proximal synapse, and per column one to four
+//segments whose number of synapses is drawn from TAILS; the slots after the last synapse of a segment keep the
+//unconnected permanence of dd_slab::allocate. Also draws the active sensors, the active columns and the active cells
+//of all delays.
+template <typename P>
+void fill_kernel_state(
+	Layer_Fluent<P>& layer_fluent,
+	Layer_Persisted<P>& layer,
+	typename Layer_Fluent<P>::Active_Sensors& active_sensors,
+	typename Layer_Fluent<P>::Active_Columns& active_columns,
+	unsigned int& random_number)
+{
+	using ::tools::random::rand_int32;
+	constexpr int TAILS[] = { 1, 3, 7, 8, 9, 15, 17, 31, 33, 47, 63, 64, 65, 100, 127, 129, 250 };
+	constexpr int N_TAILS = sizeof(TAILS) / sizeof(TAILS[0]);
+
+	for (int sensor_i = 0; sensor_i < P::N_SENSORS; ++sensor_i) active_sensors.set(sensor_i, rand_int32(0, 3, random_number) == 0);
+	for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i) active_columns.set(column_i, rand_int32(0, 3, random_number) == 0);
+	for (int delay = 0; delay <= P::HISTORY_SIZE; ++delay)
+	{
+		Bitset2<P::N_COLUMNS, P::N_CELLS_PC> current_cells;
+		for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+		{
+			for (int cell_i = 0; cell_i < P::N_CELLS_PC; ++cell_i) current_cells[column_i].set(cell_i, rand_int32(0, 3, random_number) == 0);
+		}
+		layer_fluent.active_cells.advance_time();
+		layer_fluent.active_cells.set_current(current_cells);
+	}
+
+	for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+	{
+		for (int synapse_i = 0; synapse_i < P::SP_N_PD_SYNAPSES; ++synapse_i)
+		{
+			layer.sp_pd_synapse_permanence_sf[column_i][synapse_i] = static_cast<Permanence>(rand_int32(-128, 127, random_number));
+			layer.sp_pd_synapse_origin_sensor_sf[column_i][synapse_i] = static_cast<typename P::SP_Origin>(rand_int32(0, P::N_SENSORS - 1, random_number));
+		}
+
+		const int n_segments = rand_int32(1, 4, random_number);
+		layer.dd_segment_count[column_i] = n_segments;
+		layer.dd_segment_destination[column_i].resize(n_segments);
+		layer.dd_segment_offset_sf[column_i].resize(n_segments);
+		layer.dd_segment_capacity_sf[column_i].resize(n_segments);
+		layer.dd_synapse_count_sf[column_i].resize(n_segments);
+		layer_fluent.dd_synapse_active_time[column_i].resize(n_segments, -1);
+
+		for (int segment_i = 0; segment_i < n_segments; ++segment_i)
+		{
+			const int n_synapses = TAILS[rand_int32(0, N_TAILS - 1, random_number)];
+			const int capacity = htm::tools::multiple_64(n_synapses);
+			const int offset = tp::priv::dd_slab::allocate(layer, column_i, capacity);
+			layer.dd_segment_offset_sf[column_i][segment_i] = offset;
+			layer.dd_segment_capacity_sf[column_i][segment_i] = capacity;
+			layer.dd_synapse_count_sf[column_i][segment_i] = n_synapses;
+
+			Permanence * permanence = layer.dd_synapse_permanence_segment(column_i, segment_i);
+			typename P::TP_Origin * delay_origin = layer.dd_synapse_delay_origin_segment(column_i, segment_i);
+			for (int synapse_i = 0; synapse_i < n_synapses; ++synapse_i)
+			{
+				const int global_cell_id = rand_int32(0, P::N_CELLS - 1, random_number);
+				const int delay = rand_int32(1, P::HISTORY_SIZE, random_number);
+				permanence[synapse_i] = static_cast<Permanence>(rand_int32(-128, 127, random_number));
+				delay_origin[synapse_i] = htm::tools::narrow_origin<P>(htm::tools::create_delay_and_cell_id(global_cell_id, delay));
+			}
+			layer_fluent.dd_segment_lru[column_i].touch(segment_i);
+		}
+	}
+}
+
+//Run the provided activate dendrites kernel and return the active and matching segments of every column followed by
+//the last active time of its segments; the last active times and the segment lru are restored afterwards.
+template <typename P, typename Kernel>
+std::vector<uint64_t> run_activate_dendrites(
+	const Kernel kernel,
+	Layer_Fluent<P>& layer_fluent,
+	const Layer_Persisted<P>& layer,
+	const Dynamic_Param& param)
+{
+	const auto active_time_org = layer_fluent.dd_synapse_active_time;
+	const auto lru_org = layer_fluent.dd_segment_lru;
+	kernel(layer_fluent, layer, 7, layer_fluent.active_cells, param);
+
+	std::vector<uint64_t> result;
+	for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+	{
+		const auto& active_segments = layer_fluent.active_dd_segments[column_i].current()._data;
+		const auto& matching_segments = layer_fluent.matching_dd_segments[column_i].current()._data;
+		result.insert(result.end(), active_segments.begin(), active_segments.end());
+		result.insert(result.end(), matching_segments.begin(), matching_segments.end());
+		for (const int time : layer_fluent.dd_synapse_active_time[column_i]) result.push_back(static_cast<uint64_t>(time));
+	}
+	layer_fluent.dd_synapse_active_time = active_time_org;
+	layer_fluent.dd_segment_lru = lru_org;
+	return result;
+}
+
+//Run every AVX2 and AVX512 kernel of the SP and TP that the cpu supports on the same seeded layer state as the
+//reference kernel, and compare the results.
+template <typename P>
+void test_kernel_parity(const std::string& name)
+{
+	namespace overlap = sp::priv::calc_overlap::synapse_forward;
+	namespace update_synapses = sp::priv::update_synapses::synapse_forward;
+	namespace inhibit_columns = sp::priv::inhibit_columns;
+	namespace adapt_segment = tp::priv::activate_cells::adapt_segment;
+	namespace dendrites = tp::priv::activate_dendrites::synapse_forward;
+
+	const arch_t arch = architecture_switch(arch_t::RUNTIME);
+	const bool avx2 = (arch == arch_t::AVX2) || (arch == arch_t::AVX512);
+	const bool avx512 = (arch == arch_t::AVX512);
+	int n_kernels = 0;
+	int n_differ = 0;
+	auto check = [&](const std::string& kernel, const bool equal)
+	{
+		n_kernels++;
+		if (!equal)
+		{
+			n_differ++;
+			log_ERROR(name, ": ", kernel, " differs from the reference kernel.\n");
+		}
+	};
+
+	Dynamic_Param param;
+	param.n_threads = 1;
+	param.TP_DD_SEGMENT_ACTIVE_THRESHOLD = -1; // every segment is active and matching: the activity of all segments is compared
+	param.TP_MIN_DD_ACTIVATION_THRESHOLD = -1;
+
+	auto layer = std::make_unique<Layer_Persisted<P>>();
+	auto layer_fluent = std::make_unique<Layer_Fluent<P>>();
+	typename Layer_Fluent<P>::Active_Sensors active_sensors;
+	typename Layer_Fluent<P>::Active_Columns active_columns;
+	unsigned int random_number = 42;
+	fill_kernel_state<P>(*layer_fluent, *layer, active_sensors, active_columns, random_number);
+
+	// SP overlap
+	{
+		std::vector<int> overlap_ref(P::N_COLUMNS);
+		std::vector<int> overlap_simd(P::N_COLUMNS);
+		overlap::calc_overlap_sf_ref(*layer, param, active_sensors, overlap_ref);
+		if (avx2)
+		{
+			overlap::calc_overlap_sf_avx2(*layer, param, active_sensors, overlap_simd);
+			check("calc_overlap_sf_avx2", overlap_simd == overlap_ref);
+		}
+		if (avx512)
+		{
+			overlap::calc_overlap_sf_avx512(*layer, param, active_sensors, overlap_simd);
+			check("calc_overlap_sf_avx512", overlap_simd == overlap_ref);
+			if constexpr (P::N_SENSORS < 512)
+			{
+				overlap::calc_overlap_avx512_sf_small_epi32(*layer, param, active_sensors, overlap_simd);
+				check("calc_overlap_avx512_sf_small_epi32", overlap_simd == overlap_ref);
+				overlap::calc_overlap_avx512_sf_small_epi16(*layer, param, active_sensors, overlap_simd);
+				check("calc_overlap_avx512_sf_small_epi16", overlap_simd == overlap_ref);
+			}
+		}
+	}
+	// SP update synapses
+	{
+		const auto permanence_org = layer->sp_pd_synapse_permanence_sf;
+		update_synapses::update_synapses_sf_ref(*layer, param, active_columns, active_sensors);
+		const auto permanence_ref = layer->sp_pd_synapse_permanence_sf;
+		if (avx2)
+		{
+			layer->sp_pd_synapse_permanence_sf = permanence_org;
+			update_synapses::update_synapses_sf_avx2(*layer, param, active_columns, active_sensors);
+			check("update_synapses_sf_avx2", layer->sp_pd_synapse_permanence_sf == permanence_ref);
+		}
+		layer->sp_pd_synapse_permanence_sf = permanence_org;
+	}
+	// SP top k selection: integer boosted overlaps have many ties at the threshold, fractional ones have none
+	for (const bool ties : { true, false })
+	{
+		std::vector<float> boosted_overlap(P::N_COLUMNS);
+		for (auto& f : boosted_overlap) f = static_cast<float>(::tools::random::rand_int32(0, 16, random_number)) + ((ties) ? 0.0f : ::tools::random::rand_float(0.5f, random_number));
+		const int k = std::max(1, static_cast<int>(P::N_COLUMNS * 0.02f));
+		const std::string suffix = (ties) ? " (ties)" : "";
+
+		typename Layer_Fluent<P>::Active_Columns columns_ref;
+		typename Layer_Fluent<P>::Active_Columns columns_simd;
+		inhibit_columns::active_columns_top_k_ref<P>(boosted_overlap, k, *layer_fluent, columns_ref);
+		const auto keys_ref = layer_fluent->sp_inhibition_key;
+		if (avx2)
+		{
+			inhibit_columns::active_columns_top_k_avx2<P>(boosted_overlap, k, *layer_fluent, columns_simd);
+			check("active_columns_top_k_avx2" + suffix, (columns_simd._data == columns_ref._data) && (layer_fluent->sp_inhibition_key == keys_ref));
+		}
+		if (avx512)
+		{
+			inhibit_columns::active_columns_top_k_avx512<P>(boosted_overlap, k, *layer_fluent, columns_simd);
+			check("active_columns_top_k_avx512" + suffix, (columns_simd._data == columns_ref._data) && (layer_fluent->sp_inhibition_key == keys_ref));
+		}
+	}
+	// TP adapt segment: the whole slab is compared, such that a kernel that writes past the last synapse of a segment differs
+	{
+		const Permanence inc = param.TP_DD_PERMANENCE_INC;
+		const Permanence dec = param.TP_DD_PERMANENCE_DEC;
+		using Adapt_Segment = void (*)(Layer_Persisted<P>&, const int, const int, const typename Layer_Fluent<P>::Active_Cells&, const Permanence, const Permanence);
+		auto adapt_all = [&](const Adapt_Segment kernel)
+		{
+			for (int column_i = 0; column_i < P::N_COLUMNS; ++column_i)
+			{
+				for (int segment_i = 0; segment_i < layer->dd_segment_count[column_i]; ++segment_i) kernel(*layer, column_i, segment_i, layer_fluent->active_cells, inc, dec);
+			}
+		};
+		const auto permanence_org = layer->dd_synapse_permanence_sf;
+		adapt_all(adapt_segment::adapt_segment_ref<P>);
+		const auto permanence_ref = layer->dd_synapse_permanence_sf;
+		if (avx2)
+		{
+			layer->dd_synapse_permanence_sf = permanence_org;
+			adapt_all(adapt_segment::adapt_segment_avx2<P>);
+			check("adapt_segment_avx2", layer->dd_synapse_permanence_sf == permanence_ref);
+		}
+		if (avx512)
+		{
+			layer->dd_synapse_permanence_sf = permanence_org;
+			adapt_all(adapt_segment::adapt_segment_avx512<P>);
+			check("adapt_segment_avx512", layer->dd_synapse_permanence_sf == permanence_ref);
+		}
+		layer->dd_synapse_permanence_sf = permanence_org;
+	}
+	// TP activate dendrites, without and with learning
+	{
+		const auto segments_ref = run_activate_dendrites<P>(dendrites::activate_dendrites_sf_ref<false, P>, *layer_fluent, *layer, param);
+		const auto segments_learn_ref = run_activate_dendrites<P>(dendrites::activate_dendrites_sf_ref<true, P>, *layer_fluent, *layer, param);
+		if (avx2)
+		{
+			check("activate_dendrites_sf_avx2", run_activate_dendrites<P>(dendrites::activate_dendrites_sf_avx2<false, P>, *layer_fluent, *layer, param) == segments_ref);
+			check("activate_dendrites_sf_avx2 (learn)", run_activate_dendrites<P>(dendrites::activate_dendrites_sf_avx2<true, P>, *layer_fluent, *layer, param) == segments_learn_ref);
+		}
+		if (avx512)
+		{
+			check("activate_dendrites_sf_avx512", run_activate_dendrites<P>(dendrites::activate_dendrites_sf_avx512<false, P>, *layer_fluent, *layer, param) == segments_ref);
+			check("activate_dendrites_sf_avx512 (learn)", run_activate_dendrites<P>(dendrites::activate_dendrites_sf_avx512<true, P>, *layer_fluent, *layer, param) == segments_learn_ref);
+		}
+	}
+	log_INFO(name, ": ", n_kernels, " kernels compared to the reference kernels; ", n_differ, " differ\n");
+}
+
+inline void test_kernel_parity()
+{
+	// parity of the kernels: every AVX2 and AVX512 kernel has to give the same result as the reference kernel on a
+	// seeded layer with segments of 1 to 250 synapses (mostly not a multiple of 8), with narrow and wide synapse
+	// origins, and with packed and one byte per cell active cells. Fewer than 512 sensors also selects the small
+	// AVX512 overlap kernels. The kernels also compare themselves in a debug build; this test does so in any build.
+	using P_SMALL = Static_Param<64 * 4, 4, 20 * 20, 0, 3, arch_t::RUNTIME>;
+	using P = Static_Param<64 * 4, 4, 40 * 40, 0, 3, arch_t::RUNTIME>;
+	static_assert(P::SP_ORIGIN_NARROW && P::TP_ORIGIN_NARROW, "test_kernel_parity: expected a layer with narrow synapse origins");
+
+	test_kernel_parity<P_SMALL>("test_kernel_parity: small sensors, narrow");
+	test_kernel_parity<Static_Param_Wide_Origin<P_SMALL>>("test_kernel_parity: small sensors, wide");
+	test_kernel_parity<P>("test_kernel_parity: narrow");
+	test_kernel_parity<Static_Param_Wide_Origin<P>>("test_kernel_parity: wide");
+	test_kernel_parity<Static_Param_Hist8<P>>("test_kernel_parity: hist8");
+}
+
+inline void test_1layer_sp_incremental()
+{
+	// incremental overlap of the spatial pooler: the same layer is run with the overlap recomputed every time step and
+	// with the incremental overlap; the prediction mismatch has to be identical, only the elapsed time differs.
+
+	constexpr int N_COLUMNS = 64 * 256;
+	constexpr int N_VISIBLE_SENSORS = 40 * 40;
+	std::vector<unsigned int> random_number(N_COLUMNS);
+	for (auto& r : random_number) r = ::tools::random::rdrand32();
+
+	using P_X64 = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::X64>;
+	using P_RUNTIME = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::RUNTIME>;
+
+	int prediction_mismatch_ref = -1;
+	test_1layer_jumping_ball<P_X64>("test_1layer_sp_incremental: X64 full", random_number, prediction_mismatch_ref);
+	test_1layer_jumping_ball<Static_Param_Overlap_Incremental<P_X64>>("test_1layer_sp_incremental: X64 incremental", random_number, prediction_mismatch_ref);
+	test_1layer_jumping_ball<P_RUNTIME>("test_1layer_sp_incremental: RUNTIME full", random_number, prediction_mismatch_ref);
+	test_1layer_jumping_ball<Static_Param_Overlap_Incremental<P_RUNTIME>>("test_1layer_sp_incremental: RUNTIME incremental", random_number, prediction_mismatch_ref);
+}
+
+//Static parameters with the synapse backward engine in the temporal pooler.
+template <typename P_IN>
+struct Static_Param_Synapse_Backward : P_IN
+{
+	static constexpr bool TP_SYNAPSE_FORWARD = false;
+};
+
+inline void test_1layer_tp_backward()
+{
+	// engines of the temporal pooler: the same layer is run with the forward engine only and with the inverse synapse
+	// index, which uses the backward engine in the time steps with few active cells; the prediction mismatch has to be
+	// identical, only the elapsed time differs.
+
+	constexpr int N_COLUMNS = 64 * 256;
+	constexpr int N_VISIBLE_SENSORS = 40 * 40;
+	std::vector<unsigned int> random_number(N_COLUMNS);
+	for (auto& r : random_number) r = ::tools::random::rdrand32();
+
+	using P_X64 = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::X64>;
+	using P_RUNTIME = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::RUNTIME>;
+
+	int prediction_mismatch_ref = -1;
+	test_1layer_jumping_ball<P_X64>("test_1layer_tp_backward: X64 forward", random_number, prediction_mismatch_ref);
+	test_1layer_jumping_ball<Static_Param_Synapse_Backward<P_X64>>("test_1layer_tp_backward: X64 backward", random_number, prediction_mismatch_ref);
+	test_1layer_jumping_ball<P_RUNTIME>("test_1layer_tp_backward: RUNTIME forward", random_number, prediction_mismatch_ref);
+	test_1layer_jumping_ball<Static_Param_Synapse_Backward<P_RUNTIME>>("test_1layer_tp_backward: RUNTIME backward", random_number, prediction_mismatch_ref);
+}
+
+//Static parameters with local inhibition in the spatial pooler.
+template <typename P_IN>
+struct Static_Param_Local_Inhibition : P_IN
+{
+	static constexpr bool SP_GLOBAL_INHIBITION = false;
+};
+
+inline void test_1layer_zero_alloc()
+{
+	// heap allocations of a layer in steady state; compile with ALLOC_COUNTER_ON defined as 1. Without learning a time
+	// step has to make zero allocations; with learning only the steps that grow the layer (a new segment, or a segment
+	// that moves to a larger chunk of the slab) allocate. With local inhibition the duty cycle rounds also update the
+	// inhibition radius.
+	if (!::tools::alloc_counter::ON)
+	{
+		log_WARNING("test_1layer_zero_alloc: the allocation counter is compiled out; define ALLOC_COUNTER_ON as 1.\n");
+		return;
+	}
+	using P = Static_Param<64 * 64, 4, 40 * 40, 0, 2, arch_t::RUNTIME>;
+	test_zero_alloc<P>("test_1layer_zero_alloc: global");
+	test_zero_alloc<Static_Param_Local_Inhibition<P>>("test_1layer_zero_alloc: local");
+}
+
+//Time the global inhibition (ref4), the naive local inhibition and the tiled local inhibition on random boosted overlaps.
+template <int N_COLUMNS>
+void test_sp_inhibition(const int inhibition_radius)
+{
+	using P = Static_Param<N_COLUMNS, 4, 40 * 40, 0, 1, arch_t::X64>;
+	constexpr int N_RUNS = 10;
+	constexpr float DENSITY = 0.02f;
+
+	unsigned int random_number = ::tools::random::rdrand32();
+	std::vector<float> boosted_overlap(N_COLUMNS);
+	typename Layer_Fluent<P>::Active_Columns active_columns_global;
+	typename Layer_Fluent<P>::Active_Columns active_columns_local_ref;
+	typename Layer_Fluent<P>::Active_Columns active_columns_local;
+	std::vector<float> values;
+	double seconds_global = 0, seconds_local_ref = 0, seconds_local = 0;
+	bool equal = true;
+
+	for (int run = 0; run < N_RUNS; ++run)
+	{
+		for (auto& f : boosted_overlap) f = ::tools::random::rand_int32(0, 16, random_number) + ::tools::random::rand_float(0.1f, random_number);
+
+		auto start_time = std::chrono::system_clock::now();
+		sp::priv::inhibit_columns::active_columns_ref4<P>(boosted_overlap, static_cast<int>(N_COLUMNS * DENSITY), active_columns_global, values);
+		seconds_global += std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+		start_time = std::chrono::system_clock::now();
+		sp::priv::inhibit_columns::active_columns_local_ref<P>(boosted_overlap, inhibition_radius, DENSITY, active_columns_local_ref);
+		seconds_local_ref += std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+		start_time = std::chrono::system_clock::now();
+		sp::priv::inhibit_columns::active_columns_local<P>(boosted_overlap, inhibition_radius, DENSITY, active_columns_local, values);
+		seconds_local += std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+		for (auto column_i = 0; column_i < N_COLUMNS; ++column_i) equal &= (active_columns_local.get(column_i) == active_columns_local_ref.get(column_i));
+	}
+	log_INFO("test_sp_inhibition: columns ", N_COLUMNS, " (", P::SP_N_COLUMNS_DIM1, "x", P::SP_N_COLUMNS_DIM2, "); radius ", inhibition_radius,
+		": global ref4 ", 1000 * seconds_global / N_RUNS, " ms; local ref ", 1000 * seconds_local_ref / N_RUNS, " ms; local tiled ", 1000 * seconds_local / N_RUNS, " ms", ((equal) ? "" : "; DIFFERS"), "\n");
+}
+
+inline void test_sp_local_inhibition()
+{
+	// local inhibition of the spatial pooler: the tiled local inhibition has to select the same columns as the naive
+	// local inhibition; global inhibition is timed as a reference.
+	for (const int inhibition_radius : { 4, 16 })
+	{
+		test_sp_inhibition<64 * 64>(inhibition_radius);
+		test_sp_inhibition<64 * 256>(inhibition_radius);
+		test_sp_inhibition<64 * 1024>(inhibition_radius);
+		test_sp_inhibition<64 * 4096>(inhibition_radius);
+	}
+
+	// one layer on the jumping ball input with the inhibition radius derived from the connected synapses
+	constexpr int N_COLUMNS = 64 * 64;
+	std::vector<unsigned int> random_number(N_COLUMNS);
+	for (auto& r : random_number) r = ::tools::random::rdrand32();
+	int prediction_mismatch_ref = -1;
+	test_1layer_jumping_ball<Static_Param<N_COLUMNS, 4, 40 * 40, 0, 1, arch_t::RUNTIME>>("test_sp_local_inhibition: global", random_number, prediction_mismatch_ref);
+	prediction_mismatch_ref = -1;
+	test_1layer_jumping_ball<Static_Param_Local_Inhibition<Static_Param<N_COLUMNS, 4, 40 * 40, 0, 1, arch_t::RUNTIME>>>("test_sp_local_inhibition: local", random_number, prediction_mismatch_ref);
+}
+
+//Time the global inhibition with nth_element (ref4) and with the radix top k selection on random boosted overlaps.
+template <int N_COLUMNS, arch_t ARCH>
+void test_sp_top_k(const std::string& name)
+{
+	using P = Static_Param<N_COLUMNS, 4, 40 * 40, 0, 1, ARCH>;
+	constexpr int N_RUNS = 100;
+	constexpr int INHIBITION_TOP = static_cast<int>(N_COLUMNS * 0.02f);
+
+	unsigned int random_number = ::tools::random::rdrand32();
+	auto layer_fluent = std::make_unique<Layer_Fluent<P>>();
+	std::vector<float> boosted_overlap(N_COLUMNS);
+	typename Layer_Fluent<P>::Active_Columns active_columns_ref4;
+	typename Layer_Fluent<P>::Active_Columns active_columns_top_k;
+	double seconds_ref4 = 0, seconds_top_k = 0;
+	int n_differ = 0;
+	int n_wrong_count = 0;
+
+	for (int run = 0; run < N_RUNS; ++run)
+	{
+		// every 10th run without the small random number: many ties
+		const bool ties = (run % 10) == 0;
+		for (auto& f : boosted_overlap) f = ::tools::random::rand_int32(0, 16, random_number) + ((ties) ? 0.0f : ::tools::random::rand_float(0.1f, random_number));
+
+		auto start_time = std::chrono::system_clock::now();
+		sp::priv::inhibit_columns::active_columns_ref4<P>(boosted_overlap, INHIBITION_TOP, active_columns_ref4, layer_fluent->sp_inhibition_values);
+		seconds_ref4 += std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+		start_time = std::chrono::system_clock::now();
+		sp::priv::inhibit_columns::active_columns_top_k<P>(boosted_overlap, INHIBITION_TOP, *layer_fluent, active_columns_top_k);
+		seconds_top_k += std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+		if (active_columns_top_k.count() != INHIBITION_TOP) n_wrong_count++;
+		if (!ties) for (auto column_i = 0; column_i < N_COLUMNS; ++column_i) if (active_columns_top_k.get(column_i) != active_columns_ref4.get(column_i)) { n_differ++; break; }
+	}
+	log_INFO("test_sp_top_k: ", name, ": columns ", N_COLUMNS, ": ref4 ", 1000 * seconds_ref4 / N_RUNS, " ms; top k ", 1000 * seconds_top_k / N_RUNS, " ms; runs that differ from ref4 ", n_differ, "; runs without exactly ", INHIBITION_TOP, " columns ", n_wrong_count, "\n");
+}
+
+inline void test_sp_global_inhibition()
+{
+	// global inhibition of the spatial pooler: without ties the radix top k selection has to select the same columns
+	// as ref4; with ties it has to select exactly k columns.
+	const arch_t arch = architecture_switch(arch_t::RUNTIME);
+	test_sp_top_k<64 * 64, arch_t::X64>("X64");
+	test_sp_top_k<64 * 256, arch_t::X64>("X64");
+	test_sp_top_k<64 * 1024, arch_t::X64>("X64");
+	test_sp_top_k<64 * 4096, arch_t::X64>("X64");
+	if ((arch == arch_t::AVX2) || (arch == arch_t::AVX512))
+	{
+		test_sp_top_k<64 * 64, arch_t::AVX2>("AVX2");
+		test_sp_top_k<64 * 256, arch_t::AVX2>("AVX2");
+		test_sp_top_k<64 * 1024, arch_t::AVX2>("AVX2");
+		test_sp_top_k<64 * 4096, arch_t::AVX2>("AVX2");
+	}
+	if (arch == arch_t::AVX512)
+	{
+		test_sp_top_k<64 * 64, arch_t::AVX512>("AVX512");
+		test_sp_top_k<64 * 256, arch_t::AVX512>("AVX512");
+		test_sp_top_k<64 * 1024, arch_t::AVX512>("AVX512");
+		test_sp_top_k<64 * 4096, arch_t::AVX512>("AVX512");
+	}
+}
+
+inline void test_snapshot()
+{
+	// snapshot of a trained layer: the layer restored from the snapshot has to save to the same bytes, and it predicts
+	// without relearning.
+	constexpr int N_COLUMNS = 64 * 64;
+	constexpr int N_VISIBLE_SENSORS = 40 * 40;
+	using P = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::RUNTIME>;
+
+	Dynamic_Param param1;
+	param1.learn = true;
+	param1.n_time_steps = 1000;
+	param1.n_times = 1;
+	param1.n_visible_sensors_dim1 = 40;
+	param1.n_visible_sensors_dim2 = 40;
+	param1.quiet = true;
+	param1.SP_LOCAL_AREA_DENSITY = 0.02f;
+
+	DataStream<P> datastream;
+	datastream.load_from_file("../../Misc/data/JumpingBall_40x40/input.txt", param1);
+
+	auto layer = std::make_unique<Layer_Persisted<P>>();
+	auto layer_fluent = std::make_unique<Layer_Fluent<P>>();
+	std::vector<int> prediction_mismatch(1);
+
+	auto start_time = std::chrono::system_clock::now();
+	htm::layer::run_multiple_times(datastream, *layer_fluent, *layer, param1, prediction_mismatch);
+	const double seconds_learn = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+	start_time = std::chrono::system_clock::now();
+	const bool saved = snapshot::save("layer1.snapshot", *layer_fluent, *layer);
+	const double seconds_save = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+	auto layer2 = std::make_unique<Layer_Persisted<P>>();
+	auto layer_fluent2 = std::make_unique<Layer_Fluent<P>>();
+	start_time = std::chrono::system_clock::now();
+	const bool loaded = snapshot::load("layer1.snapshot", *layer_fluent2, *layer2, param1);
+	const double seconds_load = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+	// the slabs of the restored layer are in the copy on write view of the snapshot, not copies
+	int n_slabs = 0;
+	int n_slabs_in_place = 0;
+	for (const auto& slab : layer2->dd_synapse_permanence_sf)
+	{
+		if (slab.empty()) continue;
+		n_slabs++;
+		n_slabs_in_place += ::tools::allocator::Page_Pool::instance().is_lent(slab.data());
+	}
+
+	snapshot::save("layer2.snapshot", *layer_fluent2, *layer2);
+	std::ifstream file1("layer1.snapshot", std::ios::binary);
+	std::ifstream file2("layer2.snapshot", std::ios::binary);
+	const std::string content1 = std::string(std::istreambuf_iterator<char>(file1), std::istreambuf_iterator<char>());
+	const std::string content2 = std::string(std::istreambuf_iterator<char>(file2), std::istreambuf_iterator<char>());
+
+	// damaged files must not load: a length of the first vector of the second section beyond the mapping, a segment
+	// count of column 0 beyond its segment vectors, and a first synapse of the first column with synapses from a cell
+	// outside the layer
+	const auto section_begin = [&](const int section_i)
+	{
+		size_t pos = sizeof(snapshot::priv::Header);
+		for (int i = 0; i < section_i; ++i)
+		{
+			uint64_t section_size = 0;
+			std::memcpy(&section_size, &content1[pos + offsetof(snapshot::priv::Section, size)], sizeof(uint64_t));
+			pos += static_cast<size_t>(section_size);
+		}
+		return pos + sizeof(snapshot::priv::Section);
+	};
+	const auto load_damaged = [&](const size_t pos, const auto value)
+	{
+		std::string content3 = content1;
+		std::memcpy(&content3[pos], &value, sizeof(value));
+		std::ofstream("layer3.snapshot", std::ios::binary) << content3;
+		auto layer3 = std::make_unique<Layer_Persisted<P>>();
+		auto layer_fluent3 = std::make_unique<Layer_Fluent<P>>();
+		return snapshot::load("layer3.snapshot", *layer_fluent3, *layer3, param1);
+	};
+	const size_t first_origin = section_begin(3) + snapshot::priv::multiple_align(P::N_COLUMNS * sizeof(uint64_t));
+	int n_damaged_loaded = 0;
+	n_damaged_loaded += load_damaged(section_begin(1), uint64_t(1) << 40);
+	n_damaged_loaded += load_damaged(section_begin(0), P::TP_N_DD_SEGMENTS_MAX);
+	n_damaged_loaded += load_damaged(first_origin, static_cast<typename P::TP_Origin>(P::N_CELLS));
+	const bool loaded_damaged = n_damaged_loaded > 0;
+
+	Dynamic_Param param2 = param1;
+	param2.learn = false;
+	param2.n_time_steps = 100;
+	datastream.reset_time();
+	htm::layer::run(datastream, param2, *layer_fluent2, *layer2, prediction_mismatch);
+
+	// learning after the load writes private copies of the pages; the snapshot file is not changed
+	Dynamic_Param param3 = param1;
+	param3.n_time_steps = 100;
+	std::vector<int> prediction_mismatch3(1);
+	htm::layer::run(datastream, param3, *layer_fluent2, *layer2, prediction_mismatch3);
+	std::ifstream file4("layer1.snapshot", std::ios::binary);
+	const std::string content4 = std::string(std::istreambuf_iterator<char>(file4), std::istreambuf_iterator<char>());
+
+	log_INFO("test_snapshot: saved ", saved, "; loaded ", loaded, "; ", content1.size(), " bytes; round trip ", ((content1 == content2) ? "equal" : "DIFFERS"), "; damaged files ", ((loaded_damaged) ? "LOADED" : "rejected"), "\n");
+	log_INFO("test_snapshot: ", n_slabs_in_place, " of ", n_slabs, " slabs restored in place; snapshot after learning ", ((content1 == content4) ? "unchanged" : "CHANGED"), "\n");
+	log_INFO("test_snapshot: learn ", 1000 * seconds_learn, " ms; save ", 1000 * seconds_save, " ms; load ", 1000 * seconds_load, " ms; mismatch of ", param2.n_time_steps, " steps inference after load ", prediction_mismatch[0], "\n");
+}
+
+// fields of the telemetry of test_record_encoder: a scalar, the hour of the day, the day of the week and an unbounded scalar
+template <typename P>
+htm::encoder::Record_Encoder<P> test_record_encoder_fields()
+{
+	htm::encoder::Record_Encoder<P> encoder;
+	encoder.add_scalar(400, 21, 0.0f, 100.0f);
+	encoder.add_cyclic(240, 21, 0.0f, 24.0f);
+	encoder.add_category(7, 21);
+	encoder.add_rdse(400, 21, 0.5f, 1234);
+	return encoder;
+}
+
+// encode the records with the record encoder of P in blocks of time steps; returns the checksum of the sensors, the
+// number of records with an unexpected number of active sensors, and the seconds
+template <typename P>
+std::tuple<uint64_t, int, double> test_record_encoder(
+	const std::vector<float>& values,
+	const int n_steps)
+{
+	constexpr int N_BLOCK = 64;
+	const auto encoder = test_record_encoder_fields<P>();
+	const int n_fields = encoder.n_fields();
+
+	auto sensors = std::vector<typename Layer_Fluent<P>::Active_Visible_Sensors>(N_BLOCK);
+	uint64_t checksum = 0;
+	int n_errors = 0;
+	double seconds = 0;
+
+	for (int step_i = 0; step_i < n_steps; step_i += N_BLOCK)
+	{
+		const int n_block = std::min(N_BLOCK, n_steps - step_i);
+		const auto start_time = std::chrono::system_clock::now();
+		encoder.encode(&values[static_cast<size_t>(step_i) * n_fields], n_block, sensors.data());
+		seconds += std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+		for (int block_i = 0; block_i < n_block; ++block_i)
+		{
+			const auto& s = sensors[block_i];
+			for (int word_i = 0; word_i < s.N_BLOCKS; ++word_i) checksum = (checksum * 31) + static_cast<unsigned int>(s._data[word_i]);
+
+			for (int field_i = 0; field_i < n_fields; ++field_i)
+			{
+				const auto& field = encoder.field(field_i);
+				int n_active = 0;
+				for (int i = field.offset; i < (field.offset + field.n_bits); ++i) n_active += s.get(i);
+
+				const float v = values[(static_cast<size_t>(step_i + block_i) * n_fields) + field_i];
+				const bool missing = (v != v) || ((field.encoding == htm::encoder::CYCLIC) && std::isinf(v));
+				const bool expected = (field.encoding == htm::encoder::RDSE)
+					? ((missing) ? (n_active == 0) : ((n_active > 0) && (n_active <= field.n_active)))
+					: (n_active == ((missing) ? 0 : field.n_active));
+				if (!expected) n_errors++;
+			}
+		}
+	}
+	return std::make_tuple(checksum, n_errors, seconds);
+}
+
+inline void test_record_encoder()
+{
+	// record encoder: numeric and categorical telemetry (a scalar, the hour of the day, the day of the week and an 
+	// unbounded scalar) is encoded in blocks of time steps; the reference, AVX2 and AVX512 kernels have to give the 
+	// same sensors, and every field has to have the expected number of active sensors. Then a layer learns from the
+	// encoded records.
+	constexpr int N_STEPS = 1 << 20;
+	constexpr int N_FIELDS = 4;
+	constexpr int N_VISIBLE_SENSORS = 40 * 40;
+
+	std::vector<float> values(static_cast<size_t>(N_STEPS) * N_FIELDS);
+	for (int step_i = 0; step_i < N_STEPS; ++step_i)
+	{
+		const float minute = static_cast<float>(step_i);
+		float * const record = &values[static_cast<size_t>(step_i) * N_FIELDS];
+		record[0] = 50.0f + (60.0f * std::sin(minute / 50.0f)); // clipped to [0, 100]
+		record[1] = std::fmod(minute / 60.0f, 24.0f);
+		// a cyclic value outside the period wraps around, an infinite value is missing
+		if (step_i % 1000 == 500) record[1] = 3.0e38f;
+		if (step_i % 1000 == 501) record[1] = -1.0e30f;
+		if (step_i % 1000 == 502) record[1] = std::numeric_limits<float>::infinity();
+		record[2] = static_cast<float>((step_i / 1440) % 7);
+		record[3] = (step_i % 1000 == 999) ? std::numeric_limits<float>::quiet_NaN() : (20.0f * std::sin(minute / 300.0f)) + (0.001f * minute);
+	}
+
+	const arch_t arch = architecture_switch(arch_t::RUNTIME);
+	const auto ref = test_record_encoder<Static_Param<64 * 64, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::X64>>(values, N_STEPS);
+	log_INFO("test_record_encoder: X64: M records/s ", N_STEPS / std::get<2>(ref) / 1000000, "; unexpected fields ", std::get<1>(ref), "\n");
+	if ((arch == arch_t::AVX2) || (arch == arch_t::AVX512))
+	{
+		const auto result = test_record_encoder<Static_Param<64 * 64, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::AVX2>>(values, N_STEPS);
+		log_INFO("test_record_encoder: AVX2: M records/s ", N_STEPS / std::get<2>(result) / 1000000, "; unexpected fields ", std::get<1>(result), ((std::get<0>(result) == std::get<0>(ref)) ? "" : "; DIFFERS"), "\n");
+	}
+	if (arch == arch_t::AVX512)
+	{
+		const auto result = test_record_encoder<Static_Param<64 * 64, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::AVX512>>(values, N_STEPS);
+		log_INFO("test_record_encoder: AVX512: M records/s ", N_STEPS / std::get<2>(result) / 1000000, "; unexpected fields ", std::get<1>(result), ((std::get<0>(result) == std::get<0>(ref)) ? "" : "; DIFFERS"), "\n");
+	}
+
+	using P = Static_Param<64 * 64, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::RUNTIME>;
+	Dynamic_Param param1;
+	param1.learn = true;
+	param1.n_time_steps = 2000;
+	param1.n_times = 1;
+	param1.quiet = true;
+	param1.SP_LOCAL_AREA_DENSITY = 0.02f;
+
+	DataStream<P> datastream;
+	datastream.load_from_records(test_record_encoder_fields<P>(), values.data(), param1.n_time_steps);
+
+	auto layer = std::make_unique<Layer_Persisted<P>>();
+	auto layer_fluent = std::make_unique<Layer_Fluent<P>>();
+	std::vector<int> prediction_mismatch(1);
+	const auto start_time = std::chrono::system_clock::now();
+	htm::layer::run_multiple_times(datastream, *layer_fluent, *layer, param1, prediction_mismatch);
+	const double seconds = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+	log_INFO("test_record_encoder: layer: steps/sec ", param1.n_time_steps / seconds, "; mismatch ", prediction_mismatch[0], "\n");
+}
+
+// set operations of the SDR library on consecutive pairs of sdrs, and the conversion of sdrs and activity; returns 
+// the checksum of the results and the seconds
+template <typename P, int SIZE>
+std::tuple<uint64_t, double> test_sdr_ops(
+	const std::vector<Bitset_Compact<SIZE>>& sdrs,
+	const std::vector<int>& activity,
+	const int n_rounds)
+{
+	const int n_sdrs = static_cast<int>(sdrs.size());
+	std::vector<int> sparse(Bitset_Compact<SIZE>::N_BLOCKS << 5);
+	Bitset_Compact<SIZE> thresholded;
+	uint64_t checksum = 0;
+
+	const auto start_time = std::chrono::system_clock::now();
+	for (int round_i = 0; round_i < n_rounds; ++round_i)
+	{
+		for (int i = 0; i < (n_sdrs - 1); ++i)
+		{
+			const auto& a = sdrs[i];
+			const auto& b = sdrs[i + 1];
+			checksum = (checksum * 31) + htm::sdr::count<P>(a);
+			checksum = (checksum * 31) + htm::sdr::overlap<P>(a, b);
+			checksum = (checksum * 31) + htm::sdr::union_count<P>(a, b);
+			checksum = (checksum * 31) + htm::sdr::andnot_count<P>(a, b);
+			checksum = (checksum * 31) + htm::sdr::hamming<P>(a, b);
+
+			const int n_sparse = htm::sdr::to_sparse<P>(a, sparse.data());
+			for (int j = 0; j < n_sparse; ++j) checksum = (checksum * 31) + sparse[j];
+
+			htm::sdr::threshold<P>(&activity[i], i & 7, thresholded);
+			for (int word_i = 0; word_i < thresholded.N_BLOCKS; ++word_i) checksum = (checksum * 31) + static_cast<unsigned int>(thresholded._data[word_i]);
+		}
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+	return std::make_tuple(checksum, seconds);
+}
+
+// the checksum of test_sdr_ops computed bit by bit
+template <int SIZE>
+uint64_t test_sdr_ops_bitwise(
+	const std::vector<Bitset_Compact<SIZE>>& sdrs,
+	const std::vector<int>& activity,
+	const int n_rounds)
+{
+	const int n_sdrs = static_cast<int>(sdrs.size());
+	Bitset_Compact<SIZE> thresholded;
+	uint64_t checksum = 0;
+
+	for (int round_i = 0; round_i < n_rounds; ++round_i)
+	{
+		for (int i = 0; i < (n_sdrs - 1); ++i)
+		{
+			const auto& a = sdrs[i];
+			const auto& b = sdrs[i + 1];
+			int count = 0, overlap = 0, union_count = 0, andnot_count = 0, hamming = 0;
+			for (int bit_i = 0; bit_i < SIZE; ++bit_i)
+			{
+				count += a.get(bit_i);
+				overlap += a.get(bit_i) && b.get(bit_i);
+				union_count += a.get(bit_i) || b.get(bit_i);
+				andnot_count += a.get(bit_i) && !b.get(bit_i);
+				hamming += a.get(bit_i) != b.get(bit_i);
+			}
+			checksum = (checksum * 31) + count;
+			checksum = (checksum * 31) + overlap;
+			checksum = (checksum * 31) + union_count;
+			checksum = (checksum * 31) + andnot_count;
+			checksum = (checksum * 31) + hamming;
+
+			for (int bit_i = 0; bit_i < SIZE; ++bit_i) if (a.get(bit_i)) checksum = (checksum * 31) + bit_i;
+
+			thresholded.clear_all();
+			for (int bit_i = 0; bit_i < SIZE; ++bit_i) thresholded.set(bit_i, activity[i + bit_i] > (i & 7));
+			for (int word_i = 0; word_i < thresholded.N_BLOCKS; ++word_i) checksum = (checksum * 31) + static_cast<unsigned int>(thresholded._data[word_i]);
+		}
+	}
+	return checksum;
+}
+
+inline void test_sdr()
+{
+	// SDR library: counts of the set operations, the sparse positions and the thresholded activity of the reference,
+	// AVX2 and AVX512 kernels have to equal a bit by bit computation. The size is not a multiple of the vector width
+	// such that the tails are used.
+	constexpr int SIZE = (40 * 40) + 7;
+	constexpr int N_SDRS = 1000;
+	constexpr int N_ACTIVE = 32;
+	constexpr int N_ROUNDS = 50;
+
+	std::vector<Bitset_Compact<SIZE>> sdrs(N_SDRS);
+	for (auto& sdr : sdrs)
+	{
+		for (int i = 0; i < N_ACTIVE; ++i) sdr.set(::tools::random::rand_int32(0, SIZE - 1), true);
+	}
+	std::vector<int> activity(N_SDRS + SIZE);
+	for (auto& a : activity) a = ::tools::random::rand_int32(0, 15);
+
+	const uint64_t expected = test_sdr_ops_bitwise(sdrs, activity, 1);
+	const arch_t arch = architecture_switch(arch_t::RUNTIME);
+	{
+		using P = Static_Param<64 * 64, 4, SIZE, 0, 1, arch_t::X64>;
+		const auto result = test_sdr_ops<P>(sdrs, activity, N_ROUNDS);
+		const auto check = test_sdr_ops<P>(sdrs, activity, 1);
+		log_INFO("test_sdr: X64: M sdrs/s ", (N_ROUNDS * (N_SDRS - 1)) / std::get<1>(result) / 1000000, ((std::get<0>(check) == expected) ? "" : "; DIFFERS"), "\n");
+	}
+	if ((arch == arch_t::AVX2) || (arch == arch_t::AVX512))
+	{
+		using P = Static_Param<64 * 64, 4, SIZE, 0, 1, arch_t::AVX2>;
+		const auto result = test_sdr_ops<P>(sdrs, activity, N_ROUNDS);
+		const auto check = test_sdr_ops<P>(sdrs, activity, 1);
+		log_INFO("test_sdr: AVX2: M sdrs/s ", (N_ROUNDS * (N_SDRS - 1)) / std::get<1>(result) / 1000000, ((std::get<0>(check) == expected) ? "" : "; DIFFERS"), "\n");
+	}
+	if (arch == arch_t::AVX512)
+	{
+		using P = Static_Param<64 * 64, 4, SIZE, 0, 1, arch_t::AVX512>;
+		const auto result = test_sdr_ops<P>(sdrs, activity, N_ROUNDS);
+		const auto check = test_sdr_ops<P>(sdrs, activity, 1);
+		log_INFO("test_sdr: AVX512: M sdrs/s ", (N_ROUNDS * (N_SDRS - 1)) / std::get<1>(result) / 1000000, ((std::get<0>(check) == expected) ? "" : "; DIFFERS"), "\n");
+	}
+}
+
+inline void test_binary_stream()
+{
+	// binary stream of the text input: the streamed frames have to equal the frames of the text input, and a layer
+	// that learns from the stream has the same mismatch as a layer that learns from the text input.
+	constexpr int N_COLUMNS = 64 * 64;
+	constexpr int N_VISIBLE_SENSORS = 40 * 40;
+	using P = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::RUNTIME>;
+
+	Dynamic_Param param1;
+	param1.learn = true;
+	param1.n_time_steps = 1000;
+	param1.n_times = 1;
+	param1.n_visible_sensors_dim1 = 40;
+	param1.n_visible_sensors_dim2 = 40;
+	param1.quiet = true;
+	param1.SP_LOCAL_AREA_DENSITY = 0.02f;
+
+	const std::string text_filename = "../../Misc/data/JumpingBall_40x40/input.txt";
+	const std::string binary_filename = "input.sdr";
+
+	auto start_time = std::chrono::system_clock::now();
+	const bool converted = htm::binary_stream::convert_text_to_binary<P>(text_filename, binary_filename, param1);
+	const double seconds_convert = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+	DataStream<P> datastream1;
+	start_time = std::chrono::system_clock::now();
+	datastream1.load_from_file(text_filename, param1);
+	const double seconds_load_text = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+	DataStream<P> datastream2;
+	start_time = std::chrono::system_clock::now();
+	const bool opened = datastream2.load_from_binary_file(binary_filename);
+	const double seconds_load_binary = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+	// compare the frames, including a wrap around the end of the input
+	Layer_Fluent<P>::Active_Sensors sensors1;
+	Layer_Fluent<P>::Active_Sensors sensors2;
+	std::vector<Layer_Fluent<P>::Active_Sensors> futures1(3);
+	std::vector<Layer_Fluent<P>::Active_Sensors> futures2(3);
+	int n_different = 0;
+	for (int time = 0; time < 20000; ++time)
+	{
+		datastream1.current_sensors(sensors1);
+		datastream2.current_sensors(sensors2);
+		if (sensors1._data != sensors2._data) n_different++;
+		datastream1.future_sensors(futures1);
+		datastream2.future_sensors(futures2);
+		for (int future = 0; future < 3; ++future) if (futures1[future]._data != futures2[future]._data) n_different++;
+		datastream1.advance_time();
+		datastream2.advance_time();
+	}
+
+	// a truncated stream: the frames beyond the end of the file are reported as unreadable and have no active sensors
+	std::ifstream binary_file(binary_filename, std::ios::binary);
+	const std::string binary_content = std::string(std::istreambuf_iterator<char>(binary_file), std::istreambuf_iterator<char>());
+	std::ofstream("input_truncated.sdr", std::ios::binary) << binary_content.substr(0, binary_content.size() / 2);
+	DataStream<P> datastream3;
+	datastream3.load_from_binary_file("input_truncated.sdr");
+	int n_unreadable = 0;
+	int n_unreadable_active = 0;
+	for (int time = 0; time < 1000; ++time)
+	{
+		if (!datastream3.current_sensors(sensors2))
+		{
+			n_unreadable++;
+			n_unreadable_active += sensors2.any();
+		}
+		datastream3.advance_time();
+	}
+
+	// throughput of the stream
+	constexpr int N_FRAMES = 1000000;
+	datastream2.reset_time();
+	start_time = std::chrono::system_clock::now();
+	for (int time = 0; time < N_FRAMES; ++time)
+	{
+		datastream2.current_sensors(sensors2);
+		datastream2.advance_time();
+	}
+	const double seconds_stream = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+	// learn from both inputs; both layers start with the same random numbers
+	std::vector<int> prediction_mismatch1(1);
+	std::vector<int> prediction_mismatch2(1);
+	param1.random_seed = 1;
+	datastream1.reset_time();
+	datastream2.reset_time();
+	{
+		auto layer = std::make_unique<Layer_Persisted<P>>();
+		auto layer_fluent = std::make_unique<Layer_Fluent<P>>();
+		htm::layer::run_multiple_times(datastream1, *layer_fluent, *layer, param1, prediction_mismatch1);
+	}
+	{
+		auto layer = std::make_unique<Layer_Persisted<P>>();
+		auto layer_fluent = std::make_unique<Layer_Fluent<P>>();
+		htm::layer::run_multiple_times(datastream2, *layer_fluent, *layer, param1, prediction_mismatch2);
+	}
+
+	log_INFO("test_binary_stream: converted ", converted, "; opened ", opened, "; ", n_different, " different frames; mismatch text ", prediction_mismatch1[0], "; mismatch binary ", prediction_mismatch2[0], "\n");
+	log_INFO("test_binary_stream: truncated file: ", n_unreadable, " of 1000 frames unreadable; ", n_unreadable_active, " of them with active sensors\n");
+	log_INFO("test_binary_stream: convert ", 1000 * seconds_convert, " ms; load text ", 1000 * seconds_load_text, " ms; open binary ", 1000 * seconds_load_binary, " ms; stream ", N_FRAMES / seconds_stream / 1000000, " M frames/s\n");
+}
+
+inline void test_inference_batch()
+{
+	// batched inference of many streams with one trained layer: every stream has to have the same mismatch as the
+	// stream that runs alone with layer::run without learning; the streams start at different positions in the input.
+	constexpr int N_COLUMNS = 64 * 64;
+	constexpr int N_VISIBLE_SENSORS = 40 * 40;
+	using P = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, 0, 1, arch_t::RUNTIME>;
+	constexpr int N_STREAMS = 100;
+
+	Dynamic_Param param1;
+	param1.learn = true;
+	param1.n_time_steps = 1000;
+	param1.n_times = 1;
+	param1.n_visible_sensors_dim1 = 40;
+	param1.n_visible_sensors_dim2 = 40;
+	param1.quiet = true;
+	param1.SP_LOCAL_AREA_DENSITY = 0.02f;
+
+	const std::string filename = "../../Misc/data/JumpingBall_40x40/input.txt";
+	DataStream<P> datastream;
+	datastream.load_from_file(filename, param1);
+
+	auto layer = std::make_unique<Layer_Persisted<P>>();
+	auto layer_fluent = std::make_unique<Layer_Fluent<P>>();
+	std::vector<int> prediction_mismatch(1);
+	htm::layer::run_multiple_times(datastream, *layer_fluent, *layer, param1, prediction_mismatch);
+
+	Dynamic_Param param2 = param1;
+	param2.learn = false;
+	param2.n_time_steps = 200;
+
+	// two sets of datastreams: the second is used by the streams that run at the same time as the first
+	std::vector<std::unique_ptr<DataStream<P>>> datastreams_all[2];
+	std::vector<const DataStream<P> *> datastreams_ptr_all[2];
+	for (int set_i = 0; set_i < 2; ++set_i)
+	{
+		for (int stream_i = 0; stream_i < N_STREAMS; ++stream_i)
+		{
+			datastreams_all[set_i].push_back(std::make_unique<DataStream<P>>());
+			datastreams_all[set_i].back()->load_from_file(filename, param1);
+			datastreams_ptr_all[set_i].push_back(datastreams_all[set_i].back().get());
+		}
+	}
+	auto& datastreams = datastreams_all[0];
+	auto& datastreams_ptr = datastreams_ptr_all[0];
+	const auto reset_time = [&](const int set_i = 0)
+	{
+		for (int stream_i = 0; stream_i < N_STREAMS; ++stream_i)
+		{
+			datastreams_all[set_i][stream_i]->reset_time();
+			for (int i = 0; i < 7 * stream_i; ++i) datastreams_all[set_i][stream_i]->advance_time();
+		}
+	};
+
+	htm::inference::Streams<P> streams(*layer, N_STREAMS);
+	streams.init(param2);
+	std::vector<std::unique_ptr<Layer_Fluent<P>>> layer_fluent_init;
+	for (int stream_i = 0; stream_i < N_STREAMS; ++stream_i) layer_fluent_init.push_back(std::make_unique<Layer_Fluent<P>>(streams.layer_fluent(stream_i)));
+
+	// every stream alone
+	reset_time();
+	std::vector<std::vector<int>> mismatch_serial(N_STREAMS, std::vector<int>(1));
+	auto start_time = std::chrono::system_clock::now();
+	for (int stream_i = 0; stream_i < N_STREAMS; ++stream_i)
+	{
+		auto layer_fluent_stream = std::make_unique<Layer_Fluent<P>>(*layer_fluent_init[stream_i]);
+		htm::layer::run(*datastreams[stream_i], param2, *layer_fluent_stream, *layer, mismatch_serial[stream_i]);
+	}
+	const double seconds_serial = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+	for (const int n_threads : { 1, 4 })
+	{
+		param2.n_threads = n_threads;
+		for (int stream_i = 0; stream_i < N_STREAMS; ++stream_i) streams.layer_fluent(stream_i) = *layer_fluent_init[stream_i];
+		reset_time();
+		std::vector<std::vector<int>> mismatch_batch(N_STREAMS, std::vector<int>(1));
+		start_time = std::chrono::system_clock::now();
+		htm::inference::run(streams, datastreams_ptr, param2, mismatch_batch);
+		const double seconds_batch = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+
+		int n_different = 0;
+		for (int stream_i = 0; stream_i < N_STREAMS; ++stream_i) if (mismatch_batch[stream_i] != mismatch_serial[stream_i]) n_different++;
+		log_INFO("test_inference_batch: ", N_STREAMS, " streams of ", param2.n_time_steps, " steps: serial ", 1000 * seconds_serial, " ms; batched with ", n_threads, " threads ", 1000 * seconds_batch, " ms; ", n_different, " streams with a different mismatch\n");
+	}
+
+	// two Streams with the same layer at the same time, in two threads that step with 2 and 4 threads
+	htm::inference::Streams<P> streams2(*layer, N_STREAMS);
+	streams2.init(param2);
+	htm::inference::Streams<P> * streams_all[2] = { &streams, &streams2 };
+	std::vector<std::vector<int>> mismatch_concurrent[2];
+	std::vector<std::thread> threads;
+	for (int set_i = 0; set_i < 2; ++set_i)
+	{
+		for (int stream_i = 0; stream_i < N_STREAMS; ++stream_i) streams_all[set_i]->layer_fluent(stream_i) = *layer_fluent_init[stream_i];
+		reset_time(set_i);
+		mismatch_concurrent[set_i].assign(N_STREAMS, std::vector<int>(1));
+	}
+	for (int set_i = 0; set_i < 2; ++set_i)
+	{
+		threads.emplace_back([&, set_i]()
+		{
+			Dynamic_Param param3 = param2;
+			param3.n_threads = 2 + (2 * set_i);
+			htm::inference::run(*streams_all[set_i], datastreams_ptr_all[set_i], param3, mismatch_concurrent[set_i]);
+		});
+	}
+	for (auto& thread : threads) thread.join();
+	int n_different = 0;
+	for (int set_i = 0; set_i < 2; ++set_i)
+	{
+		for (int stream_i = 0; stream_i < N_STREAMS; ++stream_i) if (mismatch_concurrent[set_i][stream_i] != mismatch_serial[stream_i]) n_different++;
+	}
+	log_INFO("test_inference_batch: 2 x ", N_STREAMS, " streams at the same time with 2 and 4 threads: ", n_different, " streams with a different mismatch\n");
+}
+
 inline void test_2layers()
 {
 	// static properties: properties that need to be known at compile time:
@@ -354,6 +1845,67 @@ inline void test_3layers()
 	htm::network::run_multiple_times(datastream, param, layer1_fluent, layer1, layer2_fluent, layer2, layer3_fluent, layer3, prediction_mismatch);
 }
 
+// run a chain of fresh layers, with the random numbers of the seeds in param; returns the mismatch and the seconds
+template <typename ... P>
+std::tuple<int, double> test_network_pipelined(
+	const DataStream<std::tuple_element_t<0, std::tuple<P...>>>& datastream,
+	const std::array<Dynamic_Param, sizeof...(P)>& param,
+	const bool pipelined)
+{
+	datastream.reset_time();
+
+	auto layer_fluent = std::make_tuple(std::make_unique<Layer_Fluent<P>>()...);
+	auto layer = std::make_tuple(std::make_unique<Layer_Persisted<P>>()...);
+	const auto layer_fluent_ref = std::apply([](auto& ... l) { return std::tie(*l...); }, layer_fluent);
+	const auto layer_ref = std::apply([](auto& ... l) { return std::tie(*l...); }, layer);
+
+	std::vector<int> prediction_mismatch(1);
+	const auto start_time = std::chrono::system_clock::now();
+	htm::network::run_multiple_times(datastream, param, layer_fluent_ref, layer_ref, pipelined, prediction_mismatch);
+	const double seconds = std::chrono::duration<double>(std::chrono::system_clock::now() - start_time).count();
+	return std::make_tuple(prediction_mismatch[0], seconds);
+}
+
+inline void test_network_pipelined()
+{
+	// pipelined network: every layer has its own thread, the results have to be identical to the sequential network.
+	constexpr int N_COLUMNS = 64 * 64;
+	constexpr int N_VISIBLE_SENSORS = 40 * 40;
+	constexpr arch_t ARCH = arch_t::RUNTIME;
+
+	using P1 = Static_Param<N_COLUMNS, 4, N_VISIBLE_SENSORS, N_COLUMNS, 1, ARCH>;
+	using P2 = Static_Param<N_COLUMNS, 4, N_COLUMNS, N_COLUMNS, 1, ARCH>;
+	using P3 = Static_Param<N_COLUMNS, 4, N_COLUMNS, N_COLUMNS, 1, ARCH>;
+	using P4 = Static_Param<N_COLUMNS, 4, N_COLUMNS, 0, 1, ARCH>;
+
+	Dynamic_Param param1;
+	param1.learn = true;
+	param1.n_time_steps = 500;
+	param1.n_times = 1;
+	param1.n_visible_sensors_dim1 = 40;
+	param1.n_visible_sensors_dim2 = 40;
+	param1.quiet = true;
+	param1.SP_LOCAL_AREA_DENSITY = 0.02f;
+
+	DataStream<P1> datastream;
+	datastream.load_from_file("../../Misc/data/JumpingBall_40x40/input.txt", param1);
+
+	{
+		auto param = std::array<Dynamic_Param, 3>{param1, param1, param1};
+		for (int layer_i = 0; layer_i < 3; ++layer_i) param[layer_i].random_seed = layer_i + 1;
+		const auto sequential = test_network_pipelined<P1, P2, P4>(datastream, param, false);
+		const auto pipelined = test_network_pipelined<P1, P2, P4>(datastream, param, true);
+		log_INFO("test_network_pipelined: 3 layers: mismatch sequential ", std::get<0>(sequential), "; pipelined ", std::get<0>(pipelined), "; time sequential ", std::get<1>(sequential), " s; pipelined ", std::get<1>(pipelined), " s; speedup ", std::get<1>(sequential) / std::get<1>(pipelined), "\n");
+	}
+	{
+		auto param = std::array<Dynamic_Param, 4>{param1, param1, param1, param1};
+		for (int layer_i = 0; layer_i < 4; ++layer_i) param[layer_i].random_seed = layer_i + 1;
+		const auto sequential = test_network_pipelined<P1, P2, P3, P4>(datastream, param, false);
+		const auto pipelined = test_network_pipelined<P1, P2, P3, P4>(datastream, param, true);
+		log_INFO("test_network_pipelined: 4 layers: mismatch sequential ", std::get<0>(sequential), "; pipelined ", std::get<0>(pipelined), "; time sequential ", std::get<1>(sequential), " s; pipelined ", std::get<1>(pipelined), " s; speedup ", std::get<1>(sequential) / std::get<1>(pipelined), "\n");
+	}
+}
+
 inline void test_swarm_1layer()
 {
 	// static properties: properties that need to be known at compile time:
@@ -589,16 +2141,135 @@ inline void test_swarm_3layers()
 	htm::swarm::run_ga<P1, P2, P3>(datastream, param, options);
 }
 
-int main()
+inline void test_swarm_halving()
+{
+	constexpr int N_VISIBLE_SENSORS = 20 * 20;
+	constexpr int N_HIDDEN_SENSORS = 0;
+	constexpr int N_COLUMNS = 1024;
+	constexpr int N_BITS_CELL = 4;
+	constexpr int HISTORY_SIZE = 1;
+	constexpr arch_t ARCH = arch_t::RUNTIME;
+	using P = Static_Param<N_COLUMNS, N_BITS_CELL, N_VISIBLE_SENSORS, N_HIDDEN_SENSORS, HISTORY_SIZE, ARCH>;
+
+	Dynamic_Param param1;
+	param1.learn = true;
+	param1.n_time_steps = 900;
+	param1.n_times = 1;
+	param1.quiet = true;
+	const auto param = std::array<Dynamic_Param, 1>{param1};
+
+	DataStream<P> datastream;
+	datastream.generate_random_NxR(0.02f, 3, 3);
+
+	// compare the ga without early termination (one rung) with successive halving over three rungs
+	for (const int n_rungs : { 1, 3 })
+	{
+		swarm::Swarm_Options options;
+		options.population_size = 30;
+		options.n_epochs = 3;
+		options.mutation_rate = 0.1f;
+		options.quiet = true;
+		options.n_rungs = n_rungs;
+
+		const auto start_time = std::chrono::system_clock::now();
+		auto pool = htm::swarm::run_ga<P>(datastream, param, options);
+		const auto end_time = std::chrono::system_clock::now();
+
+		const auto best = std::min_element(pool.begin(), pool.end(), swarm::priv::ga::Configuration_better<1>());
+		const double seconds = std::chrono::duration<double>(end_time - start_time).count();
+		log_INFO("test_swarm_halving: n_rungs ", n_rungs, ": ", pool.size(), " configurations in ", seconds, " sec (", seconds / (options.n_epochs + 1), " sec per epoch); best mismatch ", best->mismatch, "\n");
+	}
+}
+
+//Distributed swarm on one host: run "HTM-Lite-Main swarm_coordinator <port>" and several times
+//"HTM-Lite-Main swarm_worker <port>"; role "swarm" runs the coordinator and n_workers workers as threads.
+inline void test_swarm_distributed(const std::string& role = "swarm", const int port = 5701, const int n_workers = 3)
 {
+	constexpr int N_VISIBLE_SENSORS = 20 * 20;
+	constexpr int N_HIDDEN_SENSORS = 0;
+	constexpr int N_COLUMNS = 1024;
+	constexpr int N_BITS_CELL = 4;
+	constexpr int HISTORY_SIZE = 1;
+	constexpr arch_t ARCH = arch_t::RUNTIME;
+	using P = Static_Param<N_COLUMNS, N_BITS_CELL, N_VISIBLE_SENSORS, N_HIDDEN_SENSORS, HISTORY_SIZE, ARCH>;
+
+	Dynamic_Param param1;
+	param1.learn = true;
+	param1.n_time_steps = 900;
+	param1.n_times = 1;
+	param1.quiet = true;
+	const auto param = std::array<Dynamic_Param, 1>{param1};
+
+	swarm::Swarm_Options options;
+	options.population_size = 12;
+	options.n_epochs = 2;
+	options.mutation_rate = 0.1f;
+	options.quiet = false;
+	options.random_seed = 1;
+
+	swarm::distributed::Distributed_Options distributed_options;
+	distributed_options.port = port;
+	distributed_options.checkpoint_filename = "htm_swarm_checkpoint.txt";
+
+	DataStream<P> datastream;
+	datastream.load_from_file("../../Misc/data/ABBCBBA_20x20/input.txt", param1);
+
+	std::vector<std::thread> workers;
+	if ((role == "swarm_worker") || (role == "swarm"))
+	{
+		const int n = (role == "swarm") ? n_workers : 1;
+		for (int i = 0; i < n; ++i)
+		{
+			workers.emplace_back([&]() { swarm::distributed::run_worker<P>(datastream, "localhost", port); });
+		}
+	}
+	if ((role == "swarm_coordinator") || (role == "swarm"))
+	{
+		const auto pool = swarm::distributed::run_coordinator<1>(param, options, distributed_options);
+		const auto best = std::min_element(pool.begin(), pool.end(), swarm::priv::ga::Configuration_better<1>());
+		if (best != pool.end()) log_INFO("test_swarm_distributed: ", pool.size(), " configurations; best: ", best->str(), "\n");
+	}
+	for (auto& worker : workers) worker.join();
+}
+
+int main(int argc, char * argv[])
+{
+	if ((argc > 1) && (std::string(argv[1]).compare(0, 6, "swarm_") == 0))
+	{
+		test_swarm_distributed(argv[1], (argc > 2) ? std::stoi(argv[2]) : 5701);
+		return 0;
+	}
+
 	const auto start_time = std::chrono::system_clock::now();
 	if (false) test_1layer_200x200_sensors();
 	if (true) test_1layer();
+	if (false) test_1layer_threads();
+	if (false) test_1layer_profiler();
+	if (false) test_1layer_lookahead();
+	if (false) test_1layer_compaction();
+	if (false) test_1layer_arch();
+	if (false) test_1layer_active_cells();
+	if (false) test_1layer_narrow_origins();
+	if (false) test_kernel_parity();
+	if (false) test_1layer_zero_alloc();
+	if (false) test_1layer_random_streams();
+	if (false) test_1layer_sp_incremental();
+	if (false) test_1layer_tp_backward();
+	if (false) test_sp_local_inhibition();
+	if (false) test_sp_global_inhibition();
+	if (false) test_snapshot();
+	if (false) test_binary_stream();
+	if (false) test_record_encoder();
+	if (false) test_sdr();
+	if (false) test_inference_batch();
 	if (false) test_2layers();
 	if (false) test_3layers();
+	if (false) test_network_pipelined();
 	if (false) test_swarm_1layer();
 	if (false) test_swarm_2layers();
 	if (false) test_swarm_3layers();
+	if (false) test_swarm_halving();
+	if (false) test_swarm_distributed();
 
 	const auto end_time = std::chrono::system_clock::now();
 
@@ -0,0 +1,106 @@
+// C++ port of Nupic HTM with the aim of being lite and fast
+//
+// Copyright (c) 2017 Henk-Jan Lebbink
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero Public License version 3 as
+// published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero Public License for more details.
+//
+// You should have received a copy of the GNU Affero Public License
+// along with this program.  If not, see http://www.gnu.org/licenses.
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+//Define ALLOC_COUNTER_ON as 1 to count the heap allocations of all threads: the global operator new is replaced and
+//the aligned allocator reports its allocations. The replacement operators are defined in every translation unit that
+//includes this file, so define ALLOC_COUNTER_ON in (a program with) one translation unit only. Otherwise counting has
+//no overhead.
+#ifndef ALLOC_COUNTER_ON
+#define ALLOC_COUNTER_ON 0
+#endif
+
+namespace tools
+{
+	namespace alloc_counter
+	{
+		static constexpr bool ON = (ALLOC_COUNTER_ON != 0);
+
+		namespace priv
+		{
+			inline std::atomic<int64_t> n_allocations{ 0 };
+		}
+
+		//Count one heap allocation.
+		inline void add()
+		{
+			if constexpr (ON) priv::n_allocations.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		//Number of heap allocations since the start of the program; always 0 when the counter is compiled out.
+		inline int64_t get()
+		{
+			return priv::n_allocations.load(std::memory_order_relaxed);
+		}
+
+		//Number of heap allocations since the construction of the scope.
+		class Scope
+		{
+		public:
+			Scope()
+				: start_(get())
+			{}
+			int64_t n_allocations() const
+			{
+				return get() - this->start_;
+			}
+
+		private:
+			const int64_t start_;
+		};
+	}
+}
+
+#if ALLOC_COUNTER_ON
+// the array, sized and nothrow forms of the standard library call these four
+void * operator new(std::size_t size)
+{
+	::tools::alloc_counter::add();
+	void * ptr = std::malloc((size == 0) ? 1 : size);
+	if (ptr == nullptr) throw std::bad_alloc();
+	return ptr;
+}
+void operator delete(void * ptr) noexcept
+{
+	std::free(ptr);
+}
+void * operator new(std::size_t size, std::align_val_t align)
+{
+	::tools::alloc_counter::add();
+	const std::size_t alignment = static_cast<std::size_t>(align);
+	const std::size_t n_bytes = ((size + alignment - 1) / alignment) * alignment;
+	#if defined(_MSC_VER)
+	void * ptr = _aligned_malloc((n_bytes == 0) ? alignment : n_bytes, alignment);
+	#else
+	void * ptr = std::aligned_alloc(alignment, (n_bytes == 0) ? alignment : n_bytes);
+	#endif
+	if (ptr == nullptr) throw std::bad_alloc();
+	return ptr;
+}
+void operator delete(void * ptr, std::align_val_t) noexcept
+{
+	#if defined(_MSC_VER)
+	_aligned_free(ptr);
+	#else
+	std::free(ptr);
+	#endif
+}
+#endif
\ No newline at end of file
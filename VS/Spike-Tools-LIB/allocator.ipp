@@ -16,10 +16,14 @@
 
 #pragma once
 #include <string>
+#include <vector>
 #include <bitset>
+#include <type_traits>
 #include <intrin.h>
 
 #include "log.ipp"
+#include "alloc_counter.ipp"
+#include "page_pool.ipp"
 
 namespace tools
 {
@@ -77,6 +81,7 @@ namespace tools
 			{
 				const auto n_bytes = multiple_N(static_cast<int>(n) * sizeof(T), ALIGN);
 				void * ptr = _mm_malloc(n_bytes, ALIGN);
+				::tools::alloc_counter::add();
 				
 				#if _DEBUG
 				#pragma warning( push )
@@ -104,5 +109,103 @@ namespace tools
 			inline bool operator==(Allocator_AVX512 const&) { return true; }
 			inline bool operator!=(Allocator_AVX512 const& a) { return !operator==(a); }
 		};
+
+		namespace priv
+		{
+			//Block of a lent file mapping that the next allocation of the calling thread returns, and whether the
+			//elements are left as they are in the mapping instead of value initialized; set by adopt only.
+			inline thread_local void * adopted_block = nullptr;
+			inline thread_local bool adopting = false;
+		}
+
+		//Allocator with the page policy of the Page_Pool (see set_page_policy): with page_t::NONE (the default) it is the
+		//Allocator_AVX512; otherwise the storage comes from the pool, on huge pages and NUMA nodes as the policy says.
+		//Storage is freed where it came from, also when the policy has changed in between.
+		template <typename T, int ALIGN = 64>
+		class Allocator_Pool
+		{
+			static_assert(ALIGN <= 64, "ERROR:Allocator_Pool: the blocks of the pool are 64-byte aligned.");
+		public:
+
+			typedef T value_type;
+			typedef value_type* pointer;
+			typedef const value_type* const_pointer;
+			typedef value_type& reference;
+			typedef const value_type& const_reference;
+			typedef std::size_t size_type;
+			typedef std::ptrdiff_t difference_type;
+
+			template<typename U>
+			struct rebind
+			{
+				typedef Allocator_Pool<U> other;
+			};
+
+			inline explicit Allocator_Pool() {}
+			inline ~Allocator_Pool() {}
+			inline explicit Allocator_Pool(Allocator_Pool const&) {}
+			template<typename U>
+			inline Allocator_Pool(Allocator_Pool<U> const&) {}
+
+			inline pointer address(reference r) { return &r; }
+			inline const_pointer address(const_reference r) { return &r; }
+
+			pointer allocate(size_type n, [[maybe_unused]] const void *hint = 0)
+			{
+				if (priv::adopted_block != nullptr)
+				{
+					void * ptr = priv::adopted_block;
+					priv::adopted_block = nullptr;
+					return reinterpret_cast<pointer>(ptr);
+				}
+				const auto n_bytes = multiple_N(static_cast<int>(n) * sizeof(T), ALIGN);
+				Page_Pool& pool = Page_Pool::instance();
+				void * ptr = (pool.enabled()) ? pool.allocate(n_bytes) : _mm_malloc(n_bytes, ALIGN);
+				::tools::alloc_counter::add();
+				return reinterpret_cast<pointer>(ptr);
+			}
+			void deallocate(pointer p, size_type n)
+			{
+				const auto n_bytes = multiple_N(static_cast<int>(n) * sizeof(T), ALIGN);
+				if (!Page_Pool::instance().deallocate(p, n_bytes)) _mm_free(p);
+			}
+			inline size_type max_size() const
+			{
+				return std::numeric_limits<size_type>::max() / sizeof(T);
+			}
+			inline void construct(pointer p, const T& t) {
+				new(p) T(t); 
+			}
+			//Value initialize, except when a block is adopted: then the element keeps its value in the mapping.
+			template <typename U>
+			inline void construct(U * p) {
+				if (priv::adopting) new(p) U; else new(p) U();
+			}
+			inline void destroy(pointer p) { p->~T(); }
+
+			inline bool operator==(Allocator_Pool const&) { return true; }
+			inline bool operator!=(Allocator_Pool const& a) { return !operator==(a); }
+		};
+
+		//Let the provided vector hold the n elements at data, in a file mapping lent to the pool (see
+		//Page_Pool::lend_mapping), without copying or initializing them: the elements are read from the file when they
+		//are first read, and a page is copied by the OS when it is first written. The block goes back to the mapping when
+		//the vector is destroyed or reallocates. Returns false (and leaves the vector empty) when data is not in a lent
+		//mapping. The previous elements of the vector are freed.
+		template <typename T>
+		bool adopt(std::vector<T, Allocator_Pool<T>>& v, T * const data, const size_t n)
+		{
+			static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value, "ERROR:adopt: only trivial elements can be adopted.");
+			std::vector<T, Allocator_Pool<T>>().swap(v);
+			if (n == 0) return true;
+			if (!Page_Pool::instance().adopt_block(data)) return false;
+
+			priv::adopted_block = data;
+			priv::adopting = true;
+			v.resize(n);
+			priv::adopting = false;
+			priv::adopted_block = nullptr;
+			return v.data() == data;
+		}
 	}
 }
\ No newline at end of file
@@ -0,0 +1,303 @@
+// C++ port of Nupic HTM with the aim of being lite and fast
+//
+// Copyright (c) 2017 Henk-Jan Lebbink
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero Public License version 3 as
+// published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero Public License for more details.
+//
+// You should have received a copy of the GNU Affero Public License
+// along with this program.  If not, see http://www.gnu.org/licenses.
+
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+
+#ifndef _MSC_VER
+#include <filesystem>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "log.ipp"
+
+namespace tools
+{
+	//Time a function a number of runs and keep the results in a JSON file, such that a later run can be compared
+	//with a saved baseline.
+	namespace benchmark
+	{
+		struct Result
+		{
+			std::string name;
+			double median_ns = 0;
+			double min_ns = 0;
+			int n_runs = 0;
+			//Value that has to be equal between runs (eg. a prediction mismatch); -1 when there is none.
+			int64_t check = -1;
+		};
+
+		//Call f once to warm up and then n_runs times; the result holds the median and minimum time of one call.
+		template <typename F>
+		Result measure(const std::string& name, const int n_runs, F&& f)
+		{
+			f();
+			std::vector<double> elapsed_ns(std::max(1, n_runs));
+			for (auto& e : elapsed_ns)
+			{
+				const auto start_time = std::chrono::steady_clock::now();
+				f();
+				e = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count();
+			}
+			std::sort(elapsed_ns.begin(), elapsed_ns.end());
+
+			Result result;
+			result.name = name;
+			result.median_ns = elapsed_ns[elapsed_ns.size() / 2];
+			result.min_ns = elapsed_ns[0];
+			result.n_runs = static_cast<int>(elapsed_ns.size());
+			return result;
+		}
+
+		//Peak resident set size of the process in bytes; -1 on Windows.
+		inline int64_t peak_rss_bytes()
+		{
+			#ifndef _MSC_VER
+			rusage usage{};
+			if (::getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+			return static_cast<int64_t>(usage.ru_maxrss) * 1024; // ru_maxrss is in kilobytes
+			#else
+			return -1;
+			#endif
+		}
+
+		//Write the results to a JSON file with one result per line; returns false when the file cannot be written.
+		inline bool write_json(const std::string& filename, const std::string& description, const std::vector<Result>& results)
+		{
+			std::ofstream file(filename);
+			if (!file.good())
+			{
+				::tools::log::log_WARNING("benchmark:write_json: could not open file ", filename, ".\n");
+				return false;
+			}
+			file << std::fixed << std::setprecision(1);
+			file << "{\n";
+			file << "\t\"description\": \"" << description << "\",\n";
+			file << "\t\"results\": [\n";
+			for (size_t i = 0; i < results.size(); ++i)
+			{
+				const auto& r = results[i];
+				file << "\t\t{\"name\": \"" << r.name << "\", \"median_ns\": " << r.median_ns << ", \"min_ns\": " << r.min_ns
+					<< ", \"runs\": " << r.n_runs << ", \"check\": " << r.check << "}" << ((i + 1 < results.size()) ? "," : "") << "\n";
+			}
+			file << "\t]\n";
+			file << "}\n";
+			return file.good();
+		}
+
+		namespace priv
+		{
+			//Get the text after "key": up to the next comma, closing brace or closing quote.
+			inline bool find_value(const std::string& line, const std::string& key, std::string& value)
+			{
+				const std::string pattern = "\"" + key + "\":";
+				size_t pos = line.find(pattern);
+				if (pos == std::string::npos) return false;
+				pos += pattern.size();
+				while ((pos < line.size()) && (line[pos] == ' ')) pos++;
+
+				if ((pos < line.size()) && (line[pos] == '"'))
+				{
+					const size_t end = line.find('"', pos + 1);
+					if (end == std::string::npos) return false;
+					value = line.substr(pos + 1, end - pos - 1);
+				}
+				else
+				{
+					const size_t end = line.find_first_of(",}", pos);
+					value = line.substr(pos, (end == std::string::npos) ? std::string::npos : end - pos);
+				}
+				return true;
+			}
+		}
+
+		//Read the results from a JSON file as written by write_json (not a general JSON reader); returns false when
+		//the file cannot be read.
+		inline bool read_json(const std::string& filename, std::vector<Result>& results)
+		{
+			results.clear();
+			std::ifstream file(filename);
+			if (!file.good())
+			{
+				::tools::log::log_WARNING("benchmark:read_json: could not open file ", filename, ".\n");
+				return false;
+			}
+			std::string line;
+			while (std::getline(file, line))
+			{
+				Result r;
+				std::string value;
+				if (!priv::find_value(line, "name", r.name)) continue;
+				if (priv::find_value(line, "median_ns", value)) r.median_ns = std::stod(value);
+				if (priv::find_value(line, "min_ns", value)) r.min_ns = std::stod(value);
+				if (priv::find_value(line, "runs", value)) r.n_runs = std::stoi(value);
+				if (priv::find_value(line, "check", value)) r.check = std::stoll(value);
+				results.push_back(r);
+			}
+			return true;
+		}
+
+		//Compare the median times of the current results with the baseline: a result is slower when its median is
+		//more than threshold (eg. 0.1 = 10%) above the baseline. Prints one line per result and returns the number of
+		//failed results: results that are slower or whose check value differs from the baseline (the kernel computed
+		//something else).
+		inline int compare(const std::vector<Result>& baseline, const std::vector<Result>& current, const double threshold)
+		{
+			int n_slower = 0;
+			int n_check = 0;
+			int n_failed = 0;
+			std::ostringstream os;
+			os << std::fixed << std::setprecision(3);
+			for (const auto& r : current)
+			{
+				const auto it = std::find_if(baseline.begin(), baseline.end(), [&](const Result& b) { return b.name == r.name; });
+				os << std::left << std::setw(56) << r.name << std::right;
+				if (it == baseline.end())
+				{
+					os << "  new\n";
+					continue;
+				}
+				const double ratio = (it->median_ns > 0) ? (r.median_ns / it->median_ns) : 1.0;
+				os << std::setw(14) << (it->median_ns / 1e6) << " ms" << std::setw(14) << (r.median_ns / 1e6) << " ms" << std::setw(8) << ratio << "x";
+				const bool slower = ratio > 1 + threshold;
+				const bool check_differs = it->check != r.check;
+				if (slower)
+				{
+					os << "  SLOWER";
+					n_slower++;
+				}
+				else if (ratio < 1 / (1 + threshold))
+				{
+					os << "  faster";
+				}
+				if (check_differs)
+				{
+					os << "  CHECK " << it->check << " -> " << r.check;
+					n_check++;
+				}
+				if (slower || check_differs) n_failed++;
+				os << "\n";
+			}
+			for (const auto& b : baseline)
+			{
+				if (std::none_of(current.begin(), current.end(), [&](const Result& r) { return r.name == b.name; })) os << std::left << std::setw(56) << b.name << "  missing\n";
+			}
+			::tools::log::log_INFO(os.str());
+			::tools::log::log_INFO("benchmark:compare: ", n_slower, " of ", current.size(), " results are more than ", 100 * threshold, "% slower than the baseline; ", n_check, " results have a different check value.\n");
+			return n_failed;
+		}
+
+		enum class event_t
+		{
+			DTLB_LOAD_MISSES,	// loads that missed the data TLB
+			PAGE_FAULTS
+		};
+
+		//Counter of a hardware or OS event of the process, read with perf_event_open on Linux: every thread that exists
+		//at the construction of the counter (eg. the workers of a thread pool) has its own counter, which includes the
+		//threads it creates afterwards. The counter is not available on Windows, nor when the cpu or the virtual 
+		//machine does not expose the event; stop then returns -1.
+		class Event_Counter
+		{
+		public:
+			explicit Event_Counter(const event_t event)
+			{
+				#ifndef _MSC_VER
+				perf_event_attr attr{};
+				attr.size = sizeof(attr);
+				attr.disabled = 1;
+				attr.inherit = 1;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				if (event == event_t::DTLB_LOAD_MISSES)
+				{
+					attr.type = PERF_TYPE_HW_CACHE;
+					attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+				}
+				else
+				{
+					attr.type = PERF_TYPE_SOFTWARE;
+					attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+				}
+				// a thread that exits while the threads are listed is skipped
+				std::error_code error;
+				for (const auto& task : std::filesystem::directory_iterator("/proc/self/task", error))
+				{
+					const pid_t tid = static_cast<pid_t>(std::stol(task.path().filename().string()));
+					const int fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0));
+					if (fd >= 0) this->fds_.push_back(fd);
+				}
+				#endif
+			}
+			~Event_Counter()
+			{
+				#ifndef _MSC_VER
+				for (const int fd : this->fds_) ::close(fd);
+				#endif
+			}
+			Event_Counter(const Event_Counter&) = delete;
+			Event_Counter& operator=(const Event_Counter&) = delete;
+
+			bool available() const
+			{
+				return !this->fds_.empty();
+			}
+			//Reset the count and start counting.
+			void start()
+			{
+				#ifndef _MSC_VER
+				for (const int fd : this->fds_)
+				{
+					::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+					::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+				}
+				#endif
+			}
+			//Stop counting and return the count of all threads since start.
+			int64_t stop()
+			{
+				#ifndef _MSC_VER
+				if (this->fds_.empty()) return -1;
+				for (const int fd : this->fds_) ::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+				int64_t sum = 0;
+				for (const int fd : this->fds_)
+				{
+					uint64_t count = 0;
+					if (::read(fd, &count, sizeof(count)) != static_cast<ssize_t>(sizeof(count))) return -1;
+					sum += static_cast<int64_t>(count);
+				}
+				return sum;
+				#else
+				return -1;
+				#endif
+			}
+
+		private:
+			std::vector<int> fds_;
+		};
+	}
+}
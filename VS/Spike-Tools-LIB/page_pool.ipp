@@ -0,0 +1,614 @@
+// C++ port of Nupic HTM with the aim of being lite and fast
+//
+// Copyright (c) 2017 Henk-Jan Lebbink
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero Public License version 3 as
+// published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero Public License for more details.
+//
+// You should have received a copy of the GNU Affero Public License
+// along with this program.  If not, see http://www.gnu.org/licenses.
+
+#pragma once
+#include <string>
+#include <vector>
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>		// std::strlen
+#include <new>		// std::bad_alloc
+
+#ifdef _MSC_VER
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>	// QueryWorkingSetEx
+#else
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace tools
+{
+	namespace allocator
+	{
+		//Pages that back the pool.
+		enum class page_t
+		{
+			NONE,				// no pool: the allocator uses _mm_malloc
+			SMALL,				// pool of 4KB pages (transparent huge pages are disabled for the pool)
+			TRANSPARENT_HUGE,	// pool of 2MB aligned chunks that are advised to be backed by transparent huge pages
+			HUGETLB				// pool of explicit 2MB pages; falls back to TRANSPARENT_HUGE when none are reserved
+		};
+
+		//NUMA placement of the pool.
+		enum class numa_t
+		{
+			FIRST_TOUCH,		// pages are placed on the node of the thread that first writes them
+			BIND,				// pages are preferably placed on Page_Policy::numa_node
+			LOCAL				// every node has its own chunks; an allocation comes from the node of the calling thread
+		};
+
+		struct Page_Policy
+		{
+			page_t page = page_t::NONE;
+			numa_t numa = numa_t::FIRST_TOUCH;
+			int numa_node = 0;
+			//Bytes of a chunk from which the small blocks are cut; a multiple of 2MB.
+			size_t chunk_bytes = 32 << 20;
+		};
+
+		//Statistics of the pool; n_bytes_huge and the bytes per node are queried from the OS.
+		struct Page_Stats
+		{
+			int64_t n_bytes_requested = 0;	// bytes currently in use by the allocators
+			int64_t n_bytes_blocks = 0;		// bytes of the blocks (rounded to a size class) currently in use
+			int64_t n_bytes_mapped = 0;		// bytes mapped by the pool
+			int64_t n_bytes_huge = 0;		// mapped bytes that are backed by 2MB pages
+			int64_t n_bytes_not_resident = 0;
+			int n_chunks = 0;
+			int n_huge_fallbacks = 0;		// mappings since the last policy change that did not get the requested huge pages
+			std::vector<int64_t> n_bytes_node;	// resident bytes per NUMA node
+
+			std::string to_string() const
+			{
+				std::ostringstream result;
+				result << "requested " << (this->n_bytes_requested >> 20) << " MB; blocks " << (this->n_bytes_blocks >> 20)
+					<< " MB; mapped " << (this->n_bytes_mapped >> 20) << " MB in " << this->n_chunks << " chunks; huge "
+					<< (this->n_bytes_huge >> 20) << " MB; huge fallbacks " << this->n_huge_fallbacks << "; not resident "
+					<< (this->n_bytes_not_resident >> 20) << " MB";
+				for (int node_i = 0; node_i < static_cast<int>(this->n_bytes_node.size()); ++node_i)
+				{
+					result << "; node " << node_i << " " << (this->n_bytes_node[node_i] >> 20) << " MB";
+				}
+				return result.str();
+			}
+		};
+
+		namespace priv
+		{
+			static constexpr size_t SMALL_PAGE_BYTES = 4096;
+			static constexpr size_t HUGE_PAGE_BYTES = 2 << 20;
+			static constexpr int MAX_NODES = 64;
+
+			inline size_t multiple_huge_page(const size_t n_bytes)
+			{
+				return (n_bytes + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+			}
+
+#ifdef _MSC_VER
+			//Large pages need the lock memory privilege; it is enabled once, and stays missing when the account does not have it.
+			inline bool enable_large_pages()
+			{
+				static const bool enabled = []()
+				{
+					HANDLE token;
+					if (!::OpenProcessToken(::GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) return false;
+					TOKEN_PRIVILEGES privileges;
+					privileges.PrivilegeCount = 1;
+					privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+					const bool found = ::LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) != 0;
+					const bool adjusted = found && (::AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) != 0) && (::GetLastError() == ERROR_SUCCESS);
+					::CloseHandle(token);
+					return adjusted && (::GetLargePageMinimum() == HUGE_PAGE_BYTES);
+				}();
+				return enabled;
+			}
+
+			//Map n_bytes (a multiple of 2MB) with the provided pages, preferably on the provided node (-1 for any node).
+			//Windows has no transparent huge pages: both huge page types use large pages. Sets huge_fallback when
+			//huge pages were requested but not obtained.
+			inline char * map(const size_t n_bytes, const page_t page, const int node, bool& huge_fallback)
+			{
+				const DWORD preferred_node = (node < 0) ? NUMA_NO_PREFERRED_NODE : static_cast<DWORD>(node);
+				huge_fallback = false;
+				if ((page == page_t::TRANSPARENT_HUGE) || (page == page_t::HUGETLB))
+				{
+					if (enable_large_pages())
+					{
+						void * ptr = ::VirtualAllocExNuma(::GetCurrentProcess(), nullptr, n_bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, preferred_node);
+						if (ptr != nullptr) return static_cast<char *>(ptr);
+					}
+					huge_fallback = true;
+				}
+				return static_cast<char *>(::VirtualAllocExNuma(::GetCurrentProcess(), nullptr, n_bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, preferred_node));
+			}
+
+			inline void unmap(char * const ptr, [[maybe_unused]] const size_t n_bytes)
+			{
+				::VirtualFree(ptr, 0, MEM_RELEASE);
+			}
+
+			//Unmap a view of a file lent to the pool (see Page_Pool::lend_mapping).
+			inline void unmap_file(char * const ptr, [[maybe_unused]] const size_t n_bytes)
+			{
+				::UnmapViewOfFile(ptr);
+			}
+
+			//NUMA node of the processor that runs the calling thread.
+			inline int current_node()
+			{
+				PROCESSOR_NUMBER processor;
+				::GetCurrentProcessorNumberEx(&processor);
+				USHORT node = 0;
+				if (!::GetNumaProcessorNodeEx(&processor, &node)) return 0;
+				return std::min(static_cast<int>(node), MAX_NODES - 1);
+			}
+
+			//Add the resident bytes per node, the bytes not resident and the bytes in large pages of the provided range.
+			inline void query_range(const char * const begin, const size_t n_bytes, Page_Stats& stats)
+			{
+				constexpr size_t BATCH = 4096;
+				std::vector<PSAPI_WORKING_SET_EX_INFORMATION> info(BATCH);
+				for (size_t offset = 0; offset < n_bytes; offset += BATCH * SMALL_PAGE_BYTES)
+				{
+					const size_t n_pages = std::min(BATCH, (n_bytes - offset) / SMALL_PAGE_BYTES);
+					for (size_t i = 0; i < n_pages; ++i) info[i].VirtualAddress = const_cast<char *>(begin + offset + (i * SMALL_PAGE_BYTES));
+					if (!::QueryWorkingSetEx(::GetCurrentProcess(), info.data(), static_cast<DWORD>(n_pages * sizeof(PSAPI_WORKING_SET_EX_INFORMATION)))) return;
+					for (size_t i = 0; i < n_pages; ++i)
+					{
+						const auto& attributes = info[i].VirtualAttributes;
+						if (!attributes.Valid)
+						{
+							stats.n_bytes_not_resident += SMALL_PAGE_BYTES;
+							continue;
+						}
+						const int node = std::min(static_cast<int>(attributes.Node), MAX_NODES - 1);
+						if (static_cast<int>(stats.n_bytes_node.size()) <= node) stats.n_bytes_node.resize(node + 1, 0);
+						stats.n_bytes_node[node] += SMALL_PAGE_BYTES;
+						if (attributes.LargePage) stats.n_bytes_huge += SMALL_PAGE_BYTES;
+					}
+				}
+			}
+
+			//Windows reports the large pages per page in query_range.
+			inline void query_huge([[maybe_unused]] const std::vector<std::pair<const char *, size_t>>& ranges, [[maybe_unused]] Page_Stats& stats)
+			{}
+#else
+			//Memory policy of mbind (see numaif.h, which is part of libnuma and not needed for this one call).
+			static constexpr int MPOL_PREFERRED_ = 1;
+
+			//Map n_bytes (a multiple of 2MB) with the provided pages at a 2MB boundary, preferably on the provided node
+			//(-1 for any node). Sets huge_fallback when hugetlb pages were requested but none were available.
+			inline char * map(const size_t n_bytes, const page_t page, const int node, bool& huge_fallback)
+			{
+				huge_fallback = false;
+				char * ptr = nullptr;
+				if (page == page_t::HUGETLB)
+				{
+					void * p = ::mmap(nullptr, n_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+					if (p != MAP_FAILED) ptr = static_cast<char *>(p);
+					else huge_fallback = true;
+				}
+				if (ptr == nullptr)
+				{
+					// map 2MB more than needed and trim the ends such that the range starts at a 2MB boundary
+					void * p = ::mmap(nullptr, n_bytes + HUGE_PAGE_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+					if (p == MAP_FAILED) return nullptr;
+					char * const raw = static_cast<char *>(p);
+					ptr = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(raw) + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1));
+					if (ptr != raw) ::munmap(raw, ptr - raw);
+					if ((ptr + n_bytes) != (raw + n_bytes + HUGE_PAGE_BYTES)) ::munmap(ptr + n_bytes, (raw + n_bytes + HUGE_PAGE_BYTES) - (ptr + n_bytes));
+					::madvise(ptr, n_bytes, (page == page_t::SMALL) ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+				}
+				if (node >= 0)
+				{
+					const unsigned long node_mask = 1ul << node;
+					::syscall(SYS_mbind, ptr, n_bytes, MPOL_PREFERRED_, &node_mask, MAX_NODES, 0);
+				}
+				return ptr;
+			}
+
+			inline void unmap(char * const ptr, const size_t n_bytes)
+			{
+				::munmap(ptr, n_bytes);
+			}
+
+			//Unmap a view of a file lent to the pool (see Page_Pool::lend_mapping).
+			inline void unmap_file(char * const ptr, const size_t n_bytes)
+			{
+				::munmap(ptr, n_bytes);
+			}
+
+			//NUMA node of the processor that runs the calling thread.
+			inline int current_node()
+			{
+				unsigned int cpu = 0;
+				unsigned int node = 0;
+				if (::syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return 0;
+				return std::min(static_cast<int>(node), MAX_NODES - 1);
+			}
+
+			//Add the resident bytes per node and the bytes not resident of the provided range.
+			inline void query_range(const char * const begin, const size_t n_bytes, Page_Stats& stats)
+			{
+				constexpr size_t BATCH = 4096;
+				std::vector<void *> pages(BATCH);
+				std::vector<int> status(BATCH);
+				for (size_t offset = 0; offset < n_bytes; offset += BATCH * SMALL_PAGE_BYTES)
+				{
+					const size_t n_pages = std::min(BATCH, (n_bytes - offset) / SMALL_PAGE_BYTES);
+					for (size_t i = 0; i < n_pages; ++i) pages[i] = const_cast<char *>(begin + offset + (i * SMALL_PAGE_BYTES));
+					// move_pages without target nodes only reports the node of every page
+					if (::syscall(SYS_move_pages, 0, n_pages, pages.data(), nullptr, status.data(), 0) != 0) return;
+					for (size_t i = 0; i < n_pages; ++i)
+					{
+						if (status[i] < 0)
+						{
+							stats.n_bytes_not_resident += SMALL_PAGE_BYTES;
+							continue;
+						}
+						const int node = std::min(status[i], MAX_NODES - 1);
+						if (static_cast<int>(stats.n_bytes_node.size()) <= node) stats.n_bytes_node.resize(node + 1, 0);
+						stats.n_bytes_node[node] += SMALL_PAGE_BYTES;
+					}
+				}
+			}
+
+			//Add the bytes in huge pages of the mappings of /proc/self/smaps that overlap with the provided ranges.
+			inline void query_huge(const std::vector<std::pair<const char *, size_t>>& ranges, Page_Stats& stats)
+			{
+				std::ifstream smaps("/proc/self/smaps");
+				std::string line;
+				bool overlaps = false;
+				while (std::getline(smaps, line))
+				{
+					uintptr_t begin = 0;
+					uintptr_t end = 0;
+					char dash = 0;
+					std::istringstream header(line);
+					if ((header >> std::hex >> begin >> dash >> end) && (dash == '-'))
+					{
+						overlaps = std::any_of(ranges.begin(), ranges.end(), [&](const std::pair<const char *, size_t>& range)
+						{
+							const uintptr_t range_begin = reinterpret_cast<uintptr_t>(range.first);
+							return (range_begin < end) && (begin < (range_begin + range.second));
+						});
+						continue;
+					}
+					if (!overlaps) continue;
+					for (const char * const key : { "AnonHugePages:", "Private_Hugetlb:", "Shared_Hugetlb:" })
+					{
+						if (line.compare(0, std::strlen(key), key) == 0)
+						{
+							stats.n_bytes_huge += std::stoll(line.substr(std::strlen(key))) << 10;
+						}
+					}
+				}
+			}
+#endif
+		}
+
+		//Pool of 64-byte aligned blocks cut from large chunks with the pages and NUMA placement of the policy. The blocks
+		//have power of two sizes from 64 bytes up to 1MB; a freed block is kept for reuse by the pool and not returned to
+		//the OS. Larger blocks get a mapping of their own, which is unmapped when they are freed. Allocations are rare
+		//in a steady state time step, so one mutex guards the pool.
+		class Page_Pool
+		{
+		public:
+			//The pool is never destroyed, such that storage can be freed during the destruction of static objects.
+			static Page_Pool& instance()
+			{
+				static Page_Pool * const pool = new Page_Pool();
+				return *pool;
+			}
+
+			//Set the policy for the storage that is allocated after this call. Storage allocated before stays where it
+			//is; its chunks are unmapped once all of their blocks are freed.
+			void set_policy(const Page_Policy& policy)
+			{
+				std::lock_guard<std::mutex> lock(this->mutex_);
+				this->policy_ = policy;
+				this->policy_.chunk_bytes = priv::multiple_huge_page(std::max(policy.chunk_bytes, priv::HUGE_PAGE_BYTES));
+				this->enabled_.store(policy.page != page_t::NONE, std::memory_order_relaxed);
+				this->stats_.n_huge_fallbacks = 0;
+
+				for (auto& arena : this->arenas_) arena = Arena();
+				for (auto& chunk : this->chunks_) chunk.retired = true;
+				this->unmap_unused_chunks();
+			}
+			Page_Policy policy() const
+			{
+				std::lock_guard<std::mutex> lock(this->mutex_);
+				return this->policy_;
+			}
+			//True when allocations come from the pool (and not from _mm_malloc).
+			bool enabled() const
+			{
+				return this->enabled_.load(std::memory_order_relaxed);
+			}
+
+			//Allocate a 64-byte aligned block of at least n_bytes.
+			void * allocate(const size_t n_bytes)
+			{
+				std::lock_guard<std::mutex> lock(this->mutex_);
+				const int arena_i = this->arena_index();
+				const int class_i = size_class(n_bytes);
+				void * ptr = nullptr;
+
+				if (class_i >= N_CLASSES)
+				{
+					const size_t n_bytes_mapping = priv::multiple_huge_page(n_bytes);
+					Chunk * chunk = this->add_chunk(n_bytes_mapping, arena_i, true);
+					ptr = chunk->begin;
+					this->stats_.n_bytes_blocks += n_bytes_mapping;
+				}
+				else
+				{
+					const size_t n_bytes_block = block_bytes(class_i);
+					Arena& arena = this->arenas_[arena_i];
+					if (arena.free[class_i] != nullptr)
+					{
+						ptr = arena.free[class_i];
+						arena.free[class_i] = *static_cast<void **>(ptr);
+					}
+					else
+					{
+						if ((arena.bump == nullptr) || ((arena.end - arena.bump) < static_cast<ptrdiff_t>(n_bytes_block)))
+						{
+							Chunk * chunk = this->add_chunk(this->policy_.chunk_bytes, arena_i, false);
+							arena.bump = chunk->begin;
+							arena.end = chunk->begin + chunk->n_bytes;
+						}
+						ptr = arena.bump;
+						arena.bump += n_bytes_block;
+					}
+					this->find_chunk(ptr)->n_live++;
+					this->stats_.n_bytes_blocks += n_bytes_block;
+				}
+				this->stats_.n_bytes_requested += n_bytes;
+				return ptr;
+			}
+
+			//Free a block of n_bytes; returns false when the block was not allocated by the pool.
+			bool deallocate(void * const ptr, const size_t n_bytes)
+			{
+				if (this->n_chunks_.load(std::memory_order_relaxed) == 0) return false;
+				std::lock_guard<std::mutex> lock(this->mutex_);
+				Chunk * chunk = this->find_chunk(ptr);
+				if (chunk == nullptr) return false;
+
+				if (chunk->file)
+				{// a block adopted from a lent file mapping goes back to the mapping
+					chunk->n_live--;
+					if (chunk->n_live == 0) this->unmap_unused_chunks();
+					return true;
+				}
+				const int class_i = size_class(n_bytes);
+				this->stats_.n_bytes_requested -= n_bytes;
+				if (chunk->large)
+				{
+					this->stats_.n_bytes_blocks -= chunk->n_bytes;
+					chunk->retired = true;
+					chunk->n_live = 0;
+				}
+				else
+				{
+					this->stats_.n_bytes_blocks -= block_bytes(class_i);
+					chunk->n_live--;
+					if (!chunk->retired)
+					{
+						Arena& arena = this->arenas_[chunk->arena_i];
+						*static_cast<void **>(ptr) = arena.free[class_i];
+						arena.free[class_i] = ptr;
+					}
+				}
+				if (chunk->retired && (chunk->n_live == 0)) this->unmap_unused_chunks();
+				return true;
+			}
+
+			//Lend the n_bytes at begin, a private (copy on write) view of a file, to the pool: blocks of it can then be
+			//adopted by vectors (see allocator::adopt) without copying, and they go back to the mapping when they are
+			//freed. The lender holds a reference until release_mapping; the view is unmapped by the pool once the lender
+			//has released it and all adopted blocks are freed.
+			void lend_mapping(char * const begin, const size_t n_bytes)
+			{
+				std::lock_guard<std::mutex> lock(this->mutex_);
+				Chunk chunk;
+				chunk.begin = begin;
+				chunk.n_bytes = n_bytes;
+				chunk.file = true;
+				chunk.retired = true;
+				chunk.n_live = 1;
+				const auto it = std::upper_bound(this->chunks_.begin(), this->chunks_.end(), begin, [](const char * const ptr, const Chunk& c) { return ptr < c.begin; });
+				this->chunks_.insert(it, chunk);
+				this->n_chunks_.store(static_cast<int>(this->chunks_.size()), std::memory_order_relaxed);
+			}
+			//Release the reference of the lender of the mapping at begin (see lend_mapping).
+			void release_mapping(const char * const begin)
+			{
+				std::lock_guard<std::mutex> lock(this->mutex_);
+				Chunk * chunk = this->find_chunk(begin);
+				if ((chunk == nullptr) || !chunk->file) return;
+				chunk->n_live--;
+				if (chunk->n_live == 0) this->unmap_unused_chunks();
+			}
+			//Count a block of a lent mapping that a vector adopts; returns false when ptr is not in a lent mapping.
+			bool adopt_block(const void * const ptr)
+			{
+				std::lock_guard<std::mutex> lock(this->mutex_);
+				Chunk * chunk = this->find_chunk(ptr);
+				if ((chunk == nullptr) || !chunk->file) return false;
+				chunk->n_live++;
+				return true;
+			}
+			//Whether ptr is in a file mapping lent to the pool (see lend_mapping).
+			bool is_lent(const void * const ptr)
+			{
+				std::lock_guard<std::mutex> lock(this->mutex_);
+				Chunk * chunk = this->find_chunk(ptr);
+				return (chunk != nullptr) && chunk->file;
+			}
+
+			//Statistics of the pool; the page sizes and nodes are queried from the OS for every mapped page. Lent file
+			//mappings are not part of the pool and are not counted.
+			Page_Stats stats() const
+			{
+				std::lock_guard<std::mutex> lock(this->mutex_);
+				Page_Stats result = this->stats_;
+				result.n_chunks = 0;
+				result.n_bytes_mapped = 0;
+
+				std::vector<std::pair<const char *, size_t>> ranges;
+				for (const auto& chunk : this->chunks_)
+				{
+					if (chunk.file) continue;
+					result.n_chunks++;
+					result.n_bytes_mapped += chunk.n_bytes;
+					ranges.emplace_back(chunk.begin, chunk.n_bytes);
+					priv::query_range(chunk.begin, chunk.n_bytes, result);
+				}
+				priv::query_huge(ranges, result);
+				return result;
+			}
+
+		private:
+			static constexpr int MIN_CLASS_LOG2 = 6;	// 64 bytes
+			static constexpr int N_CLASSES = 15;		// up to 1MB
+
+			struct Chunk
+			{
+				char * begin = nullptr;
+				size_t n_bytes = 0;
+				int arena_i = 0;
+				bool large = false;		// one block with a mapping of its own
+				bool file = false;		// a view of a file lent by lend_mapping, from which vectors adopt blocks
+				bool retired = false;	// no new blocks are cut from it; unmapped when its last block is freed
+				int64_t n_live = 0;		// number of blocks in use
+			};
+			//Chunks of one NUMA node (or of any node): blocks are cut from the current chunk, freed blocks are reused.
+			struct Arena
+			{
+				char * bump = nullptr;
+				char * end = nullptr;
+				std::array<void *, N_CLASSES> free{};
+			};
+
+			Page_Policy policy_;
+			std::atomic<bool> enabled_{ false };
+			std::atomic<int> n_chunks_{ 0 };
+			std::vector<Chunk> chunks_;		// sorted on begin
+			std::vector<Arena> arenas_ = std::vector<Arena>(1);	// 0: any node; 1 + node: the provided node
+			Page_Stats stats_;
+			mutable std::mutex mutex_;
+
+			Page_Pool() = default;
+			Page_Pool(const Page_Pool&) = delete;
+			Page_Pool& operator=(const Page_Pool&) = delete;
+
+			static int size_class(const size_t n_bytes)
+			{
+				int log2 = MIN_CLASS_LOG2;
+				while ((static_cast<size_t>(1) << log2) < n_bytes) log2++;
+				return log2 - MIN_CLASS_LOG2;
+			}
+			static size_t block_bytes(const int class_i)
+			{
+				return static_cast<size_t>(1) << (class_i + MIN_CLASS_LOG2);
+			}
+
+			int arena_index()
+			{
+				int node = -1;
+				if (this->policy_.numa == numa_t::BIND) node = this->policy_.numa_node;
+				if (this->policy_.numa == numa_t::LOCAL) node = priv::current_node();
+				const int arena_i = node + 1;
+				if (static_cast<int>(this->arenas_.size()) <= arena_i) this->arenas_.resize(arena_i + 1);
+				return arena_i;
+			}
+
+			Chunk * add_chunk(const size_t n_bytes, const int arena_i, const bool large)
+			{
+				bool huge_fallback = false;
+				char * const begin = priv::map(n_bytes, this->policy_.page, arena_i - 1, huge_fallback);
+				if (begin == nullptr) throw std::bad_alloc();
+				if (huge_fallback) this->stats_.n_huge_fallbacks++;
+
+				Chunk chunk;
+				chunk.begin = begin;
+				chunk.n_bytes = n_bytes;
+				chunk.arena_i = arena_i;
+				chunk.large = large;
+				chunk.n_live = (large) ? 1 : 0;
+				const auto it = std::upper_bound(this->chunks_.begin(), this->chunks_.end(), begin, [](const char * const ptr, const Chunk& c) { return ptr < c.begin; });
+				const auto result = this->chunks_.insert(it, chunk);
+				this->n_chunks_.store(static_cast<int>(this->chunks_.size()), std::memory_order_relaxed);
+				return &(*result);
+			}
+
+			//The chunk that contains ptr, or nullptr.
+			Chunk * find_chunk(const void * const ptr)
+			{
+				const char * const p = static_cast<const char *>(ptr);
+				auto it = std::upper_bound(this->chunks_.begin(), this->chunks_.end(), p, [](const char * const q, const Chunk& c) { return q < c.begin; });
+				if (it == this->chunks_.begin()) return nullptr;
+				--it;
+				return (p < (it->begin + it->n_bytes)) ? &(*it) : nullptr;
+			}
+
+			void unmap_unused_chunks()
+			{
+				for (auto it = this->chunks_.begin(); it != this->chunks_.end();)
+				{
+					if (it->retired && (it->n_live == 0))
+					{
+						if (it->file) priv::unmap_file(it->begin, it->n_bytes);
+						else priv::unmap(it->begin, it->n_bytes);
+						it = this->chunks_.erase(it);
+					}
+					else ++it;
+				}
+				this->n_chunks_.store(static_cast<int>(this->chunks_.size()), std::memory_order_relaxed);
+			}
+		};
+
+		//Set the page policy of the storage of the pool allocator (see Allocator_Pool).
+		inline void set_page_policy(const Page_Policy& policy)
+		{
+			Page_Pool::instance().set_policy(policy);
+		}
+		inline Page_Policy page_policy()
+		{
+			return Page_Pool::instance().policy();
+		}
+		inline Page_Stats page_stats()
+		{
+			return Page_Pool::instance().stats();
+		}
+	}
+}
@@ -18,6 +18,26 @@
 #include <type_traits>
 #include <iostream>		// for cerr and cout
 #include <array>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <cstdint>
+
+#include "timing.ipp"	// rdtsc
+
+//Define PROFILER_ON as 1 to compile the scoped timers and counters in; otherwise they have no overhead.
+#ifndef PROFILER_ON
+#define PROFILER_ON 0
+#endif
 
 namespace tools
 {
@@ -126,5 +146,324 @@ namespace tools
 
 		template <int SIZE>
 		std::array<unsigned long long, SIZE> Profiler <SIZE, true>::totalTime_;
+
+		//Whether the scoped timers and counters are compiled in.
+		static constexpr bool ON = (PROFILER_ON != 0);
+
+		namespace priv
+		{
+			static constexpr int MAX_COUNTERS = 32;
+
+			inline int64_t now_ns()
+			{
+				return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+			}
+
+			struct Event
+			{
+				const char * name;
+				int64_t begin;
+				int64_t end;
+				int depth;
+			};
+
+			//Events and counters of one thread. Only the owning thread appends events and adds to counters, hence that
+			//needs no lock; the log is read (by step, summary_str and write_trace) when the thread does not profile.
+			struct Thread_Log
+			{
+				int thread_id = 0;
+				int depth = 0;
+				std::vector<Event> events;
+				std::array<const char *, MAX_COUNTERS> counter_name{};
+				std::array<std::atomic<int64_t>, MAX_COUNTERS> counter_value{};
+				std::atomic<int> n_counters{ 0 };
+			};
+
+			struct Counter_Sample
+			{
+				int64_t time;
+				int step;
+				std::vector<int64_t> values; // indexed as Registry::counter_names
+			};
+
+			struct Registry
+			{
+				std::mutex mutex;
+				std::vector<std::unique_ptr<Thread_Log>> thread_logs;
+				std::vector<std::string> counter_names;
+				std::vector<Counter_Sample> samples;
+				std::vector<std::thread::id> step_threads; // threads that called step since the last reset
+				int64_t origin = now_ns();
+			};
+
+			inline Registry& registry()
+			{
+				static Registry registry;
+				return registry;
+			}
+
+			inline Thread_Log& thread_log()
+			{
+				thread_local Thread_Log * log = nullptr;
+				if (log == nullptr)
+				{
+					auto& r = registry();
+					std::lock_guard<std::mutex> lock(r.mutex);
+					r.thread_logs.push_back(std::make_unique<Thread_Log>());
+					log = r.thread_logs.back().get();
+					log->thread_id = static_cast<int>(r.thread_logs.size()) - 1;
+				}
+				return *log;
+			}
+
+			inline int counter_index(Registry& r, const char * name)
+			{
+				for (size_t i = 0; i < r.counter_names.size(); ++i)
+				{
+					if (r.counter_names[i] == name) return static_cast<int>(i);
+				}
+				r.counter_names.push_back(name);
+				return static_cast<int>(r.counter_names.size()) - 1;
+			}
+		}
+
+		//Scoped timer: the time between construction and destruction is recorded as an event (with its nesting depth)
+		//in the log of the calling thread. The name has to be a string literal.
+		template <bool ON_IN>
+		class Scope_T
+		{
+		public:
+			explicit Scope_T(const char *) {}
+		};
+
+		template <>
+		class Scope_T<true>
+		{
+		public:
+			explicit Scope_T(const char * name)
+				: log_(priv::thread_log())
+				, name_(name)
+			{
+				this->log_.depth++;
+				this->begin_ = priv::now_ns();
+			}
+			~Scope_T()
+			{
+				const int64_t end = priv::now_ns();
+				this->log_.depth--;
+				this->log_.events.push_back(priv::Event{ this->name_, this->begin_, end, this->log_.depth });
+			}
+			Scope_T(const Scope_T&) = delete;
+			Scope_T& operator=(const Scope_T&) = delete;
+
+		private:
+			priv::Thread_Log& log_;
+			const char * name_;
+			int64_t begin_;
+		};
+
+		using Scope = Scope_T<ON>;
+
+		//Add n to the counter with the provided name (a string literal) of the calling thread. Counters are summed
+		//over all threads and sampled by step.
+		inline void count(const char * name, const int64_t n)
+		{
+			if constexpr (ON)
+			{
+				auto& log = priv::thread_log();
+				const int n_counters = log.n_counters.load(std::memory_order_relaxed);
+				for (int i = 0; i < n_counters; ++i)
+				{
+					if (log.counter_name[i] == name)
+					{
+						log.counter_value[i].store(log.counter_value[i].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+						return;
+					}
+				}
+				if (n_counters == priv::MAX_COUNTERS) return;
+				log.counter_name[n_counters] = name;
+				log.counter_value[n_counters].store(n, std::memory_order_relaxed);
+				log.n_counters.store(n_counters + 1, std::memory_order_release);
+			}
+		}
+
+		//End of a step: the counters of all threads are summed into a sample of the step and reset. Call it when no
+		//other thread adds to a counter (eg. after a parallel loop has finished). The counters are not attributed to a
+		//layer: a sample holds whatever all threads counted since the previous step. Counter samples are therefore only
+		//valid when one layer steps at a time (eg. the layers of a network one after the other on one thread); when
+		//layers step concurrently (pipelined network, swarm candidates) their counts mix, and summary_str warns.
+		inline void step(const int step_i)
+		{
+			if constexpr (ON)
+			{
+				auto& r = priv::registry();
+				std::lock_guard<std::mutex> lock(r.mutex);
+				const auto thread_id = std::this_thread::get_id();
+				if (std::find(r.step_threads.begin(), r.step_threads.end(), thread_id) == r.step_threads.end()) r.step_threads.push_back(thread_id);
+				priv::Counter_Sample sample{ priv::now_ns(), step_i, std::vector<int64_t>(r.counter_names.size(), 0) };
+				for (const auto& log : r.thread_logs)
+				{
+					const int n_counters = log->n_counters.load(std::memory_order_acquire);
+					for (int i = 0; i < n_counters; ++i)
+					{
+						const int index = priv::counter_index(r, log->counter_name[i]);
+						if (index >= static_cast<int>(sample.values.size())) sample.values.resize(index + 1, 0);
+						sample.values[index] += log->counter_value[i].exchange(0, std::memory_order_relaxed);
+					}
+				}
+				r.samples.push_back(std::move(sample));
+			}
+		}
+
+		//Remove all events and counter samples.
+		inline void reset()
+		{
+			if constexpr (ON)
+			{
+				auto& r = priv::registry();
+				std::lock_guard<std::mutex> lock(r.mutex);
+				for (auto& log : r.thread_logs)
+				{
+					log->events.clear();
+					for (auto& value : log->counter_value) value.store(0, std::memory_order_relaxed);
+				}
+				r.samples.clear();
+				r.step_threads.clear();
+				r.origin = priv::now_ns();
+			}
+		}
+
+		//Table with per scope name the number of events, the total and mean time, and the percentage of the time of 
+		//the outermost scopes of the first thread; followed by per counter the total and the mean and max per step.
+		//Scopes are indented by their nesting depth.
+		inline std::string summary_str()
+		{
+			std::ostringstream result;
+			if constexpr (ON)
+			{
+				struct Scope_Total
+				{
+					std::string name;
+					std::string parent; // enclosing scope in the first thread; or in any thread when the first thread has no such scope
+					bool parent_first_thread;
+					int64_t first;
+					int64_t n;
+					int64_t total;
+				};
+				auto& r = priv::registry();
+				std::lock_guard<std::mutex> lock(r.mutex);
+
+				std::vector<Scope_Total> totals;
+				int64_t root_total = 0;
+				for (const auto& log : r.thread_logs)
+				{
+					// events are logged when they end (children before their parent): in reverse order a parent comes first
+					std::vector<const char *> enclosing;
+					for (auto event = log->events.rbegin(); event != log->events.rend(); ++event)
+					{
+						enclosing.resize(event->depth + 1);
+						enclosing[event->depth] = event->name;
+						const std::string parent = (event->depth > 0) ? enclosing[event->depth - 1] : "";
+						const bool first_thread = (log->thread_id == 0);
+
+						if (first_thread && (event->depth == 0)) root_total += event->end - event->begin;
+						auto it = std::find_if(totals.begin(), totals.end(), [&](const Scope_Total& t) { return t.name == event->name; });
+						if (it == totals.end())
+						{
+							totals.push_back(Scope_Total{ event->name, parent, first_thread, event->begin, 0, 0 });
+							it = totals.end() - 1;
+						}
+						if ((first_thread && !it->parent_first_thread) || (it->parent.empty() && (first_thread == it->parent_first_thread)))
+						{
+							it->parent = parent;
+							it->parent_first_thread = first_thread;
+						}
+						it->first = std::min(it->first, event->begin);
+						it->n++;
+						it->total += event->end - event->begin;
+					}
+				}
+				std::sort(totals.begin(), totals.end(), [](const Scope_Total& a, const Scope_Total& b) { return a.first < b.first; });
+
+				result << std::left << std::setw(40) << "scope" << std::right << std::setw(12) << "count" << std::setw(14) << "total ms" << std::setw(12) << "mean us" << std::setw(9) << "%" << "\n";
+				std::vector<bool> done(totals.size(), false);
+				const std::function<void(const std::string&, int)> print_children = [&](const std::string& parent, const int depth)
+				{
+					for (size_t i = 0; i < totals.size(); ++i)
+					{
+						const auto& t = totals[i];
+						if (done[i] || (t.parent != parent)) continue;
+						done[i] = true;
+						result << std::left << std::setw(40) << (std::string(2 * depth, ' ') + t.name) << std::right
+							<< std::setw(12) << t.n
+							<< std::setw(14) << std::fixed << std::setprecision(3) << (t.total / 1e6)
+							<< std::setw(12) << std::setprecision(3) << (t.total / 1e3 / t.n)
+							<< std::setw(9) << std::setprecision(2) << ((root_total > 0) ? (100.0 * t.total / root_total) : 0.0) << "\n";
+						print_children(t.name, depth + 1);
+					}
+				};
+				print_children("", 0);
+
+				result << std::left << std::setw(40) << "counter" << std::right << std::setw(12) << "steps" << std::setw(14) << "total" << std::setw(12) << "mean" << std::setw(9) << "max" << "\n";
+				for (size_t i = 0; i < r.counter_names.size(); ++i)
+				{
+					int64_t total = 0;
+					int64_t max = 0;
+					for (const auto& sample : r.samples)
+					{
+						const int64_t value = (i < sample.values.size()) ? sample.values[i] : 0;
+						total += value;
+						max = std::max(max, value);
+					}
+					const size_t n_steps = std::max<size_t>(1, r.samples.size());
+					result << std::left << std::setw(40) << r.counter_names[i] << std::right
+						<< std::setw(12) << r.samples.size()
+						<< std::setw(14) << total
+						<< std::setw(12) << std::fixed << std::setprecision(1) << (static_cast<double>(total) / n_steps)
+						<< std::setw(9) << max << "\n";
+				}
+				if (r.step_threads.size() > 1)
+				{
+					result << "warning: steps were ended by " << r.step_threads.size() << " threads; counter samples are mixed if their layers stepped concurrently.\n";
+				}
+			}
+			return result.str();
+		}
+
+		//Write the events and counter samples as Chrome trace JSON (chrome://tracing, Perfetto). Returns false when 
+		//the file could not be written.
+		inline bool write_trace(const std::string& filename)
+		{
+			if constexpr (!ON) return false;
+
+			auto& r = priv::registry();
+			std::lock_guard<std::mutex> lock(r.mutex);
+			std::ofstream file(filename, std::ios::out | std::ios::trunc);
+			if (!file.good()) return false;
+
+			file << "{\"traceEvents\":[";
+			bool first = true;
+			file << std::fixed << std::setprecision(3);
+			for (const auto& log : r.thread_logs)
+			{
+				for (const auto& event : log->events)
+				{
+					file << (first ? "\n" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << log->thread_id
+						<< ",\"ts\":" << ((event.begin - r.origin) / 1e3) << ",\"dur\":" << ((event.end - event.begin) / 1e3) << "}";
+					first = false;
+				}
+			}
+			for (const auto& sample : r.samples)
+			{
+				for (size_t i = 0; i < sample.values.size(); ++i)
+				{
+					file << (first ? "\n" : ",\n") << "{\"name\":\"" << r.counter_names[i] << "\",\"ph\":\"C\",\"pid\":0,\"ts\":" << ((sample.time - r.origin) / 1e3)
+						<< ",\"args\":{\"value\":" << sample.values[i] << "}}";
+					first = false;
+				}
+			}
+			file << "\n]}\n";
+			return file.good();
+		}
 	}
 }
\ No newline at end of file
@@ -16,6 +16,9 @@
 
 #pragma once
 #include <iostream>		// std::cout
+#include <algorithm>	// std::min
+#include <array>
+#include <cstdint>
 #include <intrin.h>
 
 #include "assert.ipp"
@@ -49,6 +52,34 @@ namespace tools
 				return j;
 			}
 
+			inline __m256i lfsr32_galois_avx2(const __m256i i)
+			{
+				const __m256i lsb = _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(i, _mm256_set1_epi32(1)));
+				return _mm256_xor_si256(_mm256_srli_epi32(i, 1), _mm256_and_si256(lsb, _mm256_set1_epi32(0xD0000001u)));
+			}
+
+			inline __m512i lfsr32_galois_avx512(const __m512i i)
+			{
+				const __m512i lsb = _mm512_sub_epi32(_mm512_setzero_si512(), _mm512_and_si512(i, _mm512_set1_epi32(1)));
+				return _mm512_xor_si512(_mm512_srli_epi32(i, 1), _mm512_and_si512(lsb, _mm512_set1_epi32(0xD0000001u)));
+			}
+
+			//Remainder of four unsigned ints: a double holds them exactly, and below 2^53 the rounded quotient does not 
+			//cross an integer, such that the floor of the quotient is the integer quotient.
+			inline __m128i rem_epu32_avx2(const __m128i number, const __m256d range)
+			{
+				const __m256d number_pd = _mm256_add_pd(_mm256_cvtepi32_pd(_mm_xor_si128(number, _mm_set1_epi32(0x80000000))), _mm256_set1_pd(2147483648.0));
+				const __m256d quotient = _mm256_floor_pd(_mm256_div_pd(number_pd, range));
+				return _mm256_cvttpd_epi32(_mm256_sub_pd(number_pd, _mm256_mul_pd(quotient, range)));
+			}
+
+			inline __m256i rem_epu32_avx512(const __m256i number, const __m512d range)
+			{
+				const __m512d number_pd = _mm512_cvtepu32_pd(number);
+				const __m512d quotient = _mm512_roundscale_pd(_mm512_div_pd(number_pd, range), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+				return _mm512_cvttpd_epi32(_mm512_sub_pd(number_pd, _mm512_mul_pd(quotient, range)));
+			}
+
 			inline __m128i lfsr32_galois_sse(const __m128i i)
 			{
 				const __m128i i1 = _mm_and_si128(i, _mm_set1_epi32(1u));
@@ -208,5 +239,110 @@ namespace tools
 			}
 			return i;
 		}
+
+		#pragma region Random streams
+		//The overloads above with an unsigned int& draw from a random stream owned by the caller (e.g. one per column),
+		//the others from the global priv::current_random_number, which is not thread safe and depends on the order in 
+		//which threads draw. Seed streams with stream_seed such that a run is reproducible for any number of threads.
+
+		//Initial state of stream stream_i of a seed; the states of different streams are uncorrelated (splitmix64), 
+		//and never zero, the fixed point of the LFSR.
+		inline unsigned int stream_seed(const uint64_t seed, const uint64_t stream_i)
+		{
+			uint64_t z = seed + ((stream_i + 1) * 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			z = z ^ (z >> 31);
+			const unsigned int result = static_cast<unsigned int>(z ^ (z >> 32));
+			return (result == 0) ? 0xACE1ACE1 : result;
+		}
+
+		//Sixteen random streams that the bulk generators advance together. Element k of a fill is drawn from lane 
+		//k % 16, such that the ref, avx2 and avx512 versions give the same numbers, and lane l gives the numbers 
+		//rand_int32 would give with state[l].
+		struct Random_Lanes
+		{
+			static constexpr int N_LANES = 16;
+			alignas(64) std::array<unsigned int, N_LANES> state;
+
+			Random_Lanes(const uint64_t seed = 0xACE1ACE1, const uint64_t stream_i = 0)
+			{
+				this->seed(seed, stream_i);
+			}
+			void seed(const uint64_t seed, const uint64_t stream_i)
+			{
+				for (int lane_i = 0; lane_i < N_LANES; ++lane_i) this->state[lane_i] = stream_seed(seed, (stream_i * N_LANES) + lane_i);
+			}
+		};
+
+		//Fill out[0..n) with random ints between min and max (inclusive, max - min < 2^31); every lane is advanced 
+		//once per (started) block of 16 elements.
+		inline void fill_rand_int32_ref(const int min, const int max, const int n, int * const out, Random_Lanes& lanes)
+		{
+			const unsigned int range = static_cast<unsigned int>(max - min + 1);
+			for (int block_i = 0; block_i < n; block_i += Random_Lanes::N_LANES)
+			{
+				for (int lane_i = 0; lane_i < Random_Lanes::N_LANES; ++lane_i)
+				{
+					if ((block_i + lane_i) < n) out[block_i + lane_i] = min + static_cast<int>(lanes.state[lane_i] % range);
+					lanes.state[lane_i] = next_rand(lanes.state[lane_i]);
+				}
+			}
+		}
+
+		inline void fill_rand_int32_avx2(const int min, const int max, const int n, int * const out, Random_Lanes& lanes)
+		{
+			const __m256d range = _mm256_set1_pd(static_cast<double>(static_cast<unsigned int>(max - min + 1)));
+			const __m256i min_epi32 = _mm256_set1_epi32(min);
+			__m256i state0 = _mm256_load_si256(reinterpret_cast<const __m256i *>(&lanes.state[0]));
+			__m256i state1 = _mm256_load_si256(reinterpret_cast<const __m256i *>(&lanes.state[8]));
+
+			for (int block_i = 0; block_i < n; block_i += Random_Lanes::N_LANES)
+			{
+				const __m256i result0 = _mm256_add_epi32(min_epi32, _mm256_set_m128i(
+					priv::rem_epu32_avx2(_mm256_extracti128_si256(state0, 1), range),
+					priv::rem_epu32_avx2(_mm256_castsi256_si128(state0), range)));
+				const __m256i result1 = _mm256_add_epi32(min_epi32, _mm256_set_m128i(
+					priv::rem_epu32_avx2(_mm256_extracti128_si256(state1, 1), range),
+					priv::rem_epu32_avx2(_mm256_castsi256_si128(state1), range)));
+
+				if ((block_i + Random_Lanes::N_LANES) <= n)
+				{
+					_mm256_storeu_si256(reinterpret_cast<__m256i *>(&out[block_i]), result0);
+					_mm256_storeu_si256(reinterpret_cast<__m256i *>(&out[block_i + 8]), result1);
+				}
+				else
+				{
+					alignas(32) std::array<int, Random_Lanes::N_LANES> tail;
+					_mm256_store_si256(reinterpret_cast<__m256i *>(&tail[0]), result0);
+					_mm256_store_si256(reinterpret_cast<__m256i *>(&tail[8]), result1);
+					for (int i = block_i; i < n; ++i) out[i] = tail[i - block_i];
+				}
+				state0 = priv::lfsr32_galois_avx2(state0);
+				state1 = priv::lfsr32_galois_avx2(state1);
+			}
+			_mm256_store_si256(reinterpret_cast<__m256i *>(&lanes.state[0]), state0);
+			_mm256_store_si256(reinterpret_cast<__m256i *>(&lanes.state[8]), state1);
+		}
+
+		inline void fill_rand_int32_avx512(const int min, const int max, const int n, int * const out, Random_Lanes& lanes)
+		{
+			const __m512d range = _mm512_set1_pd(static_cast<double>(static_cast<unsigned int>(max - min + 1)));
+			const __m512i min_epi32 = _mm512_set1_epi32(min);
+			__m512i state = _mm512_load_si512(&lanes.state[0]);
+
+			for (int block_i = 0; block_i < n; block_i += Random_Lanes::N_LANES)
+			{
+				const __m512i result = _mm512_add_epi32(min_epi32, _mm512_inserti64x4(
+					_mm512_castsi256_si512(priv::rem_epu32_avx512(_mm512_castsi512_si256(state), range)),
+					priv::rem_epu32_avx512(_mm512_extracti64x4_epi64(state, 1), range), 1));
+
+				const int n_elements = std::min(Random_Lanes::N_LANES, n - block_i);
+				_mm512_mask_storeu_epi32(&out[block_i], static_cast<__mmask16>((1u << n_elements) - 1), result);
+				state = priv::lfsr32_galois_avx512(state);
+			}
+			_mm512_store_si512(&lanes.state[0], state);
+		}
+		#pragma endregion
 	}
 }
\ No newline at end of file
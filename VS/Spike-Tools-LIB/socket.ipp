@@ -0,0 +1,322 @@
+// C++ port of Nupic HTM with the aim of being lite and fast
+//
+// Copyright (c) 2017 Henk-Jan Lebbink
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero Public License version 3 as
+// published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero Public License for more details.
+//
+// You should have received a copy of the GNU Affero Public License
+// along with this program.  If not, see http://www.gnu.org/licenses.
+
+#pragma once
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <signal.h>
+#endif
+
+namespace tools
+{
+	//Blocking TCP connections that exchange lines of text, and a listener that accepts them.
+	namespace socket
+	{
+		namespace priv
+		{
+#ifdef _WIN32
+			using Handle = SOCKET;
+			static const Handle INVALID_HANDLE = INVALID_SOCKET;
+
+			inline void close_handle(const Handle handle)
+			{
+				::closesocket(handle);
+			}
+
+			struct Startup
+			{
+				Startup()
+				{
+					WSADATA data;
+					::WSAStartup(MAKEWORD(2, 2), &data);
+				}
+				~Startup()
+				{
+					::WSACleanup();
+				}
+			};
+			inline void startup()
+			{
+				static Startup startup;
+			}
+
+			inline int poll(pollfd * const fds, const size_t n_fds, const int timeout_ms)
+			{
+				return ::WSAPoll(fds, static_cast<ULONG>(n_fds), timeout_ms);
+			}
+#else
+			using Handle = int;
+			static const Handle INVALID_HANDLE = -1;
+
+			inline void close_handle(const Handle handle)
+			{
+				::close(handle);
+			}
+
+			inline void startup()
+			{
+				// a send to a closed connection returns an error instead of terminating the process
+				static const bool ignored = (::signal(SIGPIPE, SIG_IGN), true);
+				(void)ignored;
+			}
+
+			inline int poll(pollfd * const fds, const size_t n_fds, const int timeout_ms)
+			{
+				return ::poll(fds, static_cast<nfds_t>(n_fds), timeout_ms);
+			}
+#endif
+		}
+
+		using Handle = priv::Handle;
+
+		class Connection
+		{
+		public:
+			Connection() = default;
+			explicit Connection(const Handle handle)
+				: handle_(handle)
+			{
+				if (this->is_open())
+				{
+					int flag = 1;
+					::setsockopt(this->handle_, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&flag), sizeof(flag));
+				}
+			}
+			~Connection()
+			{
+				this->close();
+			}
+			Connection(Connection&& other)
+				: handle_(other.handle_)
+				, buffer_(std::move(other.buffer_))
+			{
+				other.handle_ = priv::INVALID_HANDLE;
+			}
+			Connection& operator=(Connection&& other)
+			{
+				if (this != &other)
+				{
+					this->close();
+					this->handle_ = other.handle_;
+					this->buffer_ = std::move(other.buffer_);
+					other.handle_ = priv::INVALID_HANDLE;
+				}
+				return *this;
+			}
+			Connection(const Connection&) = delete;
+			Connection& operator=(const Connection&) = delete;
+
+			bool is_open() const
+			{
+				return this->handle_ != priv::INVALID_HANDLE;
+			}
+			Handle handle() const
+			{
+				return this->handle_;
+			}
+			void close()
+			{
+				if (!this->is_open()) return;
+				priv::close_handle(this->handle_);
+				this->handle_ = priv::INVALID_HANDLE;
+				this->buffer_.clear();
+			}
+
+			//Send the line followed by a newline; returns false when the connection is broken.
+			bool send_line(const std::string& line)
+			{
+				if (!this->is_open()) return false;
+				const std::string data = line + "\n";
+				size_t pos = 0;
+				while (pos < data.size())
+				{
+					const int n = static_cast<int>(::send(this->handle_, data.data() + pos, static_cast<int>(data.size() - pos), 0));
+					if (n <= 0) return false;
+					pos += n;
+				}
+				return true;
+			}
+
+			//Receive the bytes that are available (blocks when none are); returns false when the connection is closed or broken,
+			//or when the peer sent more than MAX_LINE_LENGTH bytes without a newline.
+			bool receive_available()
+			{
+				if (!this->is_open()) return false;
+				char data[4096];
+				const int n = static_cast<int>(::recv(this->handle_, data, sizeof(data), 0));
+				if (n <= 0) return false;
+				this->buffer_.append(data, n);
+				return (this->buffer_.size() <= MAX_LINE_LENGTH) || (this->buffer_.find('\n') != std::string::npos);
+			}
+
+			//Take the next complete line (without newline) from the received bytes; returns false when there is none.
+			bool next_line(std::string& line)
+			{
+				const size_t pos = this->buffer_.find('\n');
+				if (pos == std::string::npos) return false;
+				line = this->buffer_.substr(0, pos);
+				this->buffer_.erase(0, pos + 1);
+				return true;
+			}
+
+			//Receive the next line; blocks until it is complete. Returns false when the connection is closed or broken.
+			bool receive_line(std::string& line)
+			{
+				while (!this->next_line(line))
+				{
+					if (!this->receive_available()) return false;
+				}
+				return true;
+			}
+
+		private:
+			//Longest line that is received; a peer that sends a longer line is considered broken, such that the buffer
+			//of received bytes cannot grow without bound.
+			static constexpr size_t MAX_LINE_LENGTH = 1 << 20;
+
+			Handle handle_ = priv::INVALID_HANDLE;
+			std::string buffer_;
+		};
+
+		class Listener
+		{
+		public:
+			Listener() = default;
+			~Listener()
+			{
+				this->close();
+			}
+			Listener(const Listener&) = delete;
+			Listener& operator=(const Listener&) = delete;
+
+			//Listen on the provided port of the loopback interface, or of all interfaces when local_only is false.
+			bool listen(const int port, const bool local_only = true)
+			{
+				priv::startup();
+				this->close();
+				this->handle_ = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+				if (this->handle_ == priv::INVALID_HANDLE) return false;
+
+				int flag = 1;
+				::setsockopt(this->handle_, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&flag), sizeof(flag));
+
+				sockaddr_in address;
+				std::memset(&address, 0, sizeof(address));
+				address.sin_family = AF_INET;
+				address.sin_addr.s_addr = htonl(local_only ? INADDR_LOOPBACK : INADDR_ANY);
+				address.sin_port = htons(static_cast<unsigned short>(port));
+
+				if ((::bind(this->handle_, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) || (::listen(this->handle_, SOMAXCONN) != 0))
+				{
+					this->close();
+					return false;
+				}
+				return true;
+			}
+			bool is_open() const
+			{
+				return this->handle_ != priv::INVALID_HANDLE;
+			}
+			Handle handle() const
+			{
+				return this->handle_;
+			}
+			void close()
+			{
+				if (!this->is_open()) return;
+				priv::close_handle(this->handle_);
+				this->handle_ = priv::INVALID_HANDLE;
+			}
+
+			//Accept the next connection; blocks when there is none.
+			Connection accept()
+			{
+				return Connection(::accept(this->handle_, nullptr, nullptr));
+			}
+
+		private:
+			Handle handle_ = priv::INVALID_HANDLE;
+		};
+
+		//Connect to the provided host and port; the connection is not open when the host cannot be reached.
+		inline Connection connect(const std::string& host, const int port)
+		{
+			priv::startup();
+			addrinfo hints;
+			std::memset(&hints, 0, sizeof(hints));
+			hints.ai_family = AF_INET;
+			hints.ai_socktype = SOCK_STREAM;
+			hints.ai_protocol = IPPROTO_TCP;
+
+			addrinfo * info = nullptr;
+			if (::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &info) != 0) return Connection();
+
+			Connection result;
+			for (addrinfo * i = info; (i != nullptr) && !result.is_open(); i = i->ai_next)
+			{
+				const Handle handle = ::socket(i->ai_family, i->ai_socktype, i->ai_protocol);
+				if (handle == priv::INVALID_HANDLE) continue;
+				if (::connect(handle, i->ai_addr, static_cast<int>(i->ai_addrlen)) == 0)
+				{
+					result = Connection(handle);
+				}
+				else
+				{
+					priv::close_handle(handle);
+				}
+			}
+			::freeaddrinfo(info);
+			return result;
+		}
+
+		//Wait at most timeout_ms milliseconds until one of the handles can be read without blocking (data, a closed
+		//connection, or for a listener a pending connection). Returns for every handle whether it can be read. Uses
+		//poll (WSAPoll on Windows), such that any handle value and any number of handles can be waited for.
+		inline std::vector<bool> wait_readable(const std::vector<Handle>& handles, const int timeout_ms)
+		{
+			std::vector<pollfd> fds(handles.size());
+			for (size_t i = 0; i < handles.size(); ++i)
+			{
+				fds[i].fd = handles[i];
+				fds[i].events = POLLIN;
+				fds[i].revents = 0;
+			}
+			std::vector<bool> result(handles.size(), false);
+			if (priv::poll(fds.data(), fds.size(), timeout_ms) <= 0) return result;
+
+			for (size_t i = 0; i < handles.size(); ++i)
+			{
+				result[i] = (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+			}
+			return result;
+		}
+	}
+}
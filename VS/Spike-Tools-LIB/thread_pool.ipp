@@ -0,0 +1,209 @@
+// C++ port of Nupic HTM with the aim of being lite and fast
+//
+// Copyright (c) 2017 Henk-Jan Lebbink
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero Public License version 3 as
+// published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// See the GNU Affero Public License for more details.
+//
+// You should have received a copy of the GNU Affero Public License
+// along with this program.  If not, see http://www.gnu.org/licenses.
+
+#pragma once
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
+
+namespace tools
+{
+	namespace thread_pool
+	{
+		//Pool of worker threads that execute a parallel for loop over chunks of items. The thread that calls
+		//parallel_for also executes chunks. Chunks are claimed with one atomic counter, such that a thread that
+		//finishes early takes the next free chunk; each item is executed exactly once by exactly one thread.
+		class Thread_Pool
+		{
+		public:
+			explicit Thread_Pool(const int n_threads)
+				: n_threads_(std::max(1, n_threads))
+			{
+				for (int i = 1; i < this->n_threads_; ++i)
+				{
+					this->workers_.emplace_back([this]() { this->worker_loop(); });
+				}
+			}
+			~Thread_Pool()
+			{
+				{
+					std::lock_guard<std::mutex> lock(this->mutex_);
+					this->stop_ = true;
+				}
+				this->cv_start_.notify_all();
+				for (auto& worker : this->workers_) worker.join();
+			}
+			Thread_Pool(const Thread_Pool&) = delete;
+			Thread_Pool& operator=(const Thread_Pool&) = delete;
+
+			int n_threads() const
+			{
+				return this->n_threads_;
+			}
+
+			//Call job(begin, end) for consecutive ranges of at most chunk_size items that together cover [0, n_items).
+			//Returns when all ranges have been executed. Calls from different threads are serialized; a call from inside a
+			//job of this pool runs all ranges on the calling thread (instead of waiting for itself). The job is called
+			//through a plain function pointer (and not a std::function) such that a call does not allocate.
+			template <typename F>
+			void parallel_for(const int n_items, const int chunk_size, const F& job)
+			{
+				if (n_items <= 0) return;
+				const int chunk = std::max(1, chunk_size);
+				const int n_chunks = (n_items + chunk - 1) / chunk;
+
+				if ((this->n_threads_ == 1) || (n_chunks == 1) || (running_pool_ == this))
+				{
+					job(0, n_items);
+					return;
+				}
+
+				std::lock_guard<std::mutex> call_lock(this->call_mutex_);
+				{
+					std::lock_guard<std::mutex> lock(this->mutex_);
+					this->job_ = &job;
+					this->call_job_ = [](const void * job_ptr, const int begin, const int end) { (*static_cast<const F *>(job_ptr))(begin, end); };
+					this->n_items_ = n_items;
+					this->chunk_size_ = chunk;
+					this->n_chunks_ = n_chunks;
+					this->next_chunk_.store(0, std::memory_order_relaxed);
+					this->n_busy_workers_ = static_cast<int>(this->workers_.size());
+					this->generation_++;
+				}
+				this->cv_start_.notify_all();
+
+				running_pool_ = this;
+				this->run_chunks();
+				running_pool_ = nullptr;
+
+				std::unique_lock<std::mutex> lock(this->mutex_);
+				this->cv_done_.wait(lock, [this]() { return this->n_busy_workers_ == 0; });
+				this->job_ = nullptr;
+			}
+
+		private:
+			const int n_threads_;
+			std::vector<std::thread> workers_;
+
+			std::mutex call_mutex_;
+			std::mutex mutex_;
+			std::condition_variable cv_start_;
+			std::condition_variable cv_done_;
+
+			const void * job_ = nullptr;
+			void (*call_job_)(const void *, int, int) = nullptr;
+			int n_items_ = 0;
+			int chunk_size_ = 0;
+			int n_chunks_ = 0;
+			std::atomic<int> next_chunk_{ 0 };
+			int n_busy_workers_ = 0;
+			unsigned long long generation_ = 0;
+			bool stop_ = false;
+
+			static inline thread_local const Thread_Pool * running_pool_ = nullptr; // pool whose chunks this thread executes
+
+			void run_chunks()
+			{
+				while (true)
+				{
+					const int chunk_i = this->next_chunk_.fetch_add(1, std::memory_order_relaxed);
+					if (chunk_i >= this->n_chunks_) return;
+					const int begin = chunk_i * this->chunk_size_;
+					const int end = std::min(this->n_items_, begin + this->chunk_size_);
+					this->call_job_(this->job_, begin, end);
+				}
+			}
+
+			void worker_loop()
+			{
+				running_pool_ = this;
+				unsigned long long seen_generation = 0;
+				while (true)
+				{
+					{
+						std::unique_lock<std::mutex> lock(this->mutex_);
+						this->cv_start_.wait(lock, [&]() { return this->stop_ || (this->generation_ != seen_generation); });
+						if (this->stop_) return;
+						seen_generation = this->generation_;
+					}
+
+					this->run_chunks();
+
+					bool last = false;
+					{
+						std::lock_guard<std::mutex> lock(this->mutex_);
+						this->n_busy_workers_--;
+						last = (this->n_busy_workers_ == 0);
+					}
+					if (last) this->cv_done_.notify_one();
+				}
+			}
+		};
+
+		//Barrier for a fixed number of threads that is reused for every phase of a computation. A thread that arrives
+		//spins (and yields) until the last thread arrives; all writes before the barrier are visible after it.
+		class Barrier
+		{
+		public:
+			explicit Barrier(const int n_threads)
+				: n_threads_(std::max(1, n_threads))
+			{}
+			Barrier(const Barrier&) = delete;
+			Barrier& operator=(const Barrier&) = delete;
+
+			void arrive_and_wait()
+			{
+				const unsigned int generation = this->generation_.load(std::memory_order_acquire);
+				if (this->n_arrived_.fetch_add(1, std::memory_order_acq_rel) == (this->n_threads_ - 1))
+				{
+					this->n_arrived_.store(0, std::memory_order_relaxed);
+					this->generation_.fetch_add(1, std::memory_order_release);
+				}
+				else
+				{
+					while (this->generation_.load(std::memory_order_acquire) == generation) std::this_thread::yield();
+				}
+			}
+
+		private:
+			const int n_threads_;
+			std::atomic<int> n_arrived_{ 0 };
+			std::atomic<unsigned int> generation_{ 0 };
+		};
+
+		namespace priv
+		{
+			inline std::mutex pool_mutex;
+			inline std::vector<std::unique_ptr<Thread_Pool>> pools; // pools[n_threads]; a pool is never destroyed before exit
+		}
+
+		//Get the shared pool with the provided number of threads (including the calling thread). There is one pool per
+		//number of threads; it is created by the first call with that number and lives until the program exits, such that
+		//a pool can never be destroyed while another thread is inside its parallel_for.
+		inline Thread_Pool& get_pool(const int n_threads)
+		{
+			const int n = std::max(1, n_threads);
+			std::lock_guard<std::mutex> lock(priv::pool_mutex);
+			if (static_cast<int>(priv::pools.size()) <= n) priv::pools.resize(n + 1);
+			if (!priv::pools[n]) priv::pools[n] = std::make_unique<Thread_Pool>(n);
+			return *priv::pools[n];
+		}
+	}
+}
@@ -19,6 +19,9 @@
 #ifndef NOMINMAX
 #define NOMINMAX
 #endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN		// windows.h without winsock.h, such that winsock2.h can be included later
+#endif
 #include <windows.h>
 #else
 #include <x86intrin.h>